@@ -0,0 +1,21 @@
+#include "asic_dispatch.h"
+
+/// @brief the chain with the shortest job queue
+/// @return index of the chain, -1 if every queue is at or above the low water mark
+int ASIC_dispatch_chain_needing_work(const int * queue_counts, int chain_count, int low_water_mark)
+{
+    int emptiest = -1;
+    for (int i = 0; i < chain_count; i++) {
+        if (queue_counts[i] < low_water_mark && (emptiest < 0 || queue_counts[i] < queue_counts[emptiest])) {
+            emptiest = i;
+        }
+    }
+    return emptiest;
+}
+
+/// @brief advances the job id of one chain, every chain keeps its own so their ids never collide in a result lookup
+uint8_t ASIC_dispatch_next_job_id(uint8_t * last_job_id, uint8_t step)
+{
+    *last_job_id = (*last_job_id + step) % ASIC_DISPATCH_JOB_IDS;
+    return *last_job_id;
+}
@@ -0,0 +1,47 @@
+#include <stdbool.h>
+#include <string.h>
+
+#include "asic_frame.h"
+#include "crc.h"
+#include "mining.h"
+
+_Static_assert(ASIC_FRAME_MAX_LEN <= BM_JOB_PACKET_MAX_LEN, "bm_job packet buffer too small for ASIC job frames");
+
+uint8_t ASIC_frame_build(uint8_t *buf, uint8_t header, const uint8_t *data, uint8_t data_len)
+{
+    bool is_job = (header & ASIC_FRAME_TYPE_JOB) != 0;
+
+    // add the preamble
+    buf[0] = 0x55;
+    buf[1] = 0xAA;
+
+    // add the header field
+    buf[2] = header;
+
+    // add the length field
+    buf[3] = is_job ? (data_len + 4) : (data_len + 3);
+
+    // add the data
+    memcpy(buf + 4, data, data_len);
+
+    // add the correct crc type
+    if (is_job) {
+        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
+        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
+        buf[5 + data_len] = crc16_total & 0xFF;
+        return data_len + 6;
+    }
+
+    buf[4 + data_len] = crc5(buf + 2, data_len + 2);
+    return data_len + 5;
+}
+
+void ASIC_frame_set_job_id(uint8_t *buf, uint8_t len, uint8_t job_id)
+{
+    // the job id is the first payload byte
+    buf[4] = job_id;
+
+    uint16_t crc16_total = crc16_false(buf + 2, len - 4);
+    buf[len - 2] = (crc16_total >> 8) & 0xFF;
+    buf[len - 1] = crc16_total & 0xFF;
+}
@@ -0,0 +1,113 @@
+#include <math.h>
+#include <string.h>
+
+#include "asic_hashrate.h"
+
+static const uint32_t window_seconds[ASIC_HASHRATE_WINDOWS] = {60, 600, 3600, 86400};
+
+void ASIC_hashrate_init(AsicHashrate * hashrate, int64_t now_us)
+{
+    memset(hashrate, 0, sizeof(*hashrate));
+    hashrate->start_us = now_us;
+
+    for (int i = 0; i < ASIC_HASHRATE_WINDOWS; i++) {
+        hashrate->windows[i].bucket_us = (int64_t) window_seconds[i] * 1000000 / ASIC_HASHRATE_BUCKETS;
+    }
+}
+
+/// @brief moves the ring forward to the bucket of now, clearing what fell out of the window
+static void _advance(AsicHashrateWindow * window, int64_t elapsed_us)
+{
+    int64_t bucket = elapsed_us / window->bucket_us;
+
+    // a long quiet spell clears the ring once instead of bucket by bucket
+    if (bucket - window->head >= ASIC_HASHRATE_BUCKETS) {
+        memset(window->work, 0, sizeof(window->work));
+        memset(window->nonces, 0, sizeof(window->nonces));
+        window->work_sum = 0;
+        window->nonce_sum = 0;
+        window->head = bucket;
+        return;
+    }
+
+    while (window->head < bucket) {
+        window->head++;
+        int slot = window->head % ASIC_HASHRATE_BUCKETS;
+        window->work_sum -= window->work[slot];
+        window->nonce_sum -= window->nonces[slot];
+        window->work[slot] = 0;
+        window->nonces[slot] = 0;
+    }
+}
+
+/// @brief counts a nonce toward every window
+/// @param ticket_difficulty mask the nonce was found under, every nonce stands for that many diff 1 shares
+void ASIC_hashrate_record(AsicHashrate * hashrate, uint32_t ticket_difficulty, int64_t now_us)
+{
+    int64_t elapsed_us = now_us - hashrate->start_us;
+
+    hashrate->last_difficulty = ticket_difficulty;
+
+    for (int i = 0; i < ASIC_HASHRATE_WINDOWS; i++) {
+        AsicHashrateWindow * window = &hashrate->windows[i];
+        _advance(window, elapsed_us);
+
+        int slot = window->head % ASIC_HASHRATE_BUCKETS;
+        window->work[slot] += ticket_difficulty;
+        window->nonces[slot]++;
+        window->work_sum += ticket_difficulty;
+        window->nonce_sum++;
+    }
+}
+
+/// @brief 95% bounds of the mean of a Poisson count, exact up to a count of 1 and Byar's approximation above,
+/// which is off by less than 1% of the bounds from a count of 5
+void ASIC_hashrate_poisson_bounds(uint32_t count, double * lower, double * upper)
+{
+    double n = count;
+    double z = ASIC_HASHRATE_CONFIDENCE_Z;
+
+    if (count == 0) {
+        *lower = 0;
+        *upper = -log(0.025);
+        return;
+    }
+
+    *lower = count == 1 ? -log(0.975) : n * pow(1 - 1 / (9 * n) - z / (3 * sqrt(n)), 3);
+    *upper = (n + 1) * pow(1 - 1 / (9 * (n + 1)) + z / (3 * sqrt(n + 1)), 3);
+}
+
+/// @brief hashrate over one window with its confidence bounds
+/// @param window 0 to ASIC_HASHRATE_WINDOWS - 1, from the shortest
+void ASIC_hashrate_estimate(AsicHashrate * hashrate, int window, int64_t now_us, AsicHashrateEstimate * estimate)
+{
+    AsicHashrateWindow * ring = &hashrate->windows[window];
+    int64_t elapsed_us = now_us - hashrate->start_us;
+
+    _advance(ring, elapsed_us);
+
+    // the full buckets behind the head and the part of the head that passed
+    int64_t covered_us = (ASIC_HASHRATE_BUCKETS - 1) * ring->bucket_us + elapsed_us - ring->head * ring->bucket_us;
+    if (covered_us > elapsed_us) {
+        covered_us = elapsed_us;
+    }
+
+    memset(estimate, 0, sizeof(*estimate));
+    estimate->window_s = window_seconds[window];
+    estimate->seconds = covered_us / 1e6;
+    estimate->nonces = ring->nonce_sum;
+
+    if (covered_us <= 0) {
+        return;
+    }
+
+    // every diff 1 share takes 2^32 hashes on average
+    double hashes_per_nonce = 4294967296.0 * (ring->nonce_sum > 0 ? (double) ring->work_sum / ring->nonce_sum : hashrate->last_difficulty);
+    double scale = hashes_per_nonce / estimate->seconds / 1e9;
+    double lower, upper;
+
+    ASIC_hashrate_poisson_bounds(ring->nonce_sum, &lower, &upper);
+    estimate->hashrate = (double) ring->work_sum * 4294967296.0 / estimate->seconds / 1e9;
+    estimate->lower = lower * scale;
+    estimate->upper = upper * scale;
+}
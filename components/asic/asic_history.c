@@ -0,0 +1,159 @@
+#include <string.h>
+
+#include "asic_history.h"
+
+static const uint32_t tier_period_s[ASIC_HISTORY_TIERS] = {10, 60, 900};
+static const uint16_t tier_capacity[ASIC_HISTORY_TIERS] = {360, 1440, 2880};
+
+static uint16_t _saturate(uint32_t value)
+{
+    return value > UINT16_MAX ? UINT16_MAX : value;
+}
+
+static void _clear_open(AsicHistoryTier * tier)
+{
+    memset(tier->sums, 0, sizeof(tier->sums));
+    tier->shares_accepted = 0;
+    tier->shares_rejected = 0;
+    tier->hw_errors = 0;
+    tier->records = 0;
+}
+
+/// @brief the sample of the period still being recorded
+static void _open_sample(const AsicHistoryTier * tier, AsicHistorySample * sample)
+{
+    memset(sample, 0, sizeof(*sample));
+    if (tier->records == 0) {
+        return;
+    }
+
+    sample->hashrate = tier->sums[0] / tier->records;
+    sample->power = tier->sums[1] / tier->records;
+    sample->chip_temp = tier->sums[2] / tier->records;
+    sample->vr_temp = tier->sums[3] / tier->records;
+    sample->fan_rpm = tier->sums[4] / tier->records;
+    sample->shares_accepted = _saturate(tier->shares_accepted);
+    sample->shares_rejected = _saturate(tier->shares_rejected);
+    sample->hw_errors = _saturate(tier->hw_errors);
+    sample->records = tier->records;
+}
+
+/// @brief closes the open period into the ring, periods skipped since the last one are kept empty
+static void _close(AsicHistoryTier * tier)
+{
+    int64_t period = tier->open_period;
+
+    if (tier->head >= 0) {
+        int64_t gap = period - tier->head - 1;
+        if (gap > tier->capacity) {
+            gap = tier->capacity;
+        }
+        for (int64_t p = period - gap; p < period; p++) {
+            memset(&tier->samples[p % tier->capacity], 0, sizeof(AsicHistorySample));
+        }
+    }
+
+    _open_sample(tier, &tier->samples[period % tier->capacity]);
+    tier->head = period;
+    _clear_open(tier);
+}
+
+/// @param samples backing store of every tier, about 130 KB so it is best kept in PSRAM
+void ASIC_history_init(AsicHistory * history, AsicHistorySample samples[ASIC_HISTORY_SAMPLES])
+{
+    memset(history, 0, sizeof(*history));
+    memset(samples, 0, sizeof(AsicHistorySample) * ASIC_HISTORY_SAMPLES);
+
+    for (int i = 0; i < ASIC_HISTORY_TIERS; i++) {
+        AsicHistoryTier * tier = &history->tiers[i];
+        tier->period_s = tier_period_s[i];
+        tier->capacity = tier_capacity[i];
+        tier->samples = samples;
+        tier->head = -1;
+        samples += tier->capacity;
+    }
+}
+
+/// @brief adds a record to every tier, a tier closes its sample once the record falls into a later period
+/// @param record instantaneous readings, and the shares and errors since the previous record
+void ASIC_history_record(AsicHistory * history, const AsicHistorySample * record, uint32_t uptime_s)
+{
+    for (int i = 0; i < ASIC_HISTORY_TIERS; i++) {
+        AsicHistoryTier * tier = &history->tiers[i];
+        int64_t period = uptime_s / tier->period_s;
+
+        if (tier->records > 0 && period > tier->open_period) {
+            _close(tier);
+        }
+        tier->open_period = period;
+
+        tier->sums[0] += record->hashrate;
+        tier->sums[1] += record->power;
+        tier->sums[2] += record->chip_temp;
+        tier->sums[3] += record->vr_temp;
+        tier->sums[4] += record->fan_rpm;
+        tier->shares_accepted += record->shares_accepted;
+        tier->shares_rejected += record->shares_rejected;
+        tier->hw_errors += record->hw_errors;
+        tier->records++;
+    }
+}
+
+/// @brief the finest tier that holds range_s at no finer than resolution_s, or -1 if none holds it
+int ASIC_history_tier_for(uint32_t resolution_s, uint32_t range_s)
+{
+    for (int i = 0; i < ASIC_HISTORY_TIERS; i++) {
+        if (tier_period_s[i] >= resolution_s && (uint64_t) tier_period_s[i] * tier_capacity[i] >= range_s) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// @brief the samples of a tier covering the last range_s, the open period included as the newest
+/// @param first_period set to the period of the oldest sample
+/// @return the number of samples, consecutive periods from first_period
+uint32_t ASIC_history_range(const AsicHistory * history, int tier_index, uint32_t range_s, int64_t * first_period)
+{
+    const AsicHistoryTier * tier = &history->tiers[tier_index];
+
+    if (tier->records == 0 && tier->head < 0) {
+        *first_period = 0;
+        return 0;
+    }
+
+    int64_t last = tier->records > 0 ? tier->open_period : tier->head;
+    int64_t count = (range_s + tier->period_s - 1) / tier->period_s;
+    // closed samples older than the ring were overwritten, the open period has no slot yet
+    int64_t held = tier->head < 0 ? 1 : (last - tier->head) + tier->capacity;
+    if (count > held) {
+        count = held;
+    }
+    if (count > last + 1) {
+        count = last + 1;
+    }
+    if (count < 1) {
+        count = 1;
+    }
+
+    *first_period = last - count + 1;
+    return count;
+}
+
+/// @return false if the period is not held, an empty period reads as a sample without records
+bool ASIC_history_get(const AsicHistory * history, int tier_index, int64_t period, AsicHistorySample * sample)
+{
+    const AsicHistoryTier * tier = &history->tiers[tier_index];
+
+    if (tier->records > 0 && period == tier->open_period) {
+        _open_sample(tier, sample);
+        return true;
+    }
+
+    if (tier->head < 0 || period > tier->head || period <= tier->head - tier->capacity || period < 0) {
+        return false;
+    }
+
+    *sample = tier->samples[period % tier->capacity];
+    return true;
+}
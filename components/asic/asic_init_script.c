@@ -0,0 +1,114 @@
+#include "asic_init_script.h"
+
+#include "asic_frame.h"
+
+/// @brief prepares a script to be run against a chain
+/// @param chip_count chips on the chain, the address space is split evenly between them
+/// @param shadow register shadow of the chain, NULL to send every write
+void ASIC_init_script_start(AsicInitScript * script, const AsicInitStep * steps, int step_count, uint16_t chip_count,
+                            AsicRegisterShadow * shadow)
+{
+    script->steps = steps;
+    script->step_count = step_count;
+    script->chip_count = chip_count;
+    script->address_interval = chip_count > 0 ? 256 / chip_count : 0;
+    script->shadow = shadow;
+    script->step = 0;
+    script->loop_start = -1;
+    script->chip = 0;
+    script->next_address = 0;
+}
+
+static int _end_of_loop(const AsicInitScript * script, int step)
+{
+    while (step < script->step_count && script->steps[step].op != ASIC_INIT_OP_END_FOR_EACH) {
+        step++;
+    }
+    return step;
+}
+
+/// @brief assembles the next batch of frames, up to the next delay or until buf is full
+/// @param buf at least ASIC_INIT_FRAME_MAX_LEN bytes
+/// @param len set to the number of bytes to send
+/// @param delay_ms set to the time to wait after sending, 0 if none
+/// @return false once the script has run to its end and there is nothing left to send
+bool ASIC_init_script_next(AsicInitScript * script, uint8_t * buf, size_t size, size_t * len, uint32_t * delay_ms)
+{
+    *len = 0;
+    *delay_ms = 0;
+
+    while (script->step < script->step_count) {
+        const AsicInitStep * step = &script->steps[script->step];
+
+        switch (step->op) {
+            case ASIC_INIT_OP_DELAY:
+                script->step++;
+                *delay_ms = step->value;
+                return true;
+
+            case ASIC_INIT_OP_FOR_EACH_CHIP:
+                if (script->chip_count == 0) {
+                    script->step = _end_of_loop(script, script->step) + 1;
+                } else {
+                    script->loop_start = ++script->step;
+                    script->chip = 0;
+                }
+                break;
+
+            case ASIC_INIT_OP_END_FOR_EACH:
+                if (script->loop_start >= 0 && ++script->chip < script->chip_count) {
+                    script->step = script->loop_start;
+                } else {
+                    script->loop_start = -1;
+                    script->chip = 0;
+                    script->step++;
+                }
+                break;
+
+            case ASIC_INIT_OP_SET_ADDRESSES:
+                while (script->next_address < script->chip_count) {
+                    if (size - *len < ASIC_INIT_FRAME_MAX_LEN) {
+                        return true;
+                    }
+                    uint8_t data[2] = {script->next_address * script->address_interval, 0x00};
+                    *len += ASIC_frame_build(buf + *len, ASIC_INIT_HEADER_SET_ADDRESS, data, sizeof(data));
+                    script->next_address++;
+                }
+                script->next_address = 0;
+                script->step++;
+                break;
+
+            case ASIC_INIT_OP_CHAIN_INACTIVE: {
+                if (size - *len < ASIC_INIT_FRAME_MAX_LEN) {
+                    return true;
+                }
+                uint8_t data[2] = {0x00, 0x00};
+                *len += ASIC_frame_build(buf + *len, ASIC_INIT_HEADER_INACTIVE, data, sizeof(data));
+                script->step++;
+                break;
+            }
+
+            case ASIC_INIT_OP_WRITE_ALL:
+            case ASIC_INIT_OP_WRITE_CHIP: {
+                if (size - *len < ASIC_INIT_FRAME_MAX_LEN) {
+                    return true;
+                }
+                bool all = step->op == ASIC_INIT_OP_WRITE_ALL;
+                uint8_t header = all ? ASIC_INIT_HEADER_WRITE_ALL : ASIC_INIT_HEADER_WRITE;
+                uint8_t data[6] = {all ? 0x00 : script->chip * script->address_interval, step->reg, (step->value >> 24) & 0xFF,
+                                   (step->value >> 16) & 0xFF, (step->value >> 8) & 0xFF, step->value & 0xFF};
+                if (script->shadow == NULL || ASIC_registers_command(script->shadow, header, data, sizeof(data))) {
+                    *len += ASIC_frame_build(buf + *len, header, data, sizeof(data));
+                }
+                script->step++;
+                break;
+            }
+
+            default:
+                script->step++;
+                break;
+        }
+    }
+
+    return *len > 0;
+}
@@ -0,0 +1,261 @@
+#include <string.h>
+
+#include "asic_link.h"
+#include "crc.h"
+
+// replies read per call while probing
+#define PROBE_BATCH_FRAMES 16
+#define PROBE_MAX_FRAME_SIZE 11
+
+#define BT8D_RATE(divider) {ASIC_LINK_BT8D_BAUD(divider), ASIC_LINK_MISC_CONTROL, 0x00001F00, (divider) << 8, 0x00006031}
+
+// BM1397, 115740, 240384, 446428, 781250, 1041666, 1562500 and 3125000 baud, the other bits as the driver writes them after a reset
+const AsicLinkRate ASIC_LINK_BT8D_RATES[ASIC_LINK_BT8D_RATE_COUNT] = {
+    BT8D_RATE(26), BT8D_RATE(12), BT8D_RATE(6), BT8D_RATE(3), BT8D_RATE(2), BT8D_RATE(1), BT8D_RATE(0),
+};
+
+// BM1366 and later, the reset rate and the 1 Mbaud fast UART, only a reset goes back
+// 0x11300200 is the only fast UART configuration the stock firmware is known to write, the divider encodings
+// for 1.5625 and 3.125 Mbaud are unconfirmed on these chips and a wrong one loses the chain until the next reset,
+// so the ladder stops here and negotiation only confirms the chain holds 1 Mbaud
+// a faster rate is one more row once its encoding has been verified on hardware
+const AsicLinkRate ASIC_LINK_FAST_UART_RATES[ASIC_LINK_FAST_UART_RATE_COUNT] = {
+    {ASIC_LINK_RESET_BAUD, ASIC_LINK_FAST_UART, 0, 0, 0},
+    {1000000, ASIC_LINK_FAST_UART, 0xFFFFFFFF, 0x11300200, 0},
+};
+
+typedef struct
+{
+    uint32_t frames;
+    uint32_t crc_errors;
+    uint32_t wrong_register;
+    uint32_t wrong_value;
+} AsicLinkProbe;
+
+/// @brief UART rate the chips of the link are at
+int ASIC_link_baud(const AsicLink * link)
+{
+    return link->rate_count > 0 ? link->rates[link->rate].baud : ASIC_LINK_RESET_BAUD;
+}
+
+/// @brief next faster rate to try
+/// @return its index, -1 once the fastest allowed rate is reached
+int ASIC_link_next_rate(const AsicLink * link)
+{
+    return link->rate < link->fastest_rate ? link->rate + 1 : -1;
+}
+
+/// @brief the probe reads MISC_CONTROL, its value only tells the rate if that is where the rate is set
+static bool _readback_tells_rate(const AsicLinkRate * rate)
+{
+    return rate->reg == ASIC_LINK_MISC_CONTROL && rate->mask != 0;
+}
+
+/// @brief checks the crc5 of a reply, it covers everything after the preamble but the 5 crc bits
+bool ASIC_link_response_crc_ok(const uint8_t * frame, uint8_t len)
+{
+    return crc5_bits(frame + 2, (len - 2) * 8 - 5) == (frame[len - 1] & 0x1F);
+}
+
+void ASIC_link_init(AsicLink * link)
+{
+    memset(link, 0, sizeof(*link));
+}
+
+/// @brief sets the rates of the model on the chain, the fastest allowed rate is kept while they stay the same
+void ASIC_link_set_rates(AsicLink * link, const AsicLinkRate * rates, uint8_t rate_count)
+{
+    if (link->rates == rates && link->rate_count == rate_count) {
+        return;
+    }
+    link->rates = rates;
+    link->rate_count = rate_count;
+    link->rate = 0;
+    link->fastest_rate = rate_count > 0 ? rate_count - 1 : 0;
+}
+
+static void _reset_window(AsicLink * link)
+{
+    link->degraded = false;
+    link->stats.window_frames = 0;
+    link->stats.window_errors = 0;
+}
+
+static void _record_window(AsicLink * link, bool error)
+{
+    link->stats.window_frames++;
+    if (error) {
+        link->stats.window_errors++;
+    }
+
+    if (link->stats.window_frames >= ASIC_LINK_WINDOW_FRAMES) {
+        if (link->stats.window_errors > ASIC_LINK_MAX_ERROR_RATE * link->stats.window_frames) {
+            link->degraded = true;
+        }
+        link->stats.window_frames = 0;
+        link->stats.window_errors = 0;
+    }
+}
+
+/// @brief counts a reply frame received during operation
+void ASIC_link_record(AsicLink * link, bool crc_ok)
+{
+    link->stats.frames++;
+    if (!crc_ok) {
+        link->stats.crc_errors++;
+    }
+    _record_window(link, !crc_ok);
+}
+
+/// @brief counts bytes skipped to find the next preamble, the frame they belonged to is lost
+void ASIC_link_record_resync(AsicLink * link, uint32_t dropped_bytes)
+{
+    link->stats.dropped_bytes += dropped_bytes;
+    link->stats.resyncs++;
+    _record_window(link, true);
+}
+
+/// @brief reads MISC_CONTROL of every chip a few times and sorts the replies
+static void _probe(const AsicLink * link, const AsicLinkIo * io, uint16_t chip_count, uint8_t response_size, const AsicLinkRate * rate,
+                   AsicLinkProbe * probe)
+{
+    uint8_t buf[PROBE_BATCH_FRAMES * PROBE_MAX_FRAME_SIZE];
+    uint32_t expected = (uint32_t) chip_count * ASIC_LINK_PROBE_READS;
+
+    memset(probe, 0, sizeof(*probe));
+
+    for (int i = 0; i < ASIC_LINK_PROBE_READS; i++) {
+        io->read_register(io->ctx, ASIC_LINK_MISC_CONTROL);
+    }
+
+    while (probe->frames < expected) {
+        int16_t received = io->read_frames(io->ctx, buf, response_size, PROBE_BATCH_FRAMES, ASIC_LINK_PROBE_TIMEOUT_MS);
+        if (received <= 0) {
+            break;
+        }
+
+        for (int i = 0; i < received; i++) {
+            const uint8_t * frame = buf + i * response_size;
+            probe->frames++;
+
+            if (!ASIC_link_response_crc_ok(frame, response_size)) {
+                probe->crc_errors++;
+                if (link->crc_checked) {
+                    continue;
+                }
+            }
+
+            // value big endian in bytes 2..5, then the chip address and the register
+            uint32_t value = ((uint32_t) frame[2] << 24) | ((uint32_t) frame[3] << 16) | ((uint32_t) frame[4] << 8) | frame[5];
+            if (frame[7] != ASIC_LINK_MISC_CONTROL) {
+                probe->wrong_register++;
+            } else if (_readback_tells_rate(rate) && (value & rate->mask) != rate->value) {
+                probe->wrong_value++;
+            }
+        }
+    }
+}
+
+static bool _probe_clean(const AsicLink * link, const AsicLinkProbe * probe, uint16_t chip_count)
+{
+    return probe->frames == (uint32_t) chip_count * ASIC_LINK_PROBE_READS && (!link->crc_checked || probe->crc_errors == 0) &&
+           probe->wrong_register == 0 && (!link->readback_checked || probe->wrong_value == 0);
+}
+
+/// @brief moves the chips and the UART to another rate and checks the link there
+/// @return false if the chips are not on the rate cleanly, or only a reset gets them there
+static bool _switch(const AsicLink * link, const AsicLinkIo * io, uint8_t index, int writes, uint16_t chip_count, uint8_t response_size)
+{
+    const AsicLinkRate * rate = &link->rates[index];
+    AsicLinkProbe probe;
+
+    if (rate->mask == 0) {
+        return false;
+    }
+
+    // the bits outside the rate keep what the chips hold
+    uint32_t value = rate->default_value;
+    if (io->written_register != NULL) {
+        io->written_register(io->ctx, rate->reg, &value);
+    }
+    value = (value & ~rate->mask) | rate->value;
+
+    // the chips change rate right after the write, repeats sent after that are noise they drop
+    for (int i = 0; i < writes; i++) {
+        io->write_register(io->ctx, rate->reg, value);
+    }
+    io->set_baud(io->ctx, rate->baud);
+
+    _probe(link, io, chip_count, response_size, rate, &probe);
+    return _probe_clean(link, &probe, chip_count);
+}
+
+/// @brief steps the link of a freshly reset chain up to the fastest rate every chip answers cleanly at
+/// @param chip_count chips that answered the enumeration
+/// @param response_size size of a reply frame of the model
+/// @return baud rate the chips and the UART were left at, -1 if the chips were lost on the way back from a failed rate
+int ASIC_link_negotiate(AsicLink * link, const AsicLinkIo * io, uint16_t chip_count, uint8_t response_size)
+{
+    AsicLinkProbe probe;
+
+    // the reset put the chips back on the reset rate
+    link->rate = 0;
+    link->stats.negotiations++;
+
+    _reset_window(link);
+    if (chip_count == 0 || link->rate_count == 0) {
+        return ASIC_link_baud(link);
+    }
+
+    // the reply crc and the readback are only trusted if the chips pass them at the rate they surely work at
+    link->crc_checked = false;
+    link->readback_checked = false;
+    _probe(link, io, chip_count, response_size, &link->rates[0], &probe);
+    if (probe.frames != (uint32_t) chip_count * ASIC_LINK_PROBE_READS || probe.wrong_register != 0) {
+        return ASIC_link_baud(link);
+    }
+    link->crc_checked = probe.crc_errors == 0;
+    link->readback_checked = _readback_tells_rate(&link->rates[0]) && probe.wrong_value == 0;
+
+    int next;
+    while ((next = ASIC_link_next_rate(link)) >= 0) {
+        if (_switch(link, io, next, 1, chip_count, response_size)) {
+            link->rate = next;
+            continue;
+        }
+
+        // keep the last clean rate and do not try the failed one again
+        link->fastest_rate = link->rate;
+        if (!_switch(link, io, link->rate, ASIC_LINK_RATE_WRITES, chip_count, response_size)) {
+            return -1;
+        }
+        break;
+    }
+
+    // the probes at the failed rate are not errors of the rate kept
+    _reset_window(link);
+    return ASIC_link_baud(link);
+}
+
+/// @brief drops a degraded link to the next slower rate, which becomes the fastest allowed one
+/// @return new baud rate, -1 if the chips do not answer cleanly there or only a reset gets them there
+int ASIC_link_fall_back(AsicLink * link, const AsicLinkIo * io, uint16_t chip_count, uint8_t response_size)
+{
+    _reset_window(link);
+
+    if (link->rate == 0) {
+        return ASIC_link_baud(link);
+    }
+
+    uint8_t slower = link->rate - 1;
+    link->fastest_rate = slower;
+    link->stats.fallbacks++;
+
+    if (!_switch(link, io, slower, ASIC_LINK_RATE_WRITES, chip_count, response_size)) {
+        return -1;
+    }
+
+    link->rate = slower;
+    _reset_window(link);
+    return ASIC_link_baud(link);
+}
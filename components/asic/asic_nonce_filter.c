@@ -0,0 +1,79 @@
+#include <string.h>
+
+#include "asic_nonce_filter.h"
+
+void ASIC_nonce_filter_init(AsicNonceFilter * filter)
+{
+    memset(filter, 0, sizeof(*filter));
+}
+
+static uint32_t _hash(uint8_t job_id, uint32_t nonce, uint32_t version)
+{
+    // murmur3 finalizer, the nonces are already random but the versions and job ids are not
+    uint32_t h = nonce ^ (version * 0x9E3779B1) ^ ((uint32_t) job_id << 24);
+    h ^= h >> 16;
+    h *= 0x85EBCA6B;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35;
+    h ^= h >> 16;
+    return h;
+}
+
+static bool _live(const AsicNonceFilter * filter, const AsicNonceFilterEntry * entry)
+{
+    return entry->used && entry->generation == filter->generations[entry->job_id];
+}
+
+/// @brief looks a result up and remembers it, only exact (job, nonce, version) matches count as duplicates
+/// @param dispatch_seq sequence number of the dispatch the id currently stands for, a different one than last time means
+/// the id was reused. A job pointer would not do, the allocator hands a freed job's address to the next one.
+/// @return true the first time a result is seen, false for a duplicate that must not be submitted
+bool ASIC_nonce_filter_check(AsicNonceFilter * filter, uint8_t job_id, uint32_t dispatch_seq, uint32_t nonce, uint32_t version)
+{
+    job_id &= ASIC_NONCE_FILTER_JOBS - 1;
+    filter->checked++;
+
+    if (filter->dispatches[job_id] != dispatch_seq) {
+        filter->dispatches[job_id] = dispatch_seq;
+        filter->generations[job_id]++;
+    }
+
+    uint32_t home = _hash(job_id, nonce, version);
+    AsicNonceFilterEntry * free_entry = NULL;
+    AsicNonceFilterEntry * oldest = NULL;
+
+    for (int i = 0; i < ASIC_NONCE_FILTER_PROBES; i++) {
+        AsicNonceFilterEntry * entry = &filter->entries[(home + i) & (ASIC_NONCE_FILTER_SLOTS - 1)];
+
+        if (!_live(filter, entry)) {
+            if (free_entry == NULL) {
+                free_entry = entry;
+            }
+            continue;
+        }
+
+        if (entry->job_id == job_id && entry->nonce == nonce && entry->version == version) {
+            filter->duplicates++;
+            return false;
+        }
+
+        if (oldest == NULL || filter->checked - entry->seen > filter->checked - oldest->seen) {
+            oldest = entry;
+        }
+    }
+
+    if (free_entry == NULL) {
+        // forgetting an old result can only let a duplicate through, never drop a new share
+        free_entry = oldest;
+        filter->evictions++;
+    }
+
+    free_entry->nonce = nonce;
+    free_entry->version = version;
+    free_entry->seen = filter->checked;
+    free_entry->generation = filter->generations[job_id];
+    free_entry->job_id = job_id;
+    free_entry->used = true;
+
+    return true;
+}
@@ -0,0 +1,129 @@
+#include <math.h>
+#include <string.h>
+
+#include "asic_pll.h"
+
+static bool _search_exact(const AsicPllTable * table, float target_freq, float max_diff, AsicPllSetting * setting)
+{
+    uint8_t postdiv_min = 255;
+    uint8_t postdiv2_min = 255;
+    bool found = false;
+
+    for (uint8_t refdiv = 2; refdiv > 0; refdiv--) {
+        for (uint8_t postdiv1 = 7; postdiv1 > 0; postdiv1--) {
+            for (uint8_t postdiv2 = 7; postdiv2 > 0; postdiv2--) {
+                uint16_t fb_divider = round(target_freq / ASIC_PLL_REFERENCE_MHZ * (refdiv * postdiv2 * postdiv1));
+                float newf = ASIC_PLL_REFERENCE_MHZ * fb_divider / (refdiv * postdiv2 * postdiv1);
+
+                if (fb_divider >= table->fb_min && fb_divider <= table->fb_max &&
+                    fabs(target_freq - newf) < max_diff &&
+                    postdiv1 >= postdiv2 &&
+                    postdiv1 * postdiv2 < postdiv_min &&
+                    postdiv2 <= postdiv2_min) {
+
+                    postdiv2_min = postdiv2;
+                    postdiv_min = postdiv1 * postdiv2;
+                    setting->fb_div = fb_divider;
+                    setting->ref_div = refdiv;
+                    setting->post_div1 = postdiv1;
+                    setting->post_div2 = postdiv2;
+                    found = true;
+                }
+            }
+        }
+    }
+
+    return found;
+}
+
+static bool _search_first_fit(const AsicPllTable * table, float target_freq, float max_diff, AsicPllSetting * setting)
+{
+    // postdivider 2 is 1 to 7 and less than postdivider 1
+    for (uint8_t refdiv = 2; refdiv > 0; refdiv--) {
+        for (uint8_t postdiv1 = 7; postdiv1 > 0; postdiv1--) {
+            for (uint8_t postdiv2 = 1; postdiv2 < postdiv1; postdiv2++) {
+                int fb_divider = round(((float) (postdiv1 * postdiv2 * target_freq * refdiv) / ASIC_PLL_REFERENCE_MHZ));
+
+                if (fb_divider >= table->fb_min && fb_divider <= table->fb_max) {
+                    float newf = ASIC_PLL_REFERENCE_MHZ * (float) fb_divider / (float) (refdiv * postdiv2 * postdiv1);
+
+                    if (fabs(target_freq - newf) < max_diff) {
+                        setting->fb_div = fb_divider;
+                        setting->ref_div = refdiv;
+                        setting->post_div1 = postdiv1;
+                        setting->post_div2 = postdiv2;
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+
+    return false;
+}
+
+/// @brief searches the dividers for a frequency
+/// @param max_diff largest distance in MHz between the frequency made and the one asked for
+/// @return false if no divider set is in range
+bool ASIC_pll_search(const AsicPllTable * table, float frequency, float max_diff, AsicPllSetting * setting)
+{
+    memset(setting, 0, sizeof(AsicPllSetting));
+
+    if (table->search == ASIC_PLL_SEARCH_FIRST_FIT) {
+        return _search_first_fit(table, frequency, max_diff, setting);
+    }
+    return _search_exact(table, frequency, max_diff, setting);
+}
+
+/// @brief works out the dividers of every grid frequency, done once at boot
+/// @param fb_min lowest feedback divider the PLL of the family locks with
+/// @param fb_max highest feedback divider the PLL of the family locks with
+void ASIC_pll_table_init(AsicPllTable * table, AsicPllSearch search, uint8_t fb_min, uint8_t fb_max)
+{
+    table->search = search;
+    table->fb_min = fb_min;
+    table->fb_max = fb_max;
+
+    // grid frequencies are exact in binary, so a search for them can ask for an exact match
+    float max_diff = search == ASIC_PLL_SEARCH_FIRST_FIT ? 10 : 0.001;
+    for (int i = 0; i < ASIC_PLL_GRID_SIZE; i++) {
+        ASIC_pll_search(table, i * ASIC_PLL_GRID_MHZ, max_diff, &table->grid[i]);
+    }
+}
+
+/// @brief dividers for a frequency, from the table for grid frequencies and searched otherwise
+/// @return false if no divider set is in range
+bool ASIC_pll_get(const AsicPllTable * table, float frequency, float max_diff, AsicPllSetting * setting)
+{
+    float index = frequency / ASIC_PLL_GRID_MHZ;
+
+    if (index >= 0 && index < ASIC_PLL_GRID_SIZE && index == floorf(index)) {
+        *setting = table->grid[(int) index];
+        return setting->fb_div != 0;
+    }
+
+    return ASIC_pll_search(table, frequency, max_diff, setting);
+}
+
+/// @brief frequency in MHz the PLL runs at with a divider set
+float ASIC_pll_frequency(const AsicPllSetting * setting)
+{
+    if (setting->fb_div == 0) {
+        return 0;
+    }
+    return ASIC_PLL_REFERENCE_MHZ * setting->fb_div / (setting->ref_div * setting->post_div1 * setting->post_div2);
+}
+
+/// @brief value of the PLL parameter register for a divider set
+uint32_t ASIC_pll_register_value(const AsicPllSetting * setting)
+{
+    if (setting->fb_div == 0) {
+        return 0;
+    }
+
+    // the VCO runs in the upper band above 2400 MHz
+    uint8_t band = (setting->fb_div * 25 / setting->ref_div >= 2400) ? 0x50 : 0x40;
+    uint8_t post_div = (((setting->post_div1 - 1) & 0xf) << 4) | ((setting->post_div2 - 1) & 0xf);
+
+    return ((uint32_t) band << 24) | ((uint32_t) setting->fb_div << 16) | ((uint32_t) setting->ref_div << 8) | post_div;
+}
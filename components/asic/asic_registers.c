@@ -0,0 +1,216 @@
+#include <stdlib.h>
+
+#include "asic_registers.h"
+
+// the readers take a const shadow, the lock is the one thing they change
+#define SHADOW_LOCK(shadow) pthread_mutex_lock((pthread_mutex_t *) &(shadow)->lock)
+#define SHADOW_UNLOCK(shadow) pthread_mutex_unlock((pthread_mutex_t *) &(shadow)->lock)
+
+static bool _is_cached(uint8_t reg)
+{
+    return (reg & 0x03) == 0 && reg != ASIC_REGISTER_CORE_CONTROL;
+}
+
+static bool _is_verifiable(uint8_t reg)
+{
+    switch (reg) {
+        // the PLLs read back with their lock bit set
+        case 0x08:
+        case 0x60:
+        case 0x64:
+        case 0x68:
+            return false;
+        default:
+            return _is_cached(reg);
+    }
+}
+
+/// @brief chip index of an address, -1 if no chip of the chain sits there
+static int _chip_index(const AsicRegisterShadow * shadow, uint8_t chip_address)
+{
+    if (shadow->chip_count <= 1) {
+        return chip_address == 0 && shadow->chip_count == 1 ? 0 : -1;
+    }
+
+    if (shadow->address_interval == 0 || chip_address % shadow->address_interval != 0) {
+        return -1;
+    }
+
+    int index = chip_address / shadow->address_interval;
+    return index < shadow->chip_count ? index : -1;
+}
+
+/// @brief forget everything written, done whenever the chain is (re)initialized
+/// @param address_interval spacing of the chip addresses on the chain
+void ASIC_registers_init(AsicRegisterShadow * shadow, uint16_t chip_count, uint8_t address_interval)
+{
+    AsicChipRegisters * chips = chip_count > 0 ? calloc(chip_count, sizeof(AsicChipRegisters)) : NULL;
+
+    SHADOW_LOCK(shadow);
+    AsicChipRegisters * old = shadow->chips;
+    shadow->chips = chips;
+    shadow->chip_count = chips != NULL ? chip_count : 0;
+    shadow->address_interval = address_interval;
+    shadow->skipped_writes = 0;
+    shadow->readbacks = 0;
+    SHADOW_UNLOCK(shadow);
+
+    free(old);
+}
+
+static bool _write_chip(AsicChipRegisters * chip, uint8_t reg, uint32_t value)
+{
+    uint64_t bit = 1ULL << (reg >> 2);
+    bool changed = (chip->written & bit) == 0 || chip->value[reg >> 2] != value;
+
+    chip->value[reg >> 2] = value;
+    chip->written |= bit;
+
+    return changed;
+}
+
+/// @brief records a register write
+/// @param broadcast the write goes to all chips, chip_address is ignored
+/// @return false if every chip addressed already holds the value and the write can be skipped
+bool ASIC_registers_write(AsicRegisterShadow * shadow, bool broadcast, uint8_t chip_address, uint8_t reg, uint32_t value)
+{
+    if (!_is_cached(reg)) {
+        return true;
+    }
+
+    bool needed = true;
+
+    SHADOW_LOCK(shadow);
+    if (broadcast && shadow->chip_count > 0) {
+        needed = false;
+        for (int i = 0; i < shadow->chip_count; i++) {
+            needed |= _write_chip(&shadow->chips[i], reg, value);
+        }
+    } else if (!broadcast) {
+        int index = _chip_index(shadow, chip_address);
+        if (index >= 0) {
+            needed = _write_chip(&shadow->chips[index], reg, value);
+        }
+    }
+
+    if (!needed) {
+        shadow->skipped_writes++;
+    }
+    SHADOW_UNLOCK(shadow);
+
+    return needed;
+}
+
+/// @brief records the command about to be sent to the chain if it is a register write
+/// @return false if the command can be skipped
+bool ASIC_registers_command(AsicRegisterShadow * shadow, uint8_t header, const uint8_t * data, uint8_t data_len)
+{
+    if ((header & ~ASIC_REGISTER_GROUP_ALL) != ASIC_REGISTER_WRITE_HEADER || data_len != 6) {
+        return true;
+    }
+
+    uint32_t value = ((uint32_t) data[2] << 24) | ((uint32_t) data[3] << 16) | ((uint32_t) data[4] << 8) | data[5];
+
+    return ASIC_registers_write(shadow, (header & ASIC_REGISTER_GROUP_ALL) != 0, data[0], data[1], value);
+}
+
+/// @brief what every chip of the chain was last written in a register
+/// @return false unless every chip was written the same value
+bool ASIC_registers_written(const AsicRegisterShadow * shadow, uint8_t reg, uint32_t * value)
+{
+    uint64_t bit = 1ULL << (reg >> 2);
+
+    if (!_is_cached(reg)) {
+        return false;
+    }
+
+    SHADOW_LOCK(shadow);
+    bool same = shadow->chip_count > 0;
+    for (int i = 0; i < shadow->chip_count && same; i++) {
+        const AsicChipRegisters * chip = &shadow->chips[i];
+        same = (chip->written & bit) != 0 && chip->value[reg >> 2] == shadow->chips[0].value[reg >> 2];
+    }
+    if (same) {
+        *value = shadow->chips[0].value[reg >> 2];
+    }
+    SHADOW_UNLOCK(shadow);
+
+    return same;
+}
+
+/// @brief compares a register read back from a chip with what was written to it
+/// @return false if the chip holds something else
+bool ASIC_registers_check(AsicRegisterShadow * shadow, uint8_t chip_address, uint8_t reg, uint32_t value)
+{
+    if (!_is_verifiable(reg)) {
+        return true;
+    }
+
+    bool held = true;
+    uint64_t bit = 1ULL << (reg >> 2);
+
+    SHADOW_LOCK(shadow);
+    int index = _chip_index(shadow, chip_address);
+    AsicChipRegisters * chip = index >= 0 ? &shadow->chips[index] : NULL;
+    if (chip != NULL && (chip->written & bit) != 0) {
+        shadow->readbacks++;
+
+        if (chip->value[reg >> 2] == value) {
+            chip->drifted &= ~bit;
+        } else {
+            if ((chip->drifted & bit) == 0) {
+                chip->drift_events++;
+            }
+            chip->drifted |= bit;
+            held = false;
+        }
+    }
+    SHADOW_UNLOCK(shadow);
+
+    return held;
+}
+
+/// @brief registers written to any chip that read back as written
+/// @return number of registers put in regs
+int ASIC_registers_verifiable(const AsicRegisterShadow * shadow, uint8_t * regs, int max_regs)
+{
+    uint64_t written = 0;
+    SHADOW_LOCK(shadow);
+    for (int i = 0; i < shadow->chip_count; i++) {
+        written |= shadow->chips[i].written;
+    }
+    SHADOW_UNLOCK(shadow);
+
+    int count = 0;
+    for (int i = 0; i < ASIC_REGISTER_COUNT && count < max_regs; i++) {
+        if ((written & (1ULL << i)) != 0 && _is_verifiable(i << 2)) {
+            regs[count++] = i << 2;
+        }
+    }
+
+    return count;
+}
+
+/// @brief the write and readback counters of the chain, taken together
+void ASIC_registers_counters(const AsicRegisterShadow * shadow, uint32_t * skipped_writes, uint32_t * readbacks)
+{
+    SHADOW_LOCK(shadow);
+    *skipped_writes = shadow->skipped_writes;
+    *readbacks = shadow->readbacks;
+    SHADOW_UNLOCK(shadow);
+}
+
+/// @brief the drift of one chip, the chips may be reallocated by a re-init while this is read
+/// @return false if the chain has no such chip
+bool ASIC_registers_chip_drift(const AsicRegisterShadow * shadow, uint16_t chip, uint32_t * drift_events, bool * drifted)
+{
+    SHADOW_LOCK(shadow);
+    bool found = chip < shadow->chip_count;
+    if (found) {
+        *drift_events = shadow->chips[chip].drift_events;
+        *drifted = shadow->chips[chip].drifted != 0;
+    }
+    SHADOW_UNLOCK(shadow);
+
+    return found;
+}
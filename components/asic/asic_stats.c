@@ -0,0 +1,154 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "asic_stats.h"
+
+void ASIC_stats_init(AsicStatsModule * stats, uint16_t chip_count, int64_t now_us)
+{
+    free(stats->chips);
+
+    stats->chips = calloc(chip_count, sizeof(AsicChipStats));
+    stats->chip_count = stats->chips != NULL ? chip_count : 0;
+    stats->start_us = now_us;
+    stats->unattributed = 0;
+    memset(stats->window_epoch, 0, sizeof(stats->window_epoch));
+}
+
+static uint32_t _window_epoch(const AsicStatsModule * stats, int64_t now_us)
+{
+    return (uint32_t) ((now_us - stats->start_us) / 1000000 / ASIC_STATS_ERROR_BUCKET_S);
+}
+
+/// @brief slot of the rolling error window for now, cleared if it still holds an expired bucket
+static uint32_t _window_slot(AsicStatsModule * stats, int64_t now_us)
+{
+    uint32_t epoch = _window_epoch(stats, now_us);
+    uint32_t slot = epoch % ASIC_STATS_ERROR_BUCKETS;
+
+    if (stats->window_epoch[slot] != epoch) {
+        for (int chip = 0; chip < stats->chip_count; chip++) {
+            stats->chips[chip].window_nonces[slot] = 0;
+            stats->chips[chip].window_hw_errors[slot] = 0;
+        }
+        stats->window_epoch[slot] = epoch;
+    }
+
+    return slot;
+}
+
+void ASIC_stats_record(AsicStatsModule * stats, uint8_t asic_nr, uint8_t core_id, uint8_t small_core_id, AsicResultType type,
+                       double ticket_diff, int64_t now_us)
+{
+    if (asic_nr >= stats->chip_count) {
+        stats->unattributed++;
+        return;
+    }
+
+    AsicChipStats * chip = &stats->chips[asic_nr];
+    uint32_t bucket = _window_slot(stats, now_us);
+
+    switch (type) {
+        case ASIC_RESULT_HW_ERROR:
+            chip->hw_errors++;
+            chip->window_hw_errors[bucket]++;
+            return;
+        case ASIC_RESULT_INVALID_JOB:
+            chip->invalid_jobs++;
+            return;
+        case ASIC_RESULT_VALID:
+        default:
+            break;
+    }
+
+    chip->nonces++;
+    chip->work += ticket_diff;
+    chip->last_seen_us = now_us;
+    chip->window_nonces[bucket]++;
+
+    if (small_core_id < ASIC_STATS_SMALL_CORES) {
+        chip->small_core_nonces[small_core_id]++;
+    }
+
+    if (core_id < ASIC_STATS_CORES) {
+        chip->cores[core_id].nonces++;
+        // never store 0 for a core that has been seen
+        chip->cores[core_id].last_seen_s = (uint32_t) ((now_us - stats->start_us) / 1000000) + 1;
+    }
+}
+
+/// @brief takes a reading of the hash counter register of a chip
+/// @param hashes_per_count hashes done by the chip for each increment of the counter
+void ASIC_stats_record_hash_counter(AsicStatsModule * stats, uint8_t asic_nr, uint32_t value, double hashes_per_count,
+                                    int64_t now_us)
+{
+    if (asic_nr >= stats->chip_count) {
+        stats->unattributed++;
+        return;
+    }
+
+    AsicChipStats * chip = &stats->chips[asic_nr];
+
+    // a counter that went back by less than half its range was reset with the chip, not wrapped
+    bool reset = value < chip->hash_counter && chip->hash_counter - value < 0x80000000;
+
+    if (chip->hash_counter_us > 0 && now_us > chip->hash_counter_us && !reset) {
+        uint32_t counts = value - chip->hash_counter;
+        double elapsed_s = (now_us - chip->hash_counter_us) / 1000000.0;
+        chip->counter_hashrate = counts * hashes_per_count / elapsed_s / 1000000000.0;
+    }
+
+    chip->hash_counter = value;
+    chip->hash_counter_us = now_us;
+}
+
+/// @brief hashrate of the chain from the hash counter registers
+/// @return GH/s
+double ASIC_stats_counter_hashrate(const AsicStatsModule * stats)
+{
+    double hashrate = 0;
+    for (int i = 0; i < stats->chip_count; i++) {
+        hashrate += stats->chips[i].counter_hashrate;
+    }
+    return hashrate;
+}
+
+/// @brief hashrate of a chip since the stats were started
+/// @return GH/s
+double ASIC_stats_chip_hashrate(const AsicStatsModule * stats, uint8_t asic_nr, int64_t now_us)
+{
+    if (asic_nr >= stats->chip_count || now_us <= stats->start_us) {
+        return 0;
+    }
+
+    double elapsed_s = (now_us - stats->start_us) / 1000000.0;
+    return stats->chips[asic_nr].work * 4294967296.0 / elapsed_s / 1000000000.0;
+}
+
+/// @brief share of hardware errors among the results of a chip over the rolling window
+/// @return 0..1, 0 if the chip returned nothing in the window
+double ASIC_stats_chip_error_rate(const AsicStatsModule * stats, uint8_t asic_nr, int64_t now_us)
+{
+    if (asic_nr >= stats->chip_count) {
+        return 0;
+    }
+
+    uint32_t epoch = _window_epoch(stats, now_us);
+
+    uint32_t nonces = 0;
+    uint32_t hw_errors = 0;
+    for (int i = 0; i < ASIC_STATS_ERROR_BUCKETS; i++) {
+        // skip slots left over from buckets that have dropped out of the window
+        if (epoch - stats->window_epoch[i] >= ASIC_STATS_ERROR_BUCKETS) {
+            continue;
+        }
+        nonces += stats->chips[asic_nr].window_nonces[i];
+        hw_errors += stats->chips[asic_nr].window_hw_errors[i];
+    }
+
+    if (nonces + hw_errors == 0) {
+        return 0;
+    }
+
+    return (double) hw_errors / (nonces + hw_errors);
+}
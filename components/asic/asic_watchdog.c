@@ -0,0 +1,81 @@
+#include "asic_watchdog.h"
+
+void ASIC_watchdog_init(AsicWatchdog * watchdog, int64_t now_us)
+{
+    atomic_init(&watchdog->last_nonce_us, now_us);
+    watchdog->backoff = 0;
+    watchdog->recoveries = 0;
+    watchdog->failed_recoveries = 0;
+    watchdog->last_recovery_us = 0;
+    watchdog->last_stall_us = 0;
+    watchdog->last_recovery_duration_us = 0;
+}
+
+/// @brief records a valid nonce from the chain
+void ASIC_watchdog_feed(AsicWatchdog * watchdog, int64_t now_us)
+{
+    atomic_store_explicit(&watchdog->last_nonce_us, now_us, memory_order_relaxed);
+    watchdog->backoff = 0;
+}
+
+/// @brief starts the wait over without counting a nonce, for a chain that was left without work
+void ASIC_watchdog_restart(AsicWatchdog * watchdog, int64_t now_us)
+{
+    atomic_store_explicit(&watchdog->last_nonce_us, now_us, memory_order_relaxed);
+}
+
+/// @brief time of the last valid nonce, safe to read while the result task feeds the watchdog
+int64_t ASIC_watchdog_last_nonce_us(const AsicWatchdog * watchdog)
+{
+    return atomic_load_explicit(&watchdog->last_nonce_us, memory_order_relaxed);
+}
+
+/// @brief mean time between two nonces that meet the ticket mask
+/// @param hashrate_ghs expected hashrate of the whole chain
+double ASIC_watchdog_expected_interval_us(double hashrate_ghs, uint32_t ticket_difficulty)
+{
+    if (hashrate_ghs <= 0) {
+        return 0;
+    }
+
+    // every nonce meeting difficulty 1 takes 2^32 hashes on average
+    return ticket_difficulty * 4294967296.0 / (hashrate_ghs * 1e9) * 1e6;
+}
+
+/// @brief time without a valid nonce after which the chain counts as stalled
+int64_t ASIC_watchdog_timeout_us(const AsicWatchdog * watchdog, double hashrate_ghs, uint32_t ticket_difficulty)
+{
+    int64_t timeout_us = (int64_t) (ASIC_watchdog_expected_interval_us(hashrate_ghs, ticket_difficulty) * ASIC_WATCHDOG_NONCE_INTERVALS);
+    if (timeout_us < ASIC_WATCHDOG_MIN_TIMEOUT_US) {
+        timeout_us = ASIC_WATCHDOG_MIN_TIMEOUT_US;
+    }
+
+    // a chain that stays silent after being re-initialized is retried less and less often
+    return timeout_us << watchdog->backoff;
+}
+
+/// @brief checks whether the chain went quiet for far longer than the expected nonce interval
+/// the chance of a healthy chain missing ASIC_WATCHDOG_NONCE_INTERVALS intervals in a row is about e^-20
+bool ASIC_watchdog_stalled(const AsicWatchdog * watchdog, double hashrate_ghs, uint32_t ticket_difficulty, int64_t now_us)
+{
+    return now_us - ASIC_watchdog_last_nonce_us(watchdog) >= ASIC_watchdog_timeout_us(watchdog, hashrate_ghs, ticket_difficulty);
+}
+
+/// @brief records a re-initialization of the chain, the timeout starts again from its end
+/// @param chips_found false if no chip answered during the re-init
+/// @param started_us time the recovery started
+void ASIC_watchdog_recovered(AsicWatchdog * watchdog, bool chips_found, int64_t started_us, int64_t now_us)
+{
+    watchdog->recoveries++;
+    if (!chips_found) {
+        watchdog->failed_recoveries++;
+    }
+    watchdog->last_recovery_us = now_us;
+    watchdog->last_stall_us = started_us - ASIC_watchdog_last_nonce_us(watchdog);
+    watchdog->last_recovery_duration_us = now_us - started_us;
+    atomic_store_explicit(&watchdog->last_nonce_us, now_us, memory_order_relaxed);
+
+    if (watchdog->backoff < ASIC_WATCHDOG_MAX_BACKOFF) {
+        watchdog->backoff++;
+    }
+}
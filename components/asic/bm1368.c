@@ -1,6 +1,13 @@
 #include "bm1368.h"
 
+#include "asic_dispatch.h"
+#include "asic_frame.h"
+#include "asic_init_script.h"
+#include "asic_link.h"
+#include "asic_pll.h"
+#include "asic_registers.h"
 #include "crc.h"
+#include "freq_ramp.h"
 #include "global_state.h"
 #include "serial.h"
 #include "utils.h"
@@ -15,7 +22,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define GPIO_ASIC_RESET CONFIG_GPIO_ASIC_RESET
 
 #define TYPE_JOB 0x20
 #define TYPE_CMD 0x40
@@ -47,6 +53,7 @@
 
 #define BM1368_TIMEOUT_MS 10000
 #define BM1368_TIMEOUT_THRESHOLD 2
+#define BM1368_RESPONSE_SIZE 11
 typedef struct __attribute__((__packed__))
 {
     uint8_t preamble[2];
@@ -59,269 +66,257 @@ typedef struct __attribute__((__packed__))
 
 static const char * TAG = "bm1368Module";
 
-static uint8_t asic_response_buffer[CHUNK_SIZE];
-static task_result result;
+static uint8_t asic_response_buffer[ASIC_MAX_CHAINS][CHUNK_SIZE];
+static uint8_t rx_batch_buffer[ASIC_MAX_CHAINS][SERIAL_RX_BATCH_FRAMES * BM1368_RESPONSE_SIZE];
+static uint16_t rx_batch_count[ASIC_MAX_CHAINS];
+static uint16_t rx_batch_index[ASIC_MAX_CHAINS];
+static task_result result[ASIC_MAX_CHAINS];
+// what was last written to the chips, writes they already hold are skipped
+static AsicRegisterShadow register_shadow[ASIC_MAX_CHAINS] = {[0 ... ASIC_MAX_CHAINS - 1] = ASIC_REGISTER_SHADOW_INITIALIZER};
 
-static float current_frequency = 56.25;
+static float current_frequency[ASIC_MAX_CHAINS];
+// PLL dividers of the frequencies the ramp steps through
+static AsicPllTable pll_table;
 
-static void _send_BM1368(uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
+static void _send_BM1368(uint8_t chain, uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
 {
-    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
-    uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
-
-    unsigned char * buf = malloc(total_length);
-
-    buf[0] = 0x55;
-    buf[1] = 0xAA;
-    buf[2] = header;
-    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
-    memcpy(buf + 4, data, data_len);
-
-    if (packet_type == JOB_PACKET) {
-        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
-        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
-        buf[5 + data_len] = crc16_total & 0xFF;
-    } else {
-        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
+    if (!ASIC_registers_command(&register_shadow[chain], header, data, data_len)) {
+        return;
     }
 
-    SERIAL_send(buf, total_length, debug);
+    uint8_t buf[ASIC_FRAME_MAX_LEN];
+    uint8_t total_length = ASIC_frame_build(buf, header, data, data_len);
 
-    free(buf);
+    // send serial data
+    SERIAL_send(chain, buf, total_length, debug);
 }
 
-static void _send_simple(uint8_t * data, uint8_t total_length)
+/// @brief sends an init script in as few UART writes as its delays allow
+static void _send_init_script(uint8_t chain, const AsicInitStep * steps, int step_count, uint16_t chip_count)
 {
-    unsigned char * buf = malloc(total_length);
-    memcpy(buf, data, total_length);
-    SERIAL_send(buf, total_length, BM1368_SERIALTX_DEBUG);
-
-    free(buf);
+    uint8_t buf[ASIC_INIT_BATCH_SIZE];
+    size_t len;
+    uint32_t delay_ms;
+
+    AsicInitScript script;
+    ASIC_init_script_start(&script, steps, step_count, chip_count, &register_shadow[chain]);
+    while (ASIC_init_script_next(&script, buf, sizeof(buf), &len, &delay_ms)) {
+        if (len > 0) {
+            SERIAL_send(chain, buf, len, BM1368_SERIALTX_DEBUG);
+        }
+        if (delay_ms > 0) {
+            vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        }
+    }
 }
 
-static void _send_chain_inactive(void)
+static void _send_chain_inactive(uint8_t chain)
 {
     unsigned char read_address[2] = {0x00, 0x00};
-    _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1368_SERIALTX_DEBUG);
+    _send_BM1368(chain, (TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1368_SERIALTX_DEBUG);
 }
 
-static void _set_chip_address(uint8_t chipAddr)
-{
-    unsigned char read_address[2] = {chipAddr, 0x00};
-    _send_BM1368((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1368_SERIALTX_DEBUG);
-}
-
-void BM1368_set_version_mask(uint32_t version_mask) 
+void BM1368_set_version_mask(uint8_t chain, uint32_t version_mask) 
 {
     int versions_to_roll = version_mask >> 13;
     uint8_t version_byte0 = (versions_to_roll >> 8);
     uint8_t version_byte1 = (versions_to_roll & 0xFF); 
     uint8_t version_cmd[] = {0x00, 0xA4, 0x90, 0x00, version_byte0, version_byte1};
-    _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1368_SERIALTX_DEBUG);
+    _send_BM1368(chain, TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1368_SERIALTX_DEBUG);
 }
 
-static void _reset(void)
+void BM1368_read_hash_counter(uint8_t chain)
 {
-    gpio_set_level(GPIO_ASIC_RESET, 0);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
-    gpio_set_level(GPIO_ASIC_RESET, 1);
-    vTaskDelay(100 / portTICK_PERIOD_MS);
+    _send_BM1368(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, ASIC_HASH_COUNTER_REGISTER}, 2, false);
 }
 
-bool BM1368_send_hash_frequency(float target_freq) {
-    float max_diff = 0.001;
-    uint8_t freqbuf[6] = {0x00, 0x08, 0x40, 0xA0, 0x02, 0x41};
-    uint8_t postdiv_min = 255;
-    uint8_t postdiv2_min = 255;
-    float best_freq = 0;
-    uint8_t best_refdiv = 0, best_fbdiv = 0, best_postdiv1 = 0, best_postdiv2 = 0;
-    bool found = false;
-
-    for (uint8_t refdiv = 2; refdiv > 0; refdiv--) {
-        for (uint8_t postdiv1 = 7; postdiv1 > 0; postdiv1--) {
-            for (uint8_t postdiv2 = 7; postdiv2 > 0; postdiv2--) {
-                uint16_t fb_divider = round(target_freq / 25.0 * (refdiv * postdiv2 * postdiv1));
-                float newf = 25.0 * fb_divider / (refdiv * postdiv2 * postdiv1);
-
-                if (fb_divider >= 144 && fb_divider <= 235 &&
-                    fabs(target_freq - newf) < max_diff &&
-                    postdiv1 >= postdiv2 &&
-                    postdiv1 * postdiv2 < postdiv_min &&
-                    postdiv2 <= postdiv2_min) {
-
-                    postdiv2_min = postdiv2;
-                    postdiv_min = postdiv1 * postdiv2;
-                    best_freq = newf;
-                    best_refdiv = refdiv;
-                    best_fbdiv = fb_divider;
-                    best_postdiv1 = postdiv1;
-                    best_postdiv2 = postdiv2;
-                    found = true;
-                }
-            }
-        }
+void BM1368_verify_registers(uint8_t chain)
+{
+    uint8_t registers[ASIC_REGISTER_COUNT];
+    int count = ASIC_registers_verifiable(&register_shadow[chain], registers, ASIC_REGISTER_COUNT);
+    for (int i = 0; i < count; i++) {
+        _send_BM1368(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, registers[i]}, 2, false);
     }
+}
+
+const AsicRegisterShadow * BM1368_get_register_shadow(uint8_t chain)
+{
+    return &register_shadow[chain];
+}
 
-    if (!found) {
+static void _reset(uint8_t chain)
+{
+    gpio_set_level(SERIAL_reset_gpio(chain), 0);
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+    gpio_set_level(SERIAL_reset_gpio(chain), 1);
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+}
+
+bool BM1368_send_hash_frequency(uint8_t chain, float target_freq) {
+    AsicPllSetting pll;
+    if (!ASIC_pll_get(&pll_table, target_freq, 0.001, &pll)) {
         ESP_LOGE(TAG, "Didn't find PLL settings for target frequency %.2f", target_freq);
         return false;
     }
 
-    freqbuf[2] = (best_fbdiv * 25 / best_refdiv >= 2400) ? 0x50 : 0x40;
-    freqbuf[3] = best_fbdiv;
-    freqbuf[4] = best_refdiv;
-    freqbuf[5] = (((best_postdiv1 - 1) & 0xf) << 4) | ((best_postdiv2 - 1) & 0xf);
+    uint32_t pll_value = ASIC_pll_register_value(&pll);
+    uint8_t freqbuf[6] = {0x00, 0x08, pll_value >> 24, (pll_value >> 16) & 0xFF, (pll_value >> 8) & 0xFF, pll_value & 0xFF};
 
-    _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_WRITE, freqbuf, sizeof(freqbuf), BM1368_SERIALTX_DEBUG);
+    _send_BM1368(chain, TYPE_CMD | GROUP_ALL | CMD_WRITE, freqbuf, sizeof(freqbuf), BM1368_SERIALTX_DEBUG);
 
-    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f)", target_freq, best_freq);
-    current_frequency = target_freq;
+    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f)", target_freq, ASIC_pll_frequency(&pll));
+    current_frequency[chain] = target_freq;
     return true;
 }
 
-bool do_frequency_transition(float target_frequency) {
-    float step = 6.25;
-    float current = current_frequency;
-    float target = target_frequency;
-
-    float direction = (target > current) ? step : -step;
-
-    if (fmod(current, step) != 0) {
-        float next_dividable;
-        if (direction > 0) {
-            next_dividable = ceil(current / step) * step;
-        } else {
-            next_dividable = floor(current / step) * step;
+bool do_frequency_transition(uint8_t chain, float target_frequency) {
+    FreqRampCurrentFn read_current = FREQ_RAMP_current_sensor();
+    FreqRampConfig config;
+    FREQ_RAMP_default_config(&config, read_current != NULL);
+    FreqRamp ramp;
+    FREQ_RAMP_init(&ramp, &config, current_frequency[chain], target_frequency);
+
+    float frequency;
+    while (FREQ_RAMP_next(&ramp, &frequency)) {
+        if (!BM1368_send_hash_frequency(chain, frequency)) {
+            return false;
         }
-        current = next_dividable;
-        BM1368_send_hash_frequency(current);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
+        uint32_t dwell_ms = 0;
+        do {
+            vTaskDelay(pdMS_TO_TICKS(config.sample_ms));
+            dwell_ms += config.sample_ms;
+        } while (!FREQ_RAMP_settled(&ramp, read_current != NULL ? read_current() : -1, dwell_ms));
     }
 
-    while ((direction > 0 && current < target) || (direction < 0 && current > target)) {
-        float next_step = fmin(fabs(direction), fabs(target - current));
-        current += direction > 0 ? next_step : -next_step;
-        BM1368_send_hash_frequency(current);
-        vTaskDelay(100 / portTICK_PERIOD_MS);
-    }
-    BM1368_send_hash_frequency(target);
+    ESP_LOGI(TAG, "Frequency transition to %.2f MHz took %d steps, %" PRIu32 " ms", target_frequency, ramp.steps, ramp.elapsed_ms);
     return true;
 }
 
-bool BM1368_set_frequency(float target_freq) {
-    return do_frequency_transition(target_freq);
+bool BM1368_set_frequency(uint8_t chain, float target_freq) {
+    return do_frequency_transition(chain, target_freq);
 }
 
-static int count_asic_chips(void) {
-    _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_READ, (uint8_t[]){0x00, 0x00}, 2, false);
+static int count_asic_chips(uint8_t chain, uint16_t asic_count) {
+    _send_BM1368(chain, TYPE_CMD | GROUP_ALL | CMD_READ, (uint8_t[]){0x00, 0x00}, 2, false);
 
     int chip_counter = 0;
     while (true) {
-        if (SERIAL_rx(asic_response_buffer, 11, 5000) <= 0) {
+        if (SERIAL_rx(chain, asic_response_buffer[chain], 11, chip_counter < asic_count ? 5000 : ASIC_INIT_COUNT_TAIL_MS) <= 0) {
             break;
         }
 
-        if (memcmp(asic_response_buffer, "\xaa\x55\x13\x68\x00\x00", 6) == 0) {
+        if (memcmp(asic_response_buffer[chain], "\xaa\x55\x13\x68\x00\x00", 6) == 0) {
             chip_counter++;
         }
     }
 
-    _send_chain_inactive();
+    _send_chain_inactive(chain);
     return chip_counter;
 }
 
 
 
-static void do_frequency_ramp_up(float target_frequency) {
-    ESP_LOGI(TAG, "Ramping up frequency from %.2f MHz to %.2f MHz", current_frequency, target_frequency);
-    do_frequency_transition(target_frequency);
+static void do_frequency_ramp_up(uint8_t chain, float target_frequency) {
+    ESP_LOGI(TAG, "Ramping up frequency from %.2f MHz to %.2f MHz", current_frequency[chain], target_frequency);
+    do_frequency_transition(chain, target_frequency);
 }
 
-uint8_t BM1368_init(uint64_t frequency, uint16_t asic_count)
+uint8_t BM1368_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
     ESP_LOGI(TAG, "Initializing BM1368");
 
-    memset(asic_response_buffer, 0, CHUNK_SIZE);
+    // the table is shared by every chain and only built by the first init
+    if (pll_table.fb_max == 0) {
+        ASIC_pll_table_init(&pll_table, ASIC_PLL_SEARCH_EXACT, 144, 235);
+    }
+
+    memset(asic_response_buffer[chain], 0, CHUNK_SIZE);
 
-    esp_rom_gpio_pad_select_gpio(GPIO_ASIC_RESET);
-    gpio_set_direction(GPIO_ASIC_RESET, GPIO_MODE_OUTPUT);
+    esp_rom_gpio_pad_select_gpio(SERIAL_reset_gpio(chain));
+    gpio_set_direction(SERIAL_reset_gpio(chain), GPIO_MODE_OUTPUT);
 
-    _reset();
+    _reset(chain);
+
+    // frames received before the reset belong to work the chain no longer holds
+    rx_batch_count[chain] = 0;
+    rx_batch_index[chain] = 0;
+    // nor does it hold anything written before, until the chips are counted nothing is skipped
+    ASIC_registers_init(&register_shadow[chain], 0, 0);
 
     // set version mask
     for (int i = 0; i < 4; i++) {
-        BM1368_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
+        BM1368_set_version_mask(chain, STRATUM_DEFAULT_VERSION_MASK);
     }
 
-    int chip_counter = count_asic_chips();
+    int chip_counter = count_asic_chips(chain, asic_count);
 
     if (chip_counter != asic_count) {
         ESP_LOGE(TAG, "Chip count mismatch. Expected: %d, Actual: %d", asic_count, chip_counter);
         return 0;
     }
 
-    uint8_t init_cmds[][6] = {
-        {0x00, 0xA8, 0x00, 0x07, 0x00, 0x00},
-        {0x00, 0x18, 0xFF, 0x0F, 0xC1, 0x00},
-        {0x00, 0x3C, 0x80, 0x00, 0x8b, 0x00},
-        {0x00, 0x3C, 0x80, 0x00, 0x80, 0x18},
-        {0x00, 0x14, 0x00, 0x00, 0x00, 0xFF},
-        {0x00, 0x54, 0x00, 0x00, 0x00, 0x03}, //Analog Mux
-        {0x00, 0x58, 0x02, 0x11, 0x11, 0x11}
+    // the chain was just reset, it holds none of the values written before
+    ASIC_registers_init(&register_shadow[chain], chip_counter, chip_counter > 0 ? 256 / chip_counter : 0);
+
+    const AsicInitStep init_script[] = {
+        ASIC_INIT_WRITE_ALL(0xA8, 0x00070000),
+        ASIC_INIT_WRITE_ALL(MISC_CONTROL, 0xFF0FC100),
+        ASIC_INIT_WRITE_ALL(CORE_REGISTER_CONTROL, 0x80008B00),
+        ASIC_INIT_WRITE_ALL(CORE_REGISTER_CONTROL, 0x80008018),
+        ASIC_INIT_WRITE_ALL(TICKET_MASK, ASIC_get_ticket_mask(BM1368_ASIC_DIFFICULTY)),
+        // Analog Mux
+        ASIC_INIT_WRITE_ALL(0x54, 0x00000003),
+        ASIC_INIT_WRITE_ALL(0x58, 0x02111111),
+        ASIC_INIT_SET_ADDRESSES,
+        ASIC_INIT_FOR_EACH_CHIP,
+            ASIC_INIT_WRITE_CHIP(0xA8, 0x000701F0),
+            ASIC_INIT_WRITE_CHIP(MISC_CONTROL, 0xF000C100),
+            ASIC_INIT_WRITE_CHIP(CORE_REGISTER_CONTROL, 0x80008B00),
+            ASIC_INIT_WRITE_CHIP(CORE_REGISTER_CONTROL, 0x80008018),
+            ASIC_INIT_WRITE_CHIP(CORE_REGISTER_CONTROL, 0x800082AA),
+            ASIC_INIT_DELAY_MS(500),
+        ASIC_INIT_END_FOR_EACH,
     };
+    _send_init_script(chain, init_script, sizeof(init_script) / sizeof(init_script[0]), chip_counter);
 
-    for (int i = 0; i < sizeof(init_cmds) / sizeof(init_cmds[0]); i++) {
-        _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_WRITE, init_cmds[i], 6, false);
-    }
-
-    uint8_t address_interval = (uint8_t) (256 / chip_counter);
-    for (int i = 0; i < chip_counter; i++) {
-        _set_chip_address(i * address_interval);
-    }
-
-    for (int i = 0; i < chip_counter; i++) {
-        uint8_t chip_init_cmds[][6] = {
-            {i * address_interval, 0xA8, 0x00, 0x07, 0x01, 0xF0},
-            {i * address_interval, 0x18, 0xF0, 0x00, 0xC1, 0x00},
-            {i * address_interval, 0x3C, 0x80, 0x00, 0x8b, 0x00},
-            {i * address_interval, 0x3C, 0x80, 0x00, 0x80, 0x18},
-            {i * address_interval, 0x3C, 0x80, 0x00, 0x82, 0xAA}
-        };
-
-        for (int j = 0; j < sizeof(chip_init_cmds) / sizeof(chip_init_cmds[0]); j++) {
-            _send_BM1368(TYPE_CMD | GROUP_SINGLE | CMD_WRITE, chip_init_cmds[j], 6, false);
-        }
-        vTaskDelay(pdMS_TO_TICKS(500));
-    }
-
-    BM1368_set_job_difficulty_mask(BM1368_ASIC_DIFFICULTY);
-
-    do_frequency_ramp_up((float)frequency);
+    do_frequency_ramp_up(chain, (float)frequency);
 
-    _send_BM1368(TYPE_CMD | GROUP_ALL | CMD_WRITE, (uint8_t[]){0x00, 0x10, 0x00, 0x00, 0x15, 0xa4}, 6, false);
-    BM1368_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
+    _send_BM1368(chain, TYPE_CMD | GROUP_ALL | CMD_WRITE, (uint8_t[]){0x00, 0x10, (BM1368_NONCE_RANGE >> 24) & 0xFF, (BM1368_NONCE_RANGE >> 16) & 0xFF, (BM1368_NONCE_RANGE >> 8) & 0xFF, BM1368_NONCE_RANGE & 0xFF}, 6, false);
+    BM1368_set_version_mask(chain, STRATUM_DEFAULT_VERSION_MASK);
 
     ESP_LOGI(TAG, "%i chip(s) detected on the chain, expected %i", chip_counter, asic_count);
     return chip_counter;
 }
 
-int BM1368_set_default_baud(void)
+int BM1368_set_default_baud(uint8_t chain)
 {
     unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001};
-    _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1368_SERIALTX_DEBUG);
+    _send_BM1368(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1368_SERIALTX_DEBUG);
     return 115749;
 }
 
-int BM1368_set_max_baud(void)
+// the rate is set in the fast UART configuration, ASIC_LINK_FAST_UART_RATES tells why it tops out at 1 Mbaud
+static const SerialLinkModel link_model = {
+    .rates = ASIC_LINK_FAST_UART_RATES,
+    .rate_count = ASIC_LINK_FAST_UART_RATE_COUNT,
+    .response_size = BM1368_RESPONSE_SIZE,
+};
+
+/// @brief steps the UART of a freshly initialized chain up to the fastest rate its chips answer cleanly at
+/// @return baud rate the chips were left at
+int BM1368_set_max_baud(uint8_t chain)
 {
-    ESP_LOGI(TAG, "Setting max baud of 1000000");
+    return SERIAL_link_negotiate(chain, &link_model, &register_shadow[chain], register_shadow[chain].chip_count);
+}
 
-    unsigned char init8[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00, 0x03};
-    _send_simple(init8, 11);
-    return 1000000;
+/// @brief drops a chain whose link degraded to the next slower rate
+/// @return new baud rate, -1 if the chips no longer answer and the chain needs a reset
+int BM1368_fall_back_baud(uint8_t chain)
+{
+    return SERIAL_link_fall_back(chain, &link_model, &register_shadow[chain], register_shadow[chain].chip_count);
 }
 
-void BM1368_set_job_difficulty_mask(int difficulty)
+void BM1368_set_job_difficulty_mask(uint8_t chain, int difficulty)
 {
     unsigned char job_difficulty_mask[9] = {0x00, TICKET_MASK, 0b00000000, 0b00000000, 0b00000000, 0b11111111};
 
@@ -334,18 +329,17 @@ void BM1368_set_job_difficulty_mask(int difficulty)
 
     ESP_LOGI(TAG, "Setting job ASIC mask to %d", difficulty);
 
-    _send_BM1368((TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1368_SERIALTX_DEBUG);
+    _send_BM1368(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1368_SERIALTX_DEBUG);
 }
 
-static uint8_t id = 0;
+// last job id handed to each chain
+static uint8_t job_ids[ASIC_MAX_CHAINS];
 
-void BM1368_send_work(void * pvParameters, bm_job * next_bm_job)
+void BM1368_prepare_work(bm_job * next_bm_job)
 {
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
-
     BM1368_job job;
-    id = (id + 24) % 128;
-    job.job_id = id;
+    // the job id is patched in when the job is dispatched
+    job.job_id = 0;
     job.num_midstates = 0x01;
     memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
     memcpy(&job.nbits, &next_bm_job->target, 4);
@@ -354,53 +348,72 @@ void BM1368_send_work(void * pvParameters, bm_job * next_bm_job)
     memcpy(job.prev_block_hash, next_bm_job->prev_block_hash_be, 32);
     memcpy(&job.version, &next_bm_job->version, 4);
 
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL) {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
+    next_bm_job->packet_len = ASIC_frame_build(next_bm_job->packet, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1368_job));
+}
+
+void BM1368_send_work(void * pvParameters, uint8_t chain, bm_job * next_bm_job)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    if (next_bm_job->packet_len == 0) {
+        BM1368_prepare_work(next_bm_job);
+    }
+
+    uint8_t id = ASIC_dispatch_next_job_id(&job_ids[chain], 24);
+    ASIC_frame_set_job_id(next_bm_job->packet, next_bm_job->packet_len, id);
+
+    if (GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[id] != NULL) {
+        free_bm_job(GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[id]);
     }
 
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
+    GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[id] = next_bm_job;
 
     pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
+    GLOBAL_STATE->chains[chain].valid_jobs[id] = 1;
     pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
 
     #if BM1368_DEBUG_JOBS
-    ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
+    ESP_LOGI(TAG, "Send Job: %02X", id);
     #endif
 
-    _send_BM1368((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1368_job), BM1368_DEBUG_WORK);
+    SERIAL_send(chain, next_bm_job->packet, next_bm_job->packet_len, BM1368_DEBUG_WORK);
 }
 
-asic_result * BM1368_receive_work(void)
+asic_result * BM1368_receive_work(uint8_t chain)
 {
-    // wait for a response
-    int received = SERIAL_rx(asic_response_buffer, 11, BM1368_TIMEOUT_MS);
+    // hand out frames left over from the last RX wakeup before waiting on the UART again
+    if (rx_batch_index[chain] < rx_batch_count[chain]) {
+        return (asic_result *) (rx_batch_buffer[chain] + (rx_batch_index[chain]++ * BM1368_RESPONSE_SIZE));
+    }
+
+    // wait for a response, then take every complete frame that is pending
+    int received = SERIAL_rx_frames(chain, rx_batch_buffer[chain], BM1368_RESPONSE_SIZE, SERIAL_RX_BATCH_FRAMES, BM1368_TIMEOUT_MS);
 
     bool uart_err = received < 0;
     bool uart_timeout = received == 0;
-    uint8_t asic_timeout_counter = 0;
+    static uint8_t asic_timeout_counter[ASIC_MAX_CHAINS];
+
+    rx_batch_count[chain] = 0;
+    rx_batch_index[chain] = 0;
 
     // handle response
     if (uart_err) {
         ESP_LOGI(TAG, "UART Error in serial RX");
         return NULL;
     } else if (uart_timeout) {
-        if (asic_timeout_counter >= BM1368_TIMEOUT_THRESHOLD) {
+        if (asic_timeout_counter[chain] >= BM1368_TIMEOUT_THRESHOLD) {
             ESP_LOGE(TAG, "ASIC not sending data");
-            asic_timeout_counter = 0;
+            asic_timeout_counter[chain] = 0;
         }
-        asic_timeout_counter++;
+        asic_timeout_counter[chain]++;
         return NULL;
     }
 
-    if (received != 11 || asic_response_buffer[0] != 0xAA || asic_response_buffer[1] != 0x55) {
-        ESP_LOGE(TAG, "Serial RX invalid %i", received);
-        ESP_LOG_BUFFER_HEX(TAG, asic_response_buffer, received);
-        SERIAL_clear_buffer();
-        return NULL;
-    }
+    asic_timeout_counter[chain] = 0;
+    rx_batch_count[chain] = received;
+    rx_batch_index[chain] = 1;
 
-    return (asic_result *) asic_response_buffer;
+    return (asic_result *) rx_batch_buffer[chain];
 }
 
 static uint16_t reverse_uint16(uint16_t num)
@@ -416,32 +429,49 @@ static uint32_t reverse_uint32(uint32_t val)
            ((val << 24) & 0xff000000);
 }
 
-task_result * BM1368_proccess_work(void * pvParameters)
+task_result * BM1368_proccess_work(void * pvParameters, uint8_t chain)
 {
-    asic_result * asic_result = BM1368_receive_work();
+    asic_result * asic_result = BM1368_receive_work(chain);
 
     if (asic_result == NULL) {
         return NULL;
     }
 
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    if ((asic_result->crc & RESPONSE_JOB) == 0) {
+        // reply to a register read, the value comes big endian where a nonce would be
+        result[chain].is_register = true;
+        result[chain].register_address = asic_result->job_id;
+        result[chain].register_value = reverse_uint32(asic_result->nonce);
+        result[chain].asic_nr = ASIC_get_asic_nr_from_address(asic_result->midstate_num, GLOBAL_STATE->chains[chain].detected_asic_count);
+        if (!ASIC_registers_check(&register_shadow[chain], asic_result->midstate_num, result[chain].register_address, result[chain].register_value)) {
+            ESP_LOGW(TAG, "Chip %d register 0x%02X drifted, reads %08" PRIX32, result[chain].asic_nr, result[chain].register_address, result[chain].register_value);
+        }
+        return &result[chain];
+    }
+    result[chain].is_register = false;
+
     uint8_t job_id = (asic_result->job_id & 0xf0) >> 1;
     uint8_t core_id = (uint8_t)((reverse_uint32(asic_result->nonce) >> 25) & 0x7f);
     uint8_t small_core_id = asic_result->job_id & 0x0f;
     uint32_t version_bits = (reverse_uint16(asic_result->version) << 13);
     ESP_LOGI(TAG, "Job ID: %02X, Core: %d/%d, Ver: %08" PRIX32, job_id, core_id, small_core_id, version_bits);
 
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    result[chain].job_id = job_id;
+    result[chain].nonce = asic_result->nonce;
+    result[chain].asic_nr = ASIC_get_asic_nr(asic_result->nonce, GLOBAL_STATE->chains[chain].detected_asic_count);
+    result[chain].core_id = core_id;
+    result[chain].small_core_id = small_core_id;
 
-    if (GLOBAL_STATE->valid_jobs[job_id] == 0) {
+    if (GLOBAL_STATE->chains[chain].valid_jobs[job_id] == 0) {
         ESP_LOGE(TAG, "Invalid job found, 0x%02X", job_id);
-        return NULL;
+        // still handed to the result task so the error is attributed to the chip
+        result[chain].rolled_version = 0;
+        return &result[chain];
     }
 
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version | version_bits;
-
-    result.job_id = job_id;
-    result.nonce = asic_result->nonce;
-    result.rolled_version = rolled_version;
+    result[chain].rolled_version = GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[job_id]->version | version_bits;
 
-    return &result;
+    return &result[chain];
 }
\ No newline at end of file
@@ -1,6 +1,13 @@
 #include "bm1370.h"
 
+#include "asic_dispatch.h"
+#include "asic_frame.h"
+#include "asic_init_script.h"
+#include "asic_link.h"
+#include "asic_pll.h"
+#include "asic_registers.h"
 #include "crc.h"
+#include "freq_ramp.h"
 #include "global_state.h"
 #include "serial.h"
 #include "utils.h"
@@ -15,7 +22,6 @@
 #include <stdlib.h>
 #include <string.h>
 
-#define GPIO_ASIC_RESET CONFIG_GPIO_ASIC_RESET
 
 #define TYPE_JOB 0x20
 #define TYPE_CMD 0x40
@@ -47,6 +53,7 @@
 
 #define BM1370_TIMEOUT_MS 10000
 #define BM1370_TIMEOUT_THRESHOLD 2
+#define BM1370_RESPONSE_SIZE 11
 
 typedef struct __attribute__((__packed__))
 {
@@ -61,172 +68,165 @@ typedef struct __attribute__((__packed__))
 static const char * TAG = "bm1370Module";
 
 
-static uint8_t asic_response_buffer[SERIAL_BUF_SIZE];
-static task_result result;
+static uint8_t asic_response_buffer[ASIC_MAX_CHAINS][SERIAL_BUF_SIZE];
+static uint8_t rx_batch_buffer[ASIC_MAX_CHAINS][SERIAL_RX_BATCH_FRAMES * BM1370_RESPONSE_SIZE];
+static uint16_t rx_batch_count[ASIC_MAX_CHAINS];
+static uint16_t rx_batch_index[ASIC_MAX_CHAINS];
+static task_result result[ASIC_MAX_CHAINS];
+// what was last written to the chips, writes they already hold are skipped
+static AsicRegisterShadow register_shadow[ASIC_MAX_CHAINS] = {[0 ... ASIC_MAX_CHAINS - 1] = ASIC_REGISTER_SHADOW_INITIALIZER};
+// spacing of the chip addresses on the chain, set during init
+static uint8_t chip_address_interval[ASIC_MAX_CHAINS];
+// PLL dividers of the frequencies the ramp and the tuner step through
+static AsicPllTable pll_table;
 
 /// @brief
 /// @param ftdi
 /// @param header
 /// @param data
 /// @param len
-static void _send_BM1370(uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
+static void _send_BM1370(uint8_t chain, uint8_t header, uint8_t * data, uint8_t data_len, bool debug)
 {
-    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
-    uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
-
-    // allocate memory for buffer
-    unsigned char * buf = malloc(total_length);
-
-    // add the preamble
-    buf[0] = 0x55;
-    buf[1] = 0xAA;
-
-    // add the header field
-    buf[2] = header;
-
-    // add the length field
-    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
-
-    // add the data
-    memcpy(buf + 4, data, data_len);
-
-    // add the correct crc type
-    if (packet_type == JOB_PACKET) {
-        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
-        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
-        buf[5 + data_len] = crc16_total & 0xFF;
-    } else {
-        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
+    if (!ASIC_registers_command(&register_shadow[chain], header, data, data_len)) {
+        return;
     }
 
+    uint8_t buf[ASIC_FRAME_MAX_LEN];
+    uint8_t total_length = ASIC_frame_build(buf, header, data, data_len);
+
     // send serial data
-    if (SERIAL_send(buf, total_length, debug) == 0) {
+    if (SERIAL_send(chain, buf, total_length, debug) == 0) {
         ESP_LOGE(TAG, "Failed to send data to BM1370");
     }
-
-    free(buf);
 }
 
-static void _send_simple(uint8_t * data, uint8_t total_length)
+static void _send_simple(uint8_t chain, uint8_t * data, uint8_t total_length)
 {
-    unsigned char * buf = malloc(total_length);
-    memcpy(buf, data, total_length);
-    SERIAL_send(buf, total_length, BM1370_SERIALTX_DEBUG);
-
-    free(buf);
-}
-
-static void _send_chain_inactive(void)
-{
-
-    unsigned char read_address[2] = {0x00, 0x00};
-    // send serial data
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1370_SERIALTX_DEBUG);
+    // raw frames are always sent, the shadow still has to follow them
+    if (total_length > 5) {
+        ASIC_registers_command(&register_shadow[chain], data[2], &data[4], total_length - 5);
+    }
+    SERIAL_send(chain, data, total_length, BM1370_SERIALTX_DEBUG);
 }
 
-static void _set_chip_address(uint8_t chipAddr)
+/// @brief sends an init script in as few UART writes as its delays allow
+static void _send_init_script(uint8_t chain, const AsicInitStep * steps, int step_count, uint16_t chip_count)
 {
-
-    unsigned char read_address[2] = {chipAddr, 0x00};
-    // send serial data
-    _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1370_SERIALTX_DEBUG);
+    uint8_t buf[ASIC_INIT_BATCH_SIZE];
+    size_t len;
+    uint32_t delay_ms;
+
+    AsicInitScript script;
+    ASIC_init_script_start(&script, steps, step_count, chip_count, &register_shadow[chain]);
+    while (ASIC_init_script_next(&script, buf, sizeof(buf), &len, &delay_ms)) {
+        if (len > 0) {
+            SERIAL_send(chain, buf, len, BM1370_SERIALTX_DEBUG);
+        }
+        if (delay_ms > 0) {
+            vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        }
+    }
 }
 
-void BM1370_set_version_mask(uint32_t version_mask) 
+void BM1370_set_version_mask(uint8_t chain, uint32_t version_mask) 
 {
     int versions_to_roll = version_mask >> 13;
     uint8_t version_byte0 = (versions_to_roll >> 8);
     uint8_t version_byte1 = (versions_to_roll & 0xFF); 
     uint8_t version_cmd[] = {0x00, 0xA4, 0x90, 0x00, version_byte0, version_byte1};
-    _send_BM1370(TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1370_SERIALTX_DEBUG);
+    _send_BM1370(chain, TYPE_CMD | GROUP_ALL | CMD_WRITE, version_cmd, 6, BM1370_SERIALTX_DEBUG);
 }
 
-void BM1370_send_hash_frequency(int id, float target_freq, float max_diff) {
-    uint8_t freqbuf[6] = {0x00, 0x08, 0x40, 0xA0, 0x02, 0x41};
-    uint8_t postdiv_min = 255;
-    uint8_t postdiv2_min = 255;
-    float best_freq = 0;
-    uint8_t best_refdiv = 0, best_fbdiv = 0, best_postdiv1 = 0, best_postdiv2 = 0;
-
-    for (uint8_t refdiv = 2; refdiv > 0; refdiv--) {
-        for (uint8_t postdiv1 = 7; postdiv1 > 0; postdiv1--) {
-            for (uint8_t postdiv2 = 7; postdiv2 > 0; postdiv2--) {
-                uint16_t fb_divider = round(target_freq / 25.0 * (refdiv * postdiv2 * postdiv1));
-                float newf = 25.0 * fb_divider / (refdiv * postdiv2 * postdiv1);
-                
-                if (fb_divider >= 0xa0 && fb_divider <= 0xef &&
-                    fabs(target_freq - newf) < max_diff &&
-                    postdiv1 >= postdiv2 &&
-                    postdiv1 * postdiv2 < postdiv_min &&
-                    postdiv2 <= postdiv2_min) {
-                    
-                    postdiv2_min = postdiv2;
-                    postdiv_min = postdiv1 * postdiv2;
-                    best_freq = newf;
-                    best_refdiv = refdiv;
-                    best_fbdiv = fb_divider;
-                    best_postdiv1 = postdiv1;
-                    best_postdiv2 = postdiv2;
-                }
-            }
-        }
+void BM1370_read_hash_counter(uint8_t chain)
+{
+    _send_BM1370(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, ASIC_HASH_COUNTER_REGISTER}, 2, false);
+}
+
+void BM1370_verify_registers(uint8_t chain)
+{
+    uint8_t registers[ASIC_REGISTER_COUNT];
+    int count = ASIC_registers_verifiable(&register_shadow[chain], registers, ASIC_REGISTER_COUNT);
+    for (int i = 0; i < count; i++) {
+        _send_BM1370(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), (uint8_t[]){0x00, registers[i]}, 2, false);
     }
+}
 
-    if (best_fbdiv == 0) {
+const AsicRegisterShadow * BM1370_get_register_shadow(uint8_t chain)
+{
+    return &register_shadow[chain];
+}
+
+void BM1370_send_hash_frequency(uint8_t chain, int id, float target_freq, float max_diff) {
+    AsicPllSetting pll;
+    if (!ASIC_pll_get(&pll_table, target_freq, max_diff, &pll)) {
         ESP_LOGE(TAG, "Failed to find PLL settings for target frequency %.2f", target_freq);
         return;
     }
 
-    freqbuf[2] = (best_fbdiv * 25 / best_refdiv >= 2400) ? 0x50 : 0x40;
-    freqbuf[3] = best_fbdiv;
-    freqbuf[4] = best_refdiv;
-    freqbuf[5] = (((best_postdiv1 - 1) & 0xf) << 4) | ((best_postdiv2 - 1) & 0xf);
+    uint32_t pll_value = ASIC_pll_register_value(&pll);
+    uint8_t freqbuf[6] = {0x00, 0x08, pll_value >> 24, (pll_value >> 16) & 0xFF, (pll_value >> 8) & 0xFF, pll_value & 0xFF};
 
     if (id != -1) {
-        freqbuf[0] = id * 2;
-        _send_BM1370(TYPE_CMD | GROUP_SINGLE | CMD_WRITE, freqbuf, 6, BM1370_SERIALTX_DEBUG);
+        freqbuf[0] = id * chip_address_interval[chain];
+        _send_BM1370(chain, TYPE_CMD | GROUP_SINGLE | CMD_WRITE, freqbuf, 6, BM1370_SERIALTX_DEBUG);
     } else {
-        _send_BM1370(TYPE_CMD | GROUP_ALL | CMD_WRITE, freqbuf, 6, BM1370_SERIALTX_DEBUG);
+        _send_BM1370(chain, TYPE_CMD | GROUP_ALL | CMD_WRITE, freqbuf, 6, BM1370_SERIALTX_DEBUG);
     }
 
-    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f)", target_freq, best_freq);
+    ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f)", target_freq, ASIC_pll_frequency(&pll));
 }
 
-static void do_frequency_ramp_up(float target_frequency) {
+void BM1370_set_chip_frequency(uint8_t chain, uint8_t asic_nr, float frequency)
+{
+    BM1370_send_hash_frequency(chain, asic_nr, frequency, 0.001);
+}
+
+static void do_frequency_ramp_up(uint8_t chain, float target_frequency) {
     float current = 56.25;
-    float step = 6.25;
 
     if (target_frequency == 0) {
         ESP_LOGI(TAG, "Skipping frequency ramp");
         return;
     }
 
-    ESP_LOGI(TAG, "Ramping up frequency from %.2f MHz to %.2f MHz with step %.2f MHz", current, target_frequency, step);
-
-    BM1370_send_hash_frequency(-1, current, 0.001);
-    
-    while (current < target_frequency) {
-        float next_step = fminf(step, target_frequency - current);
-        current += next_step;
-        BM1370_send_hash_frequency(-1, current, 0.001);
-        vTaskDelay(pdMS_TO_TICKS(100));
+    FreqRampCurrentFn read_current = FREQ_RAMP_current_sensor();
+    FreqRampConfig config;
+    FREQ_RAMP_default_config(&config, read_current != NULL);
+    FreqRamp ramp;
+    FREQ_RAMP_init(&ramp, &config, current, target_frequency);
+
+    ESP_LOGI(TAG, "Ramping up frequency from %.2f MHz to %.2f MHz%s", current, target_frequency,
+             read_current != NULL ? " as the regulator current settles" : "");
+
+    BM1370_send_hash_frequency(chain, -1, current, 0.001);
+
+    float frequency;
+    while (FREQ_RAMP_next(&ramp, &frequency)) {
+        BM1370_send_hash_frequency(chain, -1, frequency, 0.001);
+        uint32_t dwell_ms = 0;
+        do {
+            vTaskDelay(pdMS_TO_TICKS(config.sample_ms));
+            dwell_ms += config.sample_ms;
+        } while (!FREQ_RAMP_settled(&ramp, read_current != NULL ? read_current() : -1, dwell_ms));
     }
+
+    ESP_LOGI(TAG, "Frequency ramp took %d steps, %" PRIu32 " ms", ramp.steps, ramp.elapsed_ms);
 }
 
-static uint8_t _send_init(uint64_t frequency, uint16_t asic_count)
+static uint8_t _send_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
     // set version mask
     for (int i = 0; i < 3; i++) {
-        BM1370_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
+        BM1370_set_version_mask(chain, STRATUM_DEFAULT_VERSION_MASK);
     }
 
     //read register 00 on all chips (should respond AA 55 13 68 00 00 00 00 00 00 0F)
     unsigned char init3[7] = {0x55, 0xAA, 0x52, 0x05, 0x00, 0x00, 0x0A};
-    _send_simple(init3, 7);
+    _send_simple(chain, init3, 7);
 
     int chip_counter = 0;
     while (true) {
-        if (SERIAL_rx(asic_response_buffer, 11, 1000) > 0) {
+        if (SERIAL_rx(chain, asic_response_buffer[chain], 11, chip_counter < asic_count ? 1000 : ASIC_INIT_COUNT_TAIL_MS) > 0) {
             chip_counter++;
         } else {
             break;
@@ -234,84 +234,46 @@ static uint8_t _send_init(uint64_t frequency, uint16_t asic_count)
     }
     ESP_LOGI(TAG, "%i chip(s) detected on the chain, expected %i", chip_counter, asic_count);
 
-    // set version mask
-    BM1370_set_version_mask(STRATUM_DEFAULT_VERSION_MASK);
-
-    //Reg_A8
-    //unsigned char init5[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03};
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0xA8, 0x00, 0x07, 0x00, 0x00}, 6, BM1370_SERIALTX_DEBUG);
-
-    //Misc Control
-    //TX: 55 AA 51 09 [00 18 F0 00 C1 00] 04 //command all chips, write chip address 00, register 18, data F0 00 C1 00 - Misc Control
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x18, 0xF0, 0x00, 0xC1, 0x00}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    //_send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x18, 0xFF, 0x0F, 0xC1, 0x00}, 6, BM1370_SERIALTX_DEBUG); //from S21 dump
-
-    //chain inactive
-    _send_chain_inactive();
-    // unsigned char init7[7] = {0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03};
-    // _send_simple(init7, 7);
+    // the chain was just reset, it holds none of the values written before
+    ASIC_registers_init(&register_shadow[chain], chip_counter, chip_counter > 0 ? 256 / chip_counter : 0);
 
     // split the chip address space evenly
-    uint8_t address_interval = (uint8_t) (256 / chip_counter);
-    for (uint8_t i = 0; i < chip_counter; i++) {
-        _set_chip_address(i * address_interval);
-        // unsigned char init8[7] = {0x55, 0xAA, 0x40, 0x05, 0x00, 0x00, 0x1C};
-        // _send_simple(init8, 7);
-    }
-
-    //Core Register Control
-    //unsigned char init9[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x3C, 0x80, 0x00, 0x8B, 0x00, 0x12};
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x8B, 0x00}, 6, BM1370_SERIALTX_DEBUG);
-
-    //Core Register Control
-    //TX: 55 AA 51 09 [00 3C 80 00 80 0C] 11  //command all chips, write chip address 00, register 3C, data 80 00 80 0C - Core Register Control
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x80, 0x0C}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    //_send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x80, 0x18}, 6, BM1370_SERIALTX_DEBUG); //from S21 dump
-
-    //set ticket mask
-    // unsigned char init11[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x14, 0x00, 0x00, 0x00, 0xFF, 0x08};
-    BM1370_set_job_difficulty_mask(BM1370_ASIC_DIFFICULTY);
-
-    //Analog Mux Control -- not sent on S21 Pro?
-    // unsigned char init12[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x54, 0x00, 0x00, 0x00, 0x03, 0x1D};
-    // _send_simple(init12, 11);
-
-    //Set the IO Driver Strength on chip 00
-    //TX: 55 AA 51 09 [00 58 00 01 11 11] 0D  //command all chips, write chip address 00, register 58, data 01 11 11 11 - Set the IO Driver Strength on chip 00
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x58, 0x00, 0x01, 0x11, 0x11}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    //_send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x58, 0x02, 0x11, 0x11, 0x11}, 6, BM1370_SERIALTX_DEBUG); //from S21Pro dump
-    
-
-    for (uint8_t i = 0; i < chip_counter; i++) {
-        //TX: 55 AA 41 09 00 [A8 00 07 01 F0] 15    // Reg_A8
-        unsigned char set_a8_register[6] = {i * address_interval, 0xA8, 0x00, 0x07, 0x01, 0xF0};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_a8_register, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [18 F0 00 C1 00] 0C    // Misc Control
-        unsigned char set_18_register[6] = {i * address_interval, 0x18, 0xF0, 0x00, 0xC1, 0x00};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_18_register, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [3C 80 00 8B 00] 1A    // Core Register Control
-        unsigned char set_3c_register_first[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x8B, 0x00};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_first, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [3C 80 00 80 0C] 19    // Core Register Control
-        unsigned char set_3c_register_second[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x80, 0x0C};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_second, 6, BM1370_SERIALTX_DEBUG);
-        //TX: 55 AA 41 09 00 [3C 80 00 82 AA] 05    // Core Register Control
-        unsigned char set_3c_register_third[6] = {i * address_interval, 0x3C, 0x80, 0x00, 0x82, 0xAA};
-        _send_BM1370((TYPE_CMD | GROUP_SINGLE | CMD_WRITE), set_3c_register_third, 6, BM1370_SERIALTX_DEBUG);
-    }
-
-    //Some misc settings?
-    // TX: 55 AA 51 09 [00 B9 00 00 44 80] 0D    //command all chips, write chip address 00, register B9, data 00 00 44 80
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0xB9, 0x00, 0x00, 0x44, 0x80}, 6, BM1370_SERIALTX_DEBUG);
-    // TX: 55 AA 51 09 [00 54 00 00 00 02] 18    //command all chips, write chip address 00, register 54, data 00 00 00 02 - Analog Mux Control - rumored to control the temp diode
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x54, 0x00, 0x00, 0x00, 0x02}, 6, BM1370_SERIALTX_DEBUG);
-    // TX: 55 AA 51 09 [00 B9 00 00 44 80] 0D    //command all chips, write chip address 00, register B9, data 00 00 44 80 -- duplicate of first command in series
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0xB9, 0x00, 0x00, 0x44, 0x80}, 6, BM1370_SERIALTX_DEBUG);
-    // TX: 55 AA 51 09 [00 3C 80 00 8D EE] 1B    //command all chips, write chip address 00, register 3C, data 80 00 8D EE
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), (uint8_t[]){0x00, 0x3C, 0x80, 0x00, 0x8D, 0xEE}, 6, BM1370_SERIALTX_DEBUG);
+    chip_address_interval[chain] = chip_counter > 0 ? 256 / chip_counter : 0;
+
+    const AsicInitStep init_script[] = {
+        // version mask
+        ASIC_INIT_WRITE_ALL(0xA4, 0x90000000 | (STRATUM_DEFAULT_VERSION_MASK >> 13)),
+        // Reg_A8
+        ASIC_INIT_WRITE_ALL(0xA8, 0x00070000),
+        // Misc Control, from S21Pro dump (S21 dump: 0xFF0FC100)
+        ASIC_INIT_WRITE_ALL(MISC_CONTROL, 0xF000C100),
+        ASIC_INIT_CHAIN_INACTIVE,
+        ASIC_INIT_SET_ADDRESSES,
+        // Core Register Control, the second from S21Pro dump (S21 dump: 0x80008018)
+        ASIC_INIT_WRITE_ALL(CORE_REGISTER_CONTROL, 0x80008B00),
+        ASIC_INIT_WRITE_ALL(CORE_REGISTER_CONTROL, 0x8000800C),
+        ASIC_INIT_WRITE_ALL(TICKET_MASK, ASIC_get_ticket_mask(BM1370_ASIC_DIFFICULTY)),
+        // IO Driver Strength, from S21Pro dump. Analog Mux Control is not sent here on S21 Pro
+        ASIC_INIT_WRITE_ALL(0x58, 0x00011111),
+        ASIC_INIT_FOR_EACH_CHIP,
+            ASIC_INIT_WRITE_CHIP(0xA8, 0x000701F0),
+            ASIC_INIT_WRITE_CHIP(MISC_CONTROL, 0xF000C100),
+            ASIC_INIT_WRITE_CHIP(CORE_REGISTER_CONTROL, 0x80008B00),
+            ASIC_INIT_WRITE_CHIP(CORE_REGISTER_CONTROL, 0x8000800C),
+            ASIC_INIT_WRITE_CHIP(CORE_REGISTER_CONTROL, 0x800082AA),
+        ASIC_INIT_END_FOR_EACH,
+        // some misc settings?
+        ASIC_INIT_WRITE_ALL(0xB9, 0x00004480),
+        // Analog Mux Control - rumored to control the temp diode
+        ASIC_INIT_WRITE_ALL(0x54, 0x00000002),
+        // duplicate of the first B9 write in the dump
+        ASIC_INIT_WRITE_ALL(0xB9, 0x00004480),
+        ASIC_INIT_WRITE_ALL(CORE_REGISTER_CONTROL, 0x80008DEE),
+    };
+    _send_init_script(chain, init_script, sizeof(init_script) / sizeof(init_script[0]), chip_counter);
 
     //ramp up the hash frequency
-    do_frequency_ramp_up(frequency);
+    do_frequency_ramp_up(chain, frequency);
 
     //register 10 is still a bit of a mystery. discussion: https://github.com/skot/ESP-Miner/pull/167
 
@@ -319,23 +281,23 @@ static uint8_t _send_init(uint64_t frequency, uint16_t asic_count)
     // unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x14, 0x46}; //S19XP-Luxos Default
     // unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x15, 0x1C}; //S19XP-Stock Default
     //unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x15, 0xA4}; //S21-Stock Default
-    unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x00, 0x1E, 0xB5}; //S21 Pro-Stock Default
+    unsigned char set_10_hash_counting[6] = {0x00, 0x10, (BM1370_NONCE_RANGE >> 24) & 0xFF, (BM1370_NONCE_RANGE >> 16) & 0xFF, (BM1370_NONCE_RANGE >> 8) & 0xFF, BM1370_NONCE_RANGE & 0xFF}; //S21 Pro-Stock Default
     // unsigned char set_10_hash_counting[6] = {0x00, 0x10, 0x00, 0x0F, 0x00, 0x00}; //supposedly the "full" 32bit nonce range
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), set_10_hash_counting, 6, BM1370_SERIALTX_DEBUG);
+    _send_BM1370(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), set_10_hash_counting, 6, BM1370_SERIALTX_DEBUG);
 
     return chip_counter;
 }
 
 // reset the BM1370 via the RTS line
-static void _reset(void)
+static void _reset(uint8_t chain)
 {
-    gpio_set_level(GPIO_ASIC_RESET, 0);
+    gpio_set_level(SERIAL_reset_gpio(chain), 0);
 
     // delay for 100ms
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
     // set the gpio pin high
-    gpio_set_level(GPIO_ASIC_RESET, 1);
+    gpio_set_level(SERIAL_reset_gpio(chain), 1);
 
     // delay for 100ms
     vTaskDelay(100 / portTICK_PERIOD_MS);
@@ -346,46 +308,68 @@ static void _reset(void)
 
 //     unsigned char read_address[2] = {0x00, 0x00};
 //     // send serial data
-//     _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1370_SERIALTX_DEBUG);
+//     _send_BM1370(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1370_SERIALTX_DEBUG);
 // }
 
-uint8_t BM1370_init(uint64_t frequency, uint16_t asic_count)
+uint8_t BM1370_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
     ESP_LOGI(TAG, "Initializing BM1370");
 
-    memset(asic_response_buffer, 0, SERIAL_BUF_SIZE);
+    // the table is shared by every chain and only built by the first init
+    if (pll_table.fb_max == 0) {
+        ASIC_pll_table_init(&pll_table, ASIC_PLL_SEARCH_EXACT, 0xA0, 0xEF);
+    }
 
-    esp_rom_gpio_pad_select_gpio(GPIO_ASIC_RESET);
-    gpio_set_direction(GPIO_ASIC_RESET, GPIO_MODE_OUTPUT);
+    memset(asic_response_buffer[chain], 0, SERIAL_BUF_SIZE);
+
+    esp_rom_gpio_pad_select_gpio(SERIAL_reset_gpio(chain));
+    gpio_set_direction(SERIAL_reset_gpio(chain), GPIO_MODE_OUTPUT);
 
     // reset the bm1370
-    _reset();
+    _reset(chain);
+
+    // frames received before the reset belong to work the chain no longer holds
+    rx_batch_count[chain] = 0;
+    rx_batch_index[chain] = 0;
+    // nor does it hold anything written before, until the chips are counted nothing is skipped
+    ASIC_registers_init(&register_shadow[chain], 0, 0);
 
-    return _send_init(frequency, asic_count);
+    return _send_init(chain, frequency, asic_count);
 }
 
 // Baud formula = 25M/((denominator+1)*8)
 // The denominator is 5 bits found in the misc_control (bits 9-13)
-int BM1370_set_default_baud(void)
+int BM1370_set_default_baud(uint8_t chain)
 {
     // default divider of 26 (11010) for 115,749
     unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001}; // baudrate - misc_control
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1370_SERIALTX_DEBUG);
+    _send_BM1370(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1370_SERIALTX_DEBUG);
     return 115749;
 }
 
-int BM1370_set_max_baud(void)
+// the rate is set in the fast UART configuration, ASIC_LINK_FAST_UART_RATES tells why it tops out at 1 Mbaud
+static const SerialLinkModel link_model = {
+    .rates = ASIC_LINK_FAST_UART_RATES,
+    .rate_count = ASIC_LINK_FAST_UART_RATE_COUNT,
+    .response_size = BM1370_RESPONSE_SIZE,
+};
+
+/// @brief steps the UART of a freshly initialized chain up to the fastest rate its chips answer cleanly at
+/// @return baud rate the chips were left at
+int BM1370_set_max_baud(uint8_t chain)
 {
-    // divider of 0 for 3,125,000
-    ESP_LOGI(TAG, "Setting max baud of 1000000 ");
+    return SERIAL_link_negotiate(chain, &link_model, &register_shadow[chain], register_shadow[chain].chip_count);
+}
 
-    unsigned char init8[11] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00, 0x03};
-    _send_simple(init8, 11);
-    return 1000000;
+/// @brief drops a chain whose link degraded to the next slower rate
+/// @return new baud rate, -1 if the chips no longer answer and the chain needs a reset
+int BM1370_fall_back_baud(uint8_t chain)
+{
+    return SERIAL_link_fall_back(chain, &link_model, &register_shadow[chain], register_shadow[chain].chip_count);
 }
 
 
-void BM1370_set_job_difficulty_mask(int difficulty)
+void BM1370_set_job_difficulty_mask(uint8_t chain, int difficulty)
 {
     // Default mask of 256 diff
     unsigned char job_difficulty_mask[9] = {0x00, TICKET_MASK, 0b00000000, 0b00000000, 0b00000000, 0b11111111};
@@ -410,19 +394,17 @@ void BM1370_set_job_difficulty_mask(int difficulty)
 
     ESP_LOGI(TAG, "Setting ASIC difficulty mask to %d", difficulty);
 
-    _send_BM1370((TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1370_SERIALTX_DEBUG);
+    _send_BM1370(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1370_SERIALTX_DEBUG);
 }
 
-static uint8_t id = 0;
+// last job id handed to each chain
+static uint8_t job_ids[ASIC_MAX_CHAINS];
 
-void BM1370_send_work(void * pvParameters, bm_job * next_bm_job)
+void BM1370_prepare_work(bm_job * next_bm_job)
 {
-
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
-
     BM1370_job job;
-    id = (id + 24) % 128;
-    job.job_id = id;
+    // the job id is patched in when the job is dispatched
+    job.job_id = 0;
     job.num_midstates = 0x01;
     memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
     memcpy(&job.nbits, &next_bm_job->target, 4);
@@ -431,54 +413,73 @@ void BM1370_send_work(void * pvParameters, bm_job * next_bm_job)
     memcpy(job.prev_block_hash, next_bm_job->prev_block_hash_be, 32);
     memcpy(&job.version, &next_bm_job->version, 4);
 
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL) {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
+    next_bm_job->packet_len = ASIC_frame_build(next_bm_job->packet, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1370_job));
+}
+
+void BM1370_send_work(void * pvParameters, uint8_t chain, bm_job * next_bm_job)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    if (next_bm_job->packet_len == 0) {
+        BM1370_prepare_work(next_bm_job);
+    }
+
+    uint8_t id = ASIC_dispatch_next_job_id(&job_ids[chain], 24);
+    ASIC_frame_set_job_id(next_bm_job->packet, next_bm_job->packet_len, id);
+
+    if (GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[id] != NULL) {
+        free_bm_job(GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[id]);
     }
 
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
+    GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[id] = next_bm_job;
 
     pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
+    GLOBAL_STATE->chains[chain].valid_jobs[id] = 1;
     pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
 
     //debug sent jobs - this can get crazy if the interval is short
     #if BM1370_DEBUG_JOBS
-    ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
+    ESP_LOGI(TAG, "Send Job: %02X", id);
     #endif
 
-    _send_BM1370((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(BM1370_job), BM1370_DEBUG_WORK);
+    SERIAL_send(chain, next_bm_job->packet, next_bm_job->packet_len, BM1370_DEBUG_WORK);
 }
 
-asic_result * BM1370_receive_work(void)
+asic_result * BM1370_receive_work(uint8_t chain)
 {
-    // wait for a response
-    int received = SERIAL_rx(asic_response_buffer, 11, BM1370_TIMEOUT_MS);
+    // hand out frames left over from the last RX wakeup before waiting on the UART again
+    if (rx_batch_index[chain] < rx_batch_count[chain]) {
+        return (asic_result *) (rx_batch_buffer[chain] + (rx_batch_index[chain]++ * BM1370_RESPONSE_SIZE));
+    }
+
+    // wait for a response, then take every complete frame that is pending
+    int received = SERIAL_rx_frames(chain, rx_batch_buffer[chain], BM1370_RESPONSE_SIZE, SERIAL_RX_BATCH_FRAMES, BM1370_TIMEOUT_MS);
 
     bool uart_err = received < 0;
     bool uart_timeout = received == 0;
-    uint8_t asic_timeout_counter = 0;
+    static uint8_t asic_timeout_counter[ASIC_MAX_CHAINS];
+
+    rx_batch_count[chain] = 0;
+    rx_batch_index[chain] = 0;
 
     // handle response
     if (uart_err) {
         ESP_LOGI(TAG, "UART Error in serial RX");
         return NULL;
     } else if (uart_timeout) {
-        if (asic_timeout_counter >= BM1370_TIMEOUT_THRESHOLD) {
+        if (asic_timeout_counter[chain] >= BM1370_TIMEOUT_THRESHOLD) {
             ESP_LOGE(TAG, "ASIC not sending data");
-            asic_timeout_counter = 0;
+            asic_timeout_counter[chain] = 0;
         }
-        asic_timeout_counter++;
+        asic_timeout_counter[chain]++;
         return NULL;
     }
 
-    if (received != 11 || asic_response_buffer[0] != 0xAA || asic_response_buffer[1] != 0x55) {
-        ESP_LOGI(TAG, "Serial RX invalid %i", received);
-        ESP_LOG_BUFFER_HEX(TAG, asic_response_buffer, received);
-        SERIAL_clear_buffer();
-        return NULL;
-    }
+    asic_timeout_counter[chain] = 0;
+    rx_batch_count[chain] = received;
+    rx_batch_index[chain] = 1;
 
-    return (asic_result *) asic_response_buffer;
+    return (asic_result *) rx_batch_buffer[chain];
 }
 
 static uint16_t reverse_uint16(uint16_t num)
@@ -494,15 +495,30 @@ static uint32_t reverse_uint32(uint32_t val)
            ((val << 24) & 0xff000000); // Move byte 0 to byte 3
 }
 
-task_result * BM1370_proccess_work(void * pvParameters)
+task_result * BM1370_proccess_work(void * pvParameters, uint8_t chain)
 {
 
-    asic_result * asic_result = BM1370_receive_work();
+    asic_result * asic_result = BM1370_receive_work(chain);
 
     if (asic_result == NULL) {
         return NULL;
     }
 
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    if ((asic_result->crc & RESPONSE_JOB) == 0) {
+        // reply to a register read, the value comes big endian where a nonce would be
+        result[chain].is_register = true;
+        result[chain].register_address = asic_result->job_id;
+        result[chain].register_value = reverse_uint32(asic_result->nonce);
+        result[chain].asic_nr = ASIC_get_asic_nr_from_address(asic_result->midstate_num, GLOBAL_STATE->chains[chain].detected_asic_count);
+        if (!ASIC_registers_check(&register_shadow[chain], asic_result->midstate_num, result[chain].register_address, result[chain].register_value)) {
+            ESP_LOGW(TAG, "Chip %d register 0x%02X drifted, reads %08" PRIX32, result[chain].asic_nr, result[chain].register_address, result[chain].register_value);
+        }
+        return &result[chain];
+    }
+    result[chain].is_register = false;
+
     // uint8_t job_id = asic_result->job_id;
     // uint8_t rx_job_id = ((int8_t)job_id & 0xf0) >> 1;
     // ESP_LOGI(TAG, "Job ID: %02X, RX: %02X", job_id, rx_job_id);
@@ -516,18 +532,20 @@ task_result * BM1370_proccess_work(void * pvParameters)
     uint32_t version_bits = (reverse_uint16(asic_result->version) << 13); // shift the 16 bit value left 13
     ESP_LOGI(TAG, "Job ID: %02X, Core: %d/%d, Ver: %08" PRIX32, job_id, core_id, small_core_id, version_bits);
 
-    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+    result[chain].job_id = job_id;
+    result[chain].nonce = asic_result->nonce;
+    result[chain].asic_nr = ASIC_get_asic_nr(asic_result->nonce, GLOBAL_STATE->chains[chain].detected_asic_count);
+    result[chain].core_id = core_id;
+    result[chain].small_core_id = small_core_id;
 
-    if (GLOBAL_STATE->valid_jobs[job_id] == 0) {
+    if (GLOBAL_STATE->chains[chain].valid_jobs[job_id] == 0) {
         ESP_LOGE(TAG, "Invalid job nonce found, 0x%02X", job_id);
-        return NULL;
+        // still handed to the result task so the error is attributed to the chip
+        result[chain].rolled_version = 0;
+        return &result[chain];
     }
 
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version | version_bits;
-
-    result.job_id = job_id;
-    result.nonce = asic_result->nonce;
-    result.rolled_version = rolled_version;
+    result[chain].rolled_version = GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[job_id]->version | version_bits;
 
-    return &result;
+    return &result[chain];
 }
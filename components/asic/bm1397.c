@@ -11,11 +11,14 @@
 #include "serial.h"
 #include "bm1397.h"
 #include "utils.h"
+#include "asic_dispatch.h"
+#include "asic_frame.h"
+#include "asic_init_script.h"
+#include "asic_link.h"
 #include "crc.h"
 #include "mining.h"
 #include "global_state.h"
 
-#define GPIO_ASIC_RESET CONFIG_GPIO_ASIC_RESET
 
 #define TYPE_JOB 0x20
 #define TYPE_CMD 0x40
@@ -47,6 +50,7 @@
 
 #define BM1397_TIMEOUT_MS 10000
 #define BM1397_TIMEOUT_THRESHOLD 2
+#define BM1397_RESPONSE_SIZE 9
 
 typedef struct __attribute__((__packed__))
 {
@@ -59,83 +63,61 @@ typedef struct __attribute__((__packed__))
 
 static const char *TAG = "bm1397Module";
 
-static uint8_t asic_response_buffer[SERIAL_BUF_SIZE];
-static uint32_t prev_nonce = 0;
-static task_result result;
+static uint8_t asic_response_buffer[ASIC_MAX_CHAINS][SERIAL_BUF_SIZE];
+static uint8_t rx_batch_buffer[ASIC_MAX_CHAINS][SERIAL_RX_BATCH_FRAMES * BM1397_RESPONSE_SIZE];
+static uint16_t rx_batch_count[ASIC_MAX_CHAINS];
+static uint16_t rx_batch_index[ASIC_MAX_CHAINS];
+static uint32_t prev_nonce[ASIC_MAX_CHAINS];
+static task_result result[ASIC_MAX_CHAINS];
+// chips that answered the enumeration, each of them has to answer the link probes
+static uint16_t chip_count[ASIC_MAX_CHAINS];
 
 /// @brief
 /// @param ftdi
 /// @param header
 /// @param data
 /// @param len
-static void _send_BM1397(uint8_t header, uint8_t *data, uint8_t data_len, bool debug)
+static void _send_BM1397(uint8_t chain, uint8_t header, uint8_t *data, uint8_t data_len, bool debug)
 {
-    packet_type_t packet_type = (header & TYPE_JOB) ? JOB_PACKET : CMD_PACKET;
-    uint8_t total_length = (packet_type == JOB_PACKET) ? (data_len + 6) : (data_len + 5);
-
-    // allocate memory for buffer
-    unsigned char *buf = malloc(total_length);
-
-    // add the preamble
-    buf[0] = 0x55;
-    buf[1] = 0xAA;
-
-    // add the header field
-    buf[2] = header;
-
-    // add the length field
-    buf[3] = (packet_type == JOB_PACKET) ? (data_len + 4) : (data_len + 3);
-
-    // add the data
-    memcpy(buf + 4, data, data_len);
-
-    // add the correct crc type
-    if (packet_type == JOB_PACKET)
-    {
-        uint16_t crc16_total = crc16_false(buf + 2, data_len + 2);
-        buf[4 + data_len] = (crc16_total >> 8) & 0xFF;
-        buf[5 + data_len] = crc16_total & 0xFF;
-    }
-    else
-    {
-        buf[4 + data_len] = crc5(buf + 2, data_len + 2);
-    }
+    uint8_t buf[ASIC_FRAME_MAX_LEN];
+    uint8_t total_length = ASIC_frame_build(buf, header, data, data_len);
 
     // send serial data
-    SERIAL_send(buf, total_length, debug);
-
-    free(buf);
+    SERIAL_send(chain, buf, total_length, debug);
 }
 
-static void _send_read_address(void)
+static void _send_read_address(uint8_t chain)
 {
     unsigned char read_address[2] = {0x00, 0x00};
     // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1937_SERIALTX_DEBUG);
-}
-
-static void _send_chain_inactive(void)
-{
-
-    unsigned char read_address[2] = {0x00, 0x00};
-    // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_INACTIVE), read_address, 2, BM1937_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_READ), read_address, 2, BM1937_SERIALTX_DEBUG);
 }
 
-static void _set_chip_address(uint8_t chipAddr)
+/// @brief sends an init script in as few UART writes as its delays allow
+static void _send_init_script(uint8_t chain, const AsicInitStep * steps, int step_count, uint16_t chip_count)
 {
-
-    unsigned char read_address[2] = {chipAddr, 0x00};
-    // send serial data
-    _send_BM1397((TYPE_CMD | GROUP_SINGLE | CMD_SETADDRESS), read_address, 2, BM1937_SERIALTX_DEBUG);
+    uint8_t buf[ASIC_INIT_BATCH_SIZE];
+    size_t len;
+    uint32_t delay_ms;
+
+    AsicInitScript script;
+    ASIC_init_script_start(&script, steps, step_count, chip_count, NULL);
+    while (ASIC_init_script_next(&script, buf, sizeof(buf), &len, &delay_ms)) {
+        if (len > 0) {
+            SERIAL_send(chain, buf, len, BM1937_SERIALTX_DEBUG);
+        }
+        if (delay_ms > 0) {
+            vTaskDelay(pdMS_TO_TICKS(delay_ms));
+        }
+    }
 }
 
-void BM1397_set_version_mask(uint32_t version_mask) {
+void BM1397_set_version_mask(uint8_t chain, uint32_t version_mask) {
     // placeholder
 }
 
 // borrowed from cgminer driver-gekko.c calc_gsf_freq()
-void BM1397_send_hash_frequency(float frequency)
+void BM1397_send_hash_frequency(uint8_t chain, float frequency)
 {
 
     unsigned char prefreq1[9] = {0x00, 0x70, 0x0F, 0x0F, 0x0F, 0x00}; // prefreq - pll0_divider
@@ -211,12 +193,12 @@ void BM1397_send_hash_frequency(float frequency)
     for (i = 0; i < 2; i++)
     {
         vTaskDelay(10 / portTICK_PERIOD_MS);
-        _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), prefreq1, 6, BM1937_SERIALTX_DEBUG);
+        _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), prefreq1, 6, BM1937_SERIALTX_DEBUG);
     }
     for (i = 0; i < 2; i++)
     {
         vTaskDelay(10 / portTICK_PERIOD_MS);
-        _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), freqbuf, 6, BM1937_SERIALTX_DEBUG);
+        _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), freqbuf, 6, BM1937_SERIALTX_DEBUG);
     }
 
     vTaskDelay(10 / portTICK_PERIOD_MS);
@@ -224,108 +206,111 @@ void BM1397_send_hash_frequency(float frequency)
     ESP_LOGI(TAG, "Setting Frequency to %.2fMHz (%.2f)", frequency, newf);
 }
 
-static uint8_t _send_init(uint64_t frequency, uint16_t asic_count)
+static uint8_t _send_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
     // send the init command
-    _send_read_address();
+    _send_read_address(chain);
 
     int chip_counter = 0;
     while (true) {
-        if (SERIAL_rx(asic_response_buffer, 11, 1000) > 0) {
+        if (SERIAL_rx(chain, asic_response_buffer[chain], 11, chip_counter < asic_count ? 1000 : ASIC_INIT_COUNT_TAIL_MS) > 0) {
             chip_counter++;
         } else {
             break;
         }
     }
     ESP_LOGI(TAG, "%i chip(s) detected on the chain, expected %i", chip_counter, asic_count);
-
-    // send serial data
-    vTaskDelay(SLEEP_TIME / portTICK_PERIOD_MS);
-    _send_chain_inactive();
-
-    // split the chip address space evenly
-    for (uint8_t i = 0; i < asic_count; i++) {
-        _set_chip_address(i * (256 / asic_count));
-    }
-
-    unsigned char init[6] = {0x00, CLOCK_ORDER_CONTROL_0, 0x00, 0x00, 0x00, 0x00}; // init1 - clock_order_control0
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init, 6, BM1937_SERIALTX_DEBUG);
-
-    unsigned char init2[6] = {0x00, CLOCK_ORDER_CONTROL_1, 0x00, 0x00, 0x00, 0x00}; // init2 - clock_order_control1
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init2, 6, BM1937_SERIALTX_DEBUG);
-
-    unsigned char init3[9] = {0x00, ORDERED_CLOCK_ENABLE, 0x00, 0x00, 0x00, 0x01}; // init3 - ordered_clock_enable
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init3, 6, BM1937_SERIALTX_DEBUG);
-
-    unsigned char init4[9] = {0x00, CORE_REGISTER_CONTROL, 0x80, 0x00, 0x80, 0x74}; // init4 - init_4_?
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init4, 6, BM1937_SERIALTX_DEBUG);
-
-    BM1397_set_job_difficulty_mask(BM1397_ASIC_DIFFICULTY);
-
-    unsigned char init5[9] = {0x00, PLL3_PARAMETER, 0xC0, 0x70, 0x01, 0x11}; // init5 - pll3_parameter
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init5, 6, BM1937_SERIALTX_DEBUG);
-
-    unsigned char init6[9] = {0x00, FAST_UART_CONFIGURATION, 0x06, 0x00, 0x00, 0x0F}; // init6 - fast_uart_configuration
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), init6, 6, BM1937_SERIALTX_DEBUG);
-
-    BM1397_set_default_baud();
-
-    BM1397_send_hash_frequency(frequency);
+    chip_count[chain] = chip_counter;
+
+    // chip addresses split the address space evenly by the expected chip count
+    const AsicInitStep init_script[] = {
+        ASIC_INIT_DELAY_MS(SLEEP_TIME),
+        ASIC_INIT_CHAIN_INACTIVE,
+        ASIC_INIT_SET_ADDRESSES,
+        ASIC_INIT_WRITE_ALL(CLOCK_ORDER_CONTROL_0, 0x00000000),
+        ASIC_INIT_WRITE_ALL(CLOCK_ORDER_CONTROL_1, 0x00000000),
+        ASIC_INIT_WRITE_ALL(ORDERED_CLOCK_ENABLE, 0x00000001),
+        // init_4_?
+        ASIC_INIT_WRITE_ALL(CORE_REGISTER_CONTROL, 0x80008074),
+        ASIC_INIT_WRITE_ALL(TICKET_MASK, ASIC_get_ticket_mask(BM1397_ASIC_DIFFICULTY)),
+        ASIC_INIT_WRITE_ALL(PLL3_PARAMETER, 0xC0700111),
+        ASIC_INIT_WRITE_ALL(FAST_UART_CONFIGURATION, 0x0600000F),
+    };
+    _send_init_script(chain, init_script, sizeof(init_script) / sizeof(init_script[0]), asic_count);
+
+    BM1397_set_default_baud(chain);
+
+    BM1397_send_hash_frequency(chain, frequency);
 
     return chip_counter;
 }
 
 // reset the BM1397 via the RTS line
-static void _reset(void)
+static void _reset(uint8_t chain)
 {
-    gpio_set_level(GPIO_ASIC_RESET, 0);
+    gpio_set_level(SERIAL_reset_gpio(chain), 0);
 
     // delay for 100ms
     vTaskDelay(100 / portTICK_PERIOD_MS);
 
     // set the gpio pin high
-    gpio_set_level(GPIO_ASIC_RESET, 1);
+    gpio_set_level(SERIAL_reset_gpio(chain), 1);
 
     // delay for 100ms
     vTaskDelay(100 / portTICK_PERIOD_MS);
 }
 
-uint8_t BM1397_init(uint64_t frequency, uint16_t asic_count)
+uint8_t BM1397_init(uint8_t chain, uint64_t frequency, uint16_t asic_count)
 {
     ESP_LOGI(TAG, "Initializing BM1397");
 
-    memset(asic_response_buffer, 0, SERIAL_BUF_SIZE);
+    memset(asic_response_buffer[chain], 0, SERIAL_BUF_SIZE);
 
-    esp_rom_gpio_pad_select_gpio(GPIO_ASIC_RESET);
-    gpio_set_direction(GPIO_ASIC_RESET, GPIO_MODE_OUTPUT);
+    esp_rom_gpio_pad_select_gpio(SERIAL_reset_gpio(chain));
+    gpio_set_direction(SERIAL_reset_gpio(chain), GPIO_MODE_OUTPUT);
 
     // reset the bm1397
-    _reset();
+    _reset(chain);
+
+    // frames received before the reset belong to work the chain no longer holds
+    rx_batch_count[chain] = 0;
+    rx_batch_index[chain] = 0;
 
-    return _send_init(frequency, asic_count);
+    return _send_init(chain, frequency, asic_count);
 }
 
 // Baud formula = 25M/((denominator+1)*8)
 // The denominator is 5 bits found in the misc_control (bits 9-13)
-int BM1397_set_default_baud(void)
+int BM1397_set_default_baud(uint8_t chain)
 {
     // default divider of 26 (11010) for 115,749
     unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01111010, 0b00110001}; // baudrate - misc_control
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1937_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1937_SERIALTX_DEBUG);
     return 115749;
 }
 
-int BM1397_set_max_baud(void)
+// the rate is set in the BT8D divider of MISC_CONTROL
+static const SerialLinkModel link_model = {
+    .rates = ASIC_LINK_BT8D_RATES,
+    .rate_count = ASIC_LINK_BT8D_RATE_COUNT,
+    .response_size = BM1397_RESPONSE_SIZE,
+};
+
+/// @brief steps the UART of a freshly initialized chain up to the fastest rate its chips answer cleanly at
+/// @return baud rate the chips were left at
+int BM1397_set_max_baud(uint8_t chain)
 {
-    // divider of 0 for 3,125,000
-    ESP_LOGI(TAG, "Setting max baud of 3125000");
-    unsigned char baudrate[9] = {0x00, MISC_CONTROL, 0x00, 0x00, 0b01100000, 0b00110001};
-    ; // baudrate - misc_control
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), baudrate, 6, BM1937_SERIALTX_DEBUG);
-    return 3125000;
+    return SERIAL_link_negotiate(chain, &link_model, NULL, chip_count[chain]);
 }
 
-void BM1397_set_job_difficulty_mask(int difficulty)
+/// @brief drops a chain whose link degraded to the next slower rate
+/// @return new baud rate, -1 if the chips no longer answer and the chain needs a reset
+int BM1397_fall_back_baud(uint8_t chain)
+{
+    return SERIAL_link_fall_back(chain, &link_model, NULL, chip_count[chain]);
+}
+
+void BM1397_set_job_difficulty_mask(uint8_t chain, int difficulty)
 {
 
     // Default mask of 256 diff
@@ -351,23 +336,17 @@ void BM1397_set_job_difficulty_mask(int difficulty)
 
     ESP_LOGI(TAG, "Setting job ASIC mask to %d", difficulty);
 
-    _send_BM1397((TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1937_SERIALTX_DEBUG);
+    _send_BM1397(chain, (TYPE_CMD | GROUP_ALL | CMD_WRITE), job_difficulty_mask, 6, BM1937_SERIALTX_DEBUG);
 }
 
-static uint8_t id = 0;
+// last job id handed to each chain
+static uint8_t job_ids[ASIC_MAX_CHAINS];
 
-void BM1397_send_work(void *pvParameters, bm_job *next_bm_job)
+void BM1397_prepare_work(bm_job *next_bm_job)
 {
-
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
-
     job_packet job;
-    // max job number is 128
-    // there is still some really weird logic with the job id bits for the asic to sort out
-    // so we have it limited to 128 and it has to increment by 4
-    id = (id + 4) % 128;
-
-    job.job_id = id;
+    // the job id is patched in when the job is dispatched
+    job.job_id = 0;
     job.num_midstates = next_bm_job->num_midstates;
     memcpy(&job.starting_nonce, &next_bm_job->starting_nonce, 4);
     memcpy(&job.nbits, &next_bm_job->target, 4);
@@ -382,62 +361,84 @@ void BM1397_send_work(void *pvParameters, bm_job *next_bm_job)
         memcpy(job.midstate3, next_bm_job->midstate3, 32);
     }
 
-    if (GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] != NULL)
+    next_bm_job->packet_len = ASIC_frame_build(next_bm_job->packet, (TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(job_packet));
+}
+
+void BM1397_send_work(void *pvParameters, uint8_t chain, bm_job *next_bm_job)
+{
+
+    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+
+    if (next_bm_job->packet_len == 0)
+    {
+        BM1397_prepare_work(next_bm_job);
+    }
+
+    // max job number is 128
+    // there is still some really weird logic with the job id bits for the asic to sort out
+    // so we have it limited to 128 and it has to increment by 4
+    uint8_t id = ASIC_dispatch_next_job_id(&job_ids[chain], 4);
+    ASIC_frame_set_job_id(next_bm_job->packet, next_bm_job->packet_len, id);
+
+    if (GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[id] != NULL)
     {
-        free_bm_job(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id]);
+        free_bm_job(GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[id]);
     }
 
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job.job_id] = next_bm_job;
+    GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[id] = next_bm_job;
 
     pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    GLOBAL_STATE->valid_jobs[job.job_id] = 1;
+    GLOBAL_STATE->chains[chain].valid_jobs[id] = 1;
     pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
 
     #if BM1397_DEBUG_JOBS
-    ESP_LOGI(TAG, "Send Job: %02X", job.job_id);
+    ESP_LOGI(TAG, "Send Job: %02X", id);
     #endif
 
-    _send_BM1397((TYPE_JOB | GROUP_SINGLE | CMD_WRITE), (uint8_t *)&job, sizeof(job_packet), BM1397_DEBUG_WORK);
+    SERIAL_send(chain, next_bm_job->packet, next_bm_job->packet_len, BM1397_DEBUG_WORK);
 }
 
-asic_result *BM1397_receive_work(void)
+asic_result *BM1397_receive_work(uint8_t chain)
 {
+    // hand out frames left over from the last RX wakeup before waiting on the UART again
+    if (rx_batch_index[chain] < rx_batch_count[chain]) {
+        return (asic_result *)(rx_batch_buffer[chain] + (rx_batch_index[chain]++ * BM1397_RESPONSE_SIZE));
+    }
 
-    // wait for a response
-    int received = SERIAL_rx(asic_response_buffer, 9, BM1397_TIMEOUT_MS);
+    // wait for a response, then take every complete frame that is pending
+    int received = SERIAL_rx_frames(chain, rx_batch_buffer[chain], BM1397_RESPONSE_SIZE, SERIAL_RX_BATCH_FRAMES, BM1397_TIMEOUT_MS);
 
     bool uart_err = received < 0;
     bool uart_timeout = received == 0;
-    uint8_t asic_timeout_counter = 0;
+    static uint8_t asic_timeout_counter[ASIC_MAX_CHAINS];
+
+    rx_batch_count[chain] = 0;
+    rx_batch_index[chain] = 0;
 
     // handle response
     if (uart_err) {
         ESP_LOGI(TAG, "UART Error in serial RX");
         return NULL;
     } else if (uart_timeout) {
-        if (asic_timeout_counter >= BM1397_TIMEOUT_THRESHOLD) {
+        if (asic_timeout_counter[chain] >= BM1397_TIMEOUT_THRESHOLD) {
             ESP_LOGE(TAG, "ASIC not sending data");
-            asic_timeout_counter = 0;
+            asic_timeout_counter[chain] = 0;
         }
-        asic_timeout_counter++;
+        asic_timeout_counter[chain]++;
         return NULL;
     }
 
-    if (received != 9 || asic_response_buffer[0] != 0xAA || asic_response_buffer[1] != 0x55)
-    {
-        ESP_LOGI(TAG, "Serial RX invalid %i", received);
-        ESP_LOG_BUFFER_HEX(TAG, asic_response_buffer, received);
-        SERIAL_clear_buffer();
-        return NULL;
-    }
+    asic_timeout_counter[chain] = 0;
+    rx_batch_count[chain] = received;
+    rx_batch_index[chain] = 1;
 
-    return (asic_result *)asic_response_buffer;
+    return (asic_result *)rx_batch_buffer[chain];
 }
 
-task_result *BM1397_proccess_work(void *pvParameters)
+task_result *BM1397_proccess_work(void *pvParameters, uint8_t chain)
 {
 
-    asic_result *asic_result = BM1397_receive_work();
+    asic_result *asic_result = BM1397_receive_work(chain);
 
     if (asic_result == NULL)
     {
@@ -452,16 +453,27 @@ task_result *BM1397_proccess_work(void *pvParameters)
     uint8_t rx_midstate_index = asic_result->job_id & 0x03;
 
     GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
-    if (GLOBAL_STATE->valid_jobs[rx_job_id] == 0)
+
+    result[chain].job_id = rx_job_id;
+    result[chain].nonce = asic_result->nonce;
+    // chip addresses are assigned from the expected chip count in _send_init
+    // core ids are not decoded for the BM1397
+    result[chain].asic_nr = ASIC_get_asic_nr(asic_result->nonce, GLOBAL_STATE->asic_count);
+    result[chain].core_id = 0;
+    result[chain].small_core_id = 0;
+
+    if (GLOBAL_STATE->chains[chain].valid_jobs[rx_job_id] == 0)
     {
         ESP_LOGI(TAG, "Invalid job nonce found, id=%d", rx_job_id);
-        return NULL;
+        // still handed to the result task so the error is attributed to the chip
+        result[chain].rolled_version = 0;
+        return &result[chain];
     }
 
-    uint32_t rolled_version = GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[rx_job_id]->version;
+    uint32_t rolled_version = GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[rx_job_id]->version;
     for (int i = 0; i < rx_midstate_index; i++)
     {
-        rolled_version = increment_bitmask(rolled_version, GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[rx_job_id]->version_mask);
+        rolled_version = increment_bitmask(rolled_version, GLOBAL_STATE->chains[chain].ASIC_TASK_MODULE.active_jobs[rx_job_id]->version_mask);
     }
 
     // ASIC may return the same nonce multiple times
@@ -478,18 +490,16 @@ task_result *BM1397_proccess_work(void *pvParameters)
         return NULL;
     }
 
-    if (asic_result->nonce == prev_nonce)
+    if (asic_result->nonce == prev_nonce[chain])
     {
         return NULL;
     }
     else
     {
-        prev_nonce = asic_result->nonce;
+        prev_nonce[chain] = asic_result->nonce;
     }
 
-    result.job_id = rx_job_id;
-    result.nonce = asic_result->nonce;
-    result.rolled_version = rolled_version;
+    result[chain].rolled_version = rolled_version;
 
-    return &result;
+    return &result[chain];
 }
@@ -24,4 +24,115 @@ int _largest_power_of_two(int num)
     }
 
     return 1 << power;
+}
+
+/// @brief number of versions a chip rolls through for a version mask
+uint32_t ASIC_get_version_rolls(uint32_t version_mask)
+{
+    // the chips roll the 16 version bits starting at bit 13
+    return 1u << __builtin_popcount(version_mask & 0x1FFFE000);
+}
+
+/// @brief value of the ticket mask register for a ticket difficulty
+/// @param difficulty rounded down to a power of 2 so the mask has no holes
+uint32_t ASIC_get_ticket_mask(int difficulty)
+{
+    uint32_t mask = _largest_power_of_two(difficulty) - 1;
+    uint32_t value = 0;
+
+    // the chips read every byte of the mask bit reversed
+    for (int i = 0; i < 4; i++) {
+        value |= (uint32_t) _reverse_bits((mask >> (8 * i)) & 0xFF) << (8 * i);
+    }
+
+    return value;
+}
+
+/// @brief chip that found a nonce, from the chip address bits of the nonce
+/// @param nonce nonce as received in the result frame
+/// @param chip_count number of chips on the chain, addresses are spread evenly over 0..255
+/// @return index of the chip on the chain
+uint8_t ASIC_get_asic_nr(uint32_t nonce, uint16_t chip_count)
+{
+    // the chip address sits just below the 7 core id bits
+    return ASIC_get_asic_nr_from_address((__builtin_bswap32(nonce) >> 17) & 0xFF, chip_count);
+}
+
+/// @brief chip on the chain with a given address
+/// @param chip_count number of chips on the chain, addresses are spread evenly over 0..255
+uint8_t ASIC_get_asic_nr_from_address(uint8_t chip_address, uint16_t chip_count)
+{
+    if (chip_count <= 1) {
+        return 0;
+    }
+
+    return chip_address / (256 / chip_count);
+}
+
+/// @brief time for the chain to exhaust the search space of a single job
+/// @param frequency ASIC frequency in MHz
+/// @param chip_count number of chips sharing the job
+/// @param small_core_count small cores per chip, each doing one hash per clock
+/// @param nonce_range register 0x10 value, ASIC_NONCE_RANGE_FULL is the whole 2^32 nonce space
+/// @param version_rolls number of versions rolled in-chip per job
+/// @return job interval in ms, clamped to ASIC_JOB_INTERVAL_MIN_MS..ASIC_JOB_INTERVAL_MAX_MS
+double ASIC_calculate_job_interval_ms(float frequency, uint16_t chip_count, uint64_t small_core_count, uint32_t nonce_range, uint32_t version_rolls)
+{
+    if (frequency <= 0 || chip_count == 0 || small_core_count == 0) {
+        return ASIC_JOB_INTERVAL_MAX_MS;
+    }
+
+    double search_space = 4294967296.0 * ((double) nonce_range / ASIC_NONCE_RANGE_FULL) * version_rolls;
+    double hashes_per_ms = (double) frequency * 1000.0 * small_core_count * chip_count;
+    double interval_ms = ASIC_JOB_INTERVAL_MARGIN * search_space / hashes_per_ms;
+
+    if (interval_ms < ASIC_JOB_INTERVAL_MIN_MS) {
+        return ASIC_JOB_INTERVAL_MIN_MS;
+    }
+    if (interval_ms > ASIC_JOB_INTERVAL_MAX_MS) {
+        return ASIC_JOB_INTERVAL_MAX_MS;
+    }
+    return interval_ms;
+}
+
+static double _nonces_per_s(double hashrate_ghs, uint32_t difficulty)
+{
+    return hashrate_ghs * 1000000000.0 / (difficulty * 4294967296.0);
+}
+
+/// @brief ticket difficulty for the chips, always a power of 2
+/// @param hashrate_ghs expected hashrate of the chain
+/// @param pool_difficulty the ticket difficulty never exceeds it, 0 if unknown
+/// @param current_difficulty kept while it still gives a usable nonce rate, so the mask does not flap
+uint32_t ASIC_calculate_ticket_difficulty(double hashrate_ghs, uint32_t pool_difficulty, uint32_t current_difficulty)
+{
+    uint32_t max_difficulty = 0x80000000;
+    if (pool_difficulty > 0 && pool_difficulty < max_difficulty) {
+        max_difficulty = _largest_power_of_two(pool_difficulty);
+    }
+
+    if (hashrate_ghs <= 0) {
+        return current_difficulty > max_difficulty ? max_difficulty : current_difficulty;
+    }
+
+    // nonces needed in the window for the wanted confidence, Poisson so the relative error is 1/sqrt(n)
+    double min_rate = ASIC_TICKET_CONFIDENCE_Z * ASIC_TICKET_CONFIDENCE_Z
+                      / (ASIC_TICKET_RELATIVE_ERROR * ASIC_TICKET_RELATIVE_ERROR) / ASIC_TICKET_WINDOW_S;
+
+    if (current_difficulty > 0 && current_difficulty <= max_difficulty &&
+        (current_difficulty & (current_difficulty - 1)) == 0) {
+        double rate = _nonces_per_s(hashrate_ghs, current_difficulty);
+        if (rate >= min_rate && rate <= ASIC_TICKET_MAX_NONCES_PER_S) {
+            return current_difficulty;
+        }
+    }
+
+    // highest power of 2 that still gives at least min_rate, the rate then stays below 2 * min_rate
+    double ideal = hashrate_ghs * 1000000000.0 / (min_rate * 4294967296.0);
+    uint32_t difficulty = 1;
+    while (difficulty < max_difficulty && difficulty * 2.0 <= ideal) {
+        difficulty *= 2;
+    }
+
+    return difficulty;
 }
\ No newline at end of file
@@ -0,0 +1,134 @@
+#include <math.h>
+#include <stddef.h>
+
+#include "freq_ramp.h"
+
+// regulator the ramps watch, registered by the board code
+static FreqRampCurrentFn current_sensor = NULL;
+
+void FREQ_RAMP_set_current_sensor(FreqRampCurrentFn read_current)
+{
+    current_sensor = read_current;
+}
+
+FreqRampCurrentFn FREQ_RAMP_current_sensor(void)
+{
+    return current_sensor;
+}
+
+/// @brief ramp settings, without a current sensor every step is a fixed 6.25 MHz held for 100 ms
+void FREQ_RAMP_default_config(FreqRampConfig * config, bool has_current_sensor)
+{
+    config->min_step = 6.25;
+    config->settle_ratio = 0.02;
+    config->settle_floor = 0.05;
+
+    if (has_current_sensor) {
+        config->max_step = 25;
+        config->sample_ms = 10;
+        config->min_dwell_ms = 20;
+        config->max_dwell_ms = 200;
+    } else {
+        config->max_step = config->min_step;
+        config->sample_ms = 100;
+        config->min_dwell_ms = 100;
+        config->max_dwell_ms = 100;
+    }
+}
+
+void FREQ_RAMP_init(FreqRamp * ramp, const FreqRampConfig * config, float from, float to)
+{
+    ramp->config = *config;
+    ramp->frequency = from;
+    ramp->target = to;
+    ramp->step = config->min_step;
+    ramp->last_current = 0;
+    ramp->have_current = false;
+    ramp->failed_readings = 0;
+    ramp->steps = 0;
+    ramp->elapsed_ms = 0;
+}
+
+/// @brief moves to the next frequency of the ramp, steps land on multiples of min_step
+/// @param frequency set to the frequency to program
+/// @return false once the target has been reached
+bool FREQ_RAMP_next(FreqRamp * ramp, float * frequency)
+{
+    if (ramp->frequency == ramp->target) {
+        return false;
+    }
+
+    float grid = ramp->config.min_step;
+    float next;
+    if (ramp->target > ramp->frequency) {
+        next = fminf(floorf(ramp->frequency / grid + 1e-4f) * grid + ramp->step, ramp->target);
+    } else {
+        next = fmaxf(ceilf(ramp->frequency / grid - 1e-4f) * grid - ramp->step, ramp->target);
+    }
+
+    ramp->frequency = next;
+    ramp->have_current = false;
+    *frequency = next;
+
+    return true;
+}
+
+static bool _finish_step(FreqRamp * ramp, uint32_t dwell_ms)
+{
+    ramp->steps++;
+    ramp->elapsed_ms += dwell_ms;
+    return true;
+}
+
+/// @brief feeds a current reading taken after the last step
+/// @param current regulator output current in A, negative without a sensor, NAN if the sensor could not be read
+/// @param dwell_ms time since the last step was programmed
+/// @return true once the next step can be taken
+bool FREQ_RAMP_settled(FreqRamp * ramp, float current, uint32_t dwell_ms)
+{
+    const FreqRampConfig * config = &ramp->config;
+    bool has_reading = current >= 0;
+
+    // a failed read never settles a step, and a sensor that keeps failing is given up on
+    if (isnan(current)) {
+        if (++ramp->failed_readings == FREQ_RAMP_MAX_FAILED_READINGS) {
+            FREQ_RAMP_default_config(&ramp->config, false);
+            ramp->step = ramp->config.min_step;
+            ramp->have_current = false;
+        }
+    } else if (has_reading && ramp->failed_readings < FREQ_RAMP_MAX_FAILED_READINGS) {
+        ramp->failed_readings = 0;
+    }
+
+    if (dwell_ms < config->min_dwell_ms) {
+        if (has_reading) {
+            ramp->last_current = current;
+            ramp->have_current = true;
+        }
+        return false;
+    }
+
+    bool settled = false;
+    if (has_reading) {
+        settled = ramp->have_current && fabsf(current - ramp->last_current) <= fmaxf(config->settle_ratio * fabsf(ramp->last_current), config->settle_floor);
+        ramp->last_current = current;
+        ramp->have_current = true;
+    }
+
+    if (settled) {
+        // the regulator kept up right away, take bigger steps
+        if (dwell_ms <= config->min_dwell_ms + config->sample_ms) {
+            ramp->step = fminf(ramp->step * 2, config->max_step);
+        }
+        return _finish_step(ramp, dwell_ms);
+    }
+
+    if (dwell_ms >= config->max_dwell_ms) {
+        if (has_reading) {
+            ramp->step = fmaxf(ramp->step / 2, config->min_step);
+        }
+        return _finish_step(ramp, dwell_ms);
+    }
+
+    return false;
+}
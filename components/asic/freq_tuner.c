@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freq_tuner.h"
+
+void FREQ_TUNER_default_config(FreqTunerConfig * config, float frequency, float max_frequency)
+{
+    config->min_frequency = frequency * 0.75;
+    config->max_frequency = max_frequency > frequency ? max_frequency : frequency;
+    config->step = FREQ_TUNER_STEP_MHZ;
+    config->max_error_rate = 0.01;
+    config->min_yield_ratio = 0.8;
+    config->min_results = 300;
+    config->sample_timeout_s = 120;
+}
+
+static float _clamp_frequency(const FreqTunerConfig * config, float frequency)
+{
+    if (frequency < config->min_frequency) {
+        return config->min_frequency;
+    }
+    if (frequency > config->max_frequency) {
+        return config->max_frequency;
+    }
+    return frequency;
+}
+
+/// @brief start tuning a chain
+/// @param frequency frequency every chip is running at, tuning starts from here
+/// @param saved_frequencies results of an earlier run, chips with a saved frequency > 0 start settled on it. May be NULL
+bool FREQ_TUNER_init(FreqTuner * tuner, const FreqTunerConfig * config, uint16_t chip_count, float frequency,
+                    const float * saved_frequencies)
+{
+    // keep the allocation when tuning the same chain again, readers may still hold it
+    if (tuner->chips != NULL && tuner->chip_count == chip_count) {
+        memset(tuner->chips, 0, chip_count * sizeof(FreqTunerChip));
+    } else {
+        FREQ_TUNER_free(tuner);
+        tuner->chips = calloc(chip_count, sizeof(FreqTunerChip));
+        if (tuner->chips == NULL) {
+            return false;
+        }
+    }
+
+    tuner->config = *config;
+    tuner->chip_count = chip_count;
+
+    for (int i = 0; i < chip_count; i++) {
+        FreqTunerChip * chip = &tuner->chips[i];
+        if (saved_frequencies != NULL && saved_frequencies[i] > 0) {
+            chip->frequency = _clamp_frequency(config, saved_frequencies[i]);
+            chip->state = FREQ_TUNER_SETTLED;
+        } else {
+            chip->frequency = _clamp_frequency(config, frequency);
+            chip->state = FREQ_TUNER_RAISING;
+        }
+    }
+
+    return true;
+}
+
+void FREQ_TUNER_free(FreqTuner * tuner)
+{
+    free(tuner->chips);
+    tuner->chips = NULL;
+    tuner->chip_count = 0;
+}
+
+static void _start_sample(FreqTunerChip * chip, uint32_t nonces, uint32_t hw_errors, double work, int64_t now_us)
+{
+    chip->sampling = true;
+    chip->sample_nonces = nonces;
+    chip->sample_hw_errors = hw_errors;
+    chip->sample_work = work;
+    chip->sample_start_us = now_us;
+}
+
+/// @brief judge the current frequency of a chip and pick the next one
+/// @param nonces valid nonces returned by the chip so far
+/// @param hw_errors hardware errors returned by the chip so far
+/// @param work ticket difficulty of the valid nonces so far, so the yield holds across ticket mask changes
+/// @return true if the frequency of the chip changed and has to be applied
+bool FREQ_TUNER_update_chip(FreqTuner * tuner, uint8_t asic_nr, uint32_t nonces, uint32_t hw_errors, double work, int64_t now_us)
+{
+    if (asic_nr >= tuner->chip_count) {
+        return false;
+    }
+
+    const FreqTunerConfig * config = &tuner->config;
+    FreqTunerChip * chip = &tuner->chips[asic_nr];
+
+    if (!chip->sampling) {
+        _start_sample(chip, nonces, hw_errors, work, now_us);
+        return false;
+    }
+
+    uint32_t sample_nonces = nonces - chip->sample_nonces;
+    uint32_t sample_hw_errors = hw_errors - chip->sample_hw_errors;
+    uint32_t results = sample_nonces + sample_hw_errors;
+    double elapsed_s = (now_us - chip->sample_start_us) / 1000000.0;
+
+    if (elapsed_s <= 0 || (results < config->min_results && elapsed_s < config->sample_timeout_s)) {
+        return false;
+    }
+
+    double error_rate = results > 0 ? (double) sample_hw_errors / results : 1.0;
+    double yield = (work - chip->sample_work) / elapsed_s / chip->frequency;
+    // a chip that stops returning nonces is as unstable as one returning bad ones
+    bool stable = results > 0 && error_rate <= config->max_error_rate && yield >= chip->best_yield * config->min_yield_ratio;
+
+    float previous = chip->frequency;
+
+    if (stable) {
+        if (yield > chip->best_yield) {
+            chip->best_yield = yield;
+        }
+
+        if (chip->state == FREQ_TUNER_RAISING) {
+            float next = chip->frequency + config->step;
+            if (next > config->max_frequency || (chip->ceiling > 0 && next >= chip->ceiling)) {
+                chip->state = FREQ_TUNER_SETTLED;
+            } else {
+                chip->frequency = next;
+            }
+        } else if (chip->state == FREQ_TUNER_BACKING_OFF) {
+            chip->state = FREQ_TUNER_SETTLED;
+        }
+    } else {
+        chip->ceiling = chip->frequency;
+        if (chip->frequency - config->step >= config->min_frequency) {
+            chip->frequency -= config->step;
+            chip->state = FREQ_TUNER_BACKING_OFF;
+        } else {
+            // nothing lower to fall back to
+            chip->frequency = config->min_frequency;
+            chip->state = FREQ_TUNER_SETTLED;
+        }
+    }
+
+    _start_sample(chip, nonces, hw_errors, work, now_us);
+
+    return chip->frequency != previous;
+}
+
+bool FREQ_TUNER_is_settled(const FreqTuner * tuner)
+{
+    for (int i = 0; i < tuner->chip_count; i++) {
+        if (tuner->chips[i].state != FREQ_TUNER_SETTLED) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/// @brief comma separated chip frequencies, as persisted
+/// @return length of the string, -1 if it does not fit in buf
+int FREQ_TUNER_format(const FreqTuner * tuner, char * buf, size_t len)
+{
+    size_t used = 0;
+
+    if (len == 0) {
+        return -1;
+    }
+    buf[0] = '\0';
+
+    for (int i = 0; i < tuner->chip_count; i++) {
+        int written = snprintf(buf + used, len - used, "%s%.2f", i > 0 ? "," : "", tuner->chips[i].frequency);
+        if (written < 0 || (size_t) written >= len - used) {
+            return -1;
+        }
+        used += written;
+    }
+
+    return used;
+}
+
+/// @brief parse a string written by FREQ_TUNER_format
+/// @return number of frequencies read
+int FREQ_TUNER_parse(const char * str, float * frequencies, int max_frequencies)
+{
+    int count = 0;
+
+    while (str != NULL && *str != '\0' && count < max_frequencies) {
+        char * end;
+        float frequency = strtof(str, &end);
+        if (end == str) {
+            break;
+        }
+        frequencies[count++] = frequency;
+        str = *end == ',' ? end + 1 : end;
+    }
+
+    return count;
+}
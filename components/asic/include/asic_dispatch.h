@@ -0,0 +1,12 @@
+#ifndef ASIC_DISPATCH_H_
+#define ASIC_DISPATCH_H_
+
+#include <stdint.h>
+
+// job ids are 7 bits, each model steps through them by its own stride
+#define ASIC_DISPATCH_JOB_IDS 128
+
+int ASIC_dispatch_chain_needing_work(const int * queue_counts, int chain_count, int low_water_mark);
+uint8_t ASIC_dispatch_next_job_id(uint8_t * last_job_id, uint8_t step);
+
+#endif /* ASIC_DISPATCH_H_ */
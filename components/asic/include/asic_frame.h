@@ -0,0 +1,27 @@
+#ifndef ASIC_FRAME_H_
+#define ASIC_FRAME_H_
+
+#include <stdint.h>
+
+#define ASIC_FRAME_TYPE_JOB 0x20
+
+// largest payload sent to a chip, the BM1397 job with 4 midstates
+#define ASIC_FRAME_MAX_DATA_LEN 146
+// preamble (2) + header (1) + length (1) + crc16 (2)
+#define ASIC_FRAME_MAX_LEN (ASIC_FRAME_MAX_DATA_LEN + 6)
+
+/// @brief builds a complete 55 AA framed packet into buf
+/// @param buf destination, at least ASIC_FRAME_MAX_LEN bytes (or data_len + 6)
+/// @param header packet header, job packets get a crc16, commands a crc5
+/// @param data payload
+/// @param data_len payload length
+/// @return total number of bytes written to buf
+uint8_t ASIC_frame_build(uint8_t *buf, uint8_t header, const uint8_t *data, uint8_t data_len);
+
+/// @brief rewrites the job id of a job frame built by ASIC_frame_build and refreshes its crc16
+/// @param buf job frame
+/// @param len total frame length
+/// @param job_id new job id
+void ASIC_frame_set_job_id(uint8_t *buf, uint8_t len, uint8_t job_id);
+
+#endif /* ASIC_FRAME_H_ */
@@ -0,0 +1,50 @@
+#ifndef ASIC_HASHRATE_H_
+#define ASIC_HASHRATE_H_
+
+#include <stdint.h>
+
+// 1 minute, 10 minutes, 1 hour and 24 hours, each kept as a ring of buckets
+#define ASIC_HASHRATE_WINDOWS 4
+#define ASIC_HASHRATE_BUCKETS 60
+
+// two sided 95% confidence bounds
+#define ASIC_HASHRATE_CONFIDENCE_Z 1.96
+
+typedef struct
+{
+    int64_t bucket_us;
+    // absolute number of the newest bucket, bucket n covers [n, n + 1) * bucket_us since the start
+    int64_t head;
+    // ticket difficulty found and nonces per bucket, and their sums over the ring
+    uint64_t work[ASIC_HASHRATE_BUCKETS];
+    uint32_t nonces[ASIC_HASHRATE_BUCKETS];
+    uint64_t work_sum;
+    uint32_t nonce_sum;
+} AsicHashrateWindow;
+
+typedef struct
+{
+    int64_t start_us;
+    // scales the upper bound of a window without nonces
+    uint32_t last_difficulty;
+    AsicHashrateWindow windows[ASIC_HASHRATE_WINDOWS];
+} AsicHashrate;
+
+typedef struct
+{
+    uint32_t window_s;
+    // time the estimate covers, shorter than the window until the window filled up
+    double seconds;
+    uint32_t nonces;
+    // GH/s
+    double hashrate;
+    double lower;
+    double upper;
+} AsicHashrateEstimate;
+
+void ASIC_hashrate_init(AsicHashrate * hashrate, int64_t now_us);
+void ASIC_hashrate_record(AsicHashrate * hashrate, uint32_t ticket_difficulty, int64_t now_us);
+void ASIC_hashrate_estimate(AsicHashrate * hashrate, int window, int64_t now_us, AsicHashrateEstimate * estimate);
+void ASIC_hashrate_poisson_bounds(uint32_t count, double * lower, double * upper);
+
+#endif /* ASIC_HASHRATE_H_ */
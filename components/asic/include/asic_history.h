@@ -0,0 +1,57 @@
+#ifndef ASIC_HISTORY_H_
+#define ASIC_HISTORY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// 10 s for 1 hour, 1 minute for 24 hours and 15 minutes for 30 days
+#define ASIC_HISTORY_TIERS 3
+#define ASIC_HISTORY_SAMPLES (360 + 1440 + 2880)
+
+// the finest resolution, samples are recorded at about this interval
+#define ASIC_HISTORY_RECORD_S 10
+
+typedef struct
+{
+    // averages over the sample
+    float hashrate;
+    float power;
+    float chip_temp;
+    float vr_temp;
+    uint16_t fan_rpm;
+    // totals over the sample
+    uint16_t shares_accepted;
+    uint16_t shares_rejected;
+    uint16_t hw_errors;
+    // records the sample was made of, 0 for a period nothing was recorded in
+    uint16_t records;
+} AsicHistorySample;
+
+typedef struct
+{
+    uint32_t period_s;
+    uint16_t capacity;
+    AsicHistorySample * samples;
+    // period number of the newest closed sample, period n covers [n, n + 1) * period_s of uptime
+    int64_t head;
+    // the period still being recorded
+    int64_t open_period;
+    double sums[5];
+    uint32_t shares_accepted;
+    uint32_t shares_rejected;
+    uint32_t hw_errors;
+    uint16_t records;
+} AsicHistoryTier;
+
+typedef struct
+{
+    AsicHistoryTier tiers[ASIC_HISTORY_TIERS];
+} AsicHistory;
+
+void ASIC_history_init(AsicHistory * history, AsicHistorySample samples[ASIC_HISTORY_SAMPLES]);
+void ASIC_history_record(AsicHistory * history, const AsicHistorySample * record, uint32_t uptime_s);
+int ASIC_history_tier_for(uint32_t resolution_s, uint32_t range_s);
+uint32_t ASIC_history_range(const AsicHistory * history, int tier, uint32_t range_s, int64_t * first_period);
+bool ASIC_history_get(const AsicHistory * history, int tier, int64_t period, AsicHistorySample * sample);
+
+#endif /* ASIC_HISTORY_H_ */
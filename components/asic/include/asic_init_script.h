@@ -0,0 +1,74 @@
+#ifndef ASIC_INIT_SCRIPT_H_
+#define ASIC_INIT_SCRIPT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "asic_registers.h"
+
+// command frames of every BM13xx family
+#define ASIC_INIT_HEADER_SET_ADDRESS 0x40
+#define ASIC_INIT_HEADER_WRITE 0x41
+#define ASIC_INIT_HEADER_WRITE_ALL 0x51
+#define ASIC_INIT_HEADER_INACTIVE 0x53
+
+// a register write is the longest frame of a script
+#define ASIC_INIT_FRAME_MAX_LEN 11
+// frames are sent in batches of up to this many bytes, one UART write each
+#define ASIC_INIT_BATCH_SIZE 256
+
+// after the expected chips answered the address read, the count waits this long for more
+#define ASIC_INIT_COUNT_TAIL_MS 100
+
+typedef enum
+{
+    // write a register of all chips with one broadcast
+    ASIC_INIT_OP_WRITE_ALL,
+    // write a register of the chip of the running for each block, the first chip outside of one
+    ASIC_INIT_OP_WRITE_CHIP,
+    ASIC_INIT_OP_CHAIN_INACTIVE,
+    // give every chip its address, the address space is split evenly
+    ASIC_INIT_OP_SET_ADDRESSES,
+    // send what was batched so far and wait, value is in milliseconds
+    ASIC_INIT_OP_DELAY,
+    // the steps up to ASIC_INIT_OP_END_FOR_EACH are run once per chip
+    ASIC_INIT_OP_FOR_EACH_CHIP,
+    ASIC_INIT_OP_END_FOR_EACH,
+} AsicInitOp;
+
+typedef struct
+{
+    uint8_t op;
+    uint8_t reg;
+    uint32_t value;
+} AsicInitStep;
+
+#define ASIC_INIT_WRITE_ALL(reg, value) {ASIC_INIT_OP_WRITE_ALL, (reg), (value)}
+#define ASIC_INIT_WRITE_CHIP(reg, value) {ASIC_INIT_OP_WRITE_CHIP, (reg), (value)}
+#define ASIC_INIT_CHAIN_INACTIVE {ASIC_INIT_OP_CHAIN_INACTIVE, 0, 0}
+#define ASIC_INIT_SET_ADDRESSES {ASIC_INIT_OP_SET_ADDRESSES, 0, 0}
+#define ASIC_INIT_DELAY_MS(ms) {ASIC_INIT_OP_DELAY, 0, (ms)}
+#define ASIC_INIT_FOR_EACH_CHIP {ASIC_INIT_OP_FOR_EACH_CHIP, 0, 0}
+#define ASIC_INIT_END_FOR_EACH {ASIC_INIT_OP_END_FOR_EACH, 0, 0}
+
+typedef struct
+{
+    const AsicInitStep * steps;
+    int step_count;
+    uint16_t chip_count;
+    uint8_t address_interval;
+    // writes the chips already hold are left out, NULL to send all of them
+    AsicRegisterShadow * shadow;
+
+    int step;
+    int loop_start;
+    uint16_t chip;
+    uint16_t next_address;
+} AsicInitScript;
+
+void ASIC_init_script_start(AsicInitScript * script, const AsicInitStep * steps, int step_count, uint16_t chip_count,
+                            AsicRegisterShadow * shadow);
+bool ASIC_init_script_next(AsicInitScript * script, uint8_t * buf, size_t size, size_t * len, uint32_t * delay_ms);
+
+#endif /* ASIC_INIT_SCRIPT_H_ */
@@ -0,0 +1,101 @@
+#ifndef ASIC_LINK_H_
+#define ASIC_LINK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// the BM1397 clocks its UART from the 25 MHz crystal, baud = 25 MHz / (8 * (divider + 1)) with the BT8D divider of MISC_CONTROL
+#define ASIC_LINK_CLOCK_HZ 25000000
+#define ASIC_LINK_BT8D_BAUD(divider) (ASIC_LINK_CLOCK_HZ / (8 * ((divider) + 1)))
+// the BT8D divider after a reset, 115740 baud, the rate every model answers at after a reset
+#define ASIC_LINK_DEFAULT_DIVIDER 26
+#define ASIC_LINK_RESET_BAUD ASIC_LINK_BT8D_BAUD(ASIC_LINK_DEFAULT_DIVIDER)
+#define ASIC_LINK_MISC_CONTROL 0x18
+// the BM1366 and later run their UART from the fast UART configuration instead, BT8D is not the live divider there
+#define ASIC_LINK_FAST_UART 0x28
+
+#define ASIC_LINK_BT8D_RATE_COUNT 7
+#define ASIC_LINK_FAST_UART_RATE_COUNT 2
+
+// register reads sent at every rate tried, each chip has to answer all of them with a good crc
+#define ASIC_LINK_PROBE_READS 4
+#define ASIC_LINK_PROBE_TIMEOUT_MS 100
+// a rate change is sent this many times in a row, the link may already be failing
+#define ASIC_LINK_RATE_WRITES 3
+
+// during operation the link drops to the next slower rate once this share of a window of frames failed
+#define ASIC_LINK_WINDOW_FRAMES 500
+#define ASIC_LINK_MAX_ERROR_RATE 0.01
+
+typedef struct
+{
+    // reply frames received, and those dropped for a bad crc
+    uint32_t frames;
+    uint32_t crc_errors;
+    // bytes skipped to find the next preamble, and how often that happened
+    uint32_t dropped_bytes;
+    uint32_t resyncs;
+    uint32_t negotiations;
+    uint32_t fallbacks;
+    // frames and errors of the current window
+    uint32_t window_frames;
+    uint32_t window_errors;
+} AsicLinkStats;
+
+// a UART rate of a model and the register bits that move the chips to it
+typedef struct
+{
+    int baud;
+    uint8_t reg;
+    // the bits of mask are set to value, the others are kept, a mask of 0 is a rate only a reset returns to
+    uint32_t mask;
+    uint32_t value;
+    // what the other bits are taken to be while no write of the register was recorded
+    uint32_t default_value;
+} AsicLinkRate;
+
+typedef struct
+{
+    // rates of the model from the reset rate up
+    const AsicLinkRate * rates;
+    uint8_t rate_count;
+    uint8_t rate;
+    // fastest rate still allowed, lowered every time a rate fails
+    uint8_t fastest_rate;
+    // the reply crc and the MISC_CONTROL readback are only relied on once the chips passed them at the reset rate
+    bool crc_checked;
+    bool readback_checked;
+    // set when a window had too many errors, cleared by the fallback
+    bool degraded;
+    AsicLinkStats stats;
+} AsicLink;
+
+// what the negotiation needs from the driver and the UART, ctx is passed back to every call
+typedef struct
+{
+    void * ctx;
+    // broadcast register write and read, sent at the current rate
+    void (*write_register)(void * ctx, uint8_t reg, uint32_t value);
+    void (*read_register)(void * ctx, uint8_t reg);
+    // what was last written to a register of every chip, false if not known, may be NULL
+    bool (*written_register)(void * ctx, uint8_t reg, uint32_t * value);
+    void (*set_baud)(void * ctx, int baud);
+    int16_t (*read_frames)(void * ctx, uint8_t * buf, uint16_t frame_size, uint16_t max_frames, uint16_t timeout_ms);
+} AsicLinkIo;
+
+extern const AsicLinkRate ASIC_LINK_BT8D_RATES[ASIC_LINK_BT8D_RATE_COUNT];
+extern const AsicLinkRate ASIC_LINK_FAST_UART_RATES[ASIC_LINK_FAST_UART_RATE_COUNT];
+
+int ASIC_link_baud(const AsicLink * link);
+int ASIC_link_next_rate(const AsicLink * link);
+bool ASIC_link_response_crc_ok(const uint8_t * frame, uint8_t len);
+
+void ASIC_link_init(AsicLink * link);
+void ASIC_link_set_rates(AsicLink * link, const AsicLinkRate * rates, uint8_t rate_count);
+void ASIC_link_record(AsicLink * link, bool crc_ok);
+void ASIC_link_record_resync(AsicLink * link, uint32_t dropped_bytes);
+
+int ASIC_link_negotiate(AsicLink * link, const AsicLinkIo * io, uint16_t chip_count, uint8_t response_size);
+int ASIC_link_fall_back(AsicLink * link, const AsicLinkIo * io, uint16_t chip_count, uint8_t response_size);
+
+#endif /* ASIC_LINK_H_ */
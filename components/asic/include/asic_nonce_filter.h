@@ -0,0 +1,42 @@
+#ifndef ASIC_NONCE_FILTER_H_
+#define ASIC_NONCE_FILTER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// job ids the chips can report, 7 bits
+#define ASIC_NONCE_FILTER_JOBS 128
+
+// remembered results, a power of two, and slots looked at per lookup
+#define ASIC_NONCE_FILTER_SLOTS 256
+#define ASIC_NONCE_FILTER_PROBES 8
+
+typedef struct
+{
+    uint32_t nonce;
+    uint32_t version;
+    // value of checked when the result was stored, the oldest probed entry makes room for a new one
+    uint32_t seen;
+    // generation of the job id when the result was seen, entries of a reused job id are free again
+    uint16_t generation;
+    uint8_t job_id;
+    bool used;
+} AsicNonceFilterEntry;
+
+typedef struct
+{
+    // results looked up and those suppressed as duplicates
+    uint32_t checked;
+    uint32_t duplicates;
+    // live entries overwritten because every probed slot was taken, their duplicates would get through
+    uint32_t evictions;
+    // dispatch last seen behind every job id, a different one means the id was reused
+    uint32_t dispatches[ASIC_NONCE_FILTER_JOBS];
+    uint16_t generations[ASIC_NONCE_FILTER_JOBS];
+    AsicNonceFilterEntry entries[ASIC_NONCE_FILTER_SLOTS];
+} AsicNonceFilter;
+
+void ASIC_nonce_filter_init(AsicNonceFilter * filter);
+bool ASIC_nonce_filter_check(AsicNonceFilter * filter, uint8_t job_id, uint32_t dispatch_seq, uint32_t nonce, uint32_t version);
+
+#endif /* ASIC_NONCE_FILTER_H_ */
@@ -0,0 +1,44 @@
+#ifndef ASIC_PLL_H_
+#define ASIC_PLL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define ASIC_PLL_REFERENCE_MHZ 25.0
+
+// the ramps and the tuner step in multiples of this, their dividers are looked up instead of searched
+#define ASIC_PLL_GRID_MHZ 6.25f
+#define ASIC_PLL_GRID_SIZE 161
+
+typedef enum
+{
+    // exact frequency with the fewest post divider stages (BM1368, BM1370)
+    ASIC_PLL_SEARCH_EXACT,
+    // first divider set in range, within 10 MHz of the target (BM1366)
+    ASIC_PLL_SEARCH_FIRST_FIT,
+} AsicPllSearch;
+
+typedef struct
+{
+    // 0 if no divider set makes the frequency
+    uint8_t fb_div;
+    uint8_t ref_div;
+    uint8_t post_div1;
+    uint8_t post_div2;
+} AsicPllSetting;
+
+typedef struct
+{
+    AsicPllSearch search;
+    uint8_t fb_min;
+    uint8_t fb_max;
+    AsicPllSetting grid[ASIC_PLL_GRID_SIZE];
+} AsicPllTable;
+
+void ASIC_pll_table_init(AsicPllTable * table, AsicPllSearch search, uint8_t fb_min, uint8_t fb_max);
+bool ASIC_pll_search(const AsicPllTable * table, float frequency, float max_diff, AsicPllSetting * setting);
+bool ASIC_pll_get(const AsicPllTable * table, float frequency, float max_diff, AsicPllSetting * setting);
+float ASIC_pll_frequency(const AsicPllSetting * setting);
+uint32_t ASIC_pll_register_value(const AsicPllSetting * setting);
+
+#endif /* ASIC_PLL_H_ */
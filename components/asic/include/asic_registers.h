@@ -0,0 +1,52 @@
+#ifndef ASIC_REGISTERS_H_
+#define ASIC_REGISTERS_H_
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// registers are 32 bit wide and 4 byte aligned, 0x00..0xFC
+#define ASIC_REGISTER_COUNT 64
+
+// core register control is a window onto the core registers, every write is a command
+#define ASIC_REGISTER_CORE_CONTROL 0x3C
+
+// command header of a register write, GROUP_ALL sets 0x10
+#define ASIC_REGISTER_WRITE_HEADER 0x41
+#define ASIC_REGISTER_GROUP_ALL 0x10
+
+typedef struct
+{
+    uint32_t value[ASIC_REGISTER_COUNT];
+    // bit per register, set once the register has been written
+    uint64_t written;
+    // bit per register, set while the last readback differed from what was written
+    uint64_t drifted;
+    uint32_t drift_events;
+} AsicChipRegisters;
+
+// what the drivers last wrote to every chip on the chain
+// the ASIC, tuner, power management and result tasks all reach it, every function takes the lock
+typedef struct
+{
+    pthread_mutex_t lock;
+    uint16_t chip_count;
+    uint8_t address_interval;
+    uint32_t skipped_writes;
+    uint32_t readbacks;
+    AsicChipRegisters * chips;
+} AsicRegisterShadow;
+
+// a shadow has to start out with its lock initialized, the lock outlives every ASIC_registers_init
+#define ASIC_REGISTER_SHADOW_INITIALIZER {.lock = PTHREAD_MUTEX_INITIALIZER}
+
+void ASIC_registers_init(AsicRegisterShadow * shadow, uint16_t chip_count, uint8_t address_interval);
+bool ASIC_registers_write(AsicRegisterShadow * shadow, bool broadcast, uint8_t chip_address, uint8_t reg, uint32_t value);
+bool ASIC_registers_command(AsicRegisterShadow * shadow, uint8_t header, const uint8_t * data, uint8_t data_len);
+bool ASIC_registers_written(const AsicRegisterShadow * shadow, uint8_t reg, uint32_t * value);
+bool ASIC_registers_check(AsicRegisterShadow * shadow, uint8_t chip_address, uint8_t reg, uint32_t value);
+int ASIC_registers_verifiable(const AsicRegisterShadow * shadow, uint8_t * regs, int max_regs);
+void ASIC_registers_counters(const AsicRegisterShadow * shadow, uint32_t * skipped_writes, uint32_t * readbacks);
+bool ASIC_registers_chip_drift(const AsicRegisterShadow * shadow, uint16_t chip, uint32_t * drift_events, bool * drifted);
+
+#endif /* ASIC_REGISTERS_H_ */
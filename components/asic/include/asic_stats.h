@@ -0,0 +1,71 @@
+#ifndef ASIC_STATS_H_
+#define ASIC_STATS_H_
+
+#include <stdint.h>
+
+// widest core/small core ids decoded from result frames (7 and 4 bits)
+#define ASIC_STATS_CORES 128
+#define ASIC_STATS_SMALL_CORES 16
+
+// hardware error rates are kept over a rolling window of buckets
+#define ASIC_STATS_ERROR_BUCKETS 10
+#define ASIC_STATS_ERROR_BUCKET_S 60
+
+typedef enum
+{
+    // nonce meets the ticket mask
+    ASIC_RESULT_VALID,
+    // nonce below the ticket mask, the chip computed a wrong hash
+    ASIC_RESULT_HW_ERROR,
+    // result for a job id that is not active
+    ASIC_RESULT_INVALID_JOB,
+} AsicResultType;
+
+typedef struct
+{
+    uint32_t nonces;
+    // seconds since the stats were started, 0 if the core never returned a nonce
+    uint32_t last_seen_s;
+} AsicCoreStats;
+
+typedef struct
+{
+    uint32_t nonces;
+    // sum of the ticket difficulty of every nonce, in diff 1 units
+    double work;
+    int64_t last_seen_us;
+    uint32_t hw_errors;
+    uint32_t invalid_jobs;
+    // last reading of the on-chip hash counter and the hashrate between the last two readings, GH/s
+    uint32_t hash_counter;
+    int64_t hash_counter_us;
+    double counter_hashrate;
+    // valid nonces and hardware errors per bucket of the rolling window
+    uint32_t window_nonces[ASIC_STATS_ERROR_BUCKETS];
+    uint32_t window_hw_errors[ASIC_STATS_ERROR_BUCKETS];
+    // small core ids are shared by all cores of a chip
+    uint32_t small_core_nonces[ASIC_STATS_SMALL_CORES];
+    AsicCoreStats cores[ASIC_STATS_CORES];
+} AsicChipStats;
+
+typedef struct
+{
+    uint16_t chip_count;
+    int64_t start_us;
+    // results whose chip could not be attributed
+    uint32_t unattributed;
+    // absolute bucket number held by each slot of the rolling error window
+    uint32_t window_epoch[ASIC_STATS_ERROR_BUCKETS];
+    AsicChipStats * chips;
+} AsicStatsModule;
+
+void ASIC_stats_init(AsicStatsModule * stats, uint16_t chip_count, int64_t now_us);
+void ASIC_stats_record(AsicStatsModule * stats, uint8_t asic_nr, uint8_t core_id, uint8_t small_core_id, AsicResultType type,
+                       double ticket_diff, int64_t now_us);
+void ASIC_stats_record_hash_counter(AsicStatsModule * stats, uint8_t asic_nr, uint32_t value, double hashes_per_count,
+                                    int64_t now_us);
+double ASIC_stats_counter_hashrate(const AsicStatsModule * stats);
+double ASIC_stats_chip_hashrate(const AsicStatsModule * stats, uint8_t asic_nr, int64_t now_us);
+double ASIC_stats_chip_error_rate(const AsicStatsModule * stats, uint8_t asic_nr, int64_t now_us);
+
+#endif /* ASIC_STATS_H_ */
@@ -0,0 +1,41 @@
+#ifndef ASIC_WATCHDOG_H_
+#define ASIC_WATCHDOG_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// a chain is stalled once it has gone this many expected nonce intervals without a valid nonce
+#define ASIC_WATCHDOG_NONCE_INTERVALS 20
+
+// shortest stall ever reported, covers the slow start of the first jobs
+#define ASIC_WATCHDOG_MIN_TIMEOUT_US (30LL * 1000 * 1000)
+
+// the timeout doubles after every recovery that brings no nonce back, up to this many times
+#define ASIC_WATCHDOG_MAX_BACKOFF 4
+
+typedef struct
+{
+    // time of the last valid nonce, or of the last (re)start of the chain
+    // fed by the result task and read by the ASIC task, a plain 64 bit store can tear on the 32 bit cores
+    _Atomic int64_t last_nonce_us;
+    // recoveries since the last valid nonce
+    uint8_t backoff;
+    uint32_t recoveries;
+    uint32_t failed_recoveries;
+    // time of the last recovery, how long the chain had been silent and how long the re-init took
+    int64_t last_recovery_us;
+    int64_t last_stall_us;
+    int64_t last_recovery_duration_us;
+} AsicWatchdog;
+
+void ASIC_watchdog_init(AsicWatchdog * watchdog, int64_t now_us);
+void ASIC_watchdog_feed(AsicWatchdog * watchdog, int64_t now_us);
+void ASIC_watchdog_restart(AsicWatchdog * watchdog, int64_t now_us);
+int64_t ASIC_watchdog_last_nonce_us(const AsicWatchdog * watchdog);
+double ASIC_watchdog_expected_interval_us(double hashrate_ghs, uint32_t ticket_difficulty);
+int64_t ASIC_watchdog_timeout_us(const AsicWatchdog * watchdog, double hashrate_ghs, uint32_t ticket_difficulty);
+bool ASIC_watchdog_stalled(const AsicWatchdog * watchdog, double hashrate_ghs, uint32_t ticket_difficulty, int64_t now_us);
+void ASIC_watchdog_recovered(AsicWatchdog * watchdog, bool chips_found, int64_t started_us, int64_t now_us);
+
+#endif /* ASIC_WATCHDOG_H_ */
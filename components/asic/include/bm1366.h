@@ -1,6 +1,7 @@
 #ifndef BM1366_H_
 #define BM1366_H_
 
+#include "asic_registers.h"
 #include "common.h"
 #include "driver/gpio.h"
 #include "mining.h"
@@ -10,6 +11,9 @@
 #define CRC5_MASK 0x1F
 #define BM1366_ASIC_DIFFICULTY 256
 
+// register 0x10 hash counting value written at init, sets the nonce range searched per job
+#define BM1366_NONCE_RANGE 0x0000151C
+
 #define BM1366_SERIALTX_DEBUG false
 #define BM1366_SERIALRX_DEBUG false
 #define BM1366_DEBUG_WORK false //causes insane amount of debug output
@@ -35,15 +39,20 @@ typedef struct __attribute__((__packed__))
     uint8_t version[4];
 } BM1366_job;
 
-uint8_t BM1366_init(uint64_t frequency, uint16_t asic_count);
+uint8_t BM1366_init(uint8_t chain, uint64_t frequency, uint16_t asic_count);
 
 void BM1366_send_init(void);
-void BM1366_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
-void BM1366_set_job_difficulty_mask(int);
-void BM1366_set_version_mask(uint32_t version_mask);
-int BM1366_set_max_baud(void);
-int BM1366_set_default_baud(void);
-void BM1366_send_hash_frequency(float frequency);
-task_result * BM1366_proccess_work(void * GLOBAL_STATE);
+void BM1366_prepare_work(bm_job * next_bm_job);
+void BM1366_send_work(void * GLOBAL_STATE, uint8_t chain, bm_job * next_bm_job);
+void BM1366_set_job_difficulty_mask(uint8_t, int);
+void BM1366_set_version_mask(uint8_t chain, uint32_t version_mask);
+void BM1366_read_hash_counter(uint8_t chain);
+void BM1366_verify_registers(uint8_t chain);
+const AsicRegisterShadow * BM1366_get_register_shadow(uint8_t chain);
+int BM1366_set_max_baud(uint8_t chain);
+int BM1366_fall_back_baud(uint8_t chain);
+int BM1366_set_default_baud(uint8_t chain);
+void BM1366_send_hash_frequency(uint8_t chain, float frequency);
+task_result * BM1366_proccess_work(void * GLOBAL_STATE, uint8_t chain);
 
 #endif /* BM1366_H_ */
@@ -1,6 +1,7 @@
 #ifndef BM1368_H_
 #define BM1368_H_
 
+#include "asic_registers.h"
 #include "common.h"
 #include "driver/gpio.h"
 #include "mining.h"
@@ -10,6 +11,9 @@
 #define CRC5_MASK 0x1F
 #define BM1368_ASIC_DIFFICULTY 256
 
+// register 0x10 hash counting value written at init, sets the nonce range searched per job
+#define BM1368_NONCE_RANGE 0x000015A4
+
 #define BM1368_SERIALTX_DEBUG false
 #define BM1368_SERIALRX_DEBUG false
 #define BM1368_DEBUG_WORK false //causes insane amount of debug output
@@ -35,16 +39,21 @@ typedef struct __attribute__((__packed__))
     uint8_t version[4];
 } BM1368_job;
 
-uint8_t BM1368_init(uint64_t frequency, uint16_t asic_count);
+uint8_t BM1368_init(uint8_t chain, uint64_t frequency, uint16_t asic_count);
 
 uint8_t BM1368_send_init(void);
-void BM1368_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
-void BM1368_set_job_difficulty_mask(int);
-void BM1368_set_version_mask(uint32_t version_mask);
-int BM1368_set_max_baud(void);
-int BM1368_set_default_baud(void);
-bool BM1368_send_hash_frequency(float frequency);
-bool do_frequency_transition(float target_frequency);
-task_result * BM1368_proccess_work(void * GLOBAL_STATE);
+void BM1368_prepare_work(bm_job * next_bm_job);
+void BM1368_send_work(void * GLOBAL_STATE, uint8_t chain, bm_job * next_bm_job);
+void BM1368_set_job_difficulty_mask(uint8_t, int);
+void BM1368_set_version_mask(uint8_t chain, uint32_t version_mask);
+void BM1368_read_hash_counter(uint8_t chain);
+void BM1368_verify_registers(uint8_t chain);
+const AsicRegisterShadow * BM1368_get_register_shadow(uint8_t chain);
+int BM1368_set_max_baud(uint8_t chain);
+int BM1368_fall_back_baud(uint8_t chain);
+int BM1368_set_default_baud(uint8_t chain);
+bool BM1368_send_hash_frequency(uint8_t chain, float frequency);
+bool do_frequency_transition(uint8_t chain, float target_frequency);
+task_result * BM1368_proccess_work(void * GLOBAL_STATE, uint8_t chain);
 
 #endif /* BM1368_H_ */
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef BM1370_H_
 #define BM1370_H_
 
+#include "asic_registers.h"
 #include "common.h"
 #include "driver/gpio.h"
 #include "mining.h"
@@ -10,6 +11,9 @@
 #define CRC5_MASK 0x1F
 #define BM1370_ASIC_DIFFICULTY 256
 
+// register 0x10 hash counting value written at init, sets the nonce range searched per job
+#define BM1370_NONCE_RANGE 0x00001EB5
+
 #define BM1370_SERIALTX_DEBUG true
 #define BM1370_SERIALRX_DEBUG false
 #define BM1370_DEBUG_WORK false //causes insane amount of debug output
@@ -35,15 +39,21 @@ typedef struct __attribute__((__packed__))
     uint8_t version[4];
 } BM1370_job;
 
-uint8_t BM1370_init(uint64_t frequency, uint16_t asic_count);
+uint8_t BM1370_init(uint8_t chain, uint64_t frequency, uint16_t asic_count);
 
 uint8_t BM1370_send_init(void);
-void BM1370_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
-void BM1370_set_job_difficulty_mask(int);
-void BM1370_set_version_mask(uint32_t version_mask);
-int BM1370_set_max_baud(void);
-int BM1370_set_default_baud(void);
-void BM1370_send_hash_frequency(int, float, float);
-task_result * BM1370_proccess_work(void * GLOBAL_STATE);
+void BM1370_prepare_work(bm_job * next_bm_job);
+void BM1370_send_work(void * GLOBAL_STATE, uint8_t chain, bm_job * next_bm_job);
+void BM1370_set_job_difficulty_mask(uint8_t, int);
+void BM1370_set_version_mask(uint8_t chain, uint32_t version_mask);
+void BM1370_read_hash_counter(uint8_t chain);
+void BM1370_verify_registers(uint8_t chain);
+const AsicRegisterShadow * BM1370_get_register_shadow(uint8_t chain);
+int BM1370_set_max_baud(uint8_t chain);
+int BM1370_fall_back_baud(uint8_t chain);
+int BM1370_set_default_baud(uint8_t chain);
+void BM1370_send_hash_frequency(uint8_t, int, float, float);
+void BM1370_set_chip_frequency(uint8_t chain, uint8_t asic_nr, float frequency);
+task_result * BM1370_proccess_work(void * GLOBAL_STATE, uint8_t chain);
 
 #endif /* BM1370_H_ */
@@ -49,14 +49,16 @@ typedef struct __attribute__((__packed__))
     uint8_t midstate3[32];
 } job_packet;
 
-uint8_t BM1397_init(uint64_t frequency, uint16_t asic_count);
-
-void BM1397_send_work(void * GLOBAL_STATE, bm_job * next_bm_job);
-void BM1397_set_job_difficulty_mask(int);
-void BM1397_set_version_mask(uint32_t version_mask);
-int BM1397_set_max_baud(void);
-int BM1397_set_default_baud(void);
-void BM1397_send_hash_frequency(float frequency);
-task_result * BM1397_proccess_work(void * GLOBAL_STATE);
+uint8_t BM1397_init(uint8_t chain, uint64_t frequency, uint16_t asic_count);
+
+void BM1397_prepare_work(bm_job * next_bm_job);
+void BM1397_send_work(void * GLOBAL_STATE, uint8_t chain, bm_job * next_bm_job);
+void BM1397_set_job_difficulty_mask(uint8_t, int);
+void BM1397_set_version_mask(uint8_t chain, uint32_t version_mask);
+int BM1397_set_max_baud(uint8_t chain);
+int BM1397_fall_back_baud(uint8_t chain);
+int BM1397_set_default_baud(uint8_t chain);
+void BM1397_send_hash_frequency(uint8_t chain, float frequency);
+task_result * BM1397_proccess_work(void * GLOBAL_STATE, uint8_t chain);
 
 #endif /* BM1397_H_ */
\ No newline at end of file
@@ -8,9 +8,46 @@ typedef struct __attribute__((__packed__))
     uint8_t job_id;
     uint32_t nonce;
     uint32_t rolled_version;
+    uint8_t asic_nr;
+    uint8_t core_id;
+    uint8_t small_core_id;
+    // reply to a register read instead of a nonce, only asic_nr and the register fields are set
+    uint8_t is_register;
+    uint8_t register_address;
+    uint32_t register_value;
 } task_result;
 
+// register 0x10 value that covers the whole 32 bit nonce range
+#define ASIC_NONCE_RANGE_FULL 0x000F0000
+
+// replace jobs a little before the chips run out of nonce space
+#define ASIC_JOB_INTERVAL_MARGIN 0.9
+#define ASIC_JOB_INTERVAL_MIN_MS 10.0
+#define ASIC_JOB_INTERVAL_MAX_MS 5000.0
+
+// hashes it takes on average to find a nonce of difficulty 1, what a unit of work stands for
+#define ASIC_DIFF1_HASHES 4294967296.0
+
+// free running counter of the hashes done by a chip, one count per diff 1 of work (2^32 hashes).
+// register and unit follow the reverse engineered BM1366/BM1368/BM1370 register map
+#define ASIC_HASH_COUNTER_REGISTER 0x8C
+#define ASIC_HASH_COUNTER_HASHES 4294967296.0
+
+// the ticket mask is picked so the nonce stream estimates the hashrate
+// within ASIC_TICKET_RELATIVE_ERROR at ASIC_TICKET_CONFIDENCE_Z over ASIC_TICKET_WINDOW_S
+#define ASIC_TICKET_CONFIDENCE_Z 1.96
+#define ASIC_TICKET_RELATIVE_ERROR 0.05
+#define ASIC_TICKET_WINDOW_S 600.0
+// nonce rate the UART and the result task are kept under when the pool difficulty allows it
+#define ASIC_TICKET_MAX_NONCES_PER_S 50.0
+
 unsigned char _reverse_bits(unsigned char num);
 int _largest_power_of_two(int num);
+uint32_t ASIC_get_version_rolls(uint32_t version_mask);
+uint32_t ASIC_get_ticket_mask(int difficulty);
+uint8_t ASIC_get_asic_nr(uint32_t nonce, uint16_t chip_count);
+uint8_t ASIC_get_asic_nr_from_address(uint8_t chip_address, uint16_t chip_count);
+uint32_t ASIC_calculate_ticket_difficulty(double hashrate_ghs, uint32_t pool_difficulty, uint32_t current_difficulty);
+double ASIC_calculate_job_interval_ms(float frequency, uint16_t chip_count, uint64_t small_core_count, uint32_t nonce_range, uint32_t version_rolls);
 
 #endif
\ No newline at end of file
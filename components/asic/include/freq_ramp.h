@@ -0,0 +1,49 @@
+#ifndef FREQ_RAMP_H_
+#define FREQ_RAMP_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// consecutive failed current readings after which a ramp goes on with the fixed steps used without a sensor
+#define FREQ_RAMP_MAX_FAILED_READINGS 3
+
+// output current of the core voltage regulator in A, NAN if it could not be read
+typedef float (*FreqRampCurrentFn)(void);
+
+typedef struct
+{
+    // steps are multiples of min_step, doubled while the current settles quickly and halved when it does not
+    float min_step;
+    float max_step;
+    // how often the current is read after a step
+    uint32_t sample_ms;
+    // time every step is held at least, and at most while waiting for the current to settle
+    uint32_t min_dwell_ms;
+    uint32_t max_dwell_ms;
+    // the current has settled once two readings are this close, relative and absolute in A
+    float settle_ratio;
+    float settle_floor;
+} FreqRampConfig;
+
+typedef struct
+{
+    FreqRampConfig config;
+    float frequency;
+    float target;
+    float step;
+    float last_current;
+    bool have_current;
+    uint8_t failed_readings;
+    uint16_t steps;
+    uint32_t elapsed_ms;
+} FreqRamp;
+
+void FREQ_RAMP_set_current_sensor(FreqRampCurrentFn read_current);
+FreqRampCurrentFn FREQ_RAMP_current_sensor(void);
+
+void FREQ_RAMP_default_config(FreqRampConfig * config, bool has_current_sensor);
+void FREQ_RAMP_init(FreqRamp * ramp, const FreqRampConfig * config, float from, float to);
+bool FREQ_RAMP_next(FreqRamp * ramp, float * frequency);
+bool FREQ_RAMP_settled(FreqRamp * ramp, float current, uint32_t dwell_ms);
+
+#endif /* FREQ_RAMP_H_ */
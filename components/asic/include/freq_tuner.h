@@ -0,0 +1,69 @@
+#ifndef FREQ_TUNER_H_
+#define FREQ_TUNER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// PLL step used by the frequency ramps of all drivers
+#define FREQ_TUNER_STEP_MHZ 6.25
+
+typedef enum
+{
+    // stable so far, probing the next step up
+    FREQ_TUNER_RAISING,
+    // the last step was unstable, waiting to confirm the lower frequency
+    FREQ_TUNER_BACKING_OFF,
+    // running at the best stable frequency found, still watched for errors
+    FREQ_TUNER_SETTLED,
+} FreqTunerState;
+
+typedef struct
+{
+    float min_frequency;
+    float max_frequency;
+    float step;
+    // share of hardware errors among the results above which a frequency is unstable
+    double max_error_rate;
+    // work per second per MHz below this share of the best seen on the chip marks a frequency unstable
+    double min_yield_ratio;
+    // results needed before a frequency is judged
+    uint32_t min_results;
+    // a frequency that returns fewer results than min_results in this time is judged anyway
+    uint32_t sample_timeout_s;
+} FreqTunerConfig;
+
+typedef struct
+{
+    FreqTunerState state;
+    float frequency;
+    // lowest frequency found unstable, 0 if none yet
+    float ceiling;
+    // best yield at a stable frequency, diff 1 work per second per MHz
+    double best_yield;
+    // false until the stats counters for the first sample have been taken
+    bool sampling;
+    // stats counters at the start of the current sample
+    uint32_t sample_nonces;
+    uint32_t sample_hw_errors;
+    double sample_work;
+    int64_t sample_start_us;
+} FreqTunerChip;
+
+typedef struct
+{
+    FreqTunerConfig config;
+    uint16_t chip_count;
+    FreqTunerChip * chips;
+} FreqTuner;
+
+void FREQ_TUNER_default_config(FreqTunerConfig * config, float frequency, float max_frequency);
+bool FREQ_TUNER_init(FreqTuner * tuner, const FreqTunerConfig * config, uint16_t chip_count, float frequency,
+                    const float * saved_frequencies);
+void FREQ_TUNER_free(FreqTuner * tuner);
+bool FREQ_TUNER_update_chip(FreqTuner * tuner, uint8_t asic_nr, uint32_t nonces, uint32_t hw_errors, double work, int64_t now_us);
+bool FREQ_TUNER_is_settled(const FreqTuner * tuner);
+int FREQ_TUNER_format(const FreqTuner * tuner, char * buf, size_t len);
+int FREQ_TUNER_parse(const char * str, float * frequencies, int max_frequencies);
+
+#endif /* FREQ_TUNER_H_ */
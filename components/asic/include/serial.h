@@ -1,14 +1,43 @@
 #ifndef SERIAL_H_
 #define SERIAL_H_
 
+#include "asic_link.h"
+#include "asic_registers.h"
+
 #define SERIAL_BUF_SIZE 16
 #define CHUNK_SIZE 1024
 
-int SERIAL_send(uint8_t *, int, bool);
-esp_err_t SERIAL_init(void);
-void SERIAL_debug_rx(void);
-int16_t SERIAL_rx(uint8_t *, uint16_t, uint16_t);
-void SERIAL_clear_buffer(void);
-esp_err_t SERIAL_set_baud(int baud);
+// baud rate the chips talk at after a reset
+#define SERIAL_DEFAULT_BAUD 115200
+
+// maximum number of result frames handed back from a single RX wakeup
+#define SERIAL_RX_BATCH_FRAMES 32
+
+// chains of chips on the board, each on its own UART with its own reset line
+#ifdef CONFIG_ASIC_CHAIN_COUNT
+#define ASIC_MAX_CHAINS CONFIG_ASIC_CHAIN_COUNT
+#else
+#define ASIC_MAX_CHAINS 1
+#endif
+
+// what the UART rate negotiation needs to know of a model
+typedef struct
+{
+    const AsicLinkRate *rates;
+    uint8_t rate_count;
+    uint8_t response_size;
+} SerialLinkModel;
+
+int SERIAL_send(uint8_t chain, uint8_t *, int, bool);
+esp_err_t SERIAL_init(uint8_t chain);
+void SERIAL_debug_rx(uint8_t chain);
+int16_t SERIAL_rx(uint8_t chain, uint8_t *, uint16_t, uint16_t);
+int16_t SERIAL_rx_frames(uint8_t chain, uint8_t *, uint16_t, uint16_t, uint16_t);
+void SERIAL_clear_buffer(uint8_t chain);
+esp_err_t SERIAL_set_baud(uint8_t chain, int baud);
+int SERIAL_reset_gpio(uint8_t chain);
+AsicLink *SERIAL_link(uint8_t chain);
+int SERIAL_link_negotiate(uint8_t chain, const SerialLinkModel *model, AsicRegisterShadow *shadow, uint16_t chip_count);
+int SERIAL_link_fall_back(uint8_t chain, const SerialLinkModel *model, AsicRegisterShadow *shadow, uint16_t chip_count);
 
 #endif /* SERIAL_H_ */
\ No newline at end of file
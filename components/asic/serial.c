@@ -3,12 +3,14 @@
 #include <stdlib.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 
 #include "driver/uart.h"
 
 #include "esp_log.h"
 #include "soc/uart_struct.h"
 
+#include "asic_frame.h"
 #include "bm1397.h"
 #include "bm1368.h"
 #include "serial.h"
@@ -17,45 +19,81 @@
 #define ECHO_TEST_TXD (17)
 #define ECHO_TEST_RXD (18)
 #define BUF_SIZE (1024)
+#define UART_EVENT_QUEUE_SIZE 32
+
+// command headers of a register read and write sent to every chip, the same on every model
+#define LINK_WRITE_ALL (ASIC_REGISTER_WRITE_HEADER | ASIC_REGISTER_GROUP_ALL)
+#define LINK_READ_ALL 0x52
 
 static const char *TAG = "serial";
 
-esp_err_t SERIAL_init(void)
+typedef struct
+{
+    uart_port_t port;
+    int txd;
+    int rxd;
+    int reset;
+    QueueHandle_t uart_event_queue;
+    // bytes drained from the driver ring buffer that do not yet form a complete frame
+    uint8_t rx_pending[BUF_SIZE];
+    uint16_t rx_pending_len;
+    AsicLink link;
+} SerialChain;
+
+// UART0 is the console, so every chain gets one of the other ports
+static SerialChain chains[ASIC_MAX_CHAINS] = {
+    {.port = UART_NUM_1, .txd = ECHO_TEST_TXD, .rxd = ECHO_TEST_RXD, .reset = CONFIG_GPIO_ASIC_RESET},
+#if ASIC_MAX_CHAINS > 1
+    {.port = UART_NUM_2, .txd = CONFIG_GPIO_ASIC_CHAIN1_TXD, .rxd = CONFIG_GPIO_ASIC_CHAIN1_RXD, .reset = CONFIG_GPIO_ASIC_CHAIN1_RESET},
+#endif
+};
+
+/// @brief GPIO that holds the chips of a chain in reset while low
+int SERIAL_reset_gpio(uint8_t chain)
 {
-    ESP_LOGI(TAG, "Initializing serial");
+    return chains[chain].reset;
+}
+
+esp_err_t SERIAL_init(uint8_t chain)
+{
+    SerialChain *serial = &chains[chain];
+
+    ESP_LOGI(TAG, "Initializing serial for chain %u", chain);
+    ASIC_link_init(&serial->link);
     // Configure UART1 parameters
     uart_config_t uart_config = {
-        .baud_rate = 115200,
+        .baud_rate = SERIAL_DEFAULT_BAUD,
         .data_bits = UART_DATA_8_BITS,
         .parity = UART_PARITY_DISABLE,
         .stop_bits = UART_STOP_BITS_1,
         .flow_ctrl = UART_HW_FLOWCTRL_DISABLE,
         .rx_flow_ctrl_thresh = 122,
     };
-    // Configure UART1 parameters
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_param_config(UART_NUM_1, &uart_config));
-    // Set UART1 pins(TX: IO17, RX: I018)
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_pin(UART_NUM_1, ECHO_TEST_TXD, ECHO_TEST_RXD, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    // Configure the UART of the chain
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_param_config(serial->port, &uart_config));
+    // Set the pins of the chain (TX: IO17, RX: I018 on the first one)
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_pin(serial->port, serial->txd, serial->rxd, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
 
-    // Install UART driver (we don't need an event queue here)
+    // Install UART driver with an event queue so result RX can sleep until data arrives
+    // and then drain every pending frame in one go
     // tx buffer 0 so the tx time doesn't overlap with the job wait time
     //  by returning before the job is written
-    return uart_driver_install(UART_NUM_1, BUF_SIZE * 2, BUF_SIZE * 2, 0, NULL, 0);
+    return uart_driver_install(serial->port, BUF_SIZE * 2, BUF_SIZE * 2, UART_EVENT_QUEUE_SIZE, &serial->uart_event_queue, 0);
 }
 
-esp_err_t SERIAL_set_baud(int baud)
+esp_err_t SERIAL_set_baud(uint8_t chain, int baud)
 {
-    ESP_LOGI(TAG, "Changing UART baud to %i", baud);
+    ESP_LOGI(TAG, "Changing UART baud of chain %u to %i", chain, baud);
 
     // Make sure that we are done writing before setting a new baudrate.
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_wait_tx_done(UART_NUM_1, 1000 / portTICK_PERIOD_MS));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_wait_tx_done(chains[chain].port, 1000 / portTICK_PERIOD_MS));
 
-    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_baudrate(UART_NUM_1, baud));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(uart_set_baudrate(chains[chain].port, baud));
 
     return ESP_OK;
 }
 
-int SERIAL_send(uint8_t *data, int len, bool debug)
+int SERIAL_send(uint8_t chain, uint8_t *data, int len, bool debug)
 {
     if (debug)
     {
@@ -64,21 +102,21 @@ int SERIAL_send(uint8_t *data, int len, bool debug)
         printf("\n");
     }
 
-    return uart_write_bytes(UART_NUM_1, (const char *)data, len);
+    return uart_write_bytes(chains[chain].port, (const char *)data, len);
 }
 
 /// @brief waits for a serial response from the device
 /// @param buf buffer to read data into
 /// @param buf number of ms to wait before timing out
 /// @return number of bytes read, or -1 on error
-int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
+int16_t SERIAL_rx(uint8_t chain, uint8_t *buf, uint16_t size, uint16_t timeout_ms)
 {
-    int16_t bytes_read = uart_read_bytes(UART_NUM_1, buf, size, timeout_ms / portTICK_PERIOD_MS);
+    int16_t bytes_read = uart_read_bytes(chains[chain].port, buf, size, timeout_ms / portTICK_PERIOD_MS);
 
     #if BM1937_SERIALRX_DEBUG || BM1366_SERIALRX_DEBUG || BM1368_SERIALRX_DEBUG
     size_t buff_len = 0;
     if (bytes_read > 0) {
-        uart_get_buffered_data_len(UART_NUM_1, &buff_len);
+        uart_get_buffered_data_len(chains[chain].port, &buff_len);
         printf("rx: ");
         prettyHex((unsigned char*) buf, bytes_read);
         printf(" [%d]\n", buff_len);
@@ -88,12 +126,142 @@ int16_t SERIAL_rx(uint8_t *buf, uint16_t size, uint16_t timeout_ms)
     return bytes_read;
 }
 
-void SERIAL_debug_rx(void)
+/// @brief moves everything currently buffered by the UART driver into rx_pending
+static void _drain_driver_buffer(SerialChain *serial)
+{
+    size_t buffered = 0;
+    uart_get_buffered_data_len(serial->port, &buffered);
+
+    size_t space = sizeof(serial->rx_pending) - serial->rx_pending_len;
+    if (buffered > space) {
+        buffered = space;
+    }
+
+    if (buffered == 0) {
+        return;
+    }
+
+    int bytes_read = uart_read_bytes(serial->port, serial->rx_pending + serial->rx_pending_len, buffered, 0);
+
+    #if BM1937_SERIALRX_DEBUG || BM1366_SERIALRX_DEBUG || BM1368_SERIALRX_DEBUG
+    if (bytes_read > 0) {
+        printf("rx: ");
+        prettyHex(serial->rx_pending + serial->rx_pending_len, bytes_read);
+        printf(" [%d]\n", serial->rx_pending_len + bytes_read);
+    }
+    #endif
+
+    if (bytes_read > 0) {
+        serial->rx_pending_len += bytes_read;
+    }
+}
+
+/// @brief copies complete frames out of rx_pending, resyncing on the AA 55 preamble
+/// @return number of frames copied into buf
+static uint16_t _extract_frames(SerialChain *serial, uint8_t *buf, uint16_t frame_size, uint16_t max_frames)
+{
+    uint8_t *rx_pending = serial->rx_pending;
+    uint16_t rx_pending_len = serial->rx_pending_len;
+    uint16_t frames = 0;
+    uint16_t pos = 0;
+    // the bytes after a frame with a bad crc belong to the same error
+    bool crc_error = false;
+
+    while (frames < max_frames && rx_pending_len - pos >= frame_size) {
+        if (rx_pending[pos] != 0xAA || rx_pending[pos + 1] != 0x55) {
+            // out of sync, skip ahead to the next preamble
+            uint16_t start = pos;
+            pos++;
+            while (pos + 1 < rx_pending_len && !(rx_pending[pos] == 0xAA && rx_pending[pos + 1] == 0x55)) {
+                pos++;
+            }
+            ESP_LOGW(TAG, "Serial RX resync, dropped %i byte(s)", pos - start);
+            ESP_LOG_BUFFER_HEX(TAG, rx_pending + start, pos - start);
+            if (crc_error) {
+                serial->link.stats.dropped_bytes += pos - start;
+            } else {
+                ASIC_link_record_resync(&serial->link, pos - start);
+            }
+            crc_error = false;
+            continue;
+        }
+
+        // once the chips proved their reply crc at the reset rate a bad one means a corrupted frame,
+        // which may also be a preamble found inside noise, so only the preamble is skipped
+        bool crc_ok = !serial->link.crc_checked || ASIC_link_response_crc_ok(rx_pending + pos, frame_size);
+        ASIC_link_record(&serial->link, crc_ok);
+        if (!crc_ok) {
+            ESP_LOGW(TAG, "Serial RX crc error");
+            ESP_LOG_BUFFER_HEX(TAG, rx_pending + pos, frame_size);
+            pos += 2;
+            crc_error = true;
+            continue;
+        }
+        crc_error = false;
+
+        memcpy(buf + frames * frame_size, rx_pending + pos, frame_size);
+        pos += frame_size;
+        frames++;
+    }
+
+    // keep any partial frame for the next call
+    memmove(rx_pending, rx_pending + pos, rx_pending_len - pos);
+    serial->rx_pending_len = rx_pending_len - pos;
+
+    return frames;
+}
+
+/// @brief waits for response frames and returns every complete frame pending in the RX buffer
+/// @param buf buffer to copy frames into, at least frame_size * max_frames bytes
+/// @param frame_size size of a single response frame
+/// @param max_frames maximum number of frames to return
+/// @param timeout_ms number of ms to wait for the first frame before timing out
+/// @return number of frames read, 0 on timeout, or -1 if the RX buffer overflowed
+int16_t SERIAL_rx_frames(uint8_t chain, uint8_t *buf, uint16_t frame_size, uint16_t max_frames, uint16_t timeout_ms)
+{
+    SerialChain *serial = &chains[chain];
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = timeout_ms / portTICK_PERIOD_MS;
+    uart_event_t event;
+
+    while (true) {
+        _drain_driver_buffer(serial);
+
+        uint16_t frames = _extract_frames(serial, buf, frame_size, max_frames);
+        if (frames > 0) {
+            return frames;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout) {
+            return 0;
+        }
+
+        if (xQueueReceive(serial->uart_event_queue, &event, timeout - elapsed) != pdTRUE) {
+            return 0;
+        }
+
+        switch (event.type) {
+            case UART_DATA:
+                break;
+            case UART_FIFO_OVF:
+            case UART_BUFFER_FULL:
+                ESP_LOGE(TAG, "Serial RX overflow (%s), flushing", event.type == UART_FIFO_OVF ? "fifo" : "ring buffer");
+                SERIAL_clear_buffer(chain);
+                return -1;
+            default:
+                ESP_LOGD(TAG, "Serial RX event %d", event.type);
+                break;
+        }
+    }
+}
+
+void SERIAL_debug_rx(uint8_t chain)
 {
     int ret;
     uint8_t buf[100];
 
-    ret = SERIAL_rx(buf, 100, 20);
+    ret = SERIAL_rx(chain, buf, 100, 20);
     if (ret < 0)
     {
         fprintf(stderr, "unable to read data\n");
@@ -103,7 +271,108 @@ void SERIAL_debug_rx(void)
     memset(buf, 0, 100);
 }
 
-void SERIAL_clear_buffer(void)
+/// @brief rate and error counters of the link to the chips of a chain
+AsicLink *SERIAL_link(uint8_t chain)
+{
+    return &chains[chain].link;
+}
+
+typedef struct
+{
+    uint8_t chain;
+    AsicRegisterShadow *shadow;
+} SerialLinkCtx;
+
+static void _link_write_register(void *ctx, uint8_t reg, uint32_t value)
+{
+    SerialLinkCtx *link_ctx = ctx;
+    uint8_t data[6] = {0x00, reg, value >> 24, value >> 16, value >> 8, value};
+    uint8_t buf[ASIC_FRAME_MAX_LEN];
+
+    // the shadow follows, but the write goes out even if it already holds the value, a rate change may have to be repeated
+    if (link_ctx->shadow != NULL) {
+        ASIC_registers_write(link_ctx->shadow, true, 0x00, reg, value);
+    }
+    SERIAL_send(link_ctx->chain, buf, ASIC_frame_build(buf, LINK_WRITE_ALL, data, 6), false);
+}
+
+static void _link_read_register(void *ctx, uint8_t reg)
+{
+    SerialLinkCtx *link_ctx = ctx;
+    uint8_t data[2] = {0x00, reg};
+    uint8_t buf[ASIC_FRAME_MAX_LEN];
+
+    SERIAL_send(link_ctx->chain, buf, ASIC_frame_build(buf, LINK_READ_ALL, data, 2), false);
+}
+
+static bool _link_written_register(void *ctx, uint8_t reg, uint32_t *value)
+{
+    SerialLinkCtx *link_ctx = ctx;
+
+    return link_ctx->shadow != NULL && ASIC_registers_written(link_ctx->shadow, reg, value);
+}
+
+static void _link_set_baud(void *ctx, int baud)
+{
+    SERIAL_set_baud(((SerialLinkCtx *) ctx)->chain, baud);
+}
+
+static int16_t _link_read_frames(void *ctx, uint8_t *buf, uint16_t frame_size, uint16_t max_frames, uint16_t timeout_ms)
+{
+    return SERIAL_rx_frames(((SerialLinkCtx *) ctx)->chain, buf, frame_size, max_frames, timeout_ms);
+}
+
+static void _link_io(SerialLinkCtx *ctx, AsicLinkIo *io)
 {
-    uart_flush(UART_NUM_1);
+    io->ctx = ctx;
+    io->write_register = _link_write_register;
+    io->read_register = _link_read_register;
+    io->written_register = _link_written_register;
+    io->set_baud = _link_set_baud;
+    io->read_frames = _link_read_frames;
+}
+
+/// @brief steps the UART of a freshly initialized chain up to the fastest rate of the model its chips answer cleanly at
+/// @param shadow register shadow of the driver, NULL if it keeps none
+/// @return baud rate the chips were left at
+int SERIAL_link_negotiate(uint8_t chain, const SerialLinkModel *model, AsicRegisterShadow *shadow, uint16_t chip_count)
+{
+    SerialLinkCtx ctx = {.chain = chain, .shadow = shadow};
+    AsicLinkIo io;
+    _link_io(&ctx, &io);
+
+    AsicLink *link = SERIAL_link(chain);
+    ASIC_link_set_rates(link, model->rates, model->rate_count);
+
+    int baud = ASIC_link_negotiate(link, &io, chip_count, model->response_size);
+    if (baud < 0) {
+        // the watchdog resets the chain once it stalls, the renegotiation stays below the failed rate
+        ESP_LOGE(TAG, "Chain %u chips lost while negotiating the UART rate", chain);
+        return ASIC_link_baud(link);
+    }
+
+    ESP_LOGI(TAG, "Chain %u UART negotiated to %d baud%s", chain, baud, link->crc_checked ? "" : ", reply crc not checked");
+    return baud;
+}
+
+/// @brief drops a chain whose link degraded to the next slower rate of the model
+/// @return new baud rate, -1 if the chips no longer answer or only a reset gets them slower
+int SERIAL_link_fall_back(uint8_t chain, const SerialLinkModel *model, AsicRegisterShadow *shadow, uint16_t chip_count)
+{
+    SerialLinkCtx ctx = {.chain = chain, .shadow = shadow};
+    AsicLinkIo io;
+    _link_io(&ctx, &io);
+
+    return ASIC_link_fall_back(SERIAL_link(chain), &io, chip_count, model->response_size);
+}
+
+void SERIAL_clear_buffer(uint8_t chain)
+{
+    SerialChain *serial = &chains[chain];
+
+    uart_flush_input(serial->port);
+    serial->rx_pending_len = 0;
+    if (serial->uart_event_queue != NULL) {
+        xQueueReset(serial->uart_event_queue);
+    }
 }
@@ -0,0 +1,34 @@
+#include "unity.h"
+
+#include "asic_dispatch.h"
+
+TEST_CASE("Dispatch feeds the chain with the shortest queue", "[asic]")
+{
+    int counts[3] = {4, 2, 9};
+    TEST_ASSERT_EQUAL_INT(1, ASIC_dispatch_chain_needing_work(counts, 3, 10));
+
+    // ties go to the first chain
+    counts[0] = 2;
+    TEST_ASSERT_EQUAL_INT(0, ASIC_dispatch_chain_needing_work(counts, 3, 10));
+
+    // full queues are skipped even when they are the shortest
+    counts[0] = 10;
+    counts[1] = 10;
+    TEST_ASSERT_EQUAL_INT(2, ASIC_dispatch_chain_needing_work(counts, 3, 10));
+    counts[2] = 12;
+    TEST_ASSERT_EQUAL_INT(-1, ASIC_dispatch_chain_needing_work(counts, 3, 10));
+}
+
+TEST_CASE("Dispatch job ids advance per chain and wrap at 7 bits", "[asic]")
+{
+    uint8_t chain_0 = 0;
+    uint8_t chain_1 = 0;
+
+    TEST_ASSERT_EQUAL_UINT8(24, ASIC_dispatch_next_job_id(&chain_0, 24));
+    TEST_ASSERT_EQUAL_UINT8(48, ASIC_dispatch_next_job_id(&chain_0, 24));
+    TEST_ASSERT_EQUAL_UINT8(24, ASIC_dispatch_next_job_id(&chain_1, 24));
+
+    chain_0 = 120;
+    TEST_ASSERT_EQUAL_UINT8(16, ASIC_dispatch_next_job_id(&chain_0, 24));
+    TEST_ASSERT_EQUAL_UINT8(24, chain_1);
+}
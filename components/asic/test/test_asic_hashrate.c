@@ -0,0 +1,84 @@
+#include "unity.h"
+
+#include "asic_hashrate.h"
+
+static AsicHashrate hashrate;
+
+TEST_CASE("Hashrate windows count work over their span", "[asic]")
+{
+    AsicHashrateEstimate estimate;
+    ASIC_hashrate_init(&hashrate, 1000);
+
+    // 100 nonces at diff 256 over the first 10 s
+    for (int i = 1; i <= 100; i++) {
+        ASIC_hashrate_record(&hashrate, 256, 1000 + i * 100000LL);
+    }
+
+    ASIC_hashrate_estimate(&hashrate, 0, 1000 + 10000000LL, &estimate);
+    TEST_ASSERT_EQUAL_UINT32(60, estimate.window_s);
+    TEST_ASSERT_EQUAL_UINT32(100, estimate.nonces);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 10, estimate.seconds);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 25600 * 4.294967296 / 10, estimate.hashrate);
+    TEST_ASSERT_TRUE(estimate.lower < estimate.hashrate && estimate.hashrate < estimate.upper);
+
+    // the 24 h window sees the same nonces over the same time
+    AsicHashrateEstimate day;
+    ASIC_hashrate_estimate(&hashrate, ASIC_HASHRATE_WINDOWS - 1, 1000 + 10000000LL, &day);
+    TEST_ASSERT_EQUAL_UINT32(86400, day.window_s);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, estimate.hashrate, day.hashrate);
+}
+
+TEST_CASE("Hashrate windows drop what fell out of them", "[asic]")
+{
+    AsicHashrateEstimate estimate;
+    ASIC_hashrate_init(&hashrate, 0);
+
+    // one nonce a second for 10 minutes, diff 1024 for the first 5, then diff 256
+    for (int i = 1; i <= 600; i++) {
+        ASIC_hashrate_record(&hashrate, i <= 300 ? 1024 : 256, i * 1000000LL);
+    }
+
+    // the last minute only holds diff 256 nonces, 59 full buckets and the current one
+    ASIC_hashrate_estimate(&hashrate, 0, 600000000LL, &estimate);
+    TEST_ASSERT_EQUAL_UINT32(60, estimate.nonces);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 59, estimate.seconds);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 60 * 256 * 4.294967296 / 59, estimate.hashrate);
+
+    // the 10 minute window has both, its oldest 10 s bucket just dropped out
+    ASIC_hashrate_estimate(&hashrate, 1, 600000000LL, &estimate);
+    TEST_ASSERT_EQUAL_UINT32(591, estimate.nonces);
+    TEST_ASSERT_DOUBLE_WITHIN(1e-9, 590, estimate.seconds);
+    TEST_ASSERT_DOUBLE_WITHIN(0.1, (291 * 1024 + 300 * 256) * 4.294967296 / 590, estimate.hashrate);
+
+    // after a long silence the short window is empty but still bounds the rate from above
+    ASIC_hashrate_estimate(&hashrate, 0, 3600000000LL, &estimate);
+    TEST_ASSERT_EQUAL_UINT32(0, estimate.nonces);
+    TEST_ASSERT_EQUAL_DOUBLE(0, estimate.hashrate);
+    TEST_ASSERT_TRUE(estimate.upper > 0);
+
+    // the hour window lost its first minute
+    ASIC_hashrate_estimate(&hashrate, 2, 3600000000LL, &estimate);
+    TEST_ASSERT_EQUAL_UINT32(541, estimate.nonces);
+}
+
+TEST_CASE("Poisson bounds follow the exact values", "[asic]")
+{
+    double lower, upper;
+
+    ASIC_hashrate_poisson_bounds(0, &lower, &upper);
+    TEST_ASSERT_EQUAL_DOUBLE(0, lower);
+    TEST_ASSERT_DOUBLE_WITHIN(0.001, 3.689, upper);
+
+    ASIC_hashrate_poisson_bounds(1, &lower, &upper);
+    TEST_ASSERT_DOUBLE_WITHIN(0.0001, 0.0253, lower);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 5.572, upper);
+
+    ASIC_hashrate_poisson_bounds(10, &lower, &upper);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 4.795, lower);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 18.390, upper);
+
+    // the bounds narrow with the count
+    ASIC_hashrate_poisson_bounds(10000, &lower, &upper);
+    TEST_ASSERT_DOUBLE_WITHIN(2, 9804, lower);
+    TEST_ASSERT_DOUBLE_WITHIN(2, 10197, upper);
+}
@@ -0,0 +1,94 @@
+#include "unity.h"
+
+#include "asic_history.h"
+
+static AsicHistory history;
+static AsicHistorySample samples[ASIC_HISTORY_SAMPLES];
+
+static void record(uint32_t uptime_s, float hashrate, uint16_t shares)
+{
+    AsicHistorySample sample = {
+        .hashrate = hashrate,
+        .power = 15,
+        .chip_temp = 60,
+        .vr_temp = 50,
+        .fan_rpm = 4000,
+        .shares_accepted = shares,
+    };
+    ASIC_history_record(&history, &sample, uptime_s);
+}
+
+TEST_CASE("History tiers average gauges and sum counters", "[asic]")
+{
+    AsicHistorySample sample;
+    int64_t first;
+    ASIC_history_init(&history, samples);
+
+    // every 10 s for 2 minutes, 400 GH/s in the first minute and 600 GH/s in the second
+    for (uint32_t t = 0; t < 120; t += 10) {
+        record(t, t < 60 ? 400 : 600, 2);
+    }
+
+    // the 10 s tier holds one record per sample, the last one still open
+    TEST_ASSERT_EQUAL_UINT32(12, ASIC_history_range(&history, 0, 3600, &first));
+    TEST_ASSERT_EQUAL_INT64(0, first);
+    TEST_ASSERT_TRUE(ASIC_history_get(&history, 0, 11, &sample));
+    TEST_ASSERT_EQUAL_FLOAT(600, sample.hashrate);
+    TEST_ASSERT_EQUAL_UINT16(1, sample.records);
+
+    // the minute tier has one closed sample and the open one
+    TEST_ASSERT_EQUAL_UINT32(2, ASIC_history_range(&history, 1, 86400, &first));
+    TEST_ASSERT_TRUE(ASIC_history_get(&history, 1, 0, &sample));
+    TEST_ASSERT_EQUAL_FLOAT(400, sample.hashrate);
+    TEST_ASSERT_EQUAL_UINT16(12, sample.shares_accepted);
+    TEST_ASSERT_EQUAL_UINT16(4000, sample.fan_rpm);
+    TEST_ASSERT_EQUAL_UINT16(6, sample.records);
+
+    // the 15 minute tier averages both minutes in its open sample
+    TEST_ASSERT_EQUAL_UINT32(1, ASIC_history_range(&history, 2, 86400, &first));
+    TEST_ASSERT_TRUE(ASIC_history_get(&history, 2, 0, &sample));
+    TEST_ASSERT_EQUAL_FLOAT(500, sample.hashrate);
+    TEST_ASSERT_EQUAL_UINT16(24, sample.shares_accepted);
+}
+
+TEST_CASE("History keeps gaps empty and forgets what the ring overwrote", "[asic]")
+{
+    AsicHistorySample sample;
+    int64_t first;
+    ASIC_history_init(&history, samples);
+
+    record(0, 100, 1);
+    // nothing recorded for 50 s
+    record(60, 200, 1);
+    record(70, 300, 1);
+
+    TEST_ASSERT_TRUE(ASIC_history_get(&history, 0, 0, &sample));
+    TEST_ASSERT_EQUAL_FLOAT(100, sample.hashrate);
+    TEST_ASSERT_TRUE(ASIC_history_get(&history, 0, 3, &sample));
+    TEST_ASSERT_EQUAL_UINT16(0, sample.records);
+    TEST_ASSERT_TRUE(ASIC_history_get(&history, 0, 6, &sample));
+    TEST_ASSERT_EQUAL_FLOAT(200, sample.hashrate);
+
+    // past the hour the 10 s tier only holds its last 360 closed periods and the open one
+    for (uint32_t t = 80; t <= 4000; t += 10) {
+        record(t, 400, 0);
+    }
+    TEST_ASSERT_EQUAL_UINT32(361, ASIC_history_range(&history, 0, 7200, &first));
+    TEST_ASSERT_EQUAL_INT64(400 - 360, first);
+    TEST_ASSERT_FALSE(ASIC_history_get(&history, 0, first - 1, &sample));
+    TEST_ASSERT_TRUE(ASIC_history_get(&history, 0, first, &sample));
+    TEST_ASSERT_EQUAL_FLOAT(400, sample.hashrate);
+
+    // a shorter range only takes the newest samples
+    TEST_ASSERT_EQUAL_UINT32(6, ASIC_history_range(&history, 0, 60, &first));
+    TEST_ASSERT_EQUAL_INT64(395, first);
+}
+
+TEST_CASE("History picks the finest tier covering a range", "[asic]")
+{
+    TEST_ASSERT_EQUAL_INT(0, ASIC_history_tier_for(0, 3600));
+    TEST_ASSERT_EQUAL_INT(1, ASIC_history_tier_for(0, 3601));
+    TEST_ASSERT_EQUAL_INT(1, ASIC_history_tier_for(60, 600));
+    TEST_ASSERT_EQUAL_INT(2, ASIC_history_tier_for(0, 30 * 86400));
+    TEST_ASSERT_EQUAL_INT(-1, ASIC_history_tier_for(0, 31 * 86400));
+}
@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+
+#include "asic_init_script.h"
+
+TEST_CASE("Init script frames match the captured init sequence", "[asic]")
+{
+    const AsicInitStep steps[] = {
+        ASIC_INIT_WRITE_ALL(0xA8, 0x00070000),
+        ASIC_INIT_CHAIN_INACTIVE,
+        ASIC_INIT_SET_ADDRESSES,
+        ASIC_INIT_WRITE_CHIP(0x2C, 0x007C0003),
+    };
+    const uint8_t expected[] = {
+        0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03,
+        0x55, 0xAA, 0x53, 0x05, 0x00, 0x00, 0x03,
+        0x55, 0xAA, 0x40, 0x05, 0x00, 0x00, 0x1C,
+        0x55, 0xAA, 0x41, 0x09, 0x00, 0x2C, 0x00, 0x7C, 0x00, 0x03, 0x03,
+    };
+
+    AsicInitScript script;
+    ASIC_init_script_start(&script, steps, 4, 1, NULL);
+
+    uint8_t buf[ASIC_INIT_BATCH_SIZE];
+    size_t len;
+    uint32_t delay_ms;
+    TEST_ASSERT_TRUE(ASIC_init_script_next(&script, buf, sizeof(buf), &len, &delay_ms));
+    TEST_ASSERT_EQUAL(sizeof(expected), len);
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buf, sizeof(expected));
+    TEST_ASSERT_EQUAL_UINT32(0, delay_ms);
+
+    TEST_ASSERT_FALSE(ASIC_init_script_next(&script, buf, sizeof(buf), &len, &delay_ms));
+}
+
+TEST_CASE("Init script runs a block once per chip and stops at delays", "[asic]")
+{
+    const AsicInitStep steps[] = {
+        ASIC_INIT_FOR_EACH_CHIP,
+            ASIC_INIT_WRITE_CHIP(0xA8, 0x000701F0),
+            ASIC_INIT_WRITE_CHIP(0x3C, 0x800082AA),
+            ASIC_INIT_DELAY_MS(500),
+        ASIC_INIT_END_FOR_EACH,
+    };
+
+    AsicInitScript script;
+    ASIC_init_script_start(&script, steps, 5, 2, NULL);
+
+    uint8_t buf[ASIC_INIT_BATCH_SIZE];
+    size_t len;
+    uint32_t delay_ms;
+    for (int chip = 0; chip < 2; chip++) {
+        TEST_ASSERT_TRUE(ASIC_init_script_next(&script, buf, sizeof(buf), &len, &delay_ms));
+        TEST_ASSERT_EQUAL(2 * 11, len);
+        TEST_ASSERT_EQUAL_UINT32(500, delay_ms);
+        // chips of a chain of two sit at 0x00 and 0x80
+        TEST_ASSERT_EQUAL_HEX8(chip * 0x80, buf[4]);
+        TEST_ASSERT_EQUAL_HEX8(0xA8, buf[5]);
+        TEST_ASSERT_EQUAL_HEX8(chip * 0x80, buf[11 + 4]);
+        TEST_ASSERT_EQUAL_HEX8(0x3C, buf[11 + 5]);
+    }
+
+    TEST_ASSERT_FALSE(ASIC_init_script_next(&script, buf, sizeof(buf), &len, &delay_ms));
+}
+
+TEST_CASE("Init script splits batches that do not fit the buffer", "[asic]")
+{
+    const AsicInitStep steps[] = {
+        ASIC_INIT_SET_ADDRESSES,
+        ASIC_INIT_WRITE_ALL(0x58, 0x02111111),
+    };
+
+    AsicInitScript script;
+    ASIC_init_script_start(&script, steps, 2, 4, NULL);
+
+    // room for two address frames at a time
+    uint8_t buf[ASIC_INIT_FRAME_MAX_LEN + 7];
+    size_t len;
+    uint32_t delay_ms;
+    size_t total = 0;
+    int batches = 0;
+    while (ASIC_init_script_next(&script, buf, sizeof(buf), &len, &delay_ms)) {
+        TEST_ASSERT_TRUE(len > 0);
+        total += len;
+        batches++;
+    }
+
+    TEST_ASSERT_EQUAL(4 * 7 + 11, total);
+    TEST_ASSERT_EQUAL(3, batches);
+}
+
+TEST_CASE("Init script leaves out writes the chips already hold", "[asic]")
+{
+    const AsicInitStep steps[] = {
+        ASIC_INIT_WRITE_ALL(0x18, 0xF000C100),
+        ASIC_INIT_FOR_EACH_CHIP,
+            ASIC_INIT_WRITE_CHIP(0x18, 0xF000C100),
+            ASIC_INIT_WRITE_CHIP(0xA8, 0x000701F0),
+        ASIC_INIT_END_FOR_EACH,
+    };
+
+    AsicRegisterShadow shadow = ASIC_REGISTER_SHADOW_INITIALIZER;
+    ASIC_registers_init(&shadow, 2, 128);
+
+    AsicInitScript script;
+    ASIC_init_script_start(&script, steps, 5, 2, &shadow);
+
+    uint8_t buf[ASIC_INIT_BATCH_SIZE];
+    size_t len;
+    uint32_t delay_ms;
+    TEST_ASSERT_TRUE(ASIC_init_script_next(&script, buf, sizeof(buf), &len, &delay_ms));
+    TEST_ASSERT_EQUAL(3 * 11, len);
+    TEST_ASSERT_EQUAL_UINT32(2, shadow.skipped_writes);
+
+    free(shadow.chips);
+}
@@ -0,0 +1,323 @@
+#include "unity.h"
+
+#include "asic_link.h"
+#include "crc.h"
+
+#include <string.h>
+
+#define FAKE_MAX_FRAMES 64
+
+// a chain whose replies get corrupted at rates faster than its limit
+typedef struct
+{
+    uint16_t chip_count;
+    uint8_t response_size;
+    // BM1366 style, the rate is set in the fast UART configuration and BT8D is not live
+    bool fast_uart;
+    uint32_t misc_control;
+    uint32_t fast_uart_config;
+    // MISC_CONTROL is known to the driver
+    bool recorded;
+    // fastest rate the wiring carries cleanly
+    int limit_baud;
+    // every nth write still gets through at a failing rate, 0 for none
+    int write_success_every;
+    int failed_writes;
+    bool bad_crc_layout;
+    int uart_baud;
+    uint8_t frames[FAKE_MAX_FRAMES][11];
+    int frame_count;
+    int frame_read;
+} FakeChain;
+
+static int fake_chip_baud(const FakeChain * chain)
+{
+    if (chain->fast_uart) {
+        return chain->fast_uart_config == 0x11300200 ? 1000000 : ASIC_LINK_RESET_BAUD;
+    }
+    return ASIC_LINK_BT8D_BAUD((chain->misc_control >> 8) & 0x1F);
+}
+
+static bool fake_clean(const FakeChain * chain)
+{
+    return chain->uart_baud == fake_chip_baud(chain) && fake_chip_baud(chain) <= chain->limit_baud;
+}
+
+static void fake_write_register(void * ctx, uint8_t reg, uint32_t value)
+{
+    FakeChain * chain = ctx;
+
+    if (chain->uart_baud != fake_chip_baud(chain)) {
+        return;
+    }
+    if (!fake_clean(chain) && (chain->write_success_every == 0 || ++chain->failed_writes % chain->write_success_every != 0)) {
+        return;
+    }
+    if (reg == ASIC_LINK_MISC_CONTROL) {
+        chain->misc_control = value;
+    } else if (reg == ASIC_LINK_FAST_UART) {
+        chain->fast_uart_config = value;
+    }
+}
+
+static bool fake_written_register(void * ctx, uint8_t reg, uint32_t * value)
+{
+    FakeChain * chain = ctx;
+
+    if (!chain->recorded || reg != ASIC_LINK_MISC_CONTROL) {
+        return false;
+    }
+    *value = chain->misc_control;
+    return true;
+}
+
+static void fake_read_register(void * ctx, uint8_t reg)
+{
+    FakeChain * chain = ctx;
+
+    if (chain->uart_baud != fake_chip_baud(chain)) {
+        return;
+    }
+
+    uint32_t value = reg == ASIC_LINK_MISC_CONTROL ? chain->misc_control : reg == ASIC_LINK_FAST_UART ? chain->fast_uart_config : 0;
+    for (int i = 0; i < chain->chip_count && chain->frame_count < FAKE_MAX_FRAMES; i++) {
+        uint8_t * frame = chain->frames[chain->frame_count++];
+        uint8_t len = chain->response_size;
+        memset(frame, 0, sizeof(chain->frames[0]));
+        frame[0] = 0xAA;
+        frame[1] = 0x55;
+        frame[2] = value >> 24;
+        frame[3] = value >> 16;
+        frame[4] = value >> 8;
+        frame[5] = value;
+        frame[6] = i * (256 / chain->chip_count);
+        frame[7] = reg;
+        frame[len - 1] = crc5_bits(frame + 2, (len - 2) * 8 - 5);
+        if (!fake_clean(chain) || chain->bad_crc_layout) {
+            frame[len - 1] ^= 0x01;
+        }
+    }
+}
+
+static void fake_set_baud(void * ctx, int baud)
+{
+    ((FakeChain *) ctx)->uart_baud = baud;
+}
+
+static int16_t fake_read_frames(void * ctx, uint8_t * buf, uint16_t frame_size, uint16_t max_frames, uint16_t timeout_ms)
+{
+    FakeChain * chain = ctx;
+    int16_t count = 0;
+
+    while (count < max_frames && chain->frame_read < chain->frame_count) {
+        memcpy(buf + count * frame_size, chain->frames[chain->frame_read++], frame_size);
+        count++;
+    }
+    if (chain->frame_read == chain->frame_count) {
+        chain->frame_read = chain->frame_count = 0;
+    }
+    return count;
+}
+
+/// @brief puts the fake chips in their state after a reset
+static void fake_reset(FakeChain * chain)
+{
+    chain->misc_control = chain->fast_uart ? 0xF000C100 : 0x00007A31;
+    chain->fast_uart_config = 0;
+    chain->uart_baud = ASIC_LINK_RESET_BAUD;
+}
+
+static void fake_init(FakeChain * chain, AsicLinkIo * io, AsicLink * link, uint16_t chip_count, int limit_baud, bool fast_uart)
+{
+    memset(chain, 0, sizeof(*chain));
+    chain->chip_count = chip_count;
+    chain->response_size = 11;
+    chain->fast_uart = fast_uart;
+    chain->limit_baud = limit_baud;
+    chain->write_success_every = 2;
+    fake_reset(chain);
+
+    io->ctx = chain;
+    io->write_register = fake_write_register;
+    io->read_register = fake_read_register;
+    io->written_register = fake_written_register;
+    io->set_baud = fake_set_baud;
+    io->read_frames = fake_read_frames;
+
+    ASIC_link_init(link);
+    if (fast_uart) {
+        ASIC_link_set_rates(link, ASIC_LINK_FAST_UART_RATES, ASIC_LINK_FAST_UART_RATE_COUNT);
+    } else {
+        ASIC_link_set_rates(link, ASIC_LINK_BT8D_RATES, ASIC_LINK_BT8D_RATE_COUNT);
+    }
+}
+
+TEST_CASE("Link rates of the models", "[asic]")
+{
+    TEST_ASSERT_EQUAL_INT(115740, ASIC_LINK_BT8D_RATES[0].baud);
+    TEST_ASSERT_EQUAL_INT(3125000, ASIC_LINK_BT8D_RATES[ASIC_LINK_BT8D_RATE_COUNT - 1].baud);
+    TEST_ASSERT_EQUAL_INT(115740, ASIC_LINK_FAST_UART_RATES[0].baud);
+    TEST_ASSERT_EQUAL_INT(1000000, ASIC_LINK_FAST_UART_RATES[1].baud);
+
+    AsicLink link;
+    ASIC_link_init(&link);
+    TEST_ASSERT_EQUAL_INT(115740, ASIC_link_baud(&link));
+    TEST_ASSERT_EQUAL_INT(-1, ASIC_link_next_rate(&link));
+
+    ASIC_link_set_rates(&link, ASIC_LINK_BT8D_RATES, ASIC_LINK_BT8D_RATE_COUNT);
+    TEST_ASSERT_EQUAL_INT(1, ASIC_link_next_rate(&link));
+    link.fastest_rate = 4;
+    link.rate = 4;
+    TEST_ASSERT_EQUAL_INT(-1, ASIC_link_next_rate(&link));
+
+    // the fastest allowed rate survives a renegotiation of the same model
+    ASIC_link_set_rates(&link, ASIC_LINK_BT8D_RATES, ASIC_LINK_BT8D_RATE_COUNT);
+    TEST_ASSERT_EQUAL_UINT8(4, link.fastest_rate);
+}
+
+TEST_CASE("Link reply crc covers the flag bits", "[asic]")
+{
+    uint8_t frame[11] = {0xAA, 0x55, 0x13, 0x70, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x80};
+    frame[10] |= crc5_bits(frame + 2, 8 * 9 - 5);
+    TEST_ASSERT_TRUE(ASIC_link_response_crc_ok(frame, 11));
+
+    frame[10] ^= 0x80;
+    TEST_ASSERT_FALSE(ASIC_link_response_crc_ok(frame, 11));
+}
+
+TEST_CASE("Link negotiation keeps the fastest clean rate", "[asic]")
+{
+    FakeChain chain;
+    AsicLinkIo io;
+    AsicLink link;
+
+    fake_init(&chain, &io, &link, 4, ASIC_LINK_BT8D_BAUD(2), false);
+
+    TEST_ASSERT_EQUAL_INT(ASIC_LINK_BT8D_BAUD(2), ASIC_link_negotiate(&link, &io, 4, 11));
+    TEST_ASSERT_TRUE(link.crc_checked);
+    TEST_ASSERT_TRUE(link.readback_checked);
+    TEST_ASSERT_EQUAL_UINT8(4, link.rate);
+    TEST_ASSERT_EQUAL_UINT8(4, link.fastest_rate);
+    // the chips were brought back from the failed rate
+    TEST_ASSERT_EQUAL_HEX32(0x00006231, chain.misc_control);
+    TEST_ASSERT_EQUAL_INT(ASIC_LINK_BT8D_BAUD(2), chain.uart_baud);
+
+    // a clean chain goes all the way
+    fake_init(&chain, &io, &link, 1, 3125000, false);
+    TEST_ASSERT_EQUAL_INT(3125000, ASIC_link_negotiate(&link, &io, 1, 11));
+}
+
+TEST_CASE("Link rate change keeps the other MISC_CONTROL bits", "[asic]")
+{
+    FakeChain chain;
+    AsicLinkIo io;
+    AsicLink link;
+
+    fake_init(&chain, &io, &link, 2, 3125000, false);
+    chain.misc_control = 0x80007A35;
+    chain.recorded = true;
+
+    TEST_ASSERT_EQUAL_INT(3125000, ASIC_link_negotiate(&link, &io, 2, 11));
+    TEST_ASSERT_EQUAL_HEX32(0x80006035, chain.misc_control);
+}
+
+TEST_CASE("Link negotiation sets the fast UART of the newer models", "[asic]")
+{
+    FakeChain chain;
+    AsicLinkIo io;
+    AsicLink link;
+
+    fake_init(&chain, &io, &link, 4, 1000000, true);
+
+    TEST_ASSERT_EQUAL_INT(1000000, ASIC_link_negotiate(&link, &io, 4, 11));
+    TEST_ASSERT_EQUAL_HEX32(0x11300200, chain.fast_uart_config);
+    // BT8D reads 1 there, it tells nothing about the rate
+    TEST_ASSERT_EQUAL_HEX32(0xF000C100, chain.misc_control);
+    TEST_ASSERT_FALSE(link.readback_checked);
+
+    // only a reset gets the chips off a failed fast rate, the next negotiation stays at the reset rate
+    fake_init(&chain, &io, &link, 4, 500000, true);
+    TEST_ASSERT_EQUAL_INT(-1, ASIC_link_negotiate(&link, &io, 4, 11));
+    TEST_ASSERT_EQUAL_UINT8(0, link.fastest_rate);
+    fake_reset(&chain);
+    TEST_ASSERT_EQUAL_INT(115740, ASIC_link_negotiate(&link, &io, 4, 11));
+    TEST_ASSERT_EQUAL_HEX32(0, chain.fast_uart_config);
+}
+
+TEST_CASE("Link negotiation reports chips lost at a failed rate", "[asic]")
+{
+    FakeChain chain;
+    AsicLinkIo io;
+    AsicLink link;
+
+    fake_init(&chain, &io, &link, 2, ASIC_LINK_BT8D_BAUD(6), false);
+    chain.write_success_every = 0;
+
+    TEST_ASSERT_EQUAL_INT(-1, ASIC_link_negotiate(&link, &io, 2, 11));
+    TEST_ASSERT_EQUAL_UINT8(2, link.fastest_rate);
+}
+
+TEST_CASE("Link negotiation stays at the reset rate without a usable probe", "[asic]")
+{
+    FakeChain chain;
+    AsicLinkIo io;
+    AsicLink link;
+
+    fake_init(&chain, &io, &link, 2, 3125000, false);
+    TEST_ASSERT_EQUAL_INT(115740, ASIC_link_negotiate(&link, &io, 0, 11));
+
+    // fewer chips answer than were counted
+    TEST_ASSERT_EQUAL_INT(115740, ASIC_link_negotiate(&link, &io, 3, 11));
+    TEST_ASSERT_EQUAL_HEX32(0x00007A31, chain.misc_control);
+
+    // replies with an unknown crc layout still negotiate on the readback alone
+    fake_init(&chain, &io, &link, 2, 3125000, false);
+    chain.bad_crc_layout = true;
+    TEST_ASSERT_EQUAL_INT(3125000, ASIC_link_negotiate(&link, &io, 2, 11));
+    TEST_ASSERT_FALSE(link.crc_checked);
+}
+
+TEST_CASE("Link falls back a rate when errors rise", "[asic]")
+{
+    FakeChain chain;
+    AsicLinkIo io;
+    AsicLink link;
+
+    fake_init(&chain, &io, &link, 2, 3125000, false);
+    TEST_ASSERT_EQUAL_INT(3125000, ASIC_link_negotiate(&link, &io, 2, 11));
+
+    // a window within the error budget
+    for (int i = 0; i < ASIC_LINK_WINDOW_FRAMES; i++) {
+        ASIC_link_record(&link, i % 200 != 0);
+    }
+    TEST_ASSERT_FALSE(link.degraded);
+
+    for (int i = 0; i < ASIC_LINK_WINDOW_FRAMES - 10; i++) {
+        ASIC_link_record(&link, i % 50 != 0);
+    }
+    ASIC_link_record_resync(&link, 7);
+    for (int i = 0; i < 9; i++) {
+        ASIC_link_record(&link, true);
+    }
+    TEST_ASSERT_TRUE(link.degraded);
+    TEST_ASSERT_EQUAL_UINT32(7, link.stats.dropped_bytes);
+    TEST_ASSERT_EQUAL_UINT32(2 * ASIC_LINK_WINDOW_FRAMES - 1, link.stats.frames);
+
+    // the wiring got worse, the next slower rate is clean
+    chain.limit_baud = 1562500;
+    TEST_ASSERT_EQUAL_INT(1562500, ASIC_link_fall_back(&link, &io, 2, 11));
+    TEST_ASSERT_FALSE(link.degraded);
+    TEST_ASSERT_EQUAL_UINT8(5, link.fastest_rate);
+    TEST_ASSERT_EQUAL_UINT32(1, link.stats.fallbacks);
+
+    // a renegotiation after a reset does not try the failed rate again
+    fake_reset(&chain);
+    chain.limit_baud = 3125000;
+    TEST_ASSERT_EQUAL_INT(1562500, ASIC_link_negotiate(&link, &io, 2, 11));
+
+    // below the fast UART there is only the reset rate, the chain needs a reset
+    fake_init(&chain, &io, &link, 2, 1000000, true);
+    TEST_ASSERT_EQUAL_INT(1000000, ASIC_link_negotiate(&link, &io, 2, 11));
+    TEST_ASSERT_EQUAL_INT(-1, ASIC_link_fall_back(&link, &io, 2, 11));
+    TEST_ASSERT_EQUAL_UINT8(0, link.fastest_rate);
+}
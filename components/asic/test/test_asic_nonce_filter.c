@@ -0,0 +1,48 @@
+#include "unity.h"
+
+#include "asic_nonce_filter.h"
+
+static AsicNonceFilter filter;
+
+TEST_CASE("Nonce filter suppresses repeated results", "[asic]")
+{
+    ASIC_nonce_filter_init(&filter);
+
+    TEST_ASSERT_TRUE(ASIC_nonce_filter_check(&filter, 5, 1, 0x12345678, 0x20000000));
+    TEST_ASSERT_FALSE(ASIC_nonce_filter_check(&filter, 5, 1, 0x12345678, 0x20000000));
+
+    // the same nonce under another version, job id or dispatch is a different share
+    TEST_ASSERT_TRUE(ASIC_nonce_filter_check(&filter, 5, 1, 0x12345678, 0x20002000));
+    TEST_ASSERT_TRUE(ASIC_nonce_filter_check(&filter, 6, 2, 0x12345678, 0x20000000));
+
+    TEST_ASSERT_EQUAL_UINT32(4, filter.checked);
+    TEST_ASSERT_EQUAL_UINT32(1, filter.duplicates);
+}
+
+TEST_CASE("Nonce filter forgets results of a reused job id", "[asic]")
+{
+    ASIC_nonce_filter_init(&filter);
+
+    TEST_ASSERT_TRUE(ASIC_nonce_filter_check(&filter, 9, 1, 0xCAFEBABE, 0x20000000));
+    // a later dispatch under the same id, whatever memory its job landed in
+    TEST_ASSERT_TRUE(ASIC_nonce_filter_check(&filter, 9, 2, 0xCAFEBABE, 0x20000000));
+    TEST_ASSERT_FALSE(ASIC_nonce_filter_check(&filter, 9, 2, 0xCAFEBABE, 0x20000000));
+    TEST_ASSERT_EQUAL_UINT32(1, filter.duplicates);
+}
+
+TEST_CASE("Nonce filter never drops a new result when full", "[asic]")
+{
+    ASIC_nonce_filter_init(&filter);
+
+    // many more results than slots, every one of them new
+    for (uint32_t i = 0; i < 4 * ASIC_NONCE_FILTER_SLOTS; i++) {
+        TEST_ASSERT_TRUE(ASIC_nonce_filter_check(&filter, i & 0x7F, 1, i * 0x9E3779B9, 0x20000000));
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, filter.duplicates);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, filter.evictions);
+
+    // the oldest results made room, the most recent ones are still caught
+    for (uint32_t i = 4 * ASIC_NONCE_FILTER_SLOTS - 16; i < 4 * ASIC_NONCE_FILTER_SLOTS; i++) {
+        TEST_ASSERT_FALSE(ASIC_nonce_filter_check(&filter, i & 0x7F, 1, i * 0x9E3779B9, 0x20000000));
+    }
+}
@@ -0,0 +1,45 @@
+#include "unity.h"
+
+#include "asic_pll.h"
+
+TEST_CASE("PLL register value encodes the dividers", "[asic]")
+{
+    // the 200 MHz default the drivers fall back to
+    AsicPllSetting setting = {.fb_div = 0xA0, .ref_div = 2, .post_div1 = 5, .post_div2 = 2};
+    TEST_ASSERT_EQUAL_HEX32(0x40A00241, ASIC_pll_register_value(&setting));
+    TEST_ASSERT_EQUAL_FLOAT(200, ASIC_pll_frequency(&setting));
+}
+
+TEST_CASE("PLL table matches the search for grid frequencies", "[asic]")
+{
+    static AsicPllTable table;
+    ASIC_pll_table_init(&table, ASIC_PLL_SEARCH_EXACT, 0xA0, 0xEF);
+
+    for (int i = 0; i < ASIC_PLL_GRID_SIZE; i++) {
+        AsicPllSetting from_table, searched;
+        bool found = ASIC_pll_search(&table, i * ASIC_PLL_GRID_MHZ, 0.001, &searched);
+        TEST_ASSERT_EQUAL(found, ASIC_pll_get(&table, i * ASIC_PLL_GRID_MHZ, 0.001, &from_table));
+        TEST_ASSERT_EQUAL_HEX32(ASIC_pll_register_value(&searched), ASIC_pll_register_value(&from_table));
+    }
+
+    AsicPllSetting setting;
+    TEST_ASSERT_TRUE(ASIC_pll_get(&table, 525, 0.001, &setting));
+    TEST_ASSERT_EQUAL_HEX32(0x40A80230, ASIC_pll_register_value(&setting));
+
+    // off the grid the dividers are searched
+    TEST_ASSERT_TRUE(ASIC_pll_get(&table, 490, 0.001, &setting));
+    TEST_ASSERT_EQUAL_HEX32(0x50C40240, ASIC_pll_register_value(&setting));
+
+    TEST_ASSERT_FALSE(ASIC_pll_get(&table, 10, 0.001, &setting));
+}
+
+TEST_CASE("PLL first fit search approximates the frequency", "[asic]")
+{
+    static AsicPllTable table;
+    ASIC_pll_table_init(&table, ASIC_PLL_SEARCH_FIRST_FIT, 144, 235);
+
+    AsicPllSetting setting;
+    TEST_ASSERT_TRUE(ASIC_pll_get(&table, 485, 10, &setting));
+    TEST_ASSERT_EQUAL_HEX32(0x50E90250, ASIC_pll_register_value(&setting));
+    TEST_ASSERT_FLOAT_WITHIN(0.5, 485, ASIC_pll_frequency(&setting));
+}
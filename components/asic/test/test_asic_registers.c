@@ -0,0 +1,128 @@
+#include <stdlib.h>
+
+#include "unity.h"
+
+#include "asic_registers.h"
+
+TEST_CASE("Register shadow skips writes the chips already hold", "[asic]")
+{
+    AsicRegisterShadow shadow = ASIC_REGISTER_SHADOW_INITIALIZER;
+    ASIC_registers_init(&shadow, 4, 64);
+
+    TEST_ASSERT_TRUE(ASIC_registers_write(&shadow, true, 0x00, 0x18, 0xF000C100));
+    TEST_ASSERT_FALSE(ASIC_registers_write(&shadow, true, 0x00, 0x18, 0xF000C100));
+
+    // the broadcast already reached every chip
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT_FALSE(ASIC_registers_write(&shadow, false, i * 64, 0x18, 0xF000C100));
+    }
+    TEST_ASSERT_EQUAL_UINT32(5, shadow.skipped_writes);
+
+    TEST_ASSERT_TRUE(ASIC_registers_write(&shadow, false, 64, 0x18, 0xFF0FC100));
+    // one chip differs, the broadcast has to go out
+    TEST_ASSERT_TRUE(ASIC_registers_write(&shadow, true, 0x00, 0x18, 0xF000C100));
+
+    free(shadow.chips);
+}
+
+TEST_CASE("Register shadow tells what every chip holds", "[asic]")
+{
+    AsicRegisterShadow shadow = ASIC_REGISTER_SHADOW_INITIALIZER;
+    uint32_t value = 0;
+    ASIC_registers_init(&shadow, 2, 128);
+
+    TEST_ASSERT_FALSE(ASIC_registers_written(&shadow, 0x18, &value));
+    TEST_ASSERT_TRUE(ASIC_registers_write(&shadow, false, 0x00, 0x18, 0xF000C100));
+    // the second chip was not written yet
+    TEST_ASSERT_FALSE(ASIC_registers_written(&shadow, 0x18, &value));
+
+    TEST_ASSERT_TRUE(ASIC_registers_write(&shadow, false, 128, 0x18, 0xF000C100));
+    TEST_ASSERT_TRUE(ASIC_registers_written(&shadow, 0x18, &value));
+    TEST_ASSERT_EQUAL_HEX32(0xF000C100, value);
+
+    TEST_ASSERT_TRUE(ASIC_registers_write(&shadow, false, 128, 0x18, 0xFF0FC100));
+    TEST_ASSERT_FALSE(ASIC_registers_written(&shadow, 0x18, &value));
+
+    free(shadow.chips);
+}
+
+TEST_CASE("Register shadow always sends core register control and unknown chips", "[asic]")
+{
+    AsicRegisterShadow shadow = ASIC_REGISTER_SHADOW_INITIALIZER;
+
+    // nothing is known before init
+    TEST_ASSERT_TRUE(ASIC_registers_write(&shadow, true, 0x00, 0x14, 0x000000FF));
+
+    ASIC_registers_init(&shadow, 2, 128);
+    TEST_ASSERT_TRUE(ASIC_registers_write(&shadow, true, 0x00, ASIC_REGISTER_CORE_CONTROL, 0x80008B00));
+    TEST_ASSERT_TRUE(ASIC_registers_write(&shadow, true, 0x00, ASIC_REGISTER_CORE_CONTROL, 0x80008B00));
+
+    // no chip sits at 0x40 on a chain of two
+    TEST_ASSERT_TRUE(ASIC_registers_write(&shadow, false, 0x40, 0x14, 0x000000FF));
+    TEST_ASSERT_TRUE(ASIC_registers_write(&shadow, false, 0x40, 0x14, 0x000000FF));
+
+    free(shadow.chips);
+}
+
+TEST_CASE("Register shadow parses write commands", "[asic]")
+{
+    AsicRegisterShadow shadow = ASIC_REGISTER_SHADOW_INITIALIZER;
+    ASIC_registers_init(&shadow, 1, 0);
+
+    uint8_t write[] = {0x00, 0xA8, 0x00, 0x07, 0x01, 0xF0};
+    TEST_ASSERT_TRUE(ASIC_registers_command(&shadow, 0x51, write, sizeof(write)));
+    TEST_ASSERT_EQUAL_HEX32(0x000701F0, shadow.chips[0].value[0xA8 >> 2]);
+    TEST_ASSERT_FALSE(ASIC_registers_command(&shadow, 0x41, write, sizeof(write)));
+
+    // reads and address assignments are not writes
+    uint8_t read[] = {0x00, 0xA8};
+    TEST_ASSERT_TRUE(ASIC_registers_command(&shadow, 0x52, read, sizeof(read)));
+    TEST_ASSERT_TRUE(ASIC_registers_command(&shadow, 0x40, read, sizeof(read)));
+
+    free(shadow.chips);
+}
+
+TEST_CASE("Register shadow reports drifted chips on readback", "[asic]")
+{
+    AsicRegisterShadow shadow = ASIC_REGISTER_SHADOW_INITIALIZER;
+    ASIC_registers_init(&shadow, 2, 128);
+
+    ASIC_registers_write(&shadow, true, 0x00, 0x14, 0x000000FF);
+    ASIC_registers_write(&shadow, true, 0x00, 0x08, 0x40A00241);
+    ASIC_registers_write(&shadow, true, 0x00, ASIC_REGISTER_CORE_CONTROL, 0x80008B00);
+
+    // the PLL and core register control are not read back
+    uint8_t regs[ASIC_REGISTER_COUNT];
+    TEST_ASSERT_EQUAL(1, ASIC_registers_verifiable(&shadow, regs, ASIC_REGISTER_COUNT));
+    TEST_ASSERT_EQUAL_HEX8(0x14, regs[0]);
+
+    TEST_ASSERT_TRUE(ASIC_registers_check(&shadow, 0x00, 0x14, 0x000000FF));
+    TEST_ASSERT_FALSE(ASIC_registers_check(&shadow, 0x80, 0x14, 0x00000000));
+    TEST_ASSERT_FALSE(ASIC_registers_check(&shadow, 0x80, 0x14, 0x00000000));
+    TEST_ASSERT_EQUAL_UINT32(0, shadow.chips[0].drift_events);
+    TEST_ASSERT_EQUAL_UINT32(1, shadow.chips[1].drift_events);
+    TEST_ASSERT_TRUE(shadow.chips[1].drifted != 0);
+
+    // registers never written are not judged
+    TEST_ASSERT_TRUE(ASIC_registers_check(&shadow, 0x80, 0x8C, 0x12345678));
+
+    TEST_ASSERT_TRUE(ASIC_registers_check(&shadow, 0x80, 0x14, 0x000000FF));
+    TEST_ASSERT_EQUAL(0, shadow.chips[1].drifted);
+    TEST_ASSERT_EQUAL_UINT32(4, shadow.readbacks);
+
+    uint32_t skipped_writes, readbacks, drift_events;
+    bool drifted;
+    ASIC_registers_counters(&shadow, &skipped_writes, &readbacks);
+    TEST_ASSERT_EQUAL_UINT32(4, readbacks);
+    TEST_ASSERT_TRUE(ASIC_registers_chip_drift(&shadow, 1, &drift_events, &drifted));
+    TEST_ASSERT_EQUAL_UINT32(1, drift_events);
+    TEST_ASSERT_FALSE(drifted);
+
+    // a chain re-initialized without chips has none to report
+    ASIC_registers_init(&shadow, 0, 0);
+    TEST_ASSERT_FALSE(ASIC_registers_chip_drift(&shadow, 1, &drift_events, &drifted));
+    ASIC_registers_counters(&shadow, &skipped_writes, &readbacks);
+    TEST_ASSERT_EQUAL_UINT32(0, readbacks);
+
+    free(shadow.chips);
+}
@@ -0,0 +1,122 @@
+#include "unity.h"
+
+#include "asic_stats.h"
+#include "common.h"
+
+TEST_CASE("Chip index is decoded from the nonce address bits", "[asic]")
+{
+    // byte swapped nonce 0x00FE0000 -> chip address 0x7F
+    uint32_t nonce = __builtin_bswap32(0x7F << 17);
+    TEST_ASSERT_EQUAL_UINT8(0, ASIC_get_asic_nr(nonce, 1));
+    TEST_ASSERT_EQUAL_UINT8(0, ASIC_get_asic_nr(nonce, 2));
+    TEST_ASSERT_EQUAL_UINT8(1, ASIC_get_asic_nr(__builtin_bswap32(0x80 << 17), 2));
+    TEST_ASSERT_EQUAL_UINT8(3, ASIC_get_asic_nr(nonce, 8));
+
+    TEST_ASSERT_EQUAL_UINT8(3, ASIC_get_asic_nr_from_address(0xC0, 4));
+    TEST_ASSERT_EQUAL_UINT8(0, ASIC_get_asic_nr_from_address(0xC0, 1));
+
+    // core id bits do not leak into the chip index
+    TEST_ASSERT_EQUAL_UINT8(0, ASIC_get_asic_nr(__builtin_bswap32(0xFE000000), 4));
+}
+
+TEST_CASE("Nonces are attributed to chips, cores and small cores", "[asic]")
+{
+    AsicStatsModule stats = {0};
+    ASIC_stats_init(&stats, 2, 0);
+
+    ASIC_stats_record(&stats, 1, 5, 3, ASIC_RESULT_VALID, 256, 1000000);
+    ASIC_stats_record(&stats, 1, 5, 4, ASIC_RESULT_VALID, 256, 2000000);
+    ASIC_stats_record(&stats, 0, 127, 15, ASIC_RESULT_VALID, 512, 3000000);
+    ASIC_stats_record(&stats, 2, 0, 0, ASIC_RESULT_VALID, 256, 3000000);
+
+    TEST_ASSERT_EQUAL_UINT32(1, stats.unattributed);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.chips[1].nonces);
+    TEST_ASSERT_EQUAL_UINT32(2, stats.chips[1].cores[5].nonces);
+    TEST_ASSERT_EQUAL_UINT32(3, stats.chips[1].cores[5].last_seen_s);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.chips[1].small_core_nonces[4]);
+    TEST_ASSERT_EQUAL_UINT32(0, stats.chips[1].cores[6].last_seen_s);
+    TEST_ASSERT_EQUAL_DOUBLE(512, stats.chips[0].work);
+    TEST_ASSERT_EQUAL_INT64(3000000, stats.chips[0].last_seen_us);
+}
+
+TEST_CASE("Chip hashrate is weighted by ticket difficulty", "[asic]")
+{
+    AsicStatsModule stats = {0};
+    ASIC_stats_init(&stats, 1, 0);
+
+    // 1000 nonces at diff 256 over 10 s = 256000 * 2^32 / 10 hashes per second
+    for (int i = 0; i < 1000; i++) {
+        ASIC_stats_record(&stats, 0, 0, 0, ASIC_RESULT_VALID, 256, 10000000);
+    }
+
+    TEST_ASSERT_DOUBLE_WITHIN(0.1, 256000 * 4294967296.0 / 10 / 1e9, ASIC_stats_chip_hashrate(&stats, 0, 10000000));
+    TEST_ASSERT_EQUAL_DOUBLE(0, ASIC_stats_chip_hashrate(&stats, 1, 10000000));
+}
+
+TEST_CASE("Hardware errors are kept out of the hashrate", "[asic]")
+{
+    AsicStatsModule stats = {0};
+    ASIC_stats_init(&stats, 1, 0);
+
+    for (int i = 0; i < 9; i++) {
+        ASIC_stats_record(&stats, 0, 1, 1, ASIC_RESULT_VALID, 256, 1000000);
+    }
+    ASIC_stats_record(&stats, 0, 1, 1, ASIC_RESULT_HW_ERROR, 0, 1000000);
+    ASIC_stats_record(&stats, 0, 1, 1, ASIC_RESULT_INVALID_JOB, 0, 1000000);
+
+    TEST_ASSERT_EQUAL_UINT32(9, stats.chips[0].nonces);
+    TEST_ASSERT_EQUAL_UINT32(9, stats.chips[0].cores[1].nonces);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.chips[0].hw_errors);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.chips[0].invalid_jobs);
+    TEST_ASSERT_EQUAL_DOUBLE(9 * 256, stats.chips[0].work);
+    TEST_ASSERT_DOUBLE_WITHIN(0.0001, 0.1, ASIC_stats_chip_error_rate(&stats, 0, 1000000));
+}
+
+TEST_CASE("Hardware error rate only covers the rolling window", "[asic]")
+{
+    AsicStatsModule stats = {0};
+    ASIC_stats_init(&stats, 1, 0);
+
+    int64_t bucket_us = ASIC_STATS_ERROR_BUCKET_S * 1000000LL;
+    int64_t window_us = ASIC_STATS_ERROR_BUCKETS * bucket_us;
+
+    ASIC_stats_record(&stats, 0, 0, 0, ASIC_RESULT_HW_ERROR, 0, 0);
+    ASIC_stats_record(&stats, 0, 0, 0, ASIC_RESULT_VALID, 256, bucket_us);
+    TEST_ASSERT_DOUBLE_WITHIN(0.0001, 0.5, ASIC_stats_chip_error_rate(&stats, 0, bucket_us));
+
+    // the first bucket drops out of the window, the slot is reused lazily
+    TEST_ASSERT_DOUBLE_WITHIN(0.0001, 0, ASIC_stats_chip_error_rate(&stats, 0, window_us));
+
+    ASIC_stats_record(&stats, 0, 0, 0, ASIC_RESULT_VALID, 256, window_us);
+    TEST_ASSERT_DOUBLE_WITHIN(0.0001, 0, ASIC_stats_chip_error_rate(&stats, 0, window_us));
+    TEST_ASSERT_EQUAL_UINT32(1, stats.chips[0].hw_errors);
+
+    // nothing left in the window
+    TEST_ASSERT_EQUAL_DOUBLE(0, ASIC_stats_chip_error_rate(&stats, 0, 3 * window_us));
+}
+
+TEST_CASE("Hash counter readings give the chip hashrate", "[asic]")
+{
+    AsicStatsModule stats = {0};
+    ASIC_stats_init(&stats, 2, 0);
+
+    // the first reading only sets the reference
+    ASIC_stats_record_hash_counter(&stats, 0, 1000, 4294967296.0, 1000000);
+    TEST_ASSERT_EQUAL_DOUBLE(0, stats.chips[0].counter_hashrate);
+
+    // 250 counts of 2^32 hashes in 1 s
+    ASIC_stats_record_hash_counter(&stats, 0, 1250, 4294967296.0, 2000000);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 250 * 4.294967296, stats.chips[0].counter_hashrate);
+
+    // wrapping around is counted, a reset is not
+    ASIC_stats_record_hash_counter(&stats, 1, 0xFFFFFF00, 4294967296.0, 1000000);
+    ASIC_stats_record_hash_counter(&stats, 1, 0x00000100, 4294967296.0, 3000000);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 256 * 4.294967296, stats.chips[1].counter_hashrate);
+    ASIC_stats_record_hash_counter(&stats, 1, 0x00000010, 4294967296.0, 4000000);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 256 * 4.294967296, stats.chips[1].counter_hashrate);
+
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, 506 * 4.294967296, ASIC_stats_counter_hashrate(&stats));
+
+    ASIC_stats_record_hash_counter(&stats, 2, 0, 4294967296.0, 1000000);
+    TEST_ASSERT_EQUAL_UINT32(1, stats.unattributed);
+}
@@ -0,0 +1,57 @@
+#include "unity.h"
+
+#include "asic_watchdog.h"
+
+TEST_CASE("Watchdog nonce interval follows hashrate and ticket mask", "[asic]")
+{
+    // 1 TH/s at difficulty 256 finds a nonce about every 1.1 s
+    TEST_ASSERT_FLOAT_WITHIN(1000, 1099512, ASIC_watchdog_expected_interval_us(1000, 256));
+    TEST_ASSERT_FLOAT_WITHIN(1000, 2199023, ASIC_watchdog_expected_interval_us(1000, 512));
+    TEST_ASSERT_EQUAL_FLOAT(0, ASIC_watchdog_expected_interval_us(0, 256));
+}
+
+TEST_CASE("Watchdog reports a stall after many missed intervals", "[asic]")
+{
+    AsicWatchdog watchdog;
+    ASIC_watchdog_init(&watchdog, 0);
+
+    // fast chain, the floor applies
+    TEST_ASSERT_EQUAL_INT64(ASIC_WATCHDOG_MIN_TIMEOUT_US, ASIC_watchdog_timeout_us(&watchdog, 1000, 256));
+    TEST_ASSERT_FALSE(ASIC_watchdog_stalled(&watchdog, 1000, 256, ASIC_WATCHDOG_MIN_TIMEOUT_US - 1));
+    TEST_ASSERT_TRUE(ASIC_watchdog_stalled(&watchdog, 1000, 256, ASIC_WATCHDOG_MIN_TIMEOUT_US));
+
+    // a nonce restarts the wait
+    ASIC_watchdog_feed(&watchdog, 20000000);
+    TEST_ASSERT_FALSE(ASIC_watchdog_stalled(&watchdog, 1000, 256, ASIC_WATCHDOG_MIN_TIMEOUT_US));
+
+    // slow chain with a high ticket mask waits 20 intervals
+    int64_t timeout_us = ASIC_watchdog_timeout_us(&watchdog, 100, 4096);
+    TEST_ASSERT_INT64_WITHIN(1000, 20 * 175921860LL, timeout_us);
+}
+
+TEST_CASE("Watchdog backs off while recoveries bring no nonces", "[asic]")
+{
+    AsicWatchdog watchdog;
+    ASIC_watchdog_init(&watchdog, 0);
+
+    int64_t now_us = ASIC_WATCHDOG_MIN_TIMEOUT_US;
+    ASIC_watchdog_recovered(&watchdog, true, now_us, now_us + 3000000);
+    now_us += 3000000;
+    TEST_ASSERT_EQUAL_UINT32(1, watchdog.recoveries);
+    TEST_ASSERT_EQUAL_INT64(ASIC_WATCHDOG_MIN_TIMEOUT_US, watchdog.last_stall_us);
+    TEST_ASSERT_EQUAL_INT64(3000000, watchdog.last_recovery_duration_us);
+    TEST_ASSERT_EQUAL_INT64(2 * ASIC_WATCHDOG_MIN_TIMEOUT_US, ASIC_watchdog_timeout_us(&watchdog, 1000, 256));
+
+    // an idle chain restarts the wait but keeps the backoff
+    ASIC_watchdog_restart(&watchdog, now_us);
+    TEST_ASSERT_EQUAL_INT64(2 * ASIC_WATCHDOG_MIN_TIMEOUT_US, ASIC_watchdog_timeout_us(&watchdog, 1000, 256));
+
+    for (int i = 0; i < 10; i++) {
+        ASIC_watchdog_recovered(&watchdog, false, now_us, now_us);
+    }
+    TEST_ASSERT_EQUAL_UINT32(10, watchdog.failed_recoveries);
+    TEST_ASSERT_EQUAL_INT64(ASIC_WATCHDOG_MIN_TIMEOUT_US << ASIC_WATCHDOG_MAX_BACKOFF, ASIC_watchdog_timeout_us(&watchdog, 1000, 256));
+
+    ASIC_watchdog_feed(&watchdog, now_us);
+    TEST_ASSERT_EQUAL_INT64(ASIC_WATCHDOG_MIN_TIMEOUT_US, ASIC_watchdog_timeout_us(&watchdog, 1000, 256));
+}
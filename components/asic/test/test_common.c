@@ -0,0 +1,73 @@
+#include "unity.h"
+
+#include "common.h"
+
+TEST_CASE("Version rolls follow the version mask", "[asic]")
+{
+    TEST_ASSERT_EQUAL_UINT32(1, ASIC_get_version_rolls(0));
+    TEST_ASSERT_EQUAL_UINT32(65536, ASIC_get_version_rolls(0x1fffe000));
+    TEST_ASSERT_EQUAL_UINT32(4, ASIC_get_version_rolls(0x00006000));
+}
+
+TEST_CASE("Ticket mask register value follows the ticket difficulty", "[asic]")
+{
+    TEST_ASSERT_EQUAL_HEX32(0x000000FF, ASIC_get_ticket_mask(256));
+    // the second byte is bit reversed
+    TEST_ASSERT_EQUAL_HEX32(0x000080FF, ASIC_get_ticket_mask(512));
+    TEST_ASSERT_EQUAL_HEX32(0x000080FF, ASIC_get_ticket_mask(1000));
+}
+
+TEST_CASE("Job interval covers the full nonce space without version rolling", "[asic]")
+{
+    // 2^32 / (200 MHz * 672 small cores) ~= 31.96 ms
+    double expected = ASIC_JOB_INTERVAL_MARGIN * 4294967296.0 / (200.0 * 1000.0 * 672);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, expected, ASIC_calculate_job_interval_ms(200, 1, 672, ASIC_NONCE_RANGE_FULL, 1));
+
+    // twice the chips halves the interval
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, expected / 2, ASIC_calculate_job_interval_ms(200, 2, 672, ASIC_NONCE_RANGE_FULL, 1));
+}
+
+TEST_CASE("Job interval scales with nonce range and version rolls", "[asic]")
+{
+    double base = ASIC_calculate_job_interval_ms(500, 1, 2040, 0x00001EB5, 4096);
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, base * 2, ASIC_calculate_job_interval_ms(500, 1, 2040, 0x00001EB5, 8192));
+    TEST_ASSERT_DOUBLE_WITHIN(0.01, base / 2, ASIC_calculate_job_interval_ms(1000, 1, 2040, 0x00001EB5, 4096));
+}
+
+TEST_CASE("Job interval is clamped", "[asic]")
+{
+    TEST_ASSERT_EQUAL_DOUBLE(ASIC_JOB_INTERVAL_MIN_MS, ASIC_calculate_job_interval_ms(500, 1, 2040, 0x00001EB5, 1));
+    TEST_ASSERT_EQUAL_DOUBLE(ASIC_JOB_INTERVAL_MAX_MS, ASIC_calculate_job_interval_ms(1, 1, 1, ASIC_NONCE_RANGE_FULL, 65536));
+    TEST_ASSERT_EQUAL_DOUBLE(ASIC_JOB_INTERVAL_MAX_MS, ASIC_calculate_job_interval_ms(0, 1, 2040, ASIC_NONCE_RANGE_FULL, 1));
+}
+
+TEST_CASE("Ticket difficulty gives the nonce rate for the wanted confidence", "[asic]")
+{
+    double min_rate = ASIC_TICKET_CONFIDENCE_Z * ASIC_TICKET_CONFIDENCE_Z / (ASIC_TICKET_RELATIVE_ERROR * ASIC_TICKET_RELATIVE_ERROR) / ASIC_TICKET_WINDOW_S;
+
+    // ~1 TH/s
+    uint32_t difficulty = ASIC_calculate_ticket_difficulty(1071, 8192, 0);
+    TEST_ASSERT_EQUAL_UINT32(64, difficulty);
+    double rate = 1071e9 / (difficulty * 4294967296.0);
+    TEST_ASSERT_TRUE(rate >= min_rate && rate < 2 * min_rate);
+
+    // 16x the hashrate, 16x the difficulty
+    TEST_ASSERT_EQUAL_UINT32(1024, ASIC_calculate_ticket_difficulty(16 * 1071, 8192, 0));
+}
+
+TEST_CASE("Ticket difficulty never exceeds the pool difficulty", "[asic]")
+{
+    TEST_ASSERT_EQUAL_UINT32(512, ASIC_calculate_ticket_difficulty(100000, 1000, 0));
+    TEST_ASSERT_EQUAL_UINT32(512, ASIC_calculate_ticket_difficulty(100000, 1000, 4096));
+    TEST_ASSERT_EQUAL_UINT32(256, ASIC_calculate_ticket_difficulty(0, 256, 1024));
+}
+
+TEST_CASE("Ticket difficulty is kept while the nonce rate is usable", "[asic]")
+{
+    // 128 gives ~1.9 nonces/s at 1071 GH/s, below the wanted rate
+    TEST_ASSERT_EQUAL_UINT32(64, ASIC_calculate_ticket_difficulty(1071, 8192, 128));
+    // 32 gives ~7.8 nonces/s, more than needed but bounded
+    TEST_ASSERT_EQUAL_UINT32(32, ASIC_calculate_ticket_difficulty(1071, 8192, 32));
+    // 1 gives ~250 nonces/s, too many
+    TEST_ASSERT_EQUAL_UINT32(64, ASIC_calculate_ticket_difficulty(1071, 8192, 1));
+}
@@ -0,0 +1,164 @@
+#include "unity.h"
+
+#include "asic_frame.h"
+#include "crc.h"
+
+#include "esp_timer.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// original bit-serial crc5, kept as a reference for the table version
+static uint8_t crc5_bitwise_bits(const uint8_t *data, uint16_t bits)
+{
+    uint8_t crcin[5] = {1, 1, 1, 1, 1};
+    uint8_t crcout[5];
+
+    for (int i = 0; i < bits; i++) {
+        uint8_t din = (data[i / 8] >> (7 - (i % 8))) & 1;
+        crcout[0] = crcin[4] ^ din;
+        crcout[1] = crcin[0];
+        crcout[2] = crcin[1] ^ crcin[4] ^ din;
+        crcout[3] = crcin[2];
+        crcout[4] = crcin[3];
+        memcpy(crcin, crcout, 5);
+    }
+
+    return (crcin[4] << 4) | (crcin[3] << 3) | (crcin[2] << 2) | (crcin[1] << 1) | crcin[0];
+}
+
+static uint8_t crc5_bitwise(const uint8_t *data, uint8_t len)
+{
+    return crc5_bitwise_bits(data, len * 8);
+}
+
+TEST_CASE("crc5 matches known command frames", "[asic]")
+{
+    // 55 AA 51 09 00 A8 00 07 00 00 03
+    uint8_t reg_a8[] = {0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00};
+    TEST_ASSERT_EQUAL_HEX8(0x03, crc5(reg_a8, sizeof(reg_a8)));
+
+    // 55 AA 52 05 00 00 0A
+    uint8_t read_reg_00[] = {0x52, 0x05, 0x00, 0x00};
+    TEST_ASSERT_EQUAL_HEX8(0x0A, crc5(read_reg_00, sizeof(read_reg_00)));
+
+    // 55 AA 51 09 00 28 11 30 02 00 03
+    uint8_t fast_uart[] = {0x51, 0x09, 0x00, 0x28, 0x11, 0x30, 0x02, 0x00};
+    TEST_ASSERT_EQUAL_HEX8(0x03, crc5(fast_uart, sizeof(fast_uart)));
+}
+
+TEST_CASE("crc5 table matches bit-serial implementation", "[asic]")
+{
+    uint8_t data[31];
+    uint32_t seed = 0x12345678;
+
+    for (int round = 0; round < 1000; round++) {
+        uint8_t len = round % sizeof(data);
+        for (int i = 0; i < len; i++) {
+            seed = seed * 1103515245 + 12345;
+            data[i] = seed >> 16;
+        }
+        TEST_ASSERT_EQUAL_HEX8(crc5_bitwise(data, len), crc5(data, len));
+    }
+}
+
+TEST_CASE("crc5 over a bit count matches bit-serial implementation", "[asic]")
+{
+    uint8_t data[12];
+    uint32_t seed = 0x9E3779B9;
+
+    for (int round = 0; round < 1000; round++) {
+        uint16_t bits = round % (sizeof(data) * 8);
+        for (int i = 0; i < sizeof(data); i++) {
+            seed = seed * 1103515245 + 12345;
+            data[i] = seed >> 16;
+        }
+        TEST_ASSERT_EQUAL_HEX8(crc5_bitwise_bits(data, bits), crc5_bits(data, bits));
+    }
+
+    // whole bytes give the same crc as the command frame crc
+    TEST_ASSERT_EQUAL_HEX8(crc5(data, sizeof(data)), crc5_bits(data, sizeof(data) * 8));
+}
+
+TEST_CASE("crc16_false matches check value", "[asic]")
+{
+    const uint8_t check[] = "123456789";
+    TEST_ASSERT_EQUAL_HEX16(0x29B1, crc16_false(check, 9));
+    TEST_ASSERT_EQUAL_HEX16(0x31C3, crc16(check, 9));
+}
+
+TEST_CASE("Frame builder produces command and job frames", "[asic]")
+{
+    uint8_t buf[ASIC_FRAME_MAX_LEN];
+
+    uint8_t reg_a8[] = {0x00, 0xA8, 0x00, 0x07, 0x00, 0x00};
+    uint8_t expected_cmd[] = {0x55, 0xAA, 0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00, 0x03};
+    TEST_ASSERT_EQUAL_UINT8(sizeof(expected_cmd), ASIC_frame_build(buf, 0x51, reg_a8, sizeof(reg_a8)));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected_cmd, buf, sizeof(expected_cmd));
+
+    uint8_t job[ASIC_FRAME_MAX_DATA_LEN];
+    for (int i = 0; i < sizeof(job); i++) {
+        job[i] = i;
+    }
+    uint8_t len = ASIC_frame_build(buf, 0x21, job, sizeof(job));
+    TEST_ASSERT_EQUAL_UINT8(ASIC_FRAME_MAX_LEN, len);
+    TEST_ASSERT_EQUAL_HEX8(0x55, buf[0]);
+    TEST_ASSERT_EQUAL_HEX8(0xAA, buf[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x21, buf[2]);
+    TEST_ASSERT_EQUAL_UINT8(sizeof(job) + 4, buf[3]);
+    uint16_t crc = crc16_false(buf + 2, sizeof(job) + 2);
+    TEST_ASSERT_EQUAL_HEX8(crc >> 8, buf[len - 2]);
+    TEST_ASSERT_EQUAL_HEX8(crc & 0xFF, buf[len - 1]);
+}
+
+TEST_CASE("Patching the job id matches a freshly built frame", "[asic]")
+{
+    uint8_t prepared[ASIC_FRAME_MAX_LEN];
+    uint8_t expected[ASIC_FRAME_MAX_LEN];
+    uint8_t job[82];
+
+    for (int i = 0; i < sizeof(job); i++) {
+        job[i] = 0xA5 ^ i;
+    }
+
+    job[0] = 0;
+    uint8_t len = ASIC_frame_build(prepared, 0x21, job, sizeof(job));
+    ASIC_frame_set_job_id(prepared, len, 0x48);
+
+    job[0] = 0x48;
+    ASIC_frame_build(expected, 0x21, job, sizeof(job));
+
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, prepared, len);
+}
+
+// reports the timings only, they depend on caches and clocks and must not fail a run
+TEST_CASE("crc5 and frame builder benchmark", "[asic][bench]")
+{
+    uint8_t cmd[] = {0x51, 0x09, 0x00, 0xA8, 0x00, 0x07, 0x00, 0x00};
+    uint8_t buf[ASIC_FRAME_MAX_LEN];
+    uint8_t job[82] = {0};
+    const int iterations = 10000;
+    volatile uint8_t sink = 0;
+
+    int64_t start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        sink ^= crc5_bitwise(cmd, sizeof(cmd));
+    }
+    int64_t bitwise_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        sink ^= crc5(cmd, sizeof(cmd));
+    }
+    int64_t table_us = esp_timer_get_time() - start;
+
+    start = esp_timer_get_time();
+    for (int i = 0; i < iterations; i++) {
+        sink ^= ASIC_frame_build(buf, 0x21, job, sizeof(job));
+    }
+    int64_t job_us = esp_timer_get_time() - start;
+
+    printf("crc5 bit-serial: %.3f us/frame\n", (double) bitwise_us / iterations);
+    printf("crc5 table:      %.3f us/frame\n", (double) table_us / iterations);
+    printf("job frame build: %.3f us/frame\n", (double) job_us / iterations);
+}
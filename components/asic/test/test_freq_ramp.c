@@ -0,0 +1,123 @@
+#include "unity.h"
+
+#include <math.h>
+
+#include "freq_ramp.h"
+
+static void _run(FreqRamp * ramp, float current)
+{
+    float frequency;
+    while (FREQ_RAMP_next(ramp, &frequency)) {
+        uint32_t dwell_ms = 0;
+        do {
+            dwell_ms += ramp->config.sample_ms;
+        } while (!FREQ_RAMP_settled(ramp, current, dwell_ms));
+    }
+}
+
+TEST_CASE("Frequency ramp without a current sensor takes fixed steps", "[asic]")
+{
+    FreqRampConfig config;
+    FREQ_RAMP_default_config(&config, false);
+
+    FreqRamp ramp;
+    FREQ_RAMP_init(&ramp, &config, 56.25, 600);
+    _run(&ramp, -1);
+
+    TEST_ASSERT_EQUAL_FLOAT(600, ramp.frequency);
+    TEST_ASSERT_EQUAL(87, ramp.steps);
+    TEST_ASSERT_EQUAL_UINT32(8700, ramp.elapsed_ms);
+}
+
+TEST_CASE("Frequency ramp speeds up while the current settles", "[asic]")
+{
+    FreqRampConfig config;
+    FREQ_RAMP_default_config(&config, true);
+
+    FreqRamp ramp;
+    FREQ_RAMP_init(&ramp, &config, 56.25, 600);
+    _run(&ramp, 10);
+
+    TEST_ASSERT_EQUAL_FLOAT(600, ramp.frequency);
+    TEST_ASSERT_TRUE(ramp.steps < 30);
+    TEST_ASSERT_TRUE(ramp.elapsed_ms < 1000);
+}
+
+TEST_CASE("Frequency ramp slows down when the current does not settle", "[asic]")
+{
+    FreqRampConfig config;
+    FREQ_RAMP_default_config(&config, true);
+
+    FreqRamp ramp;
+    FREQ_RAMP_init(&ramp, &config, 400, 600);
+
+    float frequency;
+    TEST_ASSERT_TRUE(FREQ_RAMP_next(&ramp, &frequency));
+    TEST_ASSERT_FALSE(FREQ_RAMP_settled(&ramp, 5, 10));
+    TEST_ASSERT_TRUE(FREQ_RAMP_settled(&ramp, 5, 20));
+    TEST_ASSERT_EQUAL_FLOAT(12.5, ramp.step);
+
+    TEST_ASSERT_TRUE(FREQ_RAMP_next(&ramp, &frequency));
+    TEST_ASSERT_EQUAL_FLOAT(418.75, frequency);
+    // the current keeps climbing until the longest dwell
+    float current = 5;
+    uint32_t dwell_ms = 0;
+    do {
+        dwell_ms += config.sample_ms;
+        current += 1;
+    } while (!FREQ_RAMP_settled(&ramp, current, dwell_ms));
+    TEST_ASSERT_EQUAL_UINT32(config.max_dwell_ms, dwell_ms);
+    TEST_ASSERT_EQUAL_FLOAT(6.25, ramp.step);
+}
+
+TEST_CASE("Frequency ramp does not settle on failed current readings", "[asic]")
+{
+    FreqRampConfig config;
+    FREQ_RAMP_default_config(&config, true);
+
+    FreqRamp ramp;
+    FREQ_RAMP_init(&ramp, &config, 400, 600);
+
+    float frequency;
+    TEST_ASSERT_TRUE(FREQ_RAMP_next(&ramp, &frequency));
+    TEST_ASSERT_FALSE(FREQ_RAMP_settled(&ramp, 5, 10));
+    TEST_ASSERT_FALSE(FREQ_RAMP_settled(&ramp, NAN, 20));
+    // one good reading again and the sensor is trusted
+    TEST_ASSERT_TRUE(FREQ_RAMP_settled(&ramp, 5, 30));
+    TEST_ASSERT_EQUAL_UINT8(0, ramp.failed_readings);
+    TEST_ASSERT_EQUAL_FLOAT(25, ramp.config.max_step);
+}
+
+TEST_CASE("Frequency ramp falls back to fixed steps when the current sensor fails", "[asic]")
+{
+    FreqRampConfig config;
+    FREQ_RAMP_default_config(&config, true);
+
+    FreqRamp ramp;
+    FREQ_RAMP_init(&ramp, &config, 56.25, 600);
+    _run(&ramp, NAN);
+
+    // the first step waits out three failed 10 ms samples, then every step is 6.25 MHz held for 100 ms
+    TEST_ASSERT_EQUAL_FLOAT(600, ramp.frequency);
+    TEST_ASSERT_EQUAL(87, ramp.steps);
+    TEST_ASSERT_EQUAL_UINT32(130 + 86 * 100, ramp.elapsed_ms);
+    TEST_ASSERT_EQUAL_FLOAT(6.25, ramp.config.max_step);
+}
+
+TEST_CASE("Frequency ramp steps down and onto the grid", "[asic]")
+{
+    FreqRampConfig config;
+    FREQ_RAMP_default_config(&config, false);
+
+    FreqRamp ramp;
+    FREQ_RAMP_init(&ramp, &config, 490, 480);
+
+    float frequency;
+    TEST_ASSERT_TRUE(FREQ_RAMP_next(&ramp, &frequency));
+    TEST_ASSERT_EQUAL_FLOAT(487.5, frequency);
+    TEST_ASSERT_TRUE(FREQ_RAMP_next(&ramp, &frequency));
+    TEST_ASSERT_EQUAL_FLOAT(481.25, frequency);
+    TEST_ASSERT_TRUE(FREQ_RAMP_next(&ramp, &frequency));
+    TEST_ASSERT_EQUAL_FLOAT(480, frequency);
+    TEST_ASSERT_FALSE(FREQ_RAMP_next(&ramp, &frequency));
+}
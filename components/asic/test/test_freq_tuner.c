@@ -0,0 +1,105 @@
+#include "unity.h"
+
+#include "freq_tuner.h"
+
+static FreqTunerConfig _config(void)
+{
+    FreqTunerConfig config;
+    FREQ_TUNER_default_config(&config, 500, 525);
+    config.min_results = 100;
+    return config;
+}
+
+TEST_CASE("Frequency tuner raises a stable chip up to the maximum", "[asic]")
+{
+    FreqTunerConfig config = _config();
+    FreqTuner tuner = {0};
+    TEST_ASSERT_TRUE(FREQ_TUNER_init(&tuner, &config, 1, 500, NULL));
+
+    uint32_t nonces = 0;
+    int64_t now_us = 0;
+    FREQ_TUNER_update_chip(&tuner, 0, nonces, 0, nonces * 256.0, now_us);
+
+    for (int i = 0; i < 4; i++) {
+        nonces += 1000;
+        now_us += 10000000;
+        TEST_ASSERT_TRUE(FREQ_TUNER_update_chip(&tuner, 0, nonces, 0, nonces * 256.0, now_us));
+    }
+    TEST_ASSERT_EQUAL_FLOAT(525, tuner.chips[0].frequency);
+
+    nonces += 1000;
+    now_us += 10000000;
+    TEST_ASSERT_FALSE(FREQ_TUNER_update_chip(&tuner, 0, nonces, 0, nonces * 256.0, now_us));
+    TEST_ASSERT_TRUE(FREQ_TUNER_is_settled(&tuner));
+
+    FREQ_TUNER_free(&tuner);
+}
+
+TEST_CASE("Frequency tuner backs off from hardware errors", "[asic]")
+{
+    FreqTunerConfig config = _config();
+    FreqTuner tuner = {0};
+    TEST_ASSERT_TRUE(FREQ_TUNER_init(&tuner, &config, 1, 500, NULL));
+
+    FREQ_TUNER_update_chip(&tuner, 0, 0, 0, 0, 0);
+
+    // not enough results to judge yet
+    TEST_ASSERT_FALSE(FREQ_TUNER_update_chip(&tuner, 0, 50, 0, 12800, 1000000));
+
+    TEST_ASSERT_TRUE(FREQ_TUNER_update_chip(&tuner, 0, 1000, 0, 256000, 10000000));
+    TEST_ASSERT_EQUAL_FLOAT(506.25, tuner.chips[0].frequency);
+
+    // 5% errors at 506.25
+    TEST_ASSERT_TRUE(FREQ_TUNER_update_chip(&tuner, 0, 1950, 50, 499200, 20000000));
+    TEST_ASSERT_EQUAL_FLOAT(500, tuner.chips[0].frequency);
+    TEST_ASSERT_EQUAL(FREQ_TUNER_BACKING_OFF, tuner.chips[0].state);
+
+    TEST_ASSERT_FALSE(FREQ_TUNER_update_chip(&tuner, 0, 2950, 50, 755200, 30000000));
+    TEST_ASSERT_EQUAL(FREQ_TUNER_SETTLED, tuner.chips[0].state);
+    TEST_ASSERT_EQUAL_FLOAT(506.25, tuner.chips[0].ceiling);
+
+    FREQ_TUNER_free(&tuner);
+}
+
+TEST_CASE("Frequency tuner yield holds across ticket mask changes", "[asic]")
+{
+    FreqTunerConfig config = _config();
+    FreqTuner tuner = {0};
+    float saved[] = {512.5};
+    TEST_ASSERT_TRUE(FREQ_TUNER_init(&tuner, &config, 1, 500, saved));
+
+    FREQ_TUNER_update_chip(&tuner, 0, 0, 0, 0, 0);
+    TEST_ASSERT_FALSE(FREQ_TUNER_update_chip(&tuner, 0, 1000, 0, 256000, 10000000));
+
+    // the mask doubled: half the nonces for the same work
+    TEST_ASSERT_FALSE(FREQ_TUNER_update_chip(&tuner, 0, 1500, 0, 512000, 20000000));
+    TEST_ASSERT_EQUAL_FLOAT(512.5, tuner.chips[0].frequency);
+    TEST_ASSERT_EQUAL_FLOAT(0, tuner.chips[0].ceiling);
+
+    FREQ_TUNER_free(&tuner);
+}
+
+TEST_CASE("Frequency tuner results survive a format and parse", "[asic]")
+{
+    FreqTunerConfig config = _config();
+    FreqTuner tuner = {0};
+    float saved[] = {512.5, 0, 600};
+    TEST_ASSERT_TRUE(FREQ_TUNER_init(&tuner, &config, 3, 500, saved));
+
+    TEST_ASSERT_EQUAL(FREQ_TUNER_SETTLED, tuner.chips[0].state);
+    TEST_ASSERT_EQUAL(FREQ_TUNER_RAISING, tuner.chips[1].state);
+    TEST_ASSERT_EQUAL_FLOAT(525, tuner.chips[2].frequency);
+
+    char buf[64];
+    TEST_ASSERT_EQUAL(20, FREQ_TUNER_format(&tuner, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_STRING("512.50,500.00,525.00", buf);
+    TEST_ASSERT_EQUAL(-1, FREQ_TUNER_format(&tuner, buf, 10));
+
+    float parsed[3];
+    TEST_ASSERT_EQUAL(3, FREQ_TUNER_parse("512.50,500.00,525.00", parsed, 3));
+    TEST_ASSERT_EQUAL_FLOAT(512.5, parsed[0]);
+    TEST_ASSERT_EQUAL_FLOAT(525, parsed[2]);
+    TEST_ASSERT_EQUAL(0, FREQ_TUNER_parse("", parsed, 3));
+
+    FREQ_TUNER_free(&tuner);
+}
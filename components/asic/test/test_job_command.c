@@ -1,23 +1,33 @@
 #include "unity.h"
 
+#include "asic_frame.h"
 #include "bm1397.h"
+#include "global_state.h"
 #include "serial.h"
 
+#include <stdlib.h>
 #include <string.h>
 
 static uint8_t uart_initialized = 0;
+static GlobalState GLOBAL_STATE;
 
 TEST_CASE("Check known working midstate + job command", "[bm1397]")
 {
     if (!uart_initialized)
     {
-        SERIAL_init();
+        SERIAL_init(0);
         uart_initialized = 1;
 
-        BM1397_init();
+        // send_work records the job of chain 0 in its active jobs
+        GLOBAL_STATE.chain_count = 1;
+        GLOBAL_STATE.chains[0].ASIC_TASK_MODULE.active_jobs = calloc(128, sizeof(bm_job *));
+        GLOBAL_STATE.chains[0].valid_jobs = calloc(128, sizeof(uint8_t));
+        pthread_mutex_init(&GLOBAL_STATE.valid_jobs_lock, NULL);
+
+        BM1397_init(0, CONFIG_ASIC_FREQUENCY, 1);
 
         // read back response
-        SERIAL_debug_rx();
+        SERIAL_debug_rx(0);
     }
 
     uint8_t work1[146] = {
@@ -168,15 +178,18 @@ TEST_CASE("Check known working midstate + job command", "[bm1397]")
         0x00,
         0x00,
     };
-    job_packet test_job;
-    memcpy((uint8_t *)&test_job, work1, 146);
+    // the packet is sent as built, send_work only patches in the next job id of the chain
+    bm_job *test_job = calloc(1, sizeof(bm_job));
+    test_job->packet_len = ASIC_frame_build(test_job->packet, 0x21, work1, sizeof(work1));
 
     uint8_t buf[1024];
     memset(buf, 0, 1024);
 
-    BM1397_send_work(&test_job);
-    uint16_t received = SERIAL_rx(buf, 9, 20);
-    TEST_ASSERT_GREATER_OR_EQUAL_UINT16(sizeof(struct asic_result), received);
+    BM1397_send_work(&GLOBAL_STATE, 0, test_job);
+    uint8_t job_id = test_job->packet[4];
+    TEST_ASSERT_EQUAL_PTR(test_job, GLOBAL_STATE.chains[0].ASIC_TASK_MODULE.active_jobs[job_id]);
+    uint16_t received = SERIAL_rx(0, buf, 9, 20);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT16(9, received);
 
     int i;
     for (i = 0; i < received - 1; i++)
@@ -187,10 +200,12 @@ TEST_CASE("Check known working midstate + job command", "[bm1397]")
         }
     }
 
-    struct asic_result nonce;
-    memcpy((void *)&nonce, buf + i, sizeof(struct asic_result));
+    // result frame: preamble, nonce, midstate number, job id, crc
+    uint32_t nonce;
+    memcpy(&nonce, buf + i + 2, 4);
+    uint8_t result_job_id = buf[i + 7];
     // expected nonce 9B 04 4C 0A
-    TEST_ASSERT_EQUAL_UINT32(0x0a4c049b, nonce.nonce);
-    TEST_ASSERT_EQUAL_UINT8(0x18, nonce.job_id & 0xfc);
-    TEST_ASSERT_EQUAL_UINT8(2, nonce.job_id & 0x03);
+    TEST_ASSERT_EQUAL_UINT32(0x0a4c049b, nonce);
+    TEST_ASSERT_EQUAL_UINT8(job_id, result_job_id & 0xfc);
+    TEST_ASSERT_EQUAL_UINT8(2, result_job_id & 0x03);
 }
\ No newline at end of file
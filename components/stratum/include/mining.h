@@ -3,6 +3,9 @@
 
 #include "stratum_api.h"
 
+// large enough for the biggest ASIC job frame (BM1397 with 4 midstates)
+#define BM_JOB_PACKET_MAX_LEN 152
+
 typedef struct
 {
     uint32_t version;
@@ -23,6 +26,12 @@ typedef struct
     uint32_t pool_diff;
     char *jobid;
     char *extranonce2;
+    // set by the ASIC task when the job is sent, tells a reused job id apart from the job it replaced
+    uint32_t dispatch_seq;
+
+    // wire-format job frame prepared by the ASIC driver before dispatch
+    uint8_t packet[BM_JOB_PACKET_MAX_LEN];
+    uint8_t packet_len;
 } bm_job;
 
 void free_bm_job(bm_job *job);
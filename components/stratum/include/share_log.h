@@ -0,0 +1,58 @@
+#ifndef SHARE_LOG_H_
+#define SHARE_LOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// the last shares submitted to the pool
+#define SHARE_LOG_SIZE 256
+
+#define SHARE_LOG_JOB_ID_LEN 24
+#define SHARE_LOG_REASON_LEN 32
+
+typedef enum
+{
+    SHARE_PENDING,
+    SHARE_ACCEPTED,
+    SHARE_REJECTED,
+    // the connection closed before the pool answered
+    SHARE_UNANSWERED,
+} share_status;
+
+typedef struct
+{
+    // numbers the shares in submit order, starting at 1
+    uint32_t id;
+    // share log version of the last change to this entry, what a since cursor compares against
+    uint32_t version;
+    // wall clock at submit, unix seconds
+    uint32_t time;
+    int64_t submitted_us;
+    // from submit to the pool answer, 0 while pending
+    uint32_t latency_us;
+    int32_t message_id;
+    char job_id[SHARE_LOG_JOB_ID_LEN];
+    uint8_t chain;
+    uint8_t chip;
+    // 0 for the primary pool, 1 for the fallback
+    uint8_t pool;
+    uint8_t status;
+    double nonce_diff;
+    uint32_t pool_diff;
+    char reason[SHARE_LOG_REASON_LEN];
+} ShareLogEntry;
+
+typedef struct
+{
+    ShareLogEntry entries[SHARE_LOG_SIZE];
+    uint32_t next_id;
+    uint32_t version;
+} ShareLog;
+
+void STRATUM_share_log_init(ShareLog * log);
+uint32_t STRATUM_share_log_submitted(ShareLog * log, const ShareLogEntry * share);
+bool STRATUM_share_log_answered(ShareLog * log, int64_t message_id, bool accepted, const char * reason, int64_t now_us);
+void STRATUM_share_log_unanswered(ShareLog * log);
+int STRATUM_share_log_since(const ShareLog * log, uint32_t since_version, uint32_t after_id, ShareLogEntry * entries, int max);
+
+#endif /* SHARE_LOG_H_ */
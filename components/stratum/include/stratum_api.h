@@ -82,6 +82,6 @@ int STRATUM_V1_suggest_difficulty(int socket, uint32_t difficulty);
 
 int STRATUM_V1_submit_share(int socket, const char *username, const char *jobid,
                             const char *extranonce_2, const uint32_t ntime, const uint32_t nonce,
-                            const uint32_t version);
+                            const uint32_t version, int *message_id);
 
 #endif // STRATUM_API_H
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include <string.h>
+
+#include "share_log.h"
+
+static void _copy(char * dest, const char * src, size_t size)
+{
+    if (src == NULL) {
+        src = "";
+    }
+    strncpy(dest, src, size - 1);
+    dest[size - 1] = '\0';
+}
+
+void STRATUM_share_log_init(ShareLog * log)
+{
+    memset(log, 0, sizeof(*log));
+    log->next_id = 1;
+}
+
+/// @brief logs a share as pending, overwriting the oldest once the log is full
+/// @param share time, submitted_us, message_id, job_id, chain, chip, pool, nonce_diff and pool_diff of the share
+/// @return the id of the share
+uint32_t STRATUM_share_log_submitted(ShareLog * log, const ShareLogEntry * share)
+{
+    ShareLogEntry * entry = &log->entries[log->next_id % SHARE_LOG_SIZE];
+
+    *entry = *share;
+    _copy(entry->job_id, share->job_id, sizeof(entry->job_id));
+    entry->id = log->next_id++;
+    entry->version = ++log->version;
+    entry->latency_us = 0;
+    entry->status = SHARE_PENDING;
+    entry->reason[0] = '\0';
+
+    return entry->id;
+}
+
+/// @brief settles the newest pending share submitted with message_id
+/// @param reason the error the pool rejected the share with, may be NULL
+/// @return false if no pending share has that message id
+bool STRATUM_share_log_answered(ShareLog * log, int64_t message_id, bool accepted, const char * reason, int64_t now_us)
+{
+    // message ids restart with each connection, the newest entries are searched first
+    for (uint32_t i = 1; i <= SHARE_LOG_SIZE && i < log->next_id; i++) {
+        ShareLogEntry * entry = &log->entries[(log->next_id - i) % SHARE_LOG_SIZE];
+        if (entry->status != SHARE_PENDING || entry->message_id != message_id) {
+            continue;
+        }
+
+        int64_t latency_us = now_us - entry->submitted_us;
+        entry->latency_us = latency_us < 0 ? 0 : latency_us > UINT32_MAX ? UINT32_MAX : latency_us;
+        entry->status = accepted ? SHARE_ACCEPTED : SHARE_REJECTED;
+        _copy(entry->reason, accepted ? NULL : reason, sizeof(entry->reason));
+        entry->version = ++log->version;
+        return true;
+    }
+    return false;
+}
+
+/// @brief marks every pending share unanswered, their message ids are reused on the next connection
+void STRATUM_share_log_unanswered(ShareLog * log)
+{
+    for (uint32_t i = 1; i <= SHARE_LOG_SIZE && i < log->next_id; i++) {
+        ShareLogEntry * entry = &log->entries[(log->next_id - i) % SHARE_LOG_SIZE];
+        if (entry->status == SHARE_PENDING) {
+            entry->status = SHARE_UNANSWERED;
+            entry->version = ++log->version;
+        }
+    }
+}
+
+/// @brief copies the shares changed after since_version in id order, starting after after_id
+/// @return the number of entries copied, fewer than max once no more are held
+int STRATUM_share_log_since(const ShareLog * log, uint32_t since_version, uint32_t after_id, ShareLogEntry * entries, int max)
+{
+    uint32_t oldest = log->next_id > SHARE_LOG_SIZE ? log->next_id - SHARE_LOG_SIZE : 1;
+    int count = 0;
+
+    for (uint32_t id = after_id + 1 > oldest ? after_id + 1 : oldest; id < log->next_id && count < max; id++) {
+        const ShareLogEntry * entry = &log->entries[id % SHARE_LOG_SIZE];
+        if (entry->version > since_version) {
+            entries[count++] = *entry;
+        }
+    }
+    return count;
+}
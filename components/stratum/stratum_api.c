@@ -357,12 +357,14 @@ int STRATUM_V1_authenticate(int socket, const char * username, const char * pass
 /// @param extranonce_2 The hex-encoded value of extra nonce 2.
 /// @param nonce The hex-encoded nonce value to use in the block header.
 int STRATUM_V1_submit_share(int socket, const char * username, const char * jobid, const char * extranonce_2, const uint32_t ntime,
-                             const uint32_t nonce, const uint32_t version)
+                             const uint32_t nonce, const uint32_t version, int * message_id)
 {
     char submit_msg[BUFFER_SIZE];
+    // the pool answers with the same id
+    *message_id = send_uid++;
     sprintf(submit_msg,
             "{\"id\": %d, \"method\": \"mining.submit\", \"params\": [\"%s\", \"%s\", \"%s\", \"%08lx\", \"%08lx\", \"%08lx\"]}\n",
-            send_uid++, username, jobid, extranonce_2, ntime, nonce, version);
+            *message_id, username, jobid, extranonce_2, ntime, nonce, version);
     debug_stratum_tx(submit_msg);
 
     return write(socket, submit_msg, strlen(submit_msg));
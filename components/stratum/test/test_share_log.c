@@ -0,0 +1,89 @@
+#include "unity.h"
+#include "share_log.h"
+
+static ShareLog share_log;
+
+static uint32_t submit(int32_t message_id, int64_t submitted_us)
+{
+    ShareLogEntry share = {
+        .time = 1700000000,
+        .submitted_us = submitted_us,
+        .message_id = message_id,
+        .job_id = "1a2b3c",
+        .chain = 0,
+        .chip = 3,
+        .nonce_diff = 2048.5,
+        .pool_diff = 1024,
+    };
+    return STRATUM_share_log_submitted(&share_log, &share);
+}
+
+TEST_CASE("Share log settles the pending share of a message id", "[share_log]")
+{
+    ShareLogEntry entries[4];
+    STRATUM_share_log_init(&share_log);
+
+    TEST_ASSERT_EQUAL_UINT32(1, submit(5, 1000000));
+    TEST_ASSERT_EQUAL_UINT32(2, submit(6, 1100000));
+
+    TEST_ASSERT_TRUE(STRATUM_share_log_answered(&share_log, 6, false, "Stale share", 1180000));
+    TEST_ASSERT_TRUE(STRATUM_share_log_answered(&share_log, 5, true, NULL, 1250000));
+    // already answered
+    TEST_ASSERT_FALSE(STRATUM_share_log_answered(&share_log, 5, true, NULL, 1300000));
+
+    TEST_ASSERT_EQUAL_INT(2, STRATUM_share_log_since(&share_log, 0, 0, entries, 4));
+    TEST_ASSERT_EQUAL_UINT8(SHARE_ACCEPTED, entries[0].status);
+    TEST_ASSERT_EQUAL_UINT32(250000, entries[0].latency_us);
+    TEST_ASSERT_EQUAL_STRING("1a2b3c", entries[0].job_id);
+    TEST_ASSERT_EQUAL_UINT8(3, entries[0].chip);
+    TEST_ASSERT_EQUAL_UINT8(SHARE_REJECTED, entries[1].status);
+    TEST_ASSERT_EQUAL_UINT32(80000, entries[1].latency_us);
+    TEST_ASSERT_EQUAL_STRING("Stale share", entries[1].reason);
+}
+
+TEST_CASE("Share log cursor returns what changed since", "[share_log]")
+{
+    ShareLogEntry entries[4];
+    STRATUM_share_log_init(&share_log);
+
+    submit(5, 0);
+    submit(6, 0);
+    uint32_t cursor = share_log.version;
+
+    // the first share is answered and a third one submitted after the cursor
+    STRATUM_share_log_answered(&share_log, 5, true, NULL, 1000);
+    submit(7, 0);
+
+    TEST_ASSERT_EQUAL_INT(2, STRATUM_share_log_since(&share_log, cursor, 0, entries, 4));
+    TEST_ASSERT_EQUAL_UINT32(1, entries[0].id);
+    TEST_ASSERT_EQUAL_UINT32(3, entries[1].id);
+
+    // paging on by id
+    TEST_ASSERT_EQUAL_INT(1, STRATUM_share_log_since(&share_log, cursor, 1, entries, 4));
+    TEST_ASSERT_EQUAL_UINT32(3, entries[0].id);
+
+    // a new connection leaves the pending shares unanswered, a reused message id does not match them
+    STRATUM_share_log_unanswered(&share_log);
+    TEST_ASSERT_FALSE(STRATUM_share_log_answered(&share_log, 6, true, NULL, 2000));
+    TEST_ASSERT_EQUAL_INT(3, STRATUM_share_log_since(&share_log, 0, 0, entries, 4));
+    TEST_ASSERT_EQUAL_UINT8(SHARE_UNANSWERED, entries[1].status);
+    TEST_ASSERT_EQUAL_UINT8(SHARE_UNANSWERED, entries[2].status);
+}
+
+TEST_CASE("Share log keeps only the newest shares", "[share_log]")
+{
+    ShareLogEntry entries[4];
+    STRATUM_share_log_init(&share_log);
+
+    for (int i = 0; i < SHARE_LOG_SIZE + 10; i++) {
+        submit(i, 0);
+    }
+
+    TEST_ASSERT_EQUAL_INT(4, STRATUM_share_log_since(&share_log, 0, 0, entries, 4));
+    TEST_ASSERT_EQUAL_UINT32(11, entries[0].id);
+    TEST_ASSERT_EQUAL_INT(2, STRATUM_share_log_since(&share_log, 0, SHARE_LOG_SIZE + 8, entries, 4));
+    TEST_ASSERT_EQUAL_UINT32(SHARE_LOG_SIZE + 10, entries[1].id);
+
+    // a message id only held by an overwritten share
+    TEST_ASSERT_FALSE(STRATUM_share_log_answered(&share_log, 3, true, NULL, 0));
+}
@@ -621,24 +621,35 @@ float TPS546_get_vin(void)
     }    
 }
 
-float TPS546_get_iout(void)
+/// @brief reads the output current without hiding a failed read behind 0 A
+/// @return ESP_OK if iout holds a reading
+int TPS546_read_iout(float *iout)
 {
     uint16_t u16_value;
-    float iout;
 
     /* Get current output (SLINEAR11) */
     if (smb_read_word(PMBUS_READ_IOUT, &u16_value) != ESP_OK) {
         ESP_LOGE(TAG, "Could not read Iout");
-        return 0;
-    } else {
-        iout = slinear11_2_float(u16_value);
+        return ESP_FAIL;
+    }
 
-    #ifdef _DEBUG_LOG_
-        ESP_LOGI(TAG, "Got Iout: %2.3f A", iout);
-    #endif
+    *iout = slinear11_2_float(u16_value);
+
+#ifdef _DEBUG_LOG_
+    ESP_LOGI(TAG, "Got Iout: %2.3f A", *iout);
+#endif
 
-        return iout;
+    return ESP_OK;
 }
+
+float TPS546_get_iout(void)
+{
+    float iout;
+
+    if (TPS546_read_iout(&iout) != ESP_OK) {
+        return 0;
+    }
+    return iout;
 }
 
 float TPS546_get_vout(void)
@@ -78,6 +78,7 @@ void TPS546_set_frequency(int);
 int TPS546_get_temperature(void);
 float TPS546_get_vin(void);
 float TPS546_get_iout(void);
+int TPS546_read_iout(float *iout);
 float TPS546_get_vout(void);
 void TPS546_set_vout(float volts);
 void TPS546_show_voltage_settings(void);
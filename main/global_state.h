@@ -1,14 +1,18 @@
 #ifndef GLOBAL_STATE_H_
 #define GLOBAL_STATE_H_
 
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include "asic_hashrate.h"
+#include "asic_stats.h"
 #include "asic_task.h"
 #include "bm1370.h"
 #include "bm1368.h"
 #include "bm1366.h"
 #include "bm1397.h"
 #include "common.h"
+#include "freq_tuner.h"
 #include "power_management_task.h"
 #include "serial.h"
 #include "stratum_api.h"
@@ -17,7 +21,6 @@
 #define STRATUM_USER CONFIG_STRATUM_USER
 #define FALLBACK_STRATUM_USER CONFIG_FALLBACK_STRATUM_USER
 
-#define HISTORY_LENGTH 100
 #define DIFF_STRING_SIZE 10
 
 typedef enum
@@ -38,33 +41,85 @@ typedef enum
     ASIC_BM1370,
 } AsicModel;
 
+// every function takes the chain it talks to first
 typedef struct
 {
-    uint8_t (*init_fn)(uint64_t, uint16_t);
-    task_result * (*receive_result_fn)(void * GLOBAL_STATE);
-    int (*set_max_baud_fn)(void);
-    void (*set_difficulty_mask_fn)(int);
-    void (*send_work_fn)(void * GLOBAL_STATE, bm_job * next_bm_job);
-    void (*set_version_mask)(uint32_t);
+    uint8_t (*init_fn)(uint8_t, uint64_t, uint16_t);
+    task_result * (*receive_result_fn)(void * GLOBAL_STATE, uint8_t);
+    int (*set_max_baud_fn)(uint8_t);
+    // drops a chain whose link degraded to the next slower rate, -1 if the chips were lost on the way
+    int (*fall_back_baud_fn)(uint8_t);
+    void (*set_difficulty_mask_fn)(uint8_t, int);
+    void (*prepare_work_fn)(bm_job * next_bm_job);
+    void (*send_work_fn)(void * GLOBAL_STATE, uint8_t, bm_job * next_bm_job);
+    void (*set_version_mask)(uint8_t, uint32_t);
+    // NULL if the driver can only set the frequency of the whole chain
+    void (*set_chip_frequency_fn)(uint8_t, uint8_t, float);
+    // requests the hash counter register of every chip, the replies come back through receive_result_fn
+    void (*read_hash_counter_fn)(uint8_t);
+    // reads back every register written, drifted chips are logged and counted in the shadow
+    void (*verify_registers_fn)(uint8_t);
+    const AsicRegisterShadow * (*get_register_shadow_fn)(uint8_t);
 } AsicFunctions;
 
+// one chain of chips on its own UART, fed from the same pool work as the others
 typedef struct
 {
-    double duration_start;
-    int historical_hashrate_rolling_index;
-    double historical_hashrate_time_stamps[HISTORY_LENGTH];
-    double historical_hashrate[HISTORY_LENGTH];
-    int historical_hashrate_init;
+    uint8_t id;
+    // the GlobalState the chain belongs to, for the tasks that are started with the chain
+    void * global_state;
+    uint16_t detected_asic_count;
+    double asic_job_frequency_ms;
+    uint32_t ASIC_difficulty;
+
+    work_queue ASIC_jobs_queue;
+    AsicTaskModule ASIC_TASK_MODULE;
+    AsicStatsModule ASIC_STATS_MODULE;
+    FreqTuner FREQ_TUNER_MODULE;
+
+    // job ids are per chain, results are looked up in the tables of the chain that found them
+    uint8_t * valid_jobs;
+    bool ASIC_initalized;
+    // held by every task that programs the chips of the chain, so no frequency or mask write lands in a re-init
+    pthread_mutex_t chip_lock;
+} AsicChain;
+
+// found nonces by difficulty, bucket i counts those up to 256 * 4^i and the last one all above
+#define SYSTEM_DIFF_BUCKETS 16
+
+// what the screen and the API show, readers take a consistent copy with SYSTEM_get_stats
+typedef struct
+{
+    // the 10 minute estimate as of the last nonce
     double current_hashrate;
-    int64_t start_time;
     uint64_t shares_accepted;
     uint64_t shares_rejected;
-    int screen_page;
     uint64_t best_nonce_diff;
     char best_diff_string[DIFF_STRING_SIZE];
     uint64_t best_session_nonce_diff;
     char best_session_diff_string[DIFF_STRING_SIZE];
     bool FOUND_BLOCK;
+    uint32_t diff_buckets[SYSTEM_DIFF_BUCKETS];
+    double diff_sum;
+    // readings of the last power management pass
+    float power;
+    float voltage;
+    float current;
+    float chip_temp_avg;
+    float vr_temp;
+    uint16_t fan_perc;
+    uint16_t fan_rpm;
+} SystemStats;
+
+typedef struct
+{
+    // nonces of all chains over 1 min, 10 min, 1 h and 24 h, guarded by the found nonce lock of system.c
+    AsicHashrate hashrate;
+    // seqlock over stats, odd while a writer is inside, writers hold the found nonce lock
+    atomic_uint stats_sequence;
+    SystemStats stats;
+    int64_t start_time;
+    int screen_page;
     char ssid[32];
     char wifi_status[20];
     char ip_addr_str[16]; // IP4ADDR_STRLEN_MAX
@@ -95,18 +150,18 @@ typedef struct
     int board_version;
     AsicModel asic_model;
     char * asic_model_str;
+    // chips expected on every chain
     uint16_t asic_count;
     uint16_t voltage_domain;
     AsicFunctions ASIC_functions;
-    double asic_job_frequency_ms;
-    uint32_t ASIC_difficulty;
 
     work_queue stratum_queue;
-    work_queue ASIC_jobs_queue;
+
+    uint8_t chain_count;
+    AsicChain chains[ASIC_MAX_CHAINS];
 
     bm1397Module BM1397_MODULE;
     SystemModule SYSTEM_MODULE;
-    AsicTaskModule ASIC_TASK_MODULE;
     PowerManagementModule POWER_MANAGEMENT_MODULE;
     SelfTestModule SELF_TEST_MODULE;
 
@@ -114,7 +169,7 @@ typedef struct
     int extranonce_2_len;
     int abandon_work;
 
-    uint8_t * valid_jobs;
+    // guards valid_jobs of every chain
     pthread_mutex_t valid_jobs_lock;
 
     uint32_t stratum_difficulty;
@@ -122,7 +177,6 @@ typedef struct
     bool new_stratum_version_rolling_msg;
 
     int sock;
-    bool ASIC_initalized;
 } GlobalState;
 
 #endif /* GLOBAL_STATE_H_ */
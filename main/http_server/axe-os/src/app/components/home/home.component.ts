@@ -1,9 +1,10 @@
 import { Component } from '@angular/core';
-import { interval, map, Observable, shareReplay, startWith, switchMap, tap } from 'rxjs';
+import { catchError, interval, map, Observable, of, shareReplay, startWith, switchMap, tap } from 'rxjs';
 import { HashSuffixPipe } from 'src/app/pipes/hash-suffix.pipe';
 import { SystemService } from 'src/app/services/system.service';
 import { ThemeService } from 'src/app/services/theme.service';
 import { eASICModel } from 'src/models/enum/eASICModel';
+import { ISystemHistory } from 'src/models/ISystemHistory';
 import { ISystemInfo } from 'src/models/ISystemInfo';
 
 @Component({
@@ -195,8 +196,11 @@ export class HomeComponent {
     };
 
 
-    this.info$ = interval(5000).pipe(
-      startWith(() => this.systemService.getInfo()),
+    // the last hour comes from the history the device keeps, polling carries it on from there
+    this.info$ = this.systemService.getHistory(3600).pipe(
+      catchError(() => of(undefined)),
+      tap(history => this.seedChart(history)),
+      switchMap(() => interval(5000).pipe(startWith(0))),
       switchMap(() => {
         return this.systemService.getInfo()
       }),
@@ -255,6 +259,22 @@ export class HomeComponent {
 
   }
 
+  private seedChart(history: ISystemHistory | undefined) {
+    if (!history) {
+      return;
+    }
+
+    history.hashRate.forEach((hashRate, i) => {
+      const temp = history.temp[i];
+      if (hashRate === null || temp === null) {
+        return;
+      }
+      this.hashrateData.push(hashRate * 1000000000);
+      this.temperatureData.push(temp);
+      this.dataLabel.push((history.start + i * history.resolution) * 1000);
+    });
+  }
+
   private calculateAverage(data: number[]): number {
     if (data.length === 0) return 0;
     const sum = data.reduce((sum, value) => sum + value, 0);
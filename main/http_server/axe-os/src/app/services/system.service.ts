@@ -2,6 +2,7 @@ import { HttpClient, HttpEvent } from '@angular/common/http';
 import { Injectable } from '@angular/core';
 import { delay, Observable, of } from 'rxjs';
 import { eASICModel } from 'src/models/enum/eASICModel';
+import { ISystemHistory } from 'src/models/ISystemHistory';
 import { ISystemInfo } from 'src/models/ISystemInfo';
 
 import { environment } from '../../environments/environment';
@@ -27,6 +28,7 @@ export class SystemService {
           temp: 60,
           vrTemp: 45,
           hashRate: 475,
+          hashRateCounters: 481,
           bestDiff: "0",
           bestSessionDiff: "0",
           freeHeap: 200504,
@@ -69,6 +71,28 @@ export class SystemService {
     }
   }
 
+  public getHistory(rangeSeconds: number, uri: string = ''): Observable<ISystemHistory> {
+    if (environment.production) {
+      return this.httpClient.get(`${uri}/api/system/history?range=${rangeSeconds}`) as Observable<ISystemHistory>;
+    } else {
+      const samples = Math.floor(rangeSeconds / 10);
+      return of(
+        {
+          resolution: 10,
+          start: Math.floor(Date.now() / 1000) - samples * 10,
+          hashRate: Array.from({ length: samples }, () => 475 + Math.random() * 50),
+          power: Array(samples).fill(11.7),
+          temp: Array(samples).fill(60),
+          vrTemp: Array(samples).fill(45),
+          fanRpm: Array(samples).fill(4000),
+          sharesAccepted: Array(samples).fill(0),
+          sharesRejected: Array(samples).fill(0),
+          hwErrors: Array(samples).fill(0),
+        }
+      ).pipe(delay(1000));
+    }
+  }
+
   public restart(uri: string = '') {
     return this.httpClient.post(`${uri}/api/system/restart`, {}, {responseType: 'text'});
   }
@@ -0,0 +1,15 @@
+export interface ISystemHistory {
+
+    // seconds between samples and unix time of the first one
+    resolution: number,
+    start: number,
+    // one entry per sample, null where nothing was recorded
+    hashRate: (number | null)[],
+    power: (number | null)[],
+    temp: (number | null)[],
+    vrTemp: (number | null)[],
+    fanRpm: (number | null)[],
+    sharesAccepted: (number | null)[],
+    sharesRejected: (number | null)[],
+    hwErrors: (number | null)[],
+}
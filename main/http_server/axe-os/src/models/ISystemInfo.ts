@@ -10,6 +10,7 @@ export interface ISystemInfo {
     temp: number,
     vrTemp: number,
     hashRate: number,
+    hashRateCounters: number,
     bestDiff: string,
     bestSessionDiff: string,
     freeHeap: number,
@@ -14,10 +14,18 @@
 #include "freertos/event_groups.h"
 #include "freertos/task.h"
 #include "global_state.h"
+#include "history_task.h"
 #include "nvs_config.h"
+#include "serial.h"
+#include "system.h"
 #include "vcore.h"
 #include <fcntl.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <sys/param.h>
 
 #include "dns_server.h"
@@ -428,6 +436,15 @@ static esp_err_t PATCH_update_settings(httpd_req_t * req)
     if ((item = cJSON_GetObjectItem(root, "fanspeed")) != NULL) {
         nvs_config_set_u16(NVS_CONFIG_FAN_SPEED, item->valueint);
     }
+    if ((item = cJSON_GetObjectItem(root, "autotune")) != NULL) {
+        nvs_config_set_u16(NVS_CONFIG_AUTO_TUNE, item->valueint);
+    }
+    if ((item = cJSON_GetObjectItem(root, "autotuneMaxFrequency")) != NULL && item->valueint > 0) {
+        nvs_config_set_u16(NVS_CONFIG_AUTO_TUNE_MAX_FREQ, item->valueint);
+    }
+    if ((item = cJSON_GetObjectItem(root, "registerVerify")) != NULL) {
+        nvs_config_set_u16(NVS_CONFIG_REGISTER_VERIFY, item->valueint);
+    }
 
     cJSON_Delete(root);
     httpd_resp_send_chunk(req, NULL, 0);
@@ -491,15 +508,36 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     esp_wifi_get_mac(WIFI_IF_STA, mac);
     snprintf(formattedMac, 18, "%02X:%02X:%02X:%02X:%02X:%02X", mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 
+    SystemStats stats;
+    SYSTEM_get_stats(GLOBAL_STATE, &stats);
+
         cJSON * root = cJSON_CreateObject();
-    cJSON_AddNumberToObject(root, "power", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.power);
-    cJSON_AddNumberToObject(root, "voltage", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.voltage);
-    cJSON_AddNumberToObject(root, "current", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.current);
-    cJSON_AddNumberToObject(root, "temp", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.chip_temp_avg);
-    cJSON_AddNumberToObject(root, "vrTemp", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.vr_temp);
-    cJSON_AddNumberToObject(root, "hashRate", GLOBAL_STATE->SYSTEM_MODULE.current_hashrate);
-    cJSON_AddStringToObject(root, "bestDiff", GLOBAL_STATE->SYSTEM_MODULE.best_diff_string);
-    cJSON_AddStringToObject(root, "bestSessionDiff", GLOBAL_STATE->SYSTEM_MODULE.best_session_diff_string);
+    cJSON_AddNumberToObject(root, "power", stats.power);
+    cJSON_AddNumberToObject(root, "voltage", stats.voltage);
+    cJSON_AddNumberToObject(root, "current", stats.current);
+    cJSON_AddNumberToObject(root, "temp", stats.chip_temp_avg);
+    cJSON_AddNumberToObject(root, "vrTemp", stats.vr_temp);
+    AsicHashrateEstimate estimates[ASIC_HASHRATE_WINDOWS];
+    SYSTEM_hashrate_estimates(GLOBAL_STATE, estimates);
+    cJSON_AddNumberToObject(root, "hashRate", estimates[SYSTEM_HASHRATE_WINDOW].hashrate);
+    cJSON * windows = cJSON_AddArrayToObject(root, "hashRateWindows");
+    for (int i = 0; i < ASIC_HASHRATE_WINDOWS; i++) {
+        cJSON * window = cJSON_CreateObject();
+        cJSON_AddNumberToObject(window, "windowSeconds", estimates[i].window_s);
+        cJSON_AddNumberToObject(window, "seconds", estimates[i].seconds);
+        cJSON_AddNumberToObject(window, "nonces", estimates[i].nonces);
+        cJSON_AddNumberToObject(window, "hashRate", estimates[i].hashrate);
+        cJSON_AddNumberToObject(window, "hashRateLow", estimates[i].lower);
+        cJSON_AddNumberToObject(window, "hashRateHigh", estimates[i].upper);
+        cJSON_AddItemToArray(windows, window);
+    }
+    double counter_hashrate = 0;
+    for (int i = 0; i < GLOBAL_STATE->chain_count; i++) {
+        counter_hashrate += ASIC_stats_counter_hashrate(&GLOBAL_STATE->chains[i].ASIC_STATS_MODULE);
+    }
+    cJSON_AddNumberToObject(root, "hashRateCounters", counter_hashrate);
+    cJSON_AddStringToObject(root, "bestDiff", stats.best_diff_string);
+    cJSON_AddStringToObject(root, "bestSessionDiff", stats.best_session_diff_string);
     cJSON_AddNumberToObject(root, "stratumDiff", GLOBAL_STATE->stratum_difficulty);
 
     cJSON_AddNumberToObject(root, "isUsingFallbackStratum", GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback);
@@ -512,8 +550,8 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     cJSON_AddStringToObject(root, "macAddr", formattedMac);
     cJSON_AddStringToObject(root, "hostname", hostname);
     cJSON_AddStringToObject(root, "wifiStatus", GLOBAL_STATE->SYSTEM_MODULE.wifi_status);
-    cJSON_AddNumberToObject(root, "sharesAccepted", GLOBAL_STATE->SYSTEM_MODULE.shares_accepted);
-    cJSON_AddNumberToObject(root, "sharesRejected", GLOBAL_STATE->SYSTEM_MODULE.shares_rejected);
+    cJSON_AddNumberToObject(root, "sharesAccepted", stats.shares_accepted);
+    cJSON_AddNumberToObject(root, "sharesRejected", stats.shares_rejected);
     cJSON_AddNumberToObject(root, "uptimeSeconds", (esp_timer_get_time() - GLOBAL_STATE->SYSTEM_MODULE.start_time) / 1000000);
     cJSON_AddNumberToObject(root, "asicCount", GLOBAL_STATE->asic_count);
     uint16_t small_core_count = 0;
@@ -555,9 +593,11 @@ static esp_err_t GET_system_info(httpd_req_t * req)
 
     cJSON_AddNumberToObject(root, "invertfanpolarity", nvs_config_get_u16(NVS_CONFIG_INVERT_FAN_POLARITY, 1));
     cJSON_AddNumberToObject(root, "autofanspeed", nvs_config_get_u16(NVS_CONFIG_AUTO_FAN_SPEED, 1));
+    cJSON_AddNumberToObject(root, "autotune", nvs_config_get_u16(NVS_CONFIG_AUTO_TUNE, 0));
+    cJSON_AddNumberToObject(root, "registerVerify", nvs_config_get_u16(NVS_CONFIG_REGISTER_VERIFY, 0));
 
-    cJSON_AddNumberToObject(root, "fanspeed", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fan_perc);
-    cJSON_AddNumberToObject(root, "fanrpm", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.fan_rpm);
+    cJSON_AddNumberToObject(root, "fanspeed", stats.fan_perc);
+    cJSON_AddNumberToObject(root, "fanrpm", stats.fan_rpm);
 
     free(ssid);
     free(hostname);
@@ -574,6 +614,560 @@ static esp_err_t GET_system_info(httpd_req_t * req)
     return ESP_OK;
 }
 
+static int asic_core_count(void)
+{
+    switch (GLOBAL_STATE->asic_model) {
+        case ASIC_BM1366:
+            return BM1366_CORE_COUNT;
+        case ASIC_BM1368:
+            return BM1368_CORE_COUNT;
+        case ASIC_BM1370:
+            return BM1370_CORE_COUNT;
+        case ASIC_BM1397:
+        // core ids are not decoded for the BM1397
+        case ASIC_UNKNOWN:
+        default:
+            return 0;
+    }
+}
+
+/* Per chip, per core and per small core nonce statistics */
+static esp_err_t GET_system_asic(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    int core_count = MIN(asic_core_count(), ASIC_STATS_CORES);
+    uint32_t uptime_s = (uint32_t) ((now_us - GLOBAL_STATE->chains[0].ASIC_STATS_MODULE.start_us) / 1000000);
+
+    // totals over all chains, the chains and their chips follow
+    int chip_count = 0;
+    uint32_t unattributed = 0;
+    uint32_t duplicates = 0;
+    uint32_t recoveries = 0;
+    uint32_t failed_recoveries = 0;
+    uint32_t skipped_writes = 0;
+    uint32_t readbacks = 0;
+    const AsicWatchdog * last_recovered = NULL;
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        AsicChain * chain = &GLOBAL_STATE->chains[c];
+        const AsicWatchdog * watchdog = &chain->ASIC_TASK_MODULE.watchdog;
+        chip_count += chain->ASIC_STATS_MODULE.chip_count;
+        unattributed += chain->ASIC_STATS_MODULE.unattributed;
+        duplicates += chain->ASIC_TASK_MODULE.nonce_filter.duplicates;
+        recoveries += watchdog->recoveries;
+        failed_recoveries += watchdog->failed_recoveries;
+        if (watchdog->recoveries > 0 && (last_recovered == NULL || watchdog->last_recovery_us > last_recovered->last_recovery_us)) {
+            last_recovered = watchdog;
+        }
+        if (GLOBAL_STATE->ASIC_functions.get_register_shadow_fn != NULL) {
+            uint32_t chain_skipped_writes, chain_readbacks;
+            ASIC_registers_counters(GLOBAL_STATE->ASIC_functions.get_register_shadow_fn(chain->id), &chain_skipped_writes, &chain_readbacks);
+            skipped_writes += chain_skipped_writes;
+            readbacks += chain_readbacks;
+        }
+    }
+
+    cJSON * root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "ASICModel", GLOBAL_STATE->asic_model_str);
+    cJSON_AddNumberToObject(root, "chainCount", GLOBAL_STATE->chain_count);
+    cJSON_AddNumberToObject(root, "asicCount", chip_count);
+    cJSON_AddNumberToObject(root, "coreCount", core_count);
+    cJSON_AddNumberToObject(root, "statsSeconds", uptime_s);
+    cJSON_AddNumberToObject(root, "unattributedNonces", unattributed);
+    cJSON_AddNumberToObject(root, "duplicateNonces", duplicates);
+    cJSON_AddNumberToObject(root, "ticketDifficulty", GLOBAL_STATE->chains[0].ASIC_difficulty);
+
+    cJSON_AddNumberToObject(root, "chainRecoveries", recoveries);
+    cJSON_AddNumberToObject(root, "failedChainRecoveries", failed_recoveries);
+    cJSON_AddNumberToObject(root, "lastRecoverySeconds", last_recovered != NULL ? (now_us - last_recovered->last_recovery_us) / 1000000 : -1);
+    cJSON_AddNumberToObject(root, "lastRecoveryMs", last_recovered != NULL ? last_recovered->last_recovery_duration_us / 1000 : 0);
+    cJSON_AddNumberToObject(root, "lastStallSeconds", last_recovered != NULL ? last_recovered->last_stall_us / 1000000 : 0);
+
+    if (GLOBAL_STATE->ASIC_functions.get_register_shadow_fn != NULL) {
+        cJSON_AddNumberToObject(root, "skippedRegisterWrites", skipped_writes);
+        cJSON_AddNumberToObject(root, "registerReadbacks", readbacks);
+    }
+
+    cJSON * chains = cJSON_AddArrayToObject(root, "chains");
+    cJSON * asics = cJSON_AddArrayToObject(root, "asics");
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        AsicChain * chain_state = &GLOBAL_STATE->chains[c];
+        AsicStatsModule * stats = &chain_state->ASIC_STATS_MODULE;
+        const AsicWatchdog * watchdog = &chain_state->ASIC_TASK_MODULE.watchdog;
+        // core timestamps count from the start of the stats of their own chain
+        uint32_t chain_uptime_s = (uint32_t) ((now_us - stats->start_us) / 1000000);
+
+        cJSON * chain = cJSON_CreateObject();
+        cJSON_AddNumberToObject(chain, "id", c);
+        cJSON_AddNumberToObject(chain, "asicCount", stats->chip_count);
+        cJSON_AddNumberToObject(chain, "ticketDifficulty", chain_state->ASIC_difficulty);
+        cJSON_AddNumberToObject(chain, "jobIntervalMs", chain_state->asic_job_frequency_ms);
+        cJSON_AddNumberToObject(chain, "counterHashRate", ASIC_stats_counter_hashrate(stats));
+        cJSON_AddNumberToObject(chain, "chainRecoveries", watchdog->recoveries);
+        cJSON_AddNumberToObject(chain, "failedChainRecoveries", watchdog->failed_recoveries);
+        cJSON_AddNumberToObject(chain, "duplicateNonces", chain_state->ASIC_TASK_MODULE.nonce_filter.duplicates);
+        const AsicLink * link = SERIAL_link(chain_state->id);
+        cJSON_AddNumberToObject(chain, "baud", ASIC_link_baud(link));
+        cJSON_AddBoolToObject(chain, "linkCrcChecked", link->crc_checked);
+        cJSON_AddNumberToObject(chain, "linkFrames", link->stats.frames);
+        cJSON_AddNumberToObject(chain, "linkCrcErrors", link->stats.crc_errors);
+        cJSON_AddNumberToObject(chain, "linkDroppedBytes", link->stats.dropped_bytes);
+        cJSON_AddNumberToObject(chain, "linkResyncs", link->stats.resyncs);
+        cJSON_AddNumberToObject(chain, "linkFallbacks", link->stats.fallbacks);
+        cJSON_AddItemToArray(chains, chain);
+
+        const AsicRegisterShadow * shadow = NULL;
+        if (GLOBAL_STATE->ASIC_functions.get_register_shadow_fn != NULL) {
+            shadow = GLOBAL_STATE->ASIC_functions.get_register_shadow_fn(chain_state->id);
+        }
+
+        for (int i = 0; i < stats->chip_count; i++) {
+            AsicChipStats * chip = &stats->chips[i];
+            cJSON * asic = cJSON_CreateObject();
+
+            cJSON_AddNumberToObject(asic, "id", i);
+            cJSON_AddNumberToObject(asic, "chain", c);
+            cJSON_AddNumberToObject(asic, "nonces", chip->nonces);
+            cJSON_AddNumberToObject(asic, "hashRate", ASIC_stats_chip_hashrate(stats, i, now_us));
+            cJSON_AddNumberToObject(asic, "counterHashRate", chip->counter_hashrate);
+            cJSON_AddNumberToObject(asic, "lastSeenSeconds", chip->nonces > 0 ? (now_us - chip->last_seen_us) / 1000000 : -1);
+            cJSON_AddNumberToObject(asic, "hwErrors", chip->hw_errors);
+            cJSON_AddNumberToObject(asic, "invalidJobs", chip->invalid_jobs);
+            cJSON_AddNumberToObject(asic, "hwErrorRate", ASIC_stats_chip_error_rate(stats, i, now_us));
+            uint32_t drift_events;
+            bool drifted;
+            if (shadow != NULL && ASIC_registers_chip_drift(shadow, i, &drift_events, &drifted)) {
+                cJSON_AddNumberToObject(asic, "registerDrifts", drift_events);
+                cJSON_AddBoolToObject(asic, "registersDrifted", drifted);
+            }
+            // 0 while the tuner is off, the chip runs at the chain frequency
+            if (i < chain_state->FREQ_TUNER_MODULE.chip_count && chain_state->FREQ_TUNER_MODULE.chips[i].frequency > 0) {
+                cJSON_AddNumberToObject(asic, "frequency", chain_state->FREQ_TUNER_MODULE.chips[i].frequency);
+            }
+
+            int small_core_count = 0;
+            for (int j = 0; j < ASIC_STATS_SMALL_CORES; j++) {
+                if (chip->small_core_nonces[j] > 0) small_core_count = j + 1;
+            }
+            cJSON_AddItemToObject(asic, "smallCoreNonces", cJSON_CreateIntArray((const int *) chip->small_core_nonces, small_core_count));
+
+            cJSON * core_nonces = cJSON_AddArrayToObject(asic, "coreNonces");
+            cJSON * core_last_seen = cJSON_AddArrayToObject(asic, "coreLastSeenSeconds");
+            int silent_cores = 0;
+            for (int j = 0; j < core_count; j++) {
+                AsicCoreStats * core = &chip->cores[j];
+                cJSON_AddItemToArray(core_nonces, cJSON_CreateNumber(core->nonces));
+                cJSON_AddItemToArray(core_last_seen, cJSON_CreateNumber(core->last_seen_s > 0 ? (int) chain_uptime_s - (int) (core->last_seen_s - 1) : -1));
+                if (core->nonces == 0) silent_cores++;
+            }
+            cJSON_AddNumberToObject(asic, "silentCores", silent_cores);
+
+            cJSON_AddItemToArray(asics, asic);
+        }
+    }
+
+    const char * asic_info = cJSON_PrintUnformatted(root);
+    httpd_resp_sendstr(req, asic_info);
+    free((char *)asic_info);
+    cJSON_Delete(root);
+    return ESP_OK;
+}
+
+// samples copied out of the history at a time, small enough for the stack of the server task
+#define HISTORY_READ_BLOCK 32
+
+typedef enum
+{
+    HISTORY_HASHRATE,
+    HISTORY_POWER,
+    HISTORY_TEMP,
+    HISTORY_VR_TEMP,
+    HISTORY_FAN_RPM,
+    HISTORY_SHARES_ACCEPTED,
+    HISTORY_SHARES_REJECTED,
+    HISTORY_HW_ERRORS,
+    HISTORY_SERIES,
+} history_series_t;
+
+static const char * history_series_names[HISTORY_SERIES] = {
+    "hashRate", "power", "temp", "vrTemp", "fanRpm", "sharesAccepted", "sharesRejected", "hwErrors",
+};
+
+static int history_format(char * buf, size_t size, history_series_t series, const AsicHistorySample * sample)
+{
+    float gauge;
+
+    if (sample->records == 0) {
+        return snprintf(buf, size, "null");
+    }
+
+    switch (series) {
+        case HISTORY_HASHRATE:
+            gauge = sample->hashrate;
+            break;
+        case HISTORY_POWER:
+            gauge = sample->power;
+            break;
+        case HISTORY_TEMP:
+            gauge = sample->chip_temp;
+            break;
+        case HISTORY_VR_TEMP:
+            gauge = sample->vr_temp;
+            break;
+        case HISTORY_FAN_RPM:
+            return snprintf(buf, size, "%u", sample->fan_rpm);
+        case HISTORY_SHARES_ACCEPTED:
+            return snprintf(buf, size, "%u", sample->shares_accepted);
+        case HISTORY_SHARES_REJECTED:
+            return snprintf(buf, size, "%u", sample->shares_rejected);
+        case HISTORY_HW_ERRORS:
+        default:
+            return snprintf(buf, size, "%u", sample->hw_errors);
+    }
+
+    // a reading that failed is no number JSON can hold
+    if (!isfinite(gauge)) {
+        return snprintf(buf, size, "null");
+    }
+    return snprintf(buf, size, "%.2f", gauge);
+}
+
+/// @brief sends what is buffered once the next value might not fit, every value with its separators is shorter than 32
+static esp_err_t history_reserve(httpd_req_t * req, char * buf, size_t size, int * len)
+{
+    if (*len <= (int) size - 32) {
+        return ESP_OK;
+    }
+    if (httpd_resp_send_chunk(req, buf, *len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    *len = 0;
+    return ESP_OK;
+}
+
+static uint32_t query_u32(const char * query, const char * key, uint32_t default_value)
+{
+    char value[12];
+
+    if (query == NULL || httpd_query_key_value(query, key, value, sizeof(value)) != ESP_OK) {
+        return default_value;
+    }
+    return strtoul(value, NULL, 10);
+}
+
+/* Stored history as one array per series, ?range=<seconds back, 3600 by default>&resolution=<seconds, finest by default> */
+static esp_err_t GET_system_history(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    char query[64];
+    bool has_query = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK;
+    uint32_t range_s = query_u32(has_query ? query : NULL, "range", 3600);
+    uint32_t resolution_s = query_u32(has_query ? query : NULL, "resolution", 0);
+
+    int tier;
+    uint32_t period_s, count;
+    int64_t first_period;
+    if (!HISTORY_range(resolution_s, range_s > 0 ? range_s : 1, &tier, &period_s, &first_period, &count)) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No history is kept");
+    }
+
+    // samples are numbered in periods of uptime, the first one starts this long ago
+    int64_t age_s = esp_timer_get_time() / 1000000 - first_period * period_s;
+    char buf[512];
+    int len = snprintf(buf, sizeof(buf), "{\"resolution\":%" PRIu32 ",\"start\":%lld", period_s, (long long) (time(NULL) - age_s));
+
+    AsicHistorySample samples[HISTORY_READ_BLOCK];
+    for (int series = 0; series < HISTORY_SERIES; series++) {
+        if (history_reserve(req, buf, sizeof(buf), &len) != ESP_OK) {
+            return ESP_FAIL;
+        }
+        len += snprintf(buf + len, sizeof(buf) - len, ",\"%s\":[", history_series_names[series]);
+
+        for (uint32_t i = 0; i < count; i += HISTORY_READ_BLOCK) {
+            uint32_t block = MIN(count - i, HISTORY_READ_BLOCK);
+            HISTORY_read(tier, first_period + i, block, samples);
+
+            for (uint32_t j = 0; j < block; j++) {
+                if (history_reserve(req, buf, sizeof(buf), &len) != ESP_OK) {
+                    return ESP_FAIL;
+                }
+                if (i + j > 0) {
+                    buf[len++] = ',';
+                }
+                len += history_format(buf + len, sizeof(buf) - len, series, &samples[j]);
+            }
+        }
+        buf[len++] = ']';
+    }
+    buf[len++] = '}';
+
+    if (httpd_resp_send_chunk(req, buf, len) != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// reused by every streamed response, the server runs one handler at a time
+static char chunk_buf[1024];
+
+typedef struct
+{
+    httpd_req_t * req;
+    int len;
+    esp_err_t err;
+} ChunkWriter;
+
+/// @brief appends to the chunk buffer, sending it first when the line does not fit anymore
+static void __attribute__((format(printf, 2, 3))) chunk_printf(ChunkWriter * writer, const char * format, ...)
+{
+    va_list args;
+
+    while (writer->err == ESP_OK) {
+        va_start(args, format);
+        int written = vsnprintf(chunk_buf + writer->len, sizeof(chunk_buf) - writer->len, format, args);
+        va_end(args);
+
+        if (written < (int) sizeof(chunk_buf) - writer->len) {
+            writer->len += written;
+            return;
+        }
+        // a line longer than the whole buffer is never written
+        if (writer->len == 0) {
+            writer->err = ESP_ERR_NO_MEM;
+            return;
+        }
+        writer->err = httpd_resp_send_chunk(writer->req, chunk_buf, writer->len);
+        writer->len = 0;
+    }
+}
+
+static void metrics_header(ChunkWriter * writer, const char * name, const char * type, const char * help)
+{
+    chunk_printf(writer, "# HELP axeos_%s %s\n# TYPE axeos_%s %s\n", name, help, name, type);
+}
+
+static void metrics_gauge(ChunkWriter * writer, const char * name, const char * help, double value)
+{
+    metrics_header(writer, name, "gauge", help);
+    chunk_printf(writer, "axeos_%s %.3f\n", name, value);
+}
+
+static void metrics_counter(ChunkWriter * writer, const char * name, const char * help, uint64_t value)
+{
+    metrics_header(writer, name, "counter", help);
+    chunk_printf(writer, "axeos_%s %" PRIu64 "\n", name, value);
+}
+
+/* Prometheus text format, rendered from the stats snapshot without allocating */
+static esp_err_t GET_metrics(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    SystemStats stats;
+    AsicHashrateEstimate estimates[ASIC_HASHRATE_WINDOWS];
+    SYSTEM_get_stats(GLOBAL_STATE, &stats);
+    SYSTEM_hashrate_estimates(GLOBAL_STATE, estimates);
+
+    ChunkWriter writer = {.req = req, .len = 0, .err = ESP_OK};
+    ChunkWriter * w = &writer;
+
+    metrics_gauge(w, "uptime_seconds", "Seconds since boot.", (esp_timer_get_time() - GLOBAL_STATE->SYSTEM_MODULE.start_time) / 1e6);
+    metrics_gauge(w, "free_heap_bytes", "Free heap.", esp_get_free_heap_size());
+
+    metrics_header(w, "hashrate_ghs", "gauge", "Hashrate from found nonces over a window, with its 95% bounds.");
+    for (int i = 0; i < ASIC_HASHRATE_WINDOWS; i++) {
+        chunk_printf(w, "axeos_hashrate_ghs{window=\"%" PRIu32 "\",bound=\"estimate\"} %.3f\n", estimates[i].window_s, estimates[i].hashrate);
+        chunk_printf(w, "axeos_hashrate_ghs{window=\"%" PRIu32 "\",bound=\"lower\"} %.3f\n", estimates[i].window_s, estimates[i].lower);
+        chunk_printf(w, "axeos_hashrate_ghs{window=\"%" PRIu32 "\",bound=\"upper\"} %.3f\n", estimates[i].window_s, estimates[i].upper);
+    }
+
+    metrics_counter(w, "shares_accepted_total", "Shares the pool accepted.", stats.shares_accepted);
+    metrics_counter(w, "shares_rejected_total", "Shares the pool rejected.", stats.shares_rejected);
+    metrics_gauge(w, "best_difficulty", "Best difficulty found, kept across reboots.", stats.best_nonce_diff);
+    metrics_gauge(w, "best_session_difficulty", "Best difficulty found since boot.", stats.best_session_nonce_diff);
+    metrics_gauge(w, "block_found", "1 once a nonce met the network difficulty.", stats.FOUND_BLOCK);
+
+    metrics_header(w, "nonce_difficulty", "histogram", "Difficulty of the nonces found since boot.");
+    uint64_t cumulative = 0;
+    for (int i = 0; i < SYSTEM_DIFF_BUCKETS; i++) {
+        cumulative += stats.diff_buckets[i];
+        if (i < SYSTEM_DIFF_BUCKETS - 1) {
+            chunk_printf(w, "axeos_nonce_difficulty_bucket{le=\"%.0f\"} %" PRIu64 "\n", SYSTEM_diff_bucket_bound(i), cumulative);
+        } else {
+            chunk_printf(w, "axeos_nonce_difficulty_bucket{le=\"+Inf\"} %" PRIu64 "\n", cumulative);
+        }
+    }
+    chunk_printf(w, "axeos_nonce_difficulty_sum %.0f\naxeos_nonce_difficulty_count %" PRIu64 "\n", stats.diff_sum, cumulative);
+
+    metrics_gauge(w, "power_watts", "Input power.", stats.power);
+    metrics_gauge(w, "input_voltage_millivolts", "Input voltage.", stats.voltage);
+    metrics_gauge(w, "input_current_milliamps", "Input current.", stats.current);
+    metrics_gauge(w, "chip_temperature_celsius", "Average chip temperature.", stats.chip_temp_avg);
+    metrics_gauge(w, "vr_temperature_celsius", "Voltage regulator temperature.", stats.vr_temp);
+    metrics_gauge(w, "fan_speed_percent", "Fan duty.", stats.fan_perc);
+    metrics_gauge(w, "fan_rpm", "Fan speed.", stats.fan_rpm);
+    metrics_gauge(w, "frequency_mhz", "ASIC frequency.", GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value);
+
+    // per chain and per chip, the counters are read while the result tasks update them
+    metrics_header(w, "chain_ticket_difficulty", "gauge", "Difficulty of the ticket mask.");
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        chunk_printf(w, "axeos_chain_ticket_difficulty{chain=\"%d\"} %" PRIu32 "\n", c, GLOBAL_STATE->chains[c].ASIC_difficulty);
+    }
+    metrics_header(w, "chain_duplicate_nonces_total", "counter", "Results dropped as repeats.");
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        chunk_printf(w, "axeos_chain_duplicate_nonces_total{chain=\"%d\"} %" PRIu32 "\n", c, GLOBAL_STATE->chains[c].ASIC_TASK_MODULE.nonce_filter.duplicates);
+    }
+    metrics_header(w, "chain_recoveries_total", "counter", "Chain resets by the watchdog.");
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        chunk_printf(w, "axeos_chain_recoveries_total{chain=\"%d\"} %" PRIu32 "\n", c, GLOBAL_STATE->chains[c].ASIC_TASK_MODULE.watchdog.recoveries);
+    }
+    metrics_header(w, "chain_link_frames_total", "counter", "Reply frames received.");
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        chunk_printf(w, "axeos_chain_link_frames_total{chain=\"%d\"} %" PRIu32 "\n", c, SERIAL_link(GLOBAL_STATE->chains[c].id)->stats.frames);
+    }
+    metrics_header(w, "chain_link_crc_errors_total", "counter", "Reply frames dropped for a bad crc.");
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        chunk_printf(w, "axeos_chain_link_crc_errors_total{chain=\"%d\"} %" PRIu32 "\n", c, SERIAL_link(GLOBAL_STATE->chains[c].id)->stats.crc_errors);
+    }
+    metrics_header(w, "chain_link_baud", "gauge", "Current UART rate.");
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        chunk_printf(w, "axeos_chain_link_baud{chain=\"%d\"} %d\n", c, ASIC_link_baud(SERIAL_link(GLOBAL_STATE->chains[c].id)));
+    }
+
+    metrics_header(w, "asic_nonces_total", "counter", "Nonces found by a chip.");
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        AsicStatsModule * chain_stats = &GLOBAL_STATE->chains[c].ASIC_STATS_MODULE;
+        for (int i = 0; i < chain_stats->chip_count; i++) {
+            chunk_printf(w, "axeos_asic_nonces_total{chain=\"%d\",asic=\"%d\"} %" PRIu32 "\n", c, i, chain_stats->chips[i].nonces);
+        }
+    }
+    metrics_header(w, "asic_hw_errors_total", "counter", "Nonces of a chip that did not meet their target.");
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        AsicStatsModule * chain_stats = &GLOBAL_STATE->chains[c].ASIC_STATS_MODULE;
+        for (int i = 0; i < chain_stats->chip_count; i++) {
+            chunk_printf(w, "axeos_asic_hw_errors_total{chain=\"%d\",asic=\"%d\"} %" PRIu32 "\n", c, i, chain_stats->chips[i].hw_errors);
+        }
+    }
+
+    if (writer.err == ESP_OK && writer.len > 0) {
+        writer.err = httpd_resp_send_chunk(req, chunk_buf, writer.len);
+    }
+    if (writer.err != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// share log entries copied out at a time, small enough for the stack of the server task
+#define SHARES_READ_BLOCK 8
+
+static const char * share_status_names[] = {"pending", "accepted", "rejected", "unanswered"};
+
+/// @brief appends a string the pool sent as a JSON string
+static void chunk_json_string(ChunkWriter * writer, const char * value)
+{
+    chunk_printf(writer, "\"");
+    for (const char * c = value; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            chunk_printf(writer, "\\%c", *c);
+        } else if ((unsigned char) *c < 0x20) {
+            chunk_printf(writer, "\\u%04x", *c);
+        } else {
+            chunk_printf(writer, "%c", *c);
+        }
+    }
+    chunk_printf(writer, "\"");
+}
+
+/* Logged shares, ?since=<cursor of the previous answer> only returns the ones submitted or answered since */
+static esp_err_t GET_system_shares(httpd_req_t * req)
+{
+    if (is_network_allowed(req) != ESP_OK) {
+        return httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, "Unauthorized");
+    }
+
+    httpd_resp_set_type(req, "application/json");
+
+    // Set CORS headers
+    if (set_cors_headers(req) != ESP_OK) {
+        httpd_resp_send_500(req);
+        return ESP_OK;
+    }
+
+    char query[32];
+    bool has_query = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK;
+    uint32_t since = query_u32(has_query ? query : NULL, "since", 0);
+
+    ShareLogEntry shares[SHARES_READ_BLOCK];
+    uint32_t cursor, version;
+    int count = SYSTEM_shares_since(since, 0, shares, SHARES_READ_BLOCK, &cursor);
+    if (count < 0) {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No share log is kept");
+    }
+
+    ChunkWriter writer = {.req = req, .len = 0, .err = ESP_OK};
+    ChunkWriter * w = &writer;
+    bool first = true;
+
+    chunk_printf(w, "{\"shares\":[");
+    while (count > 0 && writer.err == ESP_OK) {
+        for (int i = 0; i < count; i++) {
+            ShareLogEntry * share = &shares[i];
+            chunk_printf(w, "%s{\"id\":%" PRIu32 ",\"time\":%" PRIu32 ",\"jobId\":", first ? "" : ",", share->id, share->time);
+            chunk_json_string(w, share->job_id);
+            chunk_printf(w, ",\"chain\":%u,\"asic\":%u,\"nonceDiff\":%.1f,\"poolDiff\":%" PRIu32 ",\"pool\":\"%s\",\"status\":\"%s\"",
+                         share->chain, share->chip, share->nonce_diff, share->pool_diff, share->pool ? "fallback" : "primary",
+                         share_status_names[share->status]);
+            if (share->status == SHARE_ACCEPTED || share->status == SHARE_REJECTED) {
+                chunk_printf(w, ",\"latencyMs\":%.1f", share->latency_us / 1000.0);
+            }
+            if (share->status == SHARE_REJECTED) {
+                chunk_printf(w, ",\"reason\":");
+                chunk_json_string(w, share->reason);
+            }
+            chunk_printf(w, "}");
+            first = false;
+        }
+        // the cursor is the version of the first copy, a share changed while streaming is sent again next time
+        count = count < SHARES_READ_BLOCK ? 0 : SYSTEM_shares_since(since, shares[count - 1].id, shares, SHARES_READ_BLOCK, &version);
+    }
+    chunk_printf(w, "],\"cursor\":%" PRIu32 "}", cursor);
+
+    if (writer.err == ESP_OK && writer.len > 0) {
+        writer.err = httpd_resp_send_chunk(req, chunk_buf, writer.len);
+    }
+    if (writer.err != ESP_OK) {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
 esp_err_t POST_WWW_update(httpd_req_t * req)
 {
     if (is_network_allowed(req) != ESP_OK) {
@@ -829,7 +1423,7 @@ esp_err_t start_rest_server(void * pvParameters)
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.uri_match_fn = httpd_uri_match_wildcard;
     config.max_open_sockets = 10;
-    config.max_uri_handlers = 20;
+    config.max_uri_handlers = 30;
 
     ESP_LOGI(TAG, "Starting HTTP Server");
     REST_CHECK(httpd_start(&server, &config) == ESP_OK, "Start server failed", err_start);
@@ -854,6 +1448,38 @@ esp_err_t start_rest_server(void * pvParameters)
     };
     httpd_register_uri_handler(server, &system_info_get_uri);
 
+    httpd_uri_t system_asic_get_uri = {
+        .uri = "/api/system/asic",
+        .method = HTTP_GET,
+        .handler = GET_system_asic,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_asic_get_uri);
+
+    httpd_uri_t system_history_get_uri = {
+        .uri = "/api/system/history",
+        .method = HTTP_GET,
+        .handler = GET_system_history,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_history_get_uri);
+
+    httpd_uri_t system_shares_get_uri = {
+        .uri = "/api/system/shares",
+        .method = HTTP_GET,
+        .handler = GET_system_shares,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &system_shares_get_uri);
+
+    httpd_uri_t metrics_get_uri = {
+        .uri = "/metrics",
+        .method = HTTP_GET,
+        .handler = GET_metrics,
+        .user_ctx = rest_context
+    };
+    httpd_register_uri_handler(server, &metrics_get_uri);
+
     httpd_uri_t swarm_options_uri = {
         .uri = "/api/swarm",
         .method = HTTP_OPTIONS,
@@ -1,6 +1,7 @@
 
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 
 // #include "protocol_examples_common.h"
@@ -9,10 +10,13 @@
 #include "asic_result_task.h"
 #include "asic_task.h"
 #include "create_jobs_task.h"
+#include "freq_tuner_task.h"
+#include "history_task.h"
 #include "esp_netif.h"
 #include "system.h"
 #include "http_server.h"
 #include "nvs_config.h"
+#include "persist.h"
 #include "serial.h"
 #include "stratum_task.h"
 #include "i2c_bitaxe.h"
@@ -25,7 +29,7 @@ static GlobalState GLOBAL_STATE = {
     .extranonce_2_len = 0, 
     .abandon_work = 0, 
     .version_mask = 0,
-    .ASIC_initalized = false
+    .chain_count = ASIC_MAX_CHAINS
 };
 
 static const char * TAG = "bitaxe";
@@ -50,6 +54,9 @@ void app_main(void)
         return;
     }
 
+    // the persisted counters are loaded once, the self test already checks the best diff
+    PERSIST_init();
+
     //parse the NVS config into GLOBAL_STATE
     if (NVSDevice_parse_config(&GLOBAL_STATE) != ESP_OK) {
         ESP_LOGE(TAG, "Failed to parse NVS config");
@@ -65,6 +72,7 @@ void app_main(void)
     }
 
     SYSTEM_init_system(&GLOBAL_STATE);
+    xTaskCreate(PERSIST_task, "persist", 4096, NULL, 2, NULL);
 
     // pull the wifi credentials and hostname out of NVS
     char * wifi_ssid = nvs_config_get_string(NVS_CONFIG_WIFI_SSID, WIFI_SSID);
@@ -83,6 +91,7 @@ void app_main(void)
     SYSTEM_init_peripherals(&GLOBAL_STATE);
 
     xTaskCreate(POWER_MANAGEMENT_task, "power management", 8192, (void *) &GLOBAL_STATE, 10, NULL);
+    xTaskCreate(HISTORY_task, "history", 4096, (void *) &GLOBAL_STATE, 3, NULL);
 
     //start the API for AxeOS
     start_rest_server((void *) &GLOBAL_STATE);
@@ -120,19 +129,33 @@ void app_main(void)
         wifi_softap_off();
 
         queue_init(&GLOBAL_STATE.stratum_queue);
-        queue_init(&GLOBAL_STATE.ASIC_jobs_queue);
-
-        SERIAL_init();
-        (*GLOBAL_STATE.ASIC_functions.init_fn)(GLOBAL_STATE.POWER_MANAGEMENT_MODULE.frequency_value, GLOBAL_STATE.asic_count);
-        SERIAL_set_baud((*GLOBAL_STATE.ASIC_functions.set_max_baud_fn)());
-        SERIAL_clear_buffer();
 
-        GLOBAL_STATE.ASIC_initalized = true;
+        for (int i = 0; i < GLOBAL_STATE.chain_count; i++) {
+            AsicChain * chain = &GLOBAL_STATE.chains[i];
+            chain->id = i;
+            chain->global_state = &GLOBAL_STATE;
+            queue_init(&chain->ASIC_jobs_queue);
+            pthread_mutex_init(&chain->chip_lock, NULL);
+
+            SERIAL_init(chain->id);
+            chain->detected_asic_count = (*GLOBAL_STATE.ASIC_functions.init_fn)(chain->id, GLOBAL_STATE.POWER_MANAGEMENT_MODULE.frequency_value, GLOBAL_STATE.asic_count);
+            ASIC_stats_init(&chain->ASIC_STATS_MODULE,
+                            chain->detected_asic_count > 0 ? chain->detected_asic_count : GLOBAL_STATE.asic_count,
+                            esp_timer_get_time());
+            SERIAL_set_baud(chain->id, (*GLOBAL_STATE.ASIC_functions.set_max_baud_fn)(chain->id));
+            SERIAL_clear_buffer(chain->id);
+
+            chain->ASIC_initalized = true;
+        }
+        ASIC_task_update_job_interval(&GLOBAL_STATE);
 
         xTaskCreate(stratum_task, "stratum admin", 8192, (void *) &GLOBAL_STATE, 5, NULL);
         xTaskCreate(create_jobs_task, "stratum miner", 8192, (void *) &GLOBAL_STATE, 10, NULL);
-        xTaskCreate(ASIC_task, "asic", 8192, (void *) &GLOBAL_STATE, 10, NULL);
-        xTaskCreate(ASIC_result_task, "asic result", 8192, (void *) &GLOBAL_STATE, 15, NULL);
+        for (int i = 0; i < GLOBAL_STATE.chain_count; i++) {
+            xTaskCreate(ASIC_task, "asic", 8192, (void *) &GLOBAL_STATE.chains[i], 10, NULL);
+            xTaskCreate(ASIC_result_task, "asic result", 8192, (void *) &GLOBAL_STATE.chains[i], 15, NULL);
+        }
+        xTaskCreate(FREQ_TUNER_task, "freq tuner", 4096, (void *) &GLOBAL_STATE, 5, NULL);
     }
 }
 
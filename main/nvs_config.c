@@ -1,134 +1,362 @@
 #include "nvs_config.h"
 #include "esp_log.h"
 #include "nvs.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 #define NVS_CONFIG_NAMESPACE "main"
 
+// every key of the namespace is held in RAM, there are about 35 of them
+#define NVS_CONFIG_MAX_ENTRIES 48
+#define NVS_CONFIG_MAX_SUBSCRIBERS 8
+
 static const char * TAG = "nvs_config";
 
-char * nvs_config_get_string(const char * key, const char * default_value)
+typedef struct
 {
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return strdup(default_value);
-    }
+    char key[NVS_KEY_NAME_MAX_SIZE];
+    nvs_type_t type;
+    union
+    {
+        uint16_t u16;
+        uint64_t u64;
+        char * str;
+    } value;
+} NvsConfigEntry;
 
-    size_t size = 0;
-    err = nvs_get_str(handle, key, NULL, &size);
+typedef struct
+{
+    // NULL for every key
+    const char * key;
+    nvs_config_callback_t callback;
+    void * ctx;
+} NvsConfigSubscriber;
 
-    if (err != ESP_OK) {
-        nvs_close(handle);
-        return strdup(default_value);
-    }
+// reads only copy out of the cache, held for the copy and never across a flash access after the first load
+static pthread_mutex_t config_lock = PTHREAD_MUTEX_INITIALIZER;
+// one setter writes the flash at a time, the cache is swapped under config_lock once the write went through
+static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool loaded = false;
+static NvsConfigEntry entries[NVS_CONFIG_MAX_ENTRIES];
+static int entry_count = 0;
+static NvsConfigSubscriber subscribers[NVS_CONFIG_MAX_SUBSCRIBERS];
+static int subscriber_count = 0;
 
-    char * out = malloc(size);
-    err = nvs_get_str(handle, key, out, &size);
+static NvsConfigEntry * _find(const char * key)
+{
+    for (int i = 0; i < entry_count; i++) {
+        if (strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
 
-    if (err != ESP_OK) {
-        free(out);
-        nvs_close(handle);
-        return strdup(default_value);
+static NvsConfigEntry * _add(const char * key, nvs_type_t type)
+{
+    if (entry_count == NVS_CONFIG_MAX_ENTRIES) {
+        ESP_LOGE(TAG, "Config cache full, %s is not kept", key);
+        return NULL;
     }
 
-    nvs_close(handle);
-    return out;
+    NvsConfigEntry * entry = &entries[entry_count++];
+    strncpy(entry->key, key, sizeof(entry->key) - 1);
+    entry->key[sizeof(entry->key) - 1] = 0;
+    entry->type = type;
+    entry->value.str = NULL;
+    return entry;
 }
 
-void nvs_config_set_string(const char * key, const char * value)
+static void _load_entry(nvs_handle handle, const nvs_entry_info_t * info)
 {
+    NvsConfigEntry * entry;
+
+    switch (info->type) {
+        case NVS_TYPE_U16: {
+            uint16_t value;
+            if (nvs_get_u16(handle, info->key, &value) == ESP_OK && (entry = _add(info->key, NVS_TYPE_U16)) != NULL) {
+                entry->value.u16 = value;
+            }
+            break;
+        }
+        case NVS_TYPE_U64: {
+            uint64_t value;
+            if (nvs_get_u64(handle, info->key, &value) == ESP_OK && (entry = _add(info->key, NVS_TYPE_U64)) != NULL) {
+                entry->value.u64 = value;
+            }
+            break;
+        }
+        case NVS_TYPE_STR: {
+            size_t size = 0;
+            if (nvs_get_str(handle, info->key, NULL, &size) != ESP_OK) {
+                break;
+            }
+            char * value = malloc(size);
+            if (nvs_get_str(handle, info->key, value, &size) != ESP_OK || (entry = _add(info->key, NVS_TYPE_STR)) == NULL) {
+                free(value);
+                break;
+            }
+            entry->value.str = value;
+            break;
+        }
+        default:
+            // no getter reads other types
+            break;
+    }
+}
 
+/// @brief reads the whole namespace into RAM, called with config_lock held
+static void _load(void)
+{
     nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not open nvs");
+    nvs_iterator_t it = NULL;
+
+    loaded = true;
+
+    // a fresh device has no namespace yet, every key reads as its default
+    if (nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
         return;
     }
 
-    err = nvs_set_str(handle, key, value);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not write nvs key: %s, value: %s", key, value);
+    esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, NVS_CONFIG_NAMESPACE, NVS_TYPE_ANY, &it);
+    while (err == ESP_OK) {
+        nvs_entry_info_t info;
+        nvs_entry_info(it, &info);
+        _load_entry(handle, &info);
+        err = nvs_entry_next(&it);
     }
-
+    nvs_release_iterator(it);
     nvs_close(handle);
+
+    ESP_LOGI(TAG, "Loaded %d config key(s)", entry_count);
 }
 
-uint16_t nvs_config_get_u16(const char * key, const uint16_t default_value)
+static NvsConfigEntry * _lookup(const char * key, nvs_type_t type)
 {
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return default_value;
+    if (!loaded) {
+        _load();
     }
 
-    uint16_t out;
-    err = nvs_get_u16(handle, key, &out);
-    nvs_close(handle);
+    NvsConfigEntry * entry = _find(key);
+    // NVS does not convert between types either
+    return entry != NULL && entry->type == type ? entry : NULL;
+}
 
-    if (err != ESP_OK) {
-        return default_value;
+/// @brief looks up the entry a setter writes, an entry of another type is taken over like NVS does
+static NvsConfigEntry * _lookup_for_write(const char * key, nvs_type_t type)
+{
+    if (!loaded) {
+        _load();
     }
-    return out;
+
+    NvsConfigEntry * entry = _find(key);
+    if (entry == NULL) {
+        return _add(key, type);
+    }
+
+    if (entry->type != type) {
+        if (entry->type == NVS_TYPE_STR) {
+            free(entry->value.str);
+        }
+        entry->type = type;
+        entry->value.str = NULL;
+    }
+    return entry;
 }
 
-void nvs_config_set_u16(const char * key, const uint16_t value)
+static void _notify(const char * key)
 {
+    NvsConfigSubscriber notify[NVS_CONFIG_MAX_SUBSCRIBERS];
+    int count;
 
-    nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) {
+    // called without the lock so subscribers can read the config
+    pthread_mutex_lock(&config_lock);
+    count = subscriber_count;
+    memcpy(notify, subscribers, sizeof(notify[0]) * count);
+    pthread_mutex_unlock(&config_lock);
+
+    for (int i = 0; i < count; i++) {
+        if (notify[i].key == NULL || strcmp(notify[i].key, key) == 0) {
+            notify[i].callback(key, notify[i].ctx);
+        }
+    }
+}
+
+static bool _open_for_write(nvs_handle * handle)
+{
+    if (nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, handle) != ESP_OK) {
         ESP_LOGW(TAG, "Could not open nvs");
-        return;
+        return false;
     }
+    return true;
+}
 
-    err = nvs_set_u16(handle, key, value);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not write nvs key: %s, value: %u", key, value);
+/// @brief loads every config key into RAM, later reads never touch the flash
+void nvs_config_init(void)
+{
+    pthread_mutex_lock(&config_lock);
+    if (!loaded) {
+        _load();
     }
+    pthread_mutex_unlock(&config_lock);
+}
 
-    nvs_close(handle);
+/// @brief calls back after a key changed, from the task that changed it
+/// @param key the key to watch, NULL for every key
+/// @return false if no more subscribers fit
+bool nvs_config_subscribe(const char * key, nvs_config_callback_t callback, void * ctx)
+{
+    bool added = false;
+
+    pthread_mutex_lock(&config_lock);
+    if (subscriber_count < NVS_CONFIG_MAX_SUBSCRIBERS) {
+        subscribers[subscriber_count++] = (NvsConfigSubscriber){.key = key, .callback = callback, .ctx = ctx};
+        added = true;
+    }
+    pthread_mutex_unlock(&config_lock);
+
+    if (!added) {
+        ESP_LOGE(TAG, "Too many config subscribers");
+    }
+    return added;
 }
 
-uint64_t nvs_config_get_u64(const char * key, const uint64_t default_value)
+char * nvs_config_get_string(const char * key, const char * default_value)
+{
+    pthread_mutex_lock(&config_lock);
+    NvsConfigEntry * entry = _lookup(key, NVS_TYPE_STR);
+    char * out = strdup(entry != NULL ? entry->value.str : default_value);
+    pthread_mutex_unlock(&config_lock);
+
+    return out;
+}
+
+void nvs_config_set_string(const char * key, const char * value)
 {
     nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READONLY, &handle);
-    if (err != ESP_OK) {
-        return default_value;
+    bool changed = false;
+
+    pthread_mutex_lock(&write_lock);
+
+    pthread_mutex_lock(&config_lock);
+    NvsConfigEntry * entry = _lookup(key, NVS_TYPE_STR);
+    bool same = entry != NULL && strcmp(entry->value.str, value) == 0;
+    pthread_mutex_unlock(&config_lock);
+
+    if (!same && _open_for_write(&handle)) {
+        esp_err_t err = nvs_set_str(handle, key, value);
+        nvs_close(handle);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Could not write nvs key: %s, value: %s", key, value);
+        } else {
+            char * copy = strdup(value);
+            char * old = NULL;
+            pthread_mutex_lock(&config_lock);
+            if ((entry = _lookup_for_write(key, NVS_TYPE_STR)) != NULL) {
+                old = entry->value.str;
+                entry->value.str = copy;
+                copy = NULL;
+                changed = true;
+            }
+            pthread_mutex_unlock(&config_lock);
+            free(old);
+            free(copy);
+        }
+    }
+
+    pthread_mutex_unlock(&write_lock);
+
+    if (changed) {
+        _notify(key);
     }
+}
+
+uint16_t nvs_config_get_u16(const char * key, const uint16_t default_value)
+{
+    pthread_mutex_lock(&config_lock);
+    NvsConfigEntry * entry = _lookup(key, NVS_TYPE_U16);
+    uint16_t out = entry != NULL ? entry->value.u16 : default_value;
+    pthread_mutex_unlock(&config_lock);
 
-    uint64_t out;
-    err = nvs_get_u64(handle, key, &out);
+    return out;
+}
 
-    if (err != ESP_OK) {
+void nvs_config_set_u16(const char * key, const uint16_t value)
+{
+    nvs_handle handle;
+    bool changed = false;
+
+    pthread_mutex_lock(&write_lock);
+
+    pthread_mutex_lock(&config_lock);
+    NvsConfigEntry * entry = _lookup(key, NVS_TYPE_U16);
+    bool same = entry != NULL && entry->value.u16 == value;
+    pthread_mutex_unlock(&config_lock);
+
+    if (!same && _open_for_write(&handle)) {
+        esp_err_t err = nvs_set_u16(handle, key, value);
         nvs_close(handle);
-        return default_value;
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Could not write nvs key: %s, value: %u", key, value);
+        } else {
+            pthread_mutex_lock(&config_lock);
+            if ((entry = _lookup_for_write(key, NVS_TYPE_U16)) != NULL) {
+                entry->value.u16 = value;
+                changed = true;
+            }
+            pthread_mutex_unlock(&config_lock);
+        }
     }
 
-    nvs_close(handle);
+    pthread_mutex_unlock(&write_lock);
+
+    if (changed) {
+        _notify(key);
+    }
+}
+
+uint64_t nvs_config_get_u64(const char * key, const uint64_t default_value)
+{
+    pthread_mutex_lock(&config_lock);
+    NvsConfigEntry * entry = _lookup(key, NVS_TYPE_U64);
+    uint64_t out = entry != NULL ? entry->value.u64 : default_value;
+    pthread_mutex_unlock(&config_lock);
+
     return out;
 }
 
 void nvs_config_set_u64(const char * key, const uint64_t value)
 {
-
     nvs_handle handle;
-    esp_err_t err;
-    err = nvs_open(NVS_CONFIG_NAMESPACE, NVS_READWRITE, &handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not open nvs");
-        return;
+    bool changed = false;
+
+    pthread_mutex_lock(&write_lock);
+
+    pthread_mutex_lock(&config_lock);
+    NvsConfigEntry * entry = _lookup(key, NVS_TYPE_U64);
+    bool same = entry != NULL && entry->value.u64 == value;
+    pthread_mutex_unlock(&config_lock);
+
+    if (!same && _open_for_write(&handle)) {
+        esp_err_t err = nvs_set_u64(handle, key, value);
+        nvs_close(handle);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Could not write nvs key: %s, value: %llu", key, value);
+        } else {
+            pthread_mutex_lock(&config_lock);
+            if ((entry = _lookup_for_write(key, NVS_TYPE_U64)) != NULL) {
+                entry->value.u64 = value;
+                changed = true;
+            }
+            pthread_mutex_unlock(&config_lock);
+        }
     }
 
-    err = nvs_set_u64(handle, key, value);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not write nvs key: %s, value: %llu", key, value);
+    pthread_mutex_unlock(&write_lock);
+
+    if (changed) {
+        _notify(key);
     }
-    nvs_close(handle);
 }
@@ -1,6 +1,7 @@
 #ifndef MAIN_NVS_CONFIG_H
 #define MAIN_NVS_CONFIG_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 // Max length 15
@@ -30,12 +31,23 @@
 #define NVS_CONFIG_SELF_TEST "selftest"
 #define NVS_CONFIG_OVERHEAT_MODE "overheat_mode"
 #define NVS_CONFIG_SWARM "swarmconfig"
+#define NVS_CONFIG_AUTO_TUNE "autotune"
+#define NVS_CONFIG_AUTO_TUNE_MAX_FREQ "autotunemaxf"
+#define NVS_CONFIG_CHIP_FREQUENCIES "chipfreqs"
+#define NVS_CONFIG_REGISTER_VERIFY "regverify"
 
 // Theme configuration
 #define NVS_CONFIG_THEME_SCHEME "themescheme"
 #define NVS_CONFIG_THEME_NAME "themename"
 #define NVS_CONFIG_THEME_COLORS "themecolors"
 
+// called with the key that changed, after the new value is readable
+typedef void (*nvs_config_callback_t)(const char * key, void * ctx);
+
+// the namespace is read into RAM once, getters copy from there and setters write through to NVS
+void nvs_config_init(void);
+bool nvs_config_subscribe(const char * key, nvs_config_callback_t callback, void * ctx);
+
 char * nvs_config_get_string(const char * key, const char * default_value);
 void nvs_config_set_string(const char * key, const char * default_value);
 uint16_t nvs_config_get_u16(const char * key, const uint16_t default_value);
@@ -9,7 +9,6 @@
 #include "global_state.h"
 
 static const char * TAG = "nvs_device";
-static const double NONCE_SPACE = 4294967296.0; //  2^32
 
 
 esp_err_t NVSDevice_init(void) {
@@ -18,6 +17,9 @@ esp_err_t NVSDevice_init(void) {
         ESP_ERROR_CHECK(nvs_flash_erase());
         err = nvs_flash_init();
     }
+    if (err == ESP_OK) {
+        nvs_config_init();
+    }
     return err;
 }
 
@@ -75,6 +77,7 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
     ESP_LOGI(TAG, "Found Device Model: %s", GLOBAL_STATE->device_model_str);
     ESP_LOGI(TAG, "Found Board Version: %d", GLOBAL_STATE->board_version);
 
+    uint32_t asic_difficulty = 0;
     GLOBAL_STATE->asic_model_str = nvs_config_get_string(NVS_CONFIG_ASIC_MODEL, "");
     if (strcmp(GLOBAL_STATE->asic_model_str, "BM1366") == 0) {
         ESP_LOGI(TAG, "ASIC: %dx BM1366 (%" PRIu64 " cores)", GLOBAL_STATE->asic_count, BM1366_CORE_COUNT);
@@ -82,12 +85,15 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
         AsicFunctions ASIC_functions = {.init_fn = BM1366_init,
                                         .receive_result_fn = BM1366_proccess_work,
                                         .set_max_baud_fn = BM1366_set_max_baud,
+                                        .fall_back_baud_fn = BM1366_fall_back_baud,
                                         .set_difficulty_mask_fn = BM1366_set_job_difficulty_mask,
+                                        .prepare_work_fn = BM1366_prepare_work,
                                         .send_work_fn = BM1366_send_work,
-                                        .set_version_mask = BM1366_set_version_mask};
-        //GLOBAL_STATE.asic_job_frequency_ms = (NONCE_SPACE / (double) (GLOBAL_STATE.POWER_MANAGEMENT_MODULE.frequency_value * BM1366_CORE_COUNT * 1000)) / (double) GLOBAL_STATE.asic_count; // version-rolling so Small Cores have different Nonce Space
-        GLOBAL_STATE->asic_job_frequency_ms = 2000; //ms
-        GLOBAL_STATE->ASIC_difficulty = BM1366_ASIC_DIFFICULTY;
+                                        .set_version_mask = BM1366_set_version_mask,
+                                        .read_hash_counter_fn = BM1366_read_hash_counter,
+                                        .verify_registers_fn = BM1366_verify_registers,
+                                        .get_register_shadow_fn = BM1366_get_register_shadow};
+        asic_difficulty = BM1366_ASIC_DIFFICULTY;
 
         GLOBAL_STATE->ASIC_functions = ASIC_functions;
         } else if (strcmp(GLOBAL_STATE->asic_model_str, "BM1370") == 0) {
@@ -96,12 +102,16 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
         AsicFunctions ASIC_functions = {.init_fn = BM1370_init,
                                         .receive_result_fn = BM1370_proccess_work,
                                         .set_max_baud_fn = BM1370_set_max_baud,
+                                        .fall_back_baud_fn = BM1370_fall_back_baud,
                                         .set_difficulty_mask_fn = BM1370_set_job_difficulty_mask,
+                                        .prepare_work_fn = BM1370_prepare_work,
                                         .send_work_fn = BM1370_send_work,
-                                        .set_version_mask = BM1370_set_version_mask};
-        //GLOBAL_STATE.asic_job_frequency_ms = (NONCE_SPACE / (double) (GLOBAL_STATE.POWER_MANAGEMENT_MODULE.frequency_value * BM1370_CORE_COUNT * 1000)) / (double) GLOBAL_STATE.asic_count; // version-rolling so Small Cores have different Nonce Space
-        GLOBAL_STATE->asic_job_frequency_ms = 500; //ms
-        GLOBAL_STATE->ASIC_difficulty = BM1370_ASIC_DIFFICULTY;
+                                        .set_version_mask = BM1370_set_version_mask,
+                                        .set_chip_frequency_fn = BM1370_set_chip_frequency,
+                                        .read_hash_counter_fn = BM1370_read_hash_counter,
+                                        .verify_registers_fn = BM1370_verify_registers,
+                                        .get_register_shadow_fn = BM1370_get_register_shadow};
+        asic_difficulty = BM1370_ASIC_DIFFICULTY;
 
         GLOBAL_STATE->ASIC_functions = ASIC_functions;
     } else if (strcmp(GLOBAL_STATE->asic_model_str, "BM1368") == 0) {
@@ -110,12 +120,15 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
         AsicFunctions ASIC_functions = {.init_fn = BM1368_init,
                                         .receive_result_fn = BM1368_proccess_work,
                                         .set_max_baud_fn = BM1368_set_max_baud,
+                                        .fall_back_baud_fn = BM1368_fall_back_baud,
                                         .set_difficulty_mask_fn = BM1368_set_job_difficulty_mask,
+                                        .prepare_work_fn = BM1368_prepare_work,
                                         .send_work_fn = BM1368_send_work,
-                                        .set_version_mask = BM1368_set_version_mask};
-        //GLOBAL_STATE.asic_job_frequency_ms = (NONCE_SPACE / (double) (GLOBAL_STATE.POWER_MANAGEMENT_MODULE.frequency_value * BM1368_CORE_COUNT * 1000)) / (double) GLOBAL_STATE.asic_count; // version-rolling so Small Cores have different Nonce Space
-        GLOBAL_STATE->asic_job_frequency_ms = 500; //ms
-        GLOBAL_STATE->ASIC_difficulty = BM1368_ASIC_DIFFICULTY;
+                                        .set_version_mask = BM1368_set_version_mask,
+                                        .read_hash_counter_fn = BM1368_read_hash_counter,
+                                        .verify_registers_fn = BM1368_verify_registers,
+                                        .get_register_shadow_fn = BM1368_get_register_shadow};
+        asic_difficulty = BM1368_ASIC_DIFFICULTY;
 
         GLOBAL_STATE->ASIC_functions = ASIC_functions;
     } else if (strcmp(GLOBAL_STATE->asic_model_str, "BM1397") == 0) {
@@ -124,11 +137,12 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
         AsicFunctions ASIC_functions = {.init_fn = BM1397_init,
                                         .receive_result_fn = BM1397_proccess_work,
                                         .set_max_baud_fn = BM1397_set_max_baud,
+                                        .fall_back_baud_fn = BM1397_fall_back_baud,
                                         .set_difficulty_mask_fn = BM1397_set_job_difficulty_mask,
+                                        .prepare_work_fn = BM1397_prepare_work,
                                         .send_work_fn = BM1397_send_work,
                                         .set_version_mask = BM1397_set_version_mask};
-        GLOBAL_STATE->asic_job_frequency_ms = (NONCE_SPACE / (double) (GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value * BM1397_SMALL_CORE_COUNT * 1000)) / (double) GLOBAL_STATE->asic_count; // no version-rolling so same Nonce Space is splitted between Small Cores
-        GLOBAL_STATE->ASIC_difficulty = BM1397_ASIC_DIFFICULTY;
+        asic_difficulty = BM1397_ASIC_DIFFICULTY;
 
         GLOBAL_STATE->ASIC_functions = ASIC_functions;
     } else {
@@ -137,11 +151,19 @@ esp_err_t NVSDevice_parse_config(GlobalState * GLOBAL_STATE) {
                                         .receive_result_fn = NULL,
                                         .set_max_baud_fn = NULL,
                                         .set_difficulty_mask_fn = NULL,
+                                        .prepare_work_fn = NULL,
                                         .send_work_fn = NULL};
         GLOBAL_STATE->ASIC_functions = ASIC_functions;
         // maybe should return here to not execute anything with a faulty device parameter !
         return ESP_FAIL;
     }
 
+    // every chain starts from the ticket mask the driver programs during init
+    for (int i = 0; i < GLOBAL_STATE->chain_count; i++) {
+        GLOBAL_STATE->chains[i].ASIC_difficulty = asic_difficulty;
+    }
+
+    ASIC_task_update_job_interval(GLOBAL_STATE);
+
     return ESP_OK;
 }
\ No newline at end of file
@@ -0,0 +1,169 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "nvs.h"
+
+#include "nvs_config.h"
+#include "persist.h"
+#include "persist_journal.h"
+
+#define PERSIST_NAMESPACE "persist"
+
+static const char * TAG = "persist";
+
+static const char * slot_keys[PERSIST_JOURNAL_SLOTS] = {"journal0", "journal1"};
+
+// values is what the hot path updates, flushed is what the newest slot holds
+static pthread_mutex_t values_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t values[PERSIST_COUNTERS];
+
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t flushed[PERSIST_COUNTERS];
+static uint32_t sequence = 0;
+
+static TaskHandle_t persist_task_handle = NULL;
+
+static bool _read_slot(nvs_handle handle, int slot, PersistRecord * record)
+{
+    size_t length = sizeof(*record);
+
+    return nvs_get_blob(handle, slot_keys[slot], record, &length) == ESP_OK && PERSIST_journal_valid(record, length);
+}
+
+static void _load_journal(void)
+{
+    nvs_handle handle;
+    PersistRecord records[PERSIST_JOURNAL_SLOTS];
+    bool valid[PERSIST_JOURNAL_SLOTS];
+
+    // nothing was flushed yet on a fresh device
+    if (nvs_open(PERSIST_NAMESPACE, NVS_READONLY, &handle) != ESP_OK) {
+        return;
+    }
+
+    for (int slot = 0; slot < PERSIST_JOURNAL_SLOTS; slot++) {
+        valid[slot] = _read_slot(handle, slot, &records[slot]);
+    }
+    nvs_close(handle);
+
+    int newest = PERSIST_journal_newest(records, valid);
+    if (newest >= 0) {
+        memcpy(flushed, records[newest].values, sizeof(flushed));
+        sequence = records[newest].sequence;
+        ESP_LOGI(TAG, "Loaded journal record %lu", (unsigned long) sequence);
+    }
+}
+
+static void _shutdown_handler(void)
+{
+    PERSIST_flush();
+}
+
+/// @brief loads the newest journal record, called once after the NVS is up and before any counter is used
+void PERSIST_init(void)
+{
+    _load_journal();
+    memcpy(values, flushed, sizeof(values));
+
+    // the best diff was written straight to the config by older firmware, PERSIST_flush keeps it there too
+    uint64_t best_diff = nvs_config_get_u64(NVS_CONFIG_BEST_DIFF, 0);
+    if (best_diff > values[PERSIST_BEST_DIFF]) {
+        values[PERSIST_BEST_DIFF] = best_diff;
+    }
+
+    // esp_restart runs it, which covers OTA updates and restarts from the API
+    if (esp_register_shutdown_handler(_shutdown_handler) != ESP_OK) {
+        ESP_LOGW(TAG, "Could not register the shutdown handler");
+    }
+}
+
+uint64_t PERSIST_get(persist_counter_t counter)
+{
+    pthread_mutex_lock(&values_lock);
+    uint64_t value = values[counter];
+    pthread_mutex_unlock(&values_lock);
+
+    return value;
+}
+
+/// @brief raises a counter in RAM only, safe to call from the nonce path
+void PERSIST_set_max(persist_counter_t counter, uint64_t value)
+{
+    bool changed = false;
+
+    pthread_mutex_lock(&values_lock);
+    if (value > values[counter]) {
+        values[counter] = value;
+        changed = true;
+    }
+    pthread_mutex_unlock(&values_lock);
+
+    if (changed && persist_task_handle != NULL) {
+        xTaskNotifyGive(persist_task_handle);
+    }
+}
+
+/// @brief writes the counters to the older journal slot if they changed since the last flush
+void PERSIST_flush(void)
+{
+    PersistRecord record;
+    uint64_t current[PERSIST_COUNTERS];
+    nvs_handle handle;
+
+    pthread_mutex_lock(&flush_lock);
+
+    pthread_mutex_lock(&values_lock);
+    memcpy(current, values, sizeof(current));
+    pthread_mutex_unlock(&values_lock);
+
+    if (memcmp(current, flushed, sizeof(flushed)) == 0) {
+        pthread_mutex_unlock(&flush_lock);
+        return;
+    }
+
+    PERSIST_journal_seal(&record, sequence + 1, current);
+
+    esp_err_t err = nvs_open(PERSIST_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(handle, slot_keys[PERSIST_journal_slot(record.sequence)], &record, sizeof(record));
+        if (err == ESP_OK) {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+
+    if (err != ESP_OK) {
+        // the values stay unflushed and the next flush tries again
+        ESP_LOGW(TAG, "Could not write journal record %lu: %s", (unsigned long) record.sequence, esp_err_to_name(err));
+        pthread_mutex_unlock(&flush_lock);
+        return;
+    }
+
+    sequence = record.sequence;
+    memcpy(flushed, record.values, sizeof(flushed));
+    pthread_mutex_unlock(&flush_lock);
+
+    // older firmware only reads the config key, after a downgrade it would come back with a stale best diff
+    // and should_test() could start a self test on a device that already mined
+    nvs_config_set_u64(NVS_CONFIG_BEST_DIFF, record.values[PERSIST_BEST_DIFF]);
+}
+
+void PERSIST_task(void * pvParameters)
+{
+    persist_task_handle = xTaskGetCurrentTaskHandle();
+
+    while (1) {
+        // a new value wakes the task early, a failed write is retried on the timeout
+        ulTaskNotifyTake(pdTRUE, PERSIST_FLUSH_INTERVAL_MS / portTICK_PERIOD_MS);
+        PERSIST_flush();
+
+        // spaces the writes out while the best diff still climbs quickly after boot
+        vTaskDelay(PERSIST_FLUSH_INTERVAL_MS / portTICK_PERIOD_MS);
+    }
+}
@@ -0,0 +1,22 @@
+#ifndef PERSIST_H_
+#define PERSIST_H_
+
+#include <stdint.h>
+
+// counters that outlive a reboot, kept in RAM and written behind by PERSIST_task
+typedef enum
+{
+    PERSIST_BEST_DIFF,
+    PERSIST_COUNTERS,
+} persist_counter_t;
+
+// the shortest time between two flushes, a new best diff is written at most this late
+#define PERSIST_FLUSH_INTERVAL_MS 60000
+
+void PERSIST_init(void);
+uint64_t PERSIST_get(persist_counter_t counter);
+void PERSIST_set_max(persist_counter_t counter, uint64_t value);
+void PERSIST_flush(void);
+void PERSIST_task(void * pvParameters);
+
+#endif /* PERSIST_H_ */
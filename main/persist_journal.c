@@ -0,0 +1,59 @@
+#include <string.h>
+
+#include "persist_journal.h"
+
+/// @brief the CRC-32 esp_rom_crc32_le(0, ...) computes, so records written by earlier firmware stay valid
+static uint32_t _crc32(const uint8_t * data, size_t length)
+{
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t _record_crc(const PersistRecord * record)
+{
+    return _crc32((const uint8_t *) record, offsetof(PersistRecord, crc));
+}
+
+/// @brief fills a record with the values to write under the next sequence number
+void PERSIST_journal_seal(PersistRecord * record, uint32_t sequence, const uint64_t * values)
+{
+    memset(record, 0, sizeof(*record));
+    record->magic = PERSIST_MAGIC;
+    record->sequence = sequence;
+    memcpy(record->values, values, sizeof(record->values));
+    record->crc = _record_crc(record);
+}
+
+/// @brief checks a record read from a slot
+/// @param length bytes the slot held, a record of another layout is ignored like a damaged one
+bool PERSIST_journal_valid(const PersistRecord * record, size_t length)
+{
+    return length == sizeof(*record) && record->magic == PERSIST_MAGIC && record->crc == _record_crc(record);
+}
+
+/// @brief the slot holding the newest valid record, the sequence numbers may have wrapped
+/// @return the slot, -1 if neither holds a valid record
+int PERSIST_journal_newest(const PersistRecord * records, const bool * valid)
+{
+    int newest = -1;
+
+    for (int slot = 0; slot < PERSIST_JOURNAL_SLOTS; slot++) {
+        if (valid[slot] && (newest < 0 || (int32_t) (records[slot].sequence - records[newest].sequence) > 0)) {
+            newest = slot;
+        }
+    }
+    return newest;
+}
+
+/// @brief the slot a record is written to, always the one not holding the newest record
+int PERSIST_journal_slot(uint32_t sequence)
+{
+    return sequence % PERSIST_JOURNAL_SLOTS;
+}
@@ -0,0 +1,28 @@
+#ifndef PERSIST_JOURNAL_H_
+#define PERSIST_JOURNAL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "persist.h"
+
+#define PERSIST_MAGIC 0x50455231 // "PER1"
+
+// the journal alternates between two slots, a write torn by a crash leaves the other one intact
+#define PERSIST_JOURNAL_SLOTS 2
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t sequence;
+    uint64_t values[PERSIST_COUNTERS];
+    uint32_t crc;
+} PersistRecord;
+
+void PERSIST_journal_seal(PersistRecord * record, uint32_t sequence, const uint64_t * values);
+bool PERSIST_journal_valid(const PersistRecord * record, size_t length);
+int PERSIST_journal_newest(const PersistRecord * records, const bool * valid);
+int PERSIST_journal_slot(uint32_t sequence);
+
+#endif /* PERSIST_JOURNAL_H_ */
@@ -6,6 +6,7 @@
 #include "esp_lvgl_port.h"
 #include "global_state.h"
 #include "screen.h"
+#include "system.h"
 
 // static const char * TAG = "screen";
 
@@ -283,7 +284,8 @@ static void screen_update_cb(lv_timer_t * timer)
 
     // Carousel
 
-    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+    SystemStats stats;
+    SYSTEM_get_stats(GLOBAL_STATE, &stats);
 
     char *pool_url = module->is_using_fallback ? module->fallback_pool_url : module->pool_url;
     if (strcmp(lv_label_get_text(mining_url_scr_urls_label), pool_url) != 0) {
@@ -294,39 +296,39 @@ static void screen_update_cb(lv_timer_t * timer)
         lv_label_set_text(ip_addr_scr_urls_label, module->ip_addr_str);
     }
 
-    if (current_hashrate != module->current_hashrate) {
-        lv_label_set_text_fmt(hashrate_label, "Gh/s: %.2f", module->current_hashrate);
+    if (current_hashrate != stats.current_hashrate) {
+        lv_label_set_text_fmt(hashrate_label, "Gh/s: %.2f", stats.current_hashrate);
     }
 
-    if (current_power != power_management->power || current_hashrate != module->current_hashrate) {
-        if (power_management->power > 0 && module->current_hashrate > 0) {
-            float efficiency = power_management->power / (module->current_hashrate / 1000.0);
+    if (current_power != stats.power || current_hashrate != stats.current_hashrate) {
+        if (stats.power > 0 && stats.current_hashrate > 0) {
+            float efficiency = stats.power / (stats.current_hashrate / 1000.0);
             lv_label_set_text_fmt(efficiency_label, "J/Th: %.2f", efficiency);
         }
     }
 
-    if (module->FOUND_BLOCK && !found_block) {
+    if (stats.FOUND_BLOCK && !found_block) {
         found_block = true;
 
         lv_obj_set_width(difficulty_label, LV_HOR_RES);
         lv_label_set_long_mode(difficulty_label, LV_LABEL_LONG_SCROLL_CIRCULAR);
-        lv_label_set_text_fmt(difficulty_label, "Best: %s   !!! BLOCK FOUND !!!", module->best_session_diff_string);
+        lv_label_set_text_fmt(difficulty_label, "Best: %s   !!! BLOCK FOUND !!!", stats.best_session_diff_string);
 
         screen_show(SCR_STATS);
     } else {
-        if (current_difficulty != module->best_session_nonce_diff) {
-            lv_label_set_text_fmt(difficulty_label, "Best: %s/%s", module->best_session_diff_string, module->best_diff_string);
+        if (current_difficulty != stats.best_session_nonce_diff) {
+            lv_label_set_text_fmt(difficulty_label, "Best: %s/%s", stats.best_session_diff_string, stats.best_diff_string);
         }
     }
 
-    if (curreny_chip_temp != power_management->chip_temp_avg) {
-        lv_label_set_text_fmt(chip_temp_label, "Temp: %.1f C", power_management->chip_temp_avg);
+    if (curreny_chip_temp != stats.chip_temp_avg) {
+        lv_label_set_text_fmt(chip_temp_label, "Temp: %.1f C", stats.chip_temp_avg);
     }
 
-    current_hashrate = module->current_hashrate;
-    current_power = power_management->power;
-    current_difficulty = module->best_session_nonce_diff;
-    curreny_chip_temp = power_management->chip_temp_avg;
+    current_hashrate = stats.current_hashrate;
+    current_power = stats.power;
+    current_difficulty = stats.best_session_nonce_diff;
+    curreny_chip_temp = stats.chip_temp_avg;
 
     if (CAROUSEL_DELAY_COUNT > current_screen_counter || found_block) {
         return;
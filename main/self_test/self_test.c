@@ -6,6 +6,7 @@
 
 #include "esp_log.h"
 #include "esp_timer.h"
+#include "freertos/semphr.h"
 
 #include "i2c_bitaxe.h"
 #include "DS4432U.h"
@@ -15,6 +16,7 @@
 #include "global_state.h"
 #include "nvs_config.h"
 #include "nvs_flash.h"
+#include "persist.h"
 #include "display.h"
 #include "screen.h"
 #include "input.h"
@@ -57,7 +59,7 @@ static void tests_done(GlobalState * GLOBAL_STATE, bool test_result);
 
 bool should_test(GlobalState * GLOBAL_STATE) {
     bool is_max = GLOBAL_STATE->asic_model == ASIC_BM1397;
-    uint64_t best_diff = nvs_config_get_u64(NVS_CONFIG_BEST_DIFF, 0);
+    uint64_t best_diff = PERSIST_get(PERSIST_BEST_DIFF);
     uint16_t should_self_test = nvs_config_get_u16(NVS_CONFIG_SELF_TEST, 0);
     if (should_self_test == 1 && !is_max && best_diff < 1) {
         return true;
@@ -360,13 +362,14 @@ void self_test(void * pvParameters)
         tests_done(GLOBAL_STATE, TESTS_FAILED);
     }
 
-    //test for number of ASICs
-    if (SERIAL_init() != ESP_OK) {
+    //test for number of ASICs, the self test runs on the first chain
+    AsicChain * chain = &GLOBAL_STATE->chains[0];
+    if (SERIAL_init(chain->id) != ESP_OK) {
         ESP_LOGE(TAG, "SERIAL init failed!");
         tests_done(GLOBAL_STATE, TESTS_FAILED);
     }
 
-    uint8_t chips_detected = (GLOBAL_STATE->ASIC_functions.init_fn)(GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, GLOBAL_STATE->asic_count);
+    uint8_t chips_detected = (GLOBAL_STATE->ASIC_functions.init_fn)(chain->id, GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value, GLOBAL_STATE->asic_count);
     ESP_LOGI(TAG, "%u chips detected, %u expected", chips_detected, GLOBAL_STATE->asic_count);
 
     if (chips_detected != GLOBAL_STATE->asic_count) {
@@ -378,20 +381,20 @@ void self_test(void * pvParameters)
     }
 
     //setup and test hashrate
-    int baud = (*GLOBAL_STATE->ASIC_functions.set_max_baud_fn)();
+    int baud = (*GLOBAL_STATE->ASIC_functions.set_max_baud_fn)(chain->id);
     vTaskDelay(10 / portTICK_PERIOD_MS);
 
-    if (SERIAL_set_baud(baud) != ESP_OK) {
+    if (SERIAL_set_baud(chain->id, baud) != ESP_OK) {
         ESP_LOGE(TAG, "SERIAL set baud failed!");
         tests_done(GLOBAL_STATE, TESTS_FAILED);
     }
 
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs = malloc(sizeof(bm_job *) * 128);
-    GLOBAL_STATE->valid_jobs = malloc(sizeof(uint8_t) * 128);
+    chain->ASIC_TASK_MODULE.active_jobs = malloc(sizeof(bm_job *) * 128);
+    chain->valid_jobs = malloc(sizeof(uint8_t) * 128);
 
     for (int i = 0; i < 128; i++) {
-        GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[i] = NULL;
-        GLOBAL_STATE->valid_jobs[i] = 0;
+        chain->ASIC_TASK_MODULE.active_jobs[i] = NULL;
+        chain->valid_jobs[i] = 0;
     }
 
     vTaskDelay(1000 / portTICK_PERIOD_MS);
@@ -437,11 +440,11 @@ void self_test(void * pvParameters)
 
     uint8_t difficulty_mask = 8;
 
-    (*GLOBAL_STATE->ASIC_functions.set_difficulty_mask_fn)(difficulty_mask);
+    (*GLOBAL_STATE->ASIC_functions.set_difficulty_mask_fn)(chain->id, difficulty_mask);
 
     ESP_LOGI(TAG, "Sending work");
 
-    (*GLOBAL_STATE->ASIC_functions.send_work_fn)(GLOBAL_STATE, &job);
+    (*GLOBAL_STATE->ASIC_functions.send_work_fn)(GLOBAL_STATE, chain->id, &job);
     
      double start = esp_timer_get_time();
      double sum = 0;
@@ -449,8 +452,9 @@ void self_test(void * pvParameters)
      double hash_rate = 0;
 
     while(duration < 3){
-        task_result * asic_result = (*GLOBAL_STATE->ASIC_functions.receive_result_fn)(GLOBAL_STATE);
-        if (asic_result != NULL) {
+        task_result * asic_result = (*GLOBAL_STATE->ASIC_functions.receive_result_fn)(GLOBAL_STATE, chain->id);
+        // results for unknown job ids are returned for error accounting, they carry no work
+        if (asic_result != NULL && chain->valid_jobs[asic_result->job_id] != 0) {
             // check the nonce difficulty
             double nonce_diff = test_nonce_value(&job, asic_result->nonce, asic_result->rolled_version);
             sum += difficulty_mask;
@@ -482,8 +486,8 @@ void self_test(void * pvParameters)
         default:
     }
 
-    free(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs);
-    free(GLOBAL_STATE->valid_jobs);
+    free(chain->ASIC_TASK_MODULE.active_jobs);
+    free(chain->valid_jobs);
 
     if (test_core_voltage(GLOBAL_STATE) != ESP_OK) {
         tests_done(GLOBAL_STATE, TESTS_FAILED);
@@ -1,5 +1,6 @@
 #include <inttypes.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
@@ -13,6 +14,7 @@
 
 #include "driver/gpio.h"
 #include "esp_app_desc.h"
+#include "esp_heap_caps.h"
 #include "esp_netif.h"
 #include "esp_timer.h"
 #include "esp_wifi.h"
@@ -25,6 +27,7 @@
 #include "adc.h"
 #include "connect.h"
 #include "nvs_config.h"
+#include "persist.h"
 #include "display.h"
 #include "input.h"
 #include "screen.h"
@@ -36,28 +39,38 @@ static void _suffix_string(uint64_t, char *, size_t, int);
 
 static esp_netif_t * netif;
 
+// the result tasks of all chains report nonces concurrently, it also serializes the writers of the stats
+static pthread_mutex_t found_nonce_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// written by the result tasks and the stratum task, read by the API
+static pthread_mutex_t share_log_lock = PTHREAD_MUTEX_INITIALIZER;
+static ShareLog * share_log;
+
 //local function prototypes
 static esp_err_t ensure_overheat_mode_config();
 
-static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id);
+static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint32_t target);
 static void _suffix_string(uint64_t val, char * buf, size_t bufsiz, int sigdigits);
 
 void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
-    module->duration_start = 0;
-    module->historical_hashrate_rolling_index = 0;
-    module->historical_hashrate_init = 0;
-    module->current_hashrate = 0;
+    ASIC_hashrate_init(&module->hashrate, esp_timer_get_time());
+    // no reader runs yet, the stats are written without the seqlock
+    memset(&module->stats, 0, sizeof(module->stats));
     module->screen_page = 0;
-    module->shares_accepted = 0;
-    module->shares_rejected = 0;
-    module->best_nonce_diff = nvs_config_get_u64(NVS_CONFIG_BEST_DIFF, 0);
-    module->best_session_nonce_diff = 0;
+    module->stats.best_nonce_diff = PERSIST_get(PERSIST_BEST_DIFF);
     module->start_time = esp_timer_get_time();
     module->lastClockSync = 0;
-    module->FOUND_BLOCK = false;
+
+    // about 25 KB, kept out of the internal RAM
+    share_log = heap_caps_malloc(sizeof(ShareLog), MALLOC_CAP_SPIRAM);
+    if (share_log != NULL) {
+        STRATUM_share_log_init(share_log);
+    } else {
+        ESP_LOGE(TAG, "No PSRAM for the share log, it is not kept");
+    }
     
     // set the pool url
     module->pool_url = nvs_config_get_string(NVS_CONFIG_STRATUM_URL, CONFIG_STRATUM_URL);
@@ -75,8 +88,8 @@ void SYSTEM_init_system(GlobalState * GLOBAL_STATE)
     ESP_LOGI(TAG, "Initial overheat_mode value: %d", module->overheat_mode);
 
     // set the best diff string
-    _suffix_string(module->best_nonce_diff, module->best_diff_string, DIFF_STRING_SIZE, 0);
-    _suffix_string(module->best_session_nonce_diff, module->best_session_diff_string, DIFF_STRING_SIZE, 0);
+    _suffix_string(module->stats.best_nonce_diff, module->stats.best_diff_string, DIFF_STRING_SIZE, 0);
+    _suffix_string(module->stats.best_session_nonce_diff, module->stats.best_session_diff_string, DIFF_STRING_SIZE, 0);
 
     // set the ssid string to blank
     memset(module->ssid, 0, sizeof(module->ssid));
@@ -153,25 +166,126 @@ void SYSTEM_init_peripherals(GlobalState * GLOBAL_STATE) {
     netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
 }
 
-void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE)
+/// @brief enters the seqlock over the stats, called with found_nonce_lock held so writers never overlap
+static void _stats_write_begin(SystemModule * module)
+{
+    unsigned int sequence = atomic_load_explicit(&module->stats_sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&module->stats_sequence, sequence + 1, memory_order_relaxed);
+    // the odd sequence is visible before any of the stats change
+    atomic_thread_fence(memory_order_release);
+}
+
+static void _stats_write_end(SystemModule * module)
+{
+    unsigned int sequence = atomic_load_explicit(&module->stats_sequence, memory_order_relaxed);
+
+    atomic_store_explicit(&module->stats_sequence, sequence + 1, memory_order_release);
+}
+
+/// @brief copies the stats without blocking their writers, retrying while one was inside
+void SYSTEM_get_stats(GlobalState * GLOBAL_STATE, SystemStats * stats)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+    unsigned int begin, end;
+    int attempts = 0;
+
+    do {
+        // a writer of lower priority preempted inside its update has to get to run
+        if (attempts++ > 3) {
+            vTaskDelay(1);
+        }
+        begin = atomic_load_explicit(&module->stats_sequence, memory_order_acquire);
+        memcpy(stats, &module->stats, sizeof(*stats));
+        atomic_thread_fence(memory_order_acquire);
+        end = atomic_load_explicit(&module->stats_sequence, memory_order_relaxed);
+    } while ((begin & 1) != 0 || begin != end);
+}
+
+void SYSTEM_notify_share_submitted(GlobalState * GLOBAL_STATE, const ShareLogEntry * share)
+{
+    if (share_log == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&share_log_lock);
+    STRATUM_share_log_submitted(share_log, share);
+    pthread_mutex_unlock(&share_log_lock);
+}
+
+static void _share_answered(int64_t message_id, bool accepted, const char * reason)
+{
+    if (share_log == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&share_log_lock);
+    STRATUM_share_log_answered(share_log, message_id, accepted, reason, esp_timer_get_time());
+    pthread_mutex_unlock(&share_log_lock);
+}
+
+void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE, int64_t message_id)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
-    module->shares_accepted++;
+    _share_answered(message_id, true, NULL);
+
+    pthread_mutex_lock(&found_nonce_lock);
+    _stats_write_begin(module);
+    module->stats.shares_accepted++;
+    _stats_write_end(module);
+    pthread_mutex_unlock(&found_nonce_lock);
 }
 
-void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE)
+void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, int64_t message_id, const char * reason)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
-    module->shares_rejected++;
+    _share_answered(message_id, false, reason);
+
+    pthread_mutex_lock(&found_nonce_lock);
+    _stats_write_begin(module);
+    module->stats.shares_rejected++;
+    _stats_write_end(module);
+    pthread_mutex_unlock(&found_nonce_lock);
+}
+
+/// @brief the shares still pending on the previous connection will not be answered, their message ids are reused
+void SYSTEM_notify_pool_connected(GlobalState * GLOBAL_STATE)
+{
+    if (share_log == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&share_log_lock);
+    STRATUM_share_log_unanswered(share_log);
+    pthread_mutex_unlock(&share_log_lock);
+}
+
+/// @brief publishes the readings of a power management pass as one update
+void SYSTEM_notify_power(GlobalState * GLOBAL_STATE)
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+    PowerManagementModule * power_management = &GLOBAL_STATE->POWER_MANAGEMENT_MODULE;
+
+    pthread_mutex_lock(&found_nonce_lock);
+    _stats_write_begin(module);
+    module->stats.power = power_management->power;
+    module->stats.voltage = power_management->voltage;
+    module->stats.current = power_management->current;
+    module->stats.chip_temp_avg = power_management->chip_temp_avg;
+    module->stats.vr_temp = power_management->vr_temp;
+    module->stats.fan_perc = power_management->fan_perc;
+    module->stats.fan_rpm = power_management->fan_rpm;
+    _stats_write_end(module);
+    pthread_mutex_unlock(&found_nonce_lock);
 }
 
 void SYSTEM_notify_mining_started(GlobalState * GLOBAL_STATE)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
-    module->duration_start = esp_timer_get_time();
+    // the time spent on init does not count toward the hashrate
+    pthread_mutex_lock(&found_nonce_lock);
+    ASIC_hashrate_init(&module->hashrate, esp_timer_get_time());
+    pthread_mutex_unlock(&found_nonce_lock);
 }
 
 void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime)
@@ -190,47 +304,34 @@ void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime)
     settimeofday(&tv, NULL);
 }
 
-void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, uint8_t job_id)
+/// @brief counts a nonce toward the hashrate and the best difficulty, called by the result task of every chain
+/// @param ticket_difficulty ticket mask the nonce was found under
+/// @param target nbits of the job the nonce was found for
+void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, uint32_t ticket_difficulty, uint32_t target)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
-    // Calculate the time difference in seconds with sub-second precision
-    // hashrate = (nonce_difficulty * 2^32) / time_to_find
+    pthread_mutex_lock(&found_nonce_lock);
 
-    module->historical_hashrate[module->historical_hashrate_rolling_index] = GLOBAL_STATE->ASIC_difficulty;
-    module->historical_hashrate_time_stamps[module->historical_hashrate_rolling_index] = esp_timer_get_time();
+    int64_t now_us = esp_timer_get_time();
+    AsicHashrateEstimate estimate;
 
-    module->historical_hashrate_rolling_index = (module->historical_hashrate_rolling_index + 1) % HISTORY_LENGTH;
+    ASIC_hashrate_record(&module->hashrate, ticket_difficulty, now_us);
+    ASIC_hashrate_estimate(&module->hashrate, SYSTEM_HASHRATE_WINDOW, now_us, &estimate);
 
-    // ESP_LOGI(TAG, "nonce_diff %.1f, ttf %.1f, res %.1f", nonce_diff, duration,
-    // historical_hashrate[historical_hashrate_rolling_index]);
-
-    if (module->historical_hashrate_init < HISTORY_LENGTH) {
-        module->historical_hashrate_init++;
-    } else {
-        module->duration_start =
-            module->historical_hashrate_time_stamps[(module->historical_hashrate_rolling_index + 1) % HISTORY_LENGTH];
-    }
-    double sum = 0;
-    for (int i = 0; i < module->historical_hashrate_init; i++) {
-        sum += module->historical_hashrate[i];
-    }
-
-    double duration = (double) (esp_timer_get_time() - module->duration_start) / 1000000;
-
-    double rolling_rate = (sum * 4294967296) / (duration * 1000000000);
-    if (module->historical_hashrate_init < HISTORY_LENGTH) {
-        module->current_hashrate = rolling_rate;
-    } else {
-        // More smoothing
-        module->current_hashrate = ((module->current_hashrate * 9) + rolling_rate) / 10;
+    int bucket = 0;
+    while (bucket < SYSTEM_DIFF_BUCKETS - 1 && found_diff > SYSTEM_diff_bucket_bound(bucket)) {
+        bucket++;
     }
 
+    _stats_write_begin(module);
+    module->stats.current_hashrate = estimate.hashrate;
+    module->stats.diff_buckets[bucket]++;
+    module->stats.diff_sum += found_diff;
+    _check_for_best_diff(GLOBAL_STATE, found_diff, target);
+    _stats_write_end(module);
 
-    // logArrayContents(historical_hashrate, HISTORY_LENGTH);
-    // logArrayContents(historical_hashrate_time_stamps, HISTORY_LENGTH);
-
-    _check_for_best_diff(GLOBAL_STATE, found_diff, job_id);
+    pthread_mutex_unlock(&found_nonce_lock);
 }
 
 static double _calculate_network_difficulty(uint32_t nBits)
@@ -245,28 +346,64 @@ static double _calculate_network_difficulty(uint32_t nBits)
     return difficulty;
 }
 
-static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint8_t job_id)
+/// @brief upper bound of a bucket of the found nonce difficulties, the last bucket has none
+double SYSTEM_diff_bucket_bound(int bucket)
+{
+    return bucket < SYSTEM_DIFF_BUCKETS - 1 ? ldexp(256, 2 * bucket) : INFINITY;
+}
+
+/// @brief copies the logged shares changed after since_version, in id order from after_id
+/// @param version set to the share log version the copy is current to
+/// @return the number of entries copied, -1 while no share log is kept
+int SYSTEM_shares_since(uint32_t since_version, uint32_t after_id, ShareLogEntry * entries, int max, uint32_t * version)
+{
+    if (share_log == NULL) {
+        return -1;
+    }
+    pthread_mutex_lock(&share_log_lock);
+    int count = STRATUM_share_log_since(share_log, since_version, after_id, entries, max);
+    *version = share_log->version;
+    pthread_mutex_unlock(&share_log_lock);
+
+    return count;
+}
+
+/// @brief hashrate of every window with its confidence bounds, from the shortest window
+void SYSTEM_hashrate_estimates(GlobalState * GLOBAL_STATE, AsicHashrateEstimate estimates[ASIC_HASHRATE_WINDOWS])
+{
+    SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
+    int64_t now_us = esp_timer_get_time();
+
+    pthread_mutex_lock(&found_nonce_lock);
+    for (int i = 0; i < ASIC_HASHRATE_WINDOWS; i++) {
+        ASIC_hashrate_estimate(&module->hashrate, i, now_us, &estimates[i]);
+    }
+    pthread_mutex_unlock(&found_nonce_lock);
+}
+
+static void _check_for_best_diff(GlobalState * GLOBAL_STATE, double diff, uint32_t target)
 {
     SystemModule * module = &GLOBAL_STATE->SYSTEM_MODULE;
 
-    if ((uint64_t) diff > module->best_session_nonce_diff) {
-        module->best_session_nonce_diff = (uint64_t) diff;
-        _suffix_string((uint64_t) diff, module->best_session_diff_string, DIFF_STRING_SIZE, 0);
+    if ((uint64_t) diff > module->stats.best_session_nonce_diff) {
+        module->stats.best_session_nonce_diff = (uint64_t) diff;
+        _suffix_string((uint64_t) diff, module->stats.best_session_diff_string, DIFF_STRING_SIZE, 0);
     }
 
-    if ((uint64_t) diff <= module->best_nonce_diff) {
+    if ((uint64_t) diff <= module->stats.best_nonce_diff) {
         return;
     }
-    module->best_nonce_diff = (uint64_t) diff;
+    module->stats.best_nonce_diff = (uint64_t) diff;
 
-    nvs_config_set_u64(NVS_CONFIG_BEST_DIFF, module->best_nonce_diff);
+    // written behind by PERSIST_task, flash latency must not hold up the result tasks
+    PERSIST_set_max(PERSIST_BEST_DIFF, module->stats.best_nonce_diff);
 
     // make the best_nonce_diff into a string
-    _suffix_string((uint64_t) diff, module->best_diff_string, DIFF_STRING_SIZE, 0);
+    _suffix_string((uint64_t) diff, module->stats.best_diff_string, DIFF_STRING_SIZE, 0);
 
-    double network_diff = _calculate_network_difficulty(GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->target);
+    double network_diff = _calculate_network_difficulty(target);
     if (diff > network_diff) {
-        module->FOUND_BLOCK = true;
+        module->stats.FOUND_BLOCK = true;
         ESP_LOGI(TAG, "FOUND BLOCK!!!!!!!!!!!!!!!!!!!!!! %f > %f", diff, network_diff);
     }
     ESP_LOGI(TAG, "Network diff: %f", network_diff);
@@ -2,14 +2,25 @@
 #define SYSTEM_H_
 
 #include "global_state.h"
+#include "share_log.h"
+
+// window of the hashrate shown on the screen and reported as hashRate, 10 minutes
+#define SYSTEM_HASHRATE_WINDOW 1
 
 void SYSTEM_init_system(GlobalState * GLOBAL_STATE);
 void SYSTEM_init_peripherals(GlobalState * GLOBAL_STATE);
 
-void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE);
-void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE);
-void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, uint8_t job_id);
+void SYSTEM_notify_share_submitted(GlobalState * GLOBAL_STATE, const ShareLogEntry * share);
+void SYSTEM_notify_accepted_share(GlobalState * GLOBAL_STATE, int64_t message_id);
+void SYSTEM_notify_rejected_share(GlobalState * GLOBAL_STATE, int64_t message_id, const char * reason);
+void SYSTEM_notify_pool_connected(GlobalState * GLOBAL_STATE);
+void SYSTEM_notify_power(GlobalState * GLOBAL_STATE);
+void SYSTEM_notify_found_nonce(GlobalState * GLOBAL_STATE, double found_diff, uint32_t ticket_difficulty, uint32_t target);
 void SYSTEM_notify_mining_started(GlobalState * GLOBAL_STATE);
 void SYSTEM_notify_new_ntime(GlobalState * GLOBAL_STATE, uint32_t ntime);
+void SYSTEM_get_stats(GlobalState * GLOBAL_STATE, SystemStats * stats);
+double SYSTEM_diff_bucket_bound(int bucket);
+int SYSTEM_shares_since(uint32_t since_version, uint32_t after_id, ShareLogEntry * entries, int max, uint32_t * version);
+void SYSTEM_hashrate_estimates(GlobalState * GLOBAL_STATE, AsicHashrateEstimate estimates[ASIC_HASHRATE_WINDOWS]);
 
 #endif /* SYSTEM_H_ */
@@ -3,56 +3,162 @@
 #include "serial.h"
 #include "bm1397.h"
 #include <string.h>
+#include <time.h>
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_config.h"
 #include "utils.h"
 #include "stratum_task.h"
 #include <lwip/tcpip.h>
+#include <pthread.h>
 
 static const char *TAG = "asic_result";
 
+// the result tasks of all chains share the pool socket and its message ids
+static pthread_mutex_t submit_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// the users the shares are submitted as, copied out of the config when they change instead of on every share
+// and swapped under submit_lock
+static char *stratum_user = NULL;
+static char *fallback_stratum_user = NULL;
+static pthread_once_t users_once = PTHREAD_ONCE_INIT;
+
+static void load_users(const char *key, void *ctx)
+{
+    char *user = nvs_config_get_string(NVS_CONFIG_STRATUM_USER, STRATUM_USER);
+    char *fallback_user = nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_USER, FALLBACK_STRATUM_USER);
+
+    pthread_mutex_lock(&submit_lock);
+    char *old_user = stratum_user;
+    char *old_fallback_user = fallback_stratum_user;
+    stratum_user = user;
+    fallback_stratum_user = fallback_user;
+    pthread_mutex_unlock(&submit_lock);
+
+    free(old_user);
+    free(old_fallback_user);
+}
+
+/// @brief loads the users once for the result tasks of all chains and follows later changes
+static void init_users(void)
+{
+    load_users(NULL, NULL);
+    nvs_config_subscribe(NVS_CONFIG_STRATUM_USER, load_users, NULL);
+    nvs_config_subscribe(NVS_CONFIG_FALLBACK_STRATUM_USER, load_users, NULL);
+}
+
+/// @brief reads the results of one chain, started once per chain with the AsicChain as parameter
 void ASIC_result_task(void *pvParameters)
 {
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    AsicChain *chain = (AsicChain *)pvParameters;
+    GlobalState *GLOBAL_STATE = (GlobalState *)chain->global_state;
+    AsicNonceFilter *nonce_filter = &chain->ASIC_TASK_MODULE.nonce_filter;
+
+    ASIC_nonce_filter_init(nonce_filter);
+    pthread_once(&users_once, init_users);
 
     while (1)
     {
-        task_result *asic_result = (*GLOBAL_STATE->ASIC_functions.receive_result_fn)(GLOBAL_STATE);
+        if (chain->ASIC_TASK_MODULE.recovering)
+        {
+            // the ASIC task owns the UART while it re-initializes the chain
+            chain->ASIC_TASK_MODULE.rx_parked = true;
+            while (chain->ASIC_TASK_MODULE.recovering)
+            {
+                vTaskDelay(100 / portTICK_PERIOD_MS);
+            }
+            chain->ASIC_TASK_MODULE.rx_parked = false;
+        }
+
+        task_result *asic_result = (*GLOBAL_STATE->ASIC_functions.receive_result_fn)(GLOBAL_STATE, chain->id);
 
         if (asic_result == NULL)
         {
             continue;
         }
 
+        if (asic_result->is_register)
+        {
+            if (asic_result->register_address == ASIC_HASH_COUNTER_REGISTER)
+            {
+                ASIC_stats_record_hash_counter(&chain->ASIC_STATS_MODULE, asic_result->asic_nr, asic_result->register_value,
+                                               ASIC_HASH_COUNTER_HASHES, esp_timer_get_time());
+            }
+            continue;
+        }
+
         uint8_t job_id = asic_result->job_id;
 
-        if (GLOBAL_STATE->valid_jobs[job_id] == 0)
+        if (chain->valid_jobs[job_id] == 0)
         {
-            ESP_LOGI(TAG, "Invalid job nonce found, 0x%02X", job_id);
+            ESP_LOGI(TAG, "Invalid job nonce found on chain %u, 0x%02X", chain->id, job_id);
+            ASIC_stats_record(&chain->ASIC_STATS_MODULE, asic_result->asic_nr, asic_result->core_id, asic_result->small_core_id,
+                              ASIC_RESULT_INVALID_JOB, 0, esp_timer_get_time());
             continue;
         }
 
         // check the nonce difficulty
         double nonce_diff = test_nonce_value(
-            GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id],
+            chain->ASIC_TASK_MODULE.active_jobs[job_id],
             asic_result->nonce,
             asic_result->rolled_version);
 
+        // every nonce returned by the chip should meet the ticket mask, anything below is a hardware error
+        if (nonce_diff < chain->ASIC_difficulty * 0.99)
+        {
+            ESP_LOGW(TAG, "HW error on chain %u chip %d, nonce %08" PRIX32 " diff %.1f below ticket mask %" PRIu32, chain->id, asic_result->asic_nr,
+                     asic_result->nonce, nonce_diff, chain->ASIC_difficulty);
+            ASIC_stats_record(&chain->ASIC_STATS_MODULE, asic_result->asic_nr, asic_result->core_id, asic_result->small_core_id,
+                              ASIC_RESULT_HW_ERROR, 0, esp_timer_get_time());
+            continue;
+        }
+
+        // overlapping nonce ranges and echoed frames report the same share twice, the pool would reject the second
+        if (!ASIC_nonce_filter_check(nonce_filter, job_id, chain->ASIC_TASK_MODULE.active_jobs[job_id]->dispatch_seq, asic_result->nonce,
+                                     asic_result->rolled_version))
+        {
+            ESP_LOGW(TAG, "Duplicate nonce %08" PRIX32 " ver %08" PRIX32 " on chain %u job 0x%02X dropped, %lu so far", asic_result->nonce,
+                     asic_result->rolled_version, chain->id, job_id, nonce_filter->duplicates);
+            continue;
+        }
+
+        // the mask the nonce was found under, the lower one stays in force until the grace period of a raise ends,
+        // the chip stats and the hashrate weight the nonce the same
+        uint32_t ticket_difficulty = chain->ASIC_difficulty;
+        ASIC_stats_record(&chain->ASIC_STATS_MODULE, asic_result->asic_nr, asic_result->core_id, asic_result->small_core_id,
+                          ASIC_RESULT_VALID, ticket_difficulty, esp_timer_get_time());
+        ASIC_watchdog_feed(&chain->ASIC_TASK_MODULE.watchdog, esp_timer_get_time());
+
         //log the ASIC response
-        ESP_LOGI(TAG, "Ver: %08" PRIX32 " Nonce %08" PRIX32 " diff %.1f of %ld.", asic_result->rolled_version, asic_result->nonce, nonce_diff, GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->pool_diff);
+        ESP_LOGI(TAG, "Ver: %08" PRIX32 " Nonce %08" PRIX32 " diff %.1f of %ld.", asic_result->rolled_version, asic_result->nonce, nonce_diff, chain->ASIC_TASK_MODULE.active_jobs[job_id]->pool_diff);
 
-        if (nonce_diff > GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->pool_diff)
+        if (nonce_diff > chain->ASIC_TASK_MODULE.active_jobs[job_id]->pool_diff)
         {
-            char * user = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? nvs_config_get_string(NVS_CONFIG_FALLBACK_STRATUM_USER, FALLBACK_STRATUM_USER) : nvs_config_get_string(NVS_CONFIG_STRATUM_USER, STRATUM_USER);
+            ShareLogEntry share = {
+                .time = time(NULL),
+                .chain = chain->id,
+                .chip = asic_result->asic_nr,
+                .pool = GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback,
+                .nonce_diff = nonce_diff,
+                .pool_diff = chain->ASIC_TASK_MODULE.active_jobs[job_id]->pool_diff,
+            };
+            strncpy(share.job_id, chain->ASIC_TASK_MODULE.active_jobs[job_id]->jobid, sizeof(share.job_id) - 1);
+            int message_id;
+            pthread_mutex_lock(&submit_lock);
+            share.submitted_us = esp_timer_get_time();
             int ret = STRATUM_V1_submit_share(
                 GLOBAL_STATE->sock,
-                user,
-                GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->jobid,
-                GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->extranonce2,
-                GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->ntime,
+                GLOBAL_STATE->SYSTEM_MODULE.is_using_fallback ? fallback_stratum_user : stratum_user,
+                chain->ASIC_TASK_MODULE.active_jobs[job_id]->jobid,
+                chain->ASIC_TASK_MODULE.active_jobs[job_id]->extranonce2,
+                chain->ASIC_TASK_MODULE.active_jobs[job_id]->ntime,
                 asic_result->nonce,
-                asic_result->rolled_version ^ GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[job_id]->version);
-            free(user);
+                asic_result->rolled_version ^ chain->ASIC_TASK_MODULE.active_jobs[job_id]->version,
+                &message_id);
+            share.message_id = message_id;
+            // the answer takes a round trip to the pool, the share is logged long before the stratum task reads it
+            SYSTEM_notify_share_submitted(GLOBAL_STATE, &share);
+            pthread_mutex_unlock(&submit_lock);
 
             if (ret < 0) {
                 ESP_LOGI(TAG, "Unable to write share to socket. Closing connection. Ret: %d (errno %d: %s)", ret, errno, strerror(errno));
@@ -60,6 +166,6 @@ void ASIC_result_task(void *pvParameters)
             }
         }
 
-        SYSTEM_notify_found_nonce(GLOBAL_STATE, nonce_diff, job_id);
+        SYSTEM_notify_found_nonce(GLOBAL_STATE, nonce_diff, ticket_difficulty, chain->ASIC_TASK_MODULE.active_jobs[job_id]->target);
     }
 }
\ No newline at end of file
@@ -3,38 +3,332 @@
 #include "serial.h"
 #include "bm1397.h"
 #include <string.h>
+#include <limits.h>
+#include "utils.h"
+#include "nvs_config.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
 static const char *TAG = "ASIC_task";
 
+#define DISPATCH_TIMER_BIT 0x01
+#define DISPATCH_PREEMPT_BIT 0x02
+
+// how often the dispatch jitter summary is logged
+#define DISPATCH_STATS_LOG_INTERVAL_US (60 * 1000 * 1000)
+
+// how often the hash counter registers are read
+#define HASH_COUNTER_POLL_INTERVAL_US (5 * 1000 * 1000)
+
+// how often the registers are read back when verification is enabled
+#define REGISTER_VERIFY_INTERVAL_US (600LL * 1000 * 1000)
+
+// time after raising the ticket mask during which results of the lower mask still count as valid
+#define TICKET_RAISE_GRACE_US (1000 * 1000)
+
+// longest wait for the result task to leave the UART before a recovery, covers a full receive timeout
+#define RECOVERY_PARK_TIMEOUT_MS 15000
+#define RECOVERY_PARK_POLL_MS 100
+
 // static bm_job ** active_jobs; is required to keep track of the active jobs since the
 
-void ASIC_task(void *pvParameters)
+static void dispatch_timer_callback(void *arg)
 {
-    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+    TaskHandle_t task_handle = (TaskHandle_t)arg;
+    xTaskNotify(task_handle, DISPATCH_TIMER_BIT, eSetBits);
+}
+
+static uint64_t job_period_us(AsicChain *chain)
+{
+    return (uint64_t)(chain->asic_job_frequency_ms * 1000.0);
+}
+
+static void record_dispatch(AsicDispatchStats *stats, int64_t jitter_us)
+{
+    stats->last_jitter_us = jitter_us;
+    if (jitter_us > stats->max_jitter_us) {
+        stats->max_jitter_us = jitter_us;
+    }
+    stats->dispatches++;
+    stats->mean_jitter_us += (jitter_us - stats->mean_jitter_us) / stats->dispatches;
+}
 
-    //initialize the semaphore
-    GLOBAL_STATE->ASIC_TASK_MODULE.semaphore = xSemaphoreCreateBinary();
+static uint64_t small_core_count(GlobalState *GLOBAL_STATE)
+{
+    switch (GLOBAL_STATE->asic_model)
+    {
+        case ASIC_BM1397:
+            return BM1397_SMALL_CORE_COUNT;
+        case ASIC_BM1366:
+            return BM1366_SMALL_CORE_COUNT;
+        case ASIC_BM1368:
+            return BM1368_SMALL_CORE_COUNT;
+        case ASIC_BM1370:
+            return BM1370_SMALL_CORE_COUNT;
+        default:
+            return 0;
+    }
+}
+
+static uint16_t chain_chip_count(GlobalState *GLOBAL_STATE, AsicChain *chain)
+{
+    return chain->detected_asic_count > 0 ? chain->detected_asic_count : GLOBAL_STATE->asic_count;
+}
+
+/// @brief frequency a chip runs at, the tuned one if the tuner moved it off the chain frequency
+static float chip_frequency(GlobalState *GLOBAL_STATE, AsicChain *chain, uint16_t chip_count, int asic_nr)
+{
+    FreqTuner *tuner = &chain->FREQ_TUNER_MODULE;
+
+    if (tuner->chips != NULL && tuner->chip_count == chip_count && tuner->chips[asic_nr].frequency > 0)
+    {
+        return tuner->chips[asic_nr].frequency;
+    }
+    return GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
+}
+
+static double expected_hashrate_ghs(GlobalState *GLOBAL_STATE, AsicChain *chain)
+{
+    uint16_t chip_count = chain_chip_count(GLOBAL_STATE, chain);
+    double frequency_sum = 0;
+
+    for (int i = 0; i < chip_count; i++)
+    {
+        frequency_sum += chip_frequency(GLOBAL_STATE, chain, chip_count, i);
+    }
+    return frequency_sum * small_core_count(GLOBAL_STATE) / 1000.0;
+}
+
+/// @brief moves the ticket mask with the expected hashrate and the pool difficulty
+static void update_ticket_difficulty(GlobalState *GLOBAL_STATE, AsicChain *chain, int64_t now_us)
+{
+    AsicTaskModule *module = &chain->ASIC_TASK_MODULE;
+
+    if (GLOBAL_STATE->ASIC_functions.set_difficulty_mask_fn == NULL)
+    {
+        return;
+    }
+
+    if (chain->ASIC_difficulty < module->ticket_difficulty && now_us - module->ticket_changed_us >= TICKET_RAISE_GRACE_US)
+    {
+        chain->ASIC_difficulty = module->ticket_difficulty;
+    }
 
-    GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs = malloc(sizeof(bm_job *) * 128);
-    GLOBAL_STATE->valid_jobs = malloc(sizeof(uint8_t) * 128);
+    double hashrate_ghs = expected_hashrate_ghs(GLOBAL_STATE, chain);
+    uint32_t difficulty = ASIC_calculate_ticket_difficulty(hashrate_ghs, GLOBAL_STATE->stratum_difficulty, module->ticket_difficulty);
+
+    if (difficulty == module->ticket_difficulty)
+    {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Chain %u ticket difficulty %lu -> %lu (%.0f GH/s, pool difficulty %lu)", chain->id, module->ticket_difficulty, difficulty,
+             hashrate_ghs, GLOBAL_STATE->stratum_difficulty);
+
+    // lowered right away so nothing found under the new mask is taken for a hardware error,
+    // raised only after the grace period
+    if (difficulty < chain->ASIC_difficulty)
+    {
+        chain->ASIC_difficulty = difficulty;
+    }
+
+    (*GLOBAL_STATE->ASIC_functions.set_difficulty_mask_fn)(chain->id, difficulty);
+    module->ticket_difficulty = difficulty;
+    module->ticket_changed_us = now_us;
+}
+
+static void update_chain_job_interval(GlobalState *GLOBAL_STATE, AsicChain *chain);
+
+/// @brief makes the result task of a chain leave the UART so the chips can be talked to directly
+/// @return false if it did not within a receive timeout, the chain is left as it was
+static bool park_result_task(AsicTaskModule *module)
+{
+    // the result task may be waiting on the UART for up to a receive timeout
+    module->recovering = true;
+    for (int waited_ms = 0; !module->rx_parked && waited_ms < RECOVERY_PARK_TIMEOUT_MS; waited_ms += RECOVERY_PARK_POLL_MS)
+    {
+        vTaskDelay(RECOVERY_PARK_POLL_MS / portTICK_PERIOD_MS);
+    }
+    if (!module->rx_parked)
+    {
+        module->recovering = false;
+        return false;
+    }
+    return true;
+}
+
+/// @brief re-runs the reset, init and baud sequence of main on a stalled chain, the pool connection stays up
+/// @return false if the result task did not leave the UART and nothing was done
+static bool recover_chain(GlobalState *GLOBAL_STATE, AsicChain *chain, int64_t now_us)
+{
+    AsicTaskModule *module = &chain->ASIC_TASK_MODULE;
+    AsicWatchdog *watchdog = &module->watchdog;
+    float frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
+
+    ESP_LOGE(TAG, "Chain %u not sending data for %lld s (timeout %lld s), re-initializing it", chain->id,
+             (now_us - ASIC_watchdog_last_nonce_us(watchdog)) / 1000000,
+             ASIC_watchdog_timeout_us(watchdog, expected_hashrate_ghs(GLOBAL_STATE, chain), module->ticket_difficulty) / 1000000);
+
+    if (!park_result_task(module))
+    {
+        ESP_LOGE(TAG, "Result task did not release the UART, chain recovery skipped");
+        return false;
+    }
+
+    // a tuner or frequency write sent now would land between the reset and the init
+    pthread_mutex_lock(&chain->chip_lock);
+    chain->ASIC_initalized = false;
+    esp_timer_stop(module->dispatch_timer);
+    int64_t start_us = esp_timer_get_time();
+
+    // the reset puts the chips back on their default baud rate
+    SERIAL_set_baud(chain->id, SERIAL_DEFAULT_BAUD);
+    SERIAL_clear_buffer(chain->id);
+    uint8_t chip_count = (*GLOBAL_STATE->ASIC_functions.init_fn)(chain->id, frequency, GLOBAL_STATE->asic_count);
+    SERIAL_set_baud(chain->id, (*GLOBAL_STATE->ASIC_functions.set_max_baud_fn)(chain->id));
+    SERIAL_clear_buffer(chain->id);
+
+    // the init left the model defaults in the chips, put back what was set since boot
+    if (GLOBAL_STATE->ASIC_functions.set_difficulty_mask_fn != NULL)
+    {
+        (*GLOBAL_STATE->ASIC_functions.set_difficulty_mask_fn)(chain->id, module->ticket_difficulty);
+    }
+    if (GLOBAL_STATE->version_mask != 0)
+    {
+        (*GLOBAL_STATE->ASIC_functions.set_version_mask)(chain->id, GLOBAL_STATE->version_mask);
+    }
+    // the tuned frequencies are only put back while the tuner runs, turning it off moved the chips to the chain frequency
+    FreqTuner *tuner = &chain->FREQ_TUNER_MODULE;
+    if (GLOBAL_STATE->ASIC_functions.set_chip_frequency_fn != NULL && chip_count == tuner->chip_count &&
+        nvs_config_get_u16(NVS_CONFIG_AUTO_TUNE, 0) != 0)
+    {
+        for (int i = 0; i < tuner->chip_count; i++)
+        {
+            if (tuner->chips[i].frequency > 0 && tuner->chips[i].frequency != frequency)
+            {
+                (*GLOBAL_STATE->ASIC_functions.set_chip_frequency_fn)(chain->id, i, tuner->chips[i].frequency);
+            }
+        }
+    }
+
+    if (chip_count > 0 && chip_count != chain->detected_asic_count)
+    {
+        ESP_LOGW(TAG, "%u chip(s) answered after the re-init, %u before", chip_count, chain->detected_asic_count);
+        chain->detected_asic_count = chip_count;
+        update_chain_job_interval(GLOBAL_STATE, chain);
+    }
+
+    int64_t end_us = esp_timer_get_time();
+    ASIC_watchdog_recovered(watchdog, chip_count > 0, start_us, end_us);
+
+    if (chip_count > 0)
+    {
+        ESP_LOGI(TAG, "Chain %u recovery %lu took %lld ms after %lld s without a nonce, %u chip(s)", chain->id, watchdog->recoveries,
+                 watchdog->last_recovery_duration_us / 1000, watchdog->last_stall_us / 1000000, chip_count);
+    }
+    else
+    {
+        ESP_LOGE(TAG, "Chain %u recovery %lu took %lld ms and found no chips, %lu failed so far", chain->id, watchdog->recoveries,
+                 watchdog->last_recovery_duration_us / 1000, watchdog->failed_recoveries);
+    }
+
+    chain->ASIC_initalized = true;
+    pthread_mutex_unlock(&chain->chip_lock);
+    module->recovering = false;
+
+    return true;
+}
+
+/// @brief moves a chain whose link exceeded its error budget to the next slower UART rate
+/// @return true if the chain was touched and its job schedule has to restart
+static bool fall_back_chain(GlobalState *GLOBAL_STATE, AsicChain *chain, int64_t now_us)
+{
+    AsicTaskModule *module = &chain->ASIC_TASK_MODULE;
+    AsicLink *link = SERIAL_link(chain->id);
+
+    ESP_LOGW(TAG, "Chain %u link errors above %.1f%% at %d baud, falling back", chain->id, ASIC_LINK_MAX_ERROR_RATE * 100,
+             ASIC_link_baud(link));
+
+    if (!park_result_task(module))
+    {
+        ESP_LOGE(TAG, "Result task did not release the UART, baud fallback skipped");
+        // the next window decides again
+        link->degraded = false;
+        return false;
+    }
+
+    pthread_mutex_lock(&chain->chip_lock);
+    int baud = (*GLOBAL_STATE->ASIC_functions.fall_back_baud_fn)(chain->id);
+    pthread_mutex_unlock(&chain->chip_lock);
+    if (baud < 0)
+    {
+        // the chips did not come back at the slower rate, the reset renegotiates below the failed rate
+        ESP_LOGE(TAG, "Chain %u lost during the baud fallback", chain->id);
+        recover_chain(GLOBAL_STATE, chain, now_us);
+        return true;
+    }
+
+    SERIAL_clear_buffer(chain->id);
+    ESP_LOGI(TAG, "Chain %u now at %d baud", chain->id, baud);
+    module->recovering = false;
+    return true;
+}
+
+/// @brief feeds one chain, started once per chain with the AsicChain as parameter
+void ASIC_task(void *pvParameters)
+{
+    AsicChain *chain = (AsicChain *)pvParameters;
+    GlobalState *GLOBAL_STATE = (GlobalState *)chain->global_state;
+    AsicTaskModule *module = &chain->ASIC_TASK_MODULE;
+
+    module->active_jobs = malloc(sizeof(bm_job *) * 128);
+    chain->valid_jobs = malloc(sizeof(uint8_t) * 128);
     for (int i = 0; i < 128; i++)
     {
-        GLOBAL_STATE->ASIC_TASK_MODULE.active_jobs[i] = NULL;
-        GLOBAL_STATE->valid_jobs[i] = 0;
+        module->active_jobs[i] = NULL;
+        chain->valid_jobs[i] = 0;
     }
 
-    ESP_LOGI(TAG, "ASIC Job Interval: %.2f ms", GLOBAL_STATE->asic_job_frequency_ms);
-    SYSTEM_notify_mining_started(GLOBAL_STATE);
-    ESP_LOGI(TAG, "ASIC Ready!");
+    memset(&module->dispatch_stats, 0, sizeof(AsicDispatchStats));
+    // the drivers program the model default during init
+    module->ticket_difficulty = chain->ASIC_difficulty;
+    module->ticket_changed_us = 0;
+    module->task_handle = xTaskGetCurrentTaskHandle();
+    module->recovering = false;
+    module->rx_parked = false;
+    ASIC_watchdog_init(&module->watchdog, esp_timer_get_time());
 
-    while (1)
+    const esp_timer_create_args_t timer_args = {
+        .callback = &dispatch_timer_callback,
+        .arg = module->task_handle,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "asic dispatch",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &module->dispatch_timer));
+
+    ESP_LOGI(TAG, "Chain %u Job Interval: %.2f ms", chain->id, chain->asic_job_frequency_ms);
+    if (chain->id == 0)
     {
+        SYSTEM_notify_mining_started(GLOBAL_STATE);
+    }
+    ESP_LOGI(TAG, "Chain %u Ready!", chain->id);
+
+    uint64_t period_us = 0;
+    int64_t next_dispatch_us = 0;
+    int64_t last_stats_log_us = esp_timer_get_time();
+    int64_t last_counter_poll_us = 0;
+    // the first pass runs right after init
+    int64_t last_verify_us = -REGISTER_VERIFY_INTERVAL_US;
+    bool verify_registers = GLOBAL_STATE->ASIC_functions.verify_registers_fn != NULL && nvs_config_get_u16(NVS_CONFIG_REGISTER_VERIFY, 0) != 0;
+    bool preempted = true;
 
-        bm_job *next_bm_job = (bm_job *)queue_dequeue(&GLOBAL_STATE->ASIC_jobs_queue);
+    while (1)
+    {
+        int64_t wait_start_us = esp_timer_get_time();
+        bm_job *next_bm_job = (bm_job *)queue_dequeue(&chain->ASIC_jobs_queue);
 
         if (next_bm_job->pool_diff != GLOBAL_STATE->stratum_difficulty)
         {
@@ -42,11 +336,165 @@ void ASIC_task(void *pvParameters)
             GLOBAL_STATE->stratum_difficulty = next_bm_job->pool_diff;
         }
 
-        (*GLOBAL_STATE->ASIC_functions.send_work_fn)(GLOBAL_STATE, next_bm_job); // send the job to the ASIC
+        int64_t now_us = esp_timer_get_time();
+
+        // a chain left without work finds nothing, the silence only counts while jobs are sent
+        if (now_us - wait_start_us > (int64_t)job_period_us(chain))
+        {
+            ASIC_watchdog_restart(&module->watchdog, now_us);
+            // the periods spent waiting for work were not missed, the schedule restarts from this job
+            preempted = true;
+        }
+        else if (ASIC_watchdog_stalled(&module->watchdog, expected_hashrate_ghs(GLOBAL_STATE, chain), module->ticket_difficulty, now_us) &&
+                 recover_chain(GLOBAL_STATE, chain, now_us))
+        {
+            now_us = esp_timer_get_time();
+            preempted = true;
+        }
+        else if (GLOBAL_STATE->ASIC_functions.fall_back_baud_fn != NULL && SERIAL_link(chain->id)->degraded &&
+                 fall_back_chain(GLOBAL_STATE, chain, now_us))
+        {
+            now_us = esp_timer_get_time();
+            preempted = true;
+        }
+
+        update_ticket_difficulty(GLOBAL_STATE, chain, now_us);
+        next_bm_job->dispatch_seq = ++module->dispatch_seq;
+        (*GLOBAL_STATE->ASIC_functions.send_work_fn)(GLOBAL_STATE, chain->id, next_bm_job); // send the job to the ASIC
+
+        if (preempted || job_period_us(chain) != period_us)
+        {
+            // (re)start the schedule from this dispatch, either because new work
+            // preempted the running job or because the job interval changed
+            period_us = job_period_us(chain);
+            esp_timer_stop(module->dispatch_timer);
+            ESP_ERROR_CHECK(esp_timer_start_periodic(module->dispatch_timer, period_us));
+            next_dispatch_us = now_us + period_us;
+            preempted = false;
+        }
+        else
+        {
+            // late dispatches that skipped a whole period left the chips idle
+            while (now_us - next_dispatch_us >= (int64_t)period_us)
+            {
+                next_dispatch_us += period_us;
+                module->dispatch_stats.missed_periods++;
+            }
+            record_dispatch(&module->dispatch_stats, now_us - next_dispatch_us);
+            next_dispatch_us += period_us;
+        }
+
+        // a tick that fired while the dispatch was late or waiting for work is for the job just sent,
+        // left set it would replace that job right away
+        ulTaskNotifyValueClear(NULL, DISPATCH_TIMER_BIT);
+
+        // read right behind a job so the request never splits a job frame and the chips are already busy
+        if (GLOBAL_STATE->ASIC_functions.read_hash_counter_fn != NULL && now_us - last_counter_poll_us >= HASH_COUNTER_POLL_INTERVAL_US)
+        {
+            (*GLOBAL_STATE->ASIC_functions.read_hash_counter_fn)(chain->id);
+            last_counter_poll_us = now_us;
+        }
+
+        if (verify_registers && now_us - last_verify_us >= REGISTER_VERIFY_INTERVAL_US)
+        {
+            (*GLOBAL_STATE->ASIC_functions.verify_registers_fn)(chain->id);
+            last_verify_us = now_us;
+        }
+
+        if (now_us - last_stats_log_us >= DISPATCH_STATS_LOG_INTERVAL_US)
+        {
+            AsicDispatchStats *stats = &module->dispatch_stats;
+            ESP_LOGI(TAG, "Chain %u dispatch jitter: last %lld us, mean %.1f us, max %lld us, %lu jobs, %lu missed periods, %lu preempts",
+                     chain->id, stats->last_jitter_us, stats->mean_jitter_us, stats->max_jitter_us,
+                     stats->dispatches, stats->missed_periods, stats->preempts);
+            last_stats_log_us = now_us;
+        }
+
+        // wait for the next timer period or for new work to preempt the current job
+        uint32_t notification = 0;
+        while (notification == 0)
+        {
+            xTaskNotifyWait(0, ULONG_MAX, &notification, portMAX_DELAY);
+        }
+
+        if (notification & DISPATCH_PREEMPT_BIT)
+        {
+            module->dispatch_stats.preempts++;
+            preempted = true;
+        }
+    }
+}
+
+/// @brief dispatches the next job of every chain immediately instead of waiting for the timer, used for clean jobs
+void ASIC_task_preempt(void *pvParameters)
+{
+    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+
+    for (int i = 0; i < GLOBAL_STATE->chain_count; i++)
+    {
+        if (GLOBAL_STATE->chains[i].ASIC_TASK_MODULE.task_handle != NULL)
+        {
+            xTaskNotify(GLOBAL_STATE->chains[i].ASIC_TASK_MODULE.task_handle, DISPATCH_PREEMPT_BIT, eSetBits);
+        }
+    }
+}
+
+/// @brief recomputes asic_job_frequency_ms of a chain from the chip frequencies, its chip count and version rolling
+/// the dispatch timer picks up the new period on the next job
+static void update_chain_job_interval(GlobalState *GLOBAL_STATE, AsicChain *chain)
+{
+    uint16_t chip_count = chain_chip_count(GLOBAL_STATE, chain);
 
-        // Time to execute the above code is ~0.3ms
-        // Delay for ASIC(s) to finish the job
-        //vTaskDelay((GLOBAL_STATE->asic_job_frequency_ms - 0.3) / portTICK_PERIOD_MS);
-        xSemaphoreTake(GLOBAL_STATE->ASIC_TASK_MODULE.semaphore, (GLOBAL_STATE->asic_job_frequency_ms / portTICK_PERIOD_MS));
+    // every chip searches an equal share of the nonce space, the fastest one runs out of its share first
+    float frequency = 0;
+    for (int i = 0; i < chip_count; i++)
+    {
+        float chip = chip_frequency(GLOBAL_STATE, chain, chip_count, i);
+        if (chip > frequency)
+        {
+            frequency = chip;
+        }
+    }
+
+    // the chips are initialized with the default mask and keep rolling it until the pool sets one
+    uint32_t version_mask = GLOBAL_STATE->version_mask != 0 ? GLOBAL_STATE->version_mask : STRATUM_DEFAULT_VERSION_MASK;
+    uint32_t version_rolls = ASIC_get_version_rolls(version_mask);
+
+    double interval_ms;
+    switch (GLOBAL_STATE->asic_model)
+    {
+        case ASIC_BM1397:
+            // no version-rolling so same Nonce Space is splitted between Small Cores
+            interval_ms = ASIC_calculate_job_interval_ms(frequency, chip_count, BM1397_SMALL_CORE_COUNT, ASIC_NONCE_RANGE_FULL, 1);
+            break;
+        case ASIC_BM1366:
+            interval_ms = ASIC_calculate_job_interval_ms(frequency, chip_count, BM1366_SMALL_CORE_COUNT, BM1366_NONCE_RANGE, version_rolls);
+            break;
+        case ASIC_BM1368:
+            interval_ms = ASIC_calculate_job_interval_ms(frequency, chip_count, BM1368_SMALL_CORE_COUNT, BM1368_NONCE_RANGE, version_rolls);
+            break;
+        case ASIC_BM1370:
+            interval_ms = ASIC_calculate_job_interval_ms(frequency, chip_count, BM1370_SMALL_CORE_COUNT, BM1370_NONCE_RANGE, version_rolls);
+            break;
+        default:
+            return;
+    }
+
+    if (interval_ms != chain->asic_job_frequency_ms)
+    {
+        ESP_LOGI(TAG, "Chain %u Job Interval: %.2f ms (%.0f MHz, %u chip(s), %lu version rolls)", chain->id, interval_ms, frequency, chip_count,
+                 version_rolls);
+        chain->asic_job_frequency_ms = interval_ms;
+    }
+}
+
+/// @brief recomputes the job interval of every chain, each one has its own chip count
+void ASIC_task_update_job_interval(void *pvParameters)
+{
+    GlobalState *GLOBAL_STATE = (GlobalState *)pvParameters;
+
+    for (int i = 0; i < GLOBAL_STATE->chain_count; i++)
+    {
+        update_chain_job_interval(GLOBAL_STATE, &GLOBAL_STATE->chains[i]);
     }
 }
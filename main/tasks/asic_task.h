@@ -2,18 +2,52 @@
 #define ASIC_TASK_H_
 
 #include "freertos/FreeRTOS.h"
-#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
 #include "mining.h"
+#include "asic_nonce_filter.h"
+#include "asic_watchdog.h"
+
+typedef struct
+{
+    // dispatch lateness relative to the timer schedule, in microseconds
+    int64_t last_jitter_us;
+    int64_t max_jitter_us;
+    double mean_jitter_us;
+    uint32_t dispatches;
+    // timer periods that passed without a job being sent
+    uint32_t missed_periods;
+    // immediate dispatches for new blocks / clean jobs
+    uint32_t preempts;
+} AsicDispatchStats;
+
 typedef struct
 {
     // ASIC may not return the nonce in the same order as the jobs were sent
     // it also may return a previous nonce under some circumstances
     // so we keep a list of jobs indexed by the job id
     bm_job **active_jobs;
-    //semaphone
-    SemaphoreHandle_t semaphore;
+    // job dispatch is paced by a periodic esp_timer that notifies the ASIC task
+    TaskHandle_t task_handle;
+    esp_timer_handle_t dispatch_timer;
+    AsicDispatchStats dispatch_stats;
+    // ticket difficulty programmed into the chips, ASIC_difficulty follows it
+    // once results found under a lower mask can no longer be in flight
+    uint32_t ticket_difficulty;
+    int64_t ticket_changed_us;
+    // fed with every valid nonce, a chain that stays silent is re-initialized by the ASIC task
+    AsicWatchdog watchdog;
+    // set while the chain is re-initialized, the result task stays off the UART and sets rx_parked
+    volatile bool recovering;
+    volatile bool rx_parked;
+    // owned by the result task, results the chips reported twice are dropped before submission
+    AsicNonceFilter nonce_filter;
+    // numbers the jobs sent to the chain, starting at 1
+    uint32_t dispatch_seq;
 } AsicTaskModule;
 
 void ASIC_task(void *pvParameters);
+void ASIC_task_preempt(void *pvParameters);
+void ASIC_task_update_job_interval(void *pvParameters);
 
 #endif /* ASIC_TASK_H_ */
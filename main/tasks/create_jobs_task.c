@@ -1,4 +1,5 @@
 #include "work_queue.h"
+#include "asic_dispatch.h"
 #include "global_state.h"
 #include "esp_log.h"
 #include "esp_system.h"
@@ -12,8 +13,8 @@ static const char *TAG = "create_jobs_task";
 
 #define QUEUE_LOW_WATER_MARK 10 // Adjust based on your requirements
 
-static bool should_generate_more_work(GlobalState *GLOBAL_STATE);
-static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint32_t extranonce_2);
+static AsicChain *chain_needing_work(GlobalState *GLOBAL_STATE);
+static void generate_work(GlobalState *GLOBAL_STATE, AsicChain *chain, mining_notify *notification, uint32_t extranonce_2);
 
 void create_jobs_task(void *pvParameters)
 {
@@ -32,16 +33,23 @@ void create_jobs_task(void *pvParameters)
 
         if (GLOBAL_STATE->new_stratum_version_rolling_msg) {
             ESP_LOGI(TAG, "Set chip version rolls %i", (int)(GLOBAL_STATE->version_mask >> 13));
-            (GLOBAL_STATE->ASIC_functions.set_version_mask)(GLOBAL_STATE->version_mask);
+            for (int i = 0; i < GLOBAL_STATE->chain_count; i++) {
+                pthread_mutex_lock(&GLOBAL_STATE->chains[i].chip_lock);
+                (GLOBAL_STATE->ASIC_functions.set_version_mask)(i, GLOBAL_STATE->version_mask);
+                pthread_mutex_unlock(&GLOBAL_STATE->chains[i].chip_lock);
+            }
             GLOBAL_STATE->new_stratum_version_rolling_msg = false;
+            ASIC_task_update_job_interval(GLOBAL_STATE);
         }
 
+        // every job gets its own extranonce_2 whichever chain it goes to, so no two chains hash the same space
         uint32_t extranonce_2 = 0;
         while (GLOBAL_STATE->stratum_queue.count < 1 && GLOBAL_STATE->abandon_work == 0)
         {
-            if (should_generate_more_work(GLOBAL_STATE))
+            AsicChain *chain = chain_needing_work(GLOBAL_STATE);
+            if (chain != NULL)
             {
-                generate_work(GLOBAL_STATE, mining_notification, extranonce_2);
+                generate_work(GLOBAL_STATE, chain, mining_notification, extranonce_2);
 
                 // Increase extranonce_2 for the next job.
                 extranonce_2++;
@@ -56,20 +64,29 @@ void create_jobs_task(void *pvParameters)
         if (GLOBAL_STATE->abandon_work == 1)
         {
             GLOBAL_STATE->abandon_work = 0;
-            ASIC_jobs_queue_clear(&GLOBAL_STATE->ASIC_jobs_queue);
-            xSemaphoreGive(GLOBAL_STATE->ASIC_TASK_MODULE.semaphore);
+            for (int i = 0; i < GLOBAL_STATE->chain_count; i++) {
+                ASIC_jobs_queue_clear(&GLOBAL_STATE->chains[i].ASIC_jobs_queue);
+            }
+            ASIC_task_preempt(GLOBAL_STATE);
         }
 
         STRATUM_V1_free_mining_notify(mining_notification);
     }
 }
 
-static bool should_generate_more_work(GlobalState *GLOBAL_STATE)
+/// @brief the chain with the shortest job queue, NULL if every queue is above the low water mark
+static AsicChain *chain_needing_work(GlobalState *GLOBAL_STATE)
 {
-    return GLOBAL_STATE->ASIC_jobs_queue.count < QUEUE_LOW_WATER_MARK;
+    int queue_counts[ASIC_MAX_CHAINS];
+    for (int i = 0; i < GLOBAL_STATE->chain_count; i++) {
+        queue_counts[i] = GLOBAL_STATE->chains[i].ASIC_jobs_queue.count;
+    }
+
+    int chain = ASIC_dispatch_chain_needing_work(queue_counts, GLOBAL_STATE->chain_count, QUEUE_LOW_WATER_MARK);
+    return chain < 0 ? NULL : &GLOBAL_STATE->chains[chain];
 }
 
-static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification, uint32_t extranonce_2)
+static void generate_work(GlobalState *GLOBAL_STATE, AsicChain *chain, mining_notify *notification, uint32_t extranonce_2)
 {
     char *extranonce_2_str = extranonce_2_generate(extranonce_2, GLOBAL_STATE->extranonce_2_len);
     if (extranonce_2_str == NULL) {
@@ -108,7 +125,12 @@ static void generate_work(GlobalState *GLOBAL_STATE, mining_notify *notification
     queued_next_job->jobid = strdup(notification->job_id);
     queued_next_job->version_mask = GLOBAL_STATE->version_mask;
 
-    queue_enqueue(&GLOBAL_STATE->ASIC_jobs_queue, queued_next_job);
+    // serialize the job for the ASIC now so dispatch only has to write it out
+    if (GLOBAL_STATE->ASIC_functions.prepare_work_fn != NULL) {
+        (*GLOBAL_STATE->ASIC_functions.prepare_work_fn)(queued_next_job);
+    }
+
+    queue_enqueue(&chain->ASIC_jobs_queue, queued_next_job);
 
     free(coinbase_tx);
     free(merkle_root);
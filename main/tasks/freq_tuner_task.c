@@ -0,0 +1,226 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "freq_tuner_task.h"
+#include "global_state.h"
+#include "nvs_config.h"
+
+#define FREQ_TUNER_POLL_RATE_MS 10000
+// frequencies of all chips as "%.2f," fit in here
+#define FREQ_TUNER_NVS_STR_SIZE 256
+#define FREQ_TUNER_DEFAULT_HEADROOM_MHZ 100
+
+static const char * TAG = "freq_tuner";
+
+/// @brief chips counted on all chains, the saved frequencies list them chain after chain
+static int _total_chip_count(GlobalState * GLOBAL_STATE)
+{
+    int count = 0;
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        count += GLOBAL_STATE->chains[c].ASIC_STATS_MODULE.chip_count;
+    }
+    return count;
+}
+
+static void _start_tuning(GlobalState * GLOBAL_STATE, bool use_saved)
+{
+    float frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
+    uint16_t max_frequency = nvs_config_get_u16(NVS_CONFIG_AUTO_TUNE_MAX_FREQ, frequency + FREQ_TUNER_DEFAULT_HEADROOM_MHZ);
+    int total_chip_count = _total_chip_count(GLOBAL_STATE);
+
+    FreqTunerConfig config;
+    FREQ_TUNER_default_config(&config, frequency, max_frequency);
+
+    float * saved = NULL;
+    if (use_saved) {
+        char * saved_str = nvs_config_get_string(NVS_CONFIG_CHIP_FREQUENCIES, "");
+        saved = calloc(total_chip_count, sizeof(float));
+        // a saved result for different chains is not used
+        if (saved != NULL && FREQ_TUNER_parse(saved_str, saved, total_chip_count) != total_chip_count) {
+            free(saved);
+            saved = NULL;
+        }
+        free(saved_str);
+    }
+
+    int offset = 0;
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        AsicChain * chain = &GLOBAL_STATE->chains[c];
+        FreqTuner * tuner = &chain->FREQ_TUNER_MODULE;
+        uint16_t chip_count = chain->ASIC_STATS_MODULE.chip_count;
+
+        pthread_mutex_lock(&chain->chip_lock);
+        if (!FREQ_TUNER_init(tuner, &config, chip_count, frequency, saved != NULL ? saved + offset : NULL)) {
+            pthread_mutex_unlock(&chain->chip_lock);
+            ESP_LOGE(TAG, "Failed to allocate the tuner of chain %d", c);
+            break;
+        }
+        offset += chip_count;
+
+        ESP_LOGI(TAG, "Tuning %d chip(s) of chain %d between %.2f and %.2f MHz%s", tuner->chip_count, c, config.min_frequency,
+                 config.max_frequency, saved != NULL ? ", starting from the saved frequencies" : "");
+
+        // the chain was ramped to a single frequency, move the chips to where the tuner starts them
+        // a chain being re-initialized gets them from the tuner once it is back
+        for (int i = 0; i < tuner->chip_count && chain->ASIC_initalized; i++) {
+            if (tuner->chips[i].frequency != frequency) {
+                GLOBAL_STATE->ASIC_functions.set_chip_frequency_fn(chain->id, i, tuner->chips[i].frequency);
+            }
+        }
+        pthread_mutex_unlock(&chain->chip_lock);
+    }
+
+    free(saved);
+
+    ASIC_task_update_job_interval(GLOBAL_STATE);
+}
+
+/// @brief puts every tuned chip back on the chain frequency and forgets the tuned frequencies
+static void _stop_tuning(GlobalState * GLOBAL_STATE)
+{
+    float frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
+
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        AsicChain * chain = &GLOBAL_STATE->chains[c];
+        FreqTuner * tuner = &chain->FREQ_TUNER_MODULE;
+
+        pthread_mutex_lock(&chain->chip_lock);
+        for (int i = 0; i < tuner->chip_count; i++) {
+            if (chain->ASIC_initalized && tuner->chips[i].frequency > 0 && tuner->chips[i].frequency != frequency) {
+                GLOBAL_STATE->ASIC_functions.set_chip_frequency_fn(chain->id, i, frequency);
+            }
+            // the allocation is kept, the ASIC task reads it without the lock and takes 0 for the chain frequency
+            tuner->chips[i].frequency = 0;
+        }
+        pthread_mutex_unlock(&chain->chip_lock);
+    }
+
+    ESP_LOGI(TAG, "Auto tune disabled, all chips back at %.2f MHz", frequency);
+    ASIC_task_update_job_interval(GLOBAL_STATE);
+}
+
+static void _save_frequencies(GlobalState * GLOBAL_STATE)
+{
+    char buf[FREQ_TUNER_NVS_STR_SIZE];
+    size_t used = 0;
+
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        if (c > 0) {
+            if (used + 1 >= sizeof(buf)) {
+                ESP_LOGE(TAG, "Too many chips to save the frequencies");
+                return;
+            }
+            buf[used++] = ',';
+        }
+        int written = FREQ_TUNER_format(&GLOBAL_STATE->chains[c].FREQ_TUNER_MODULE, buf + used, sizeof(buf) - used);
+        if (written < 0) {
+            ESP_LOGE(TAG, "Too many chips to save the frequencies");
+            return;
+        }
+        used += written;
+    }
+
+    char * saved = nvs_config_get_string(NVS_CONFIG_CHIP_FREQUENCIES, "");
+    if (strcmp(saved, buf) != 0) {
+        ESP_LOGI(TAG, "Saving chip frequencies: %s", buf);
+        nvs_config_set_string(NVS_CONFIG_CHIP_FREQUENCIES, buf);
+    }
+    free(saved);
+}
+
+static bool _all_settled(GlobalState * GLOBAL_STATE)
+{
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        if (!FREQ_TUNER_is_settled(&GLOBAL_STATE->chains[c].FREQ_TUNER_MODULE)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void FREQ_TUNER_task(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    if (GLOBAL_STATE->ASIC_functions.set_chip_frequency_fn == NULL) {
+        ESP_LOGI(TAG, "%s can not set the frequency per chip, not tuning", GLOBAL_STATE->asic_model_str);
+        vTaskDelete(NULL);
+        return;
+    }
+
+    float base_frequency = 0;
+    bool tuning = false;
+    bool settled = false;
+
+    while (1) {
+        vTaskDelay(FREQ_TUNER_POLL_RATE_MS / portTICK_PERIOD_MS);
+
+        if (nvs_config_get_u16(NVS_CONFIG_AUTO_TUNE, 0) == 0) {
+            if (tuning) {
+                _stop_tuning(GLOBAL_STATE);
+                tuning = false;
+            }
+            continue;
+        }
+
+        if (!tuning) {
+            base_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
+            _start_tuning(GLOBAL_STATE, true);
+            settled = _all_settled(GLOBAL_STATE);
+            tuning = true;
+        }
+
+        // the power management task moved the whole chain, tune again from there
+        if (GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value != base_frequency) {
+            base_frequency = GLOBAL_STATE->POWER_MANAGEMENT_MODULE.frequency_value;
+            nvs_config_set_string(NVS_CONFIG_CHIP_FREQUENCIES, "");
+            _start_tuning(GLOBAL_STATE, false);
+            settled = _all_settled(GLOBAL_STATE);
+        }
+
+        bool changed = false;
+        int64_t now_us = esp_timer_get_time();
+        for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+            AsicChain * chain = &GLOBAL_STATE->chains[c];
+            FreqTuner * tuner = &chain->FREQ_TUNER_MODULE;
+            AsicStatsModule * stats = &chain->ASIC_STATS_MODULE;
+
+            pthread_mutex_lock(&chain->chip_lock);
+            // the chain was re-initialized without chips, its counters say nothing about the frequencies
+            if (!chain->ASIC_initalized) {
+                pthread_mutex_unlock(&chain->chip_lock);
+                continue;
+            }
+
+            for (int i = 0; i < tuner->chip_count && i < stats->chip_count; i++) {
+                FreqTunerChip * chip = &tuner->chips[i];
+                float previous = chip->frequency;
+                if (FREQ_TUNER_update_chip(tuner, i, stats->chips[i].nonces, stats->chips[i].hw_errors, stats->chips[i].work, now_us)) {
+                    ESP_LOGI(TAG, "Chain %d chip %d: %.2f -> %.2f MHz", c, i, previous, chip->frequency);
+                    GLOBAL_STATE->ASIC_functions.set_chip_frequency_fn(chain->id, i, chip->frequency);
+                    changed = true;
+                }
+            }
+            pthread_mutex_unlock(&chain->chip_lock);
+        }
+
+        // the job intervals and expected hashrates follow the chip frequencies
+        if (changed) {
+            ASIC_task_update_job_interval(GLOBAL_STATE);
+        }
+
+        bool now_settled = _all_settled(GLOBAL_STATE);
+        if (now_settled && (changed || !settled)) {
+            _save_frequencies(GLOBAL_STATE);
+        }
+        if (now_settled != settled) {
+            ESP_LOGI(TAG, "%s", now_settled ? "All chips settled" : "Tuning resumed");
+            settled = now_settled;
+        }
+    }
+}
@@ -0,0 +1,6 @@
+#ifndef FREQ_TUNER_TASK_H_
+#define FREQ_TUNER_TASK_H_
+
+void FREQ_TUNER_task(void * pvParameters);
+
+#endif
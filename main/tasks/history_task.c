@@ -0,0 +1,154 @@
+#include <pthread.h>
+#include <string.h>
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "common.h"
+#include "global_state.h"
+#include "history_task.h"
+#include "system.h"
+
+static const char * TAG = "history";
+
+// recorded by HISTORY_task, read by the API
+static pthread_mutex_t history_lock = PTHREAD_MUTEX_INITIALIZER;
+static AsicHistory history;
+static bool history_ready = false;
+
+static uint32_t _uptime_s(void)
+{
+    return esp_timer_get_time() / 1000000;
+}
+
+static uint32_t _hw_errors(GlobalState * GLOBAL_STATE)
+{
+    uint32_t hw_errors = 0;
+
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        AsicStatsModule * stats = &GLOBAL_STATE->chains[c].ASIC_STATS_MODULE;
+        for (int i = 0; i < stats->chip_count; i++) {
+            hw_errors += stats->chips[i].hw_errors;
+        }
+    }
+    return hw_errors;
+}
+
+/// @brief diff 1 work of every chip since the stats were started
+static double _work(GlobalState * GLOBAL_STATE)
+{
+    double work = 0;
+
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        AsicStatsModule * stats = &GLOBAL_STATE->chains[c].ASIC_STATS_MODULE;
+        for (int i = 0; i < stats->chip_count; i++) {
+            work += stats->chips[i].work;
+        }
+    }
+    return work;
+}
+
+static uint16_t _delta(uint64_t now, uint64_t before)
+{
+    return now - before > UINT16_MAX ? UINT16_MAX : now - before;
+}
+
+/// @brief the finest tier of at least resolution_s that covers range_s, the coarsest if none covers it
+/// @return false while no history is kept
+bool HISTORY_range(uint32_t resolution_s, uint32_t range_s, int * tier, uint32_t * period_s, int64_t * first_period, uint32_t * count)
+{
+    *tier = ASIC_history_tier_for(resolution_s, range_s);
+    if (*tier < 0) {
+        *tier = ASIC_HISTORY_TIERS - 1;
+    }
+
+    pthread_mutex_lock(&history_lock);
+    if (!history_ready) {
+        pthread_mutex_unlock(&history_lock);
+        return false;
+    }
+    *period_s = history.tiers[*tier].period_s;
+    *count = ASIC_history_range(&history, *tier, range_s, first_period);
+    pthread_mutex_unlock(&history_lock);
+
+    return true;
+}
+
+/// @brief copies consecutive samples, a period no longer held reads as a sample without records
+void HISTORY_read(int tier, int64_t first_period, uint32_t count, AsicHistorySample * samples)
+{
+    pthread_mutex_lock(&history_lock);
+    for (uint32_t i = 0; i < count; i++) {
+        if (!history_ready || !ASIC_history_get(&history, tier, first_period + i, &samples[i])) {
+            memset(&samples[i], 0, sizeof(samples[i]));
+        }
+    }
+    pthread_mutex_unlock(&history_lock);
+}
+
+void HISTORY_task(void * pvParameters)
+{
+    GlobalState * GLOBAL_STATE = (GlobalState *) pvParameters;
+
+    // about 130 KB, kept out of the internal RAM
+    AsicHistorySample * samples = heap_caps_malloc(sizeof(AsicHistorySample) * ASIC_HISTORY_SAMPLES, MALLOC_CAP_SPIRAM);
+    if (samples == NULL) {
+        ESP_LOGE(TAG, "No PSRAM for the history, it is not kept");
+        vTaskDelete(NULL);
+        return;
+    }
+
+    pthread_mutex_lock(&history_lock);
+    ASIC_history_init(&history, samples);
+    history_ready = true;
+    pthread_mutex_unlock(&history_lock);
+
+    SystemStats stats;
+    SYSTEM_get_stats(GLOBAL_STATE, &stats);
+    uint64_t last_accepted = stats.shares_accepted;
+    uint64_t last_rejected = stats.shares_rejected;
+    uint32_t last_hw_errors = _hw_errors(GLOBAL_STATE);
+    double last_work = _work(GLOBAL_STATE);
+    int64_t last_us = esp_timer_get_time();
+
+    TickType_t last_wake = xTaskGetTickCount();
+    while (1) {
+        vTaskDelayUntil(&last_wake, ASIC_HISTORY_RECORD_S * 1000 / portTICK_PERIOD_MS);
+
+        SYSTEM_get_stats(GLOBAL_STATE, &stats);
+        uint32_t hw_errors = _hw_errors(GLOBAL_STATE);
+        double work = _work(GLOBAL_STATE);
+        int64_t now_us = esp_timer_get_time();
+
+        // the hashrate of this interval alone, the windows of the stats would smear it over the next samples
+        double elapsed_s = (now_us - last_us) / 1e6;
+        double hashrate = 0;
+        if (elapsed_s > 0 && work >= last_work) {
+            hashrate = (work - last_work) * ASIC_DIFF1_HASHES / elapsed_s / 1e9;
+        }
+
+        AsicHistorySample record = {
+            .hashrate = hashrate,
+            .power = stats.power,
+            .chip_temp = stats.chip_temp_avg,
+            .vr_temp = stats.vr_temp,
+            .fan_rpm = stats.fan_rpm,
+            .shares_accepted = _delta(stats.shares_accepted, last_accepted),
+            .shares_rejected = _delta(stats.shares_rejected, last_rejected),
+            // a sum that went down, like after a chip count change, counts as none
+            .hw_errors = hw_errors >= last_hw_errors ? _delta(hw_errors, last_hw_errors) : 0,
+        };
+        last_accepted = stats.shares_accepted;
+        last_rejected = stats.shares_rejected;
+        last_hw_errors = hw_errors;
+        last_work = work;
+        last_us = now_us;
+
+        pthread_mutex_lock(&history_lock);
+        ASIC_history_record(&history, &record, _uptime_s());
+        pthread_mutex_unlock(&history_lock);
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef HISTORY_TASK_H_
+#define HISTORY_TASK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "asic_history.h"
+
+void HISTORY_task(void * pvParameters);
+bool HISTORY_range(uint32_t resolution_s, uint32_t range_s, int * tier, uint32_t * period_s, int64_t * first_period, uint32_t * count);
+void HISTORY_read(int tier, int64_t first_period, uint32_t count, AsicHistorySample * samples);
+
+#endif
@@ -10,6 +10,7 @@
 #include "mining.h"
 #include "nvs_config.h"
 #include "serial.h"
+#include "system.h"
 #include "TPS546.h"
 #include "vcore.h"
 
@@ -44,6 +45,17 @@ static const char * TAG = "power_management";
 //     return value;
 // }
 
+// a frequency change is only sent once no chain is being re-initialized
+static bool _chains_initialized(GlobalState * GLOBAL_STATE)
+{
+    for (int i = 0; i < GLOBAL_STATE->chain_count; i++) {
+        if (!GLOBAL_STATE->chains[i].ASIC_initalized) {
+            return false;
+        }
+    }
+    return true;
+}
+
 // Set the fan speed between 20% min and 100% max based on chip temperature as input.
 // The fan speed increases from 20% to 100% proportionally to the temperature increase from 50 and THROTTLE_TEMP
 static double automatic_fan_speed(float chip_temp, GlobalState * GLOBAL_STATE)
@@ -76,6 +88,12 @@ static double automatic_fan_speed(float chip_temp, GlobalState * GLOBAL_STATE)
 	return result;
 }
 
+/// @brief wakes the task when the settings are changed so voltage, frequency and fan follow right away
+static void _config_changed(const char * key, void * ctx)
+{
+    xTaskNotifyGive((TaskHandle_t) ctx);
+}
+
 void POWER_MANAGEMENT_task(void * pvParameters)
 {
     ESP_LOGI(TAG, "Starting");
@@ -120,6 +138,8 @@ void POWER_MANAGEMENT_task(void * pvParameters)
         default:
     }
 
+    nvs_config_subscribe(NULL, _config_changed, xTaskGetCurrentTaskHandle());
+
     vTaskDelay(500 / portTICK_PERIOD_MS);
     uint16_t last_core_voltage = 0.0;
     uint16_t last_asic_frequency = power_management->frequency_value;
@@ -161,7 +181,7 @@ void POWER_MANAGEMENT_task(void * pvParameters)
 
         switch (GLOBAL_STATE->device_model) {
             case DEVICE_MAX:
-                power_management->chip_temp_avg = GLOBAL_STATE->ASIC_initalized ? EMC2101_get_external_temp() : -1;
+                power_management->chip_temp_avg = GLOBAL_STATE->chains[0].ASIC_initalized ? EMC2101_get_external_temp() : -1;
 
                 if ((power_management->chip_temp_avg > THROTTLE_TEMP) &&
                     (power_management->frequency_value > 50 || power_management->voltage > 1000)) {
@@ -183,7 +203,7 @@ void POWER_MANAGEMENT_task(void * pvParameters)
             case DEVICE_SUPRA:
                 
                 if (GLOBAL_STATE->board_version >= 402 && GLOBAL_STATE->board_version <= 499) {
-                    power_management->chip_temp_avg = GLOBAL_STATE->ASIC_initalized ? EMC2101_get_external_temp() : -1;
+                    power_management->chip_temp_avg = GLOBAL_STATE->chains[0].ASIC_initalized ? EMC2101_get_external_temp() : -1;
                     power_management->vr_temp = (float)TPS546_get_temperature();
                 } else {
                     power_management->chip_temp_avg = EMC2101_get_internal_temp() + 5;
@@ -217,7 +237,7 @@ void POWER_MANAGEMENT_task(void * pvParameters)
 
                 break;
             case DEVICE_GAMMA:
-                power_management->chip_temp_avg = GLOBAL_STATE->ASIC_initalized ? EMC2101_get_external_temp() : -1;
+                power_management->chip_temp_avg = GLOBAL_STATE->chains[0].ASIC_initalized ? EMC2101_get_external_temp() : -1;
                 power_management->vr_temp = (float)TPS546_get_temperature();
 
                 // EMC2101 will give bad readings if the ASIC is turned off
@@ -286,10 +306,18 @@ void POWER_MANAGEMENT_task(void * pvParameters)
             last_core_voltage = core_voltage;
         }
 
-        if (asic_frequency != last_asic_frequency) {
+        // a change requested while the chain is re-initialized is applied once it is back
+        if (asic_frequency != last_asic_frequency && _chains_initialized(GLOBAL_STATE)) {
             ESP_LOGI(TAG, "New ASIC frequency requested: %uMHz (current: %uMHz)", asic_frequency, last_asic_frequency);
-            if (do_frequency_transition((float)asic_frequency)) {
+            bool transitioned = true;
+            for (int i = 0; i < GLOBAL_STATE->chain_count; i++) {
+                pthread_mutex_lock(&GLOBAL_STATE->chains[i].chip_lock);
+                transitioned = do_frequency_transition(i, (float)asic_frequency) && transitioned;
+                pthread_mutex_unlock(&GLOBAL_STATE->chains[i].chip_lock);
+            }
+            if (transitioned) {
                 power_management->frequency_value = (float)asic_frequency;
+                ASIC_task_update_job_interval(GLOBAL_STATE);
                 ESP_LOGI(TAG, "Successfully transitioned to new ASIC frequency: %uMHz", asic_frequency);
             } else {
                 ESP_LOGE(TAG, "Failed to transition to new ASIC frequency: %uMHz", asic_frequency);
@@ -306,6 +334,8 @@ void POWER_MANAGEMENT_task(void * pvParameters)
             ESP_LOGI(TAG, "Overheat mode updated to: %d", module->overheat_mode);
         }
 
-        vTaskDelay(POLL_RATE / portTICK_PERIOD_MS);
+        SYSTEM_notify_power(GLOBAL_STATE);
+
+        ulTaskNotifyTake(pdTRUE, POLL_RATE / portTICK_PERIOD_MS);
     }
 }
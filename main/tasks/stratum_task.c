@@ -43,15 +43,31 @@ bool is_wifi_connected() {
     }
 }
 
+/// @brief jobs waiting in the queues of all chains
+static int asic_jobs_queued(GlobalState * GLOBAL_STATE)
+{
+    int count = 0;
+    for (int i = 0; i < GLOBAL_STATE->chain_count; i++) {
+        count += GLOBAL_STATE->chains[i].ASIC_jobs_queue.count;
+    }
+    return count;
+}
+
 void cleanQueue(GlobalState * GLOBAL_STATE) {
     ESP_LOGI(TAG, "Clean Jobs: clearing queue");
     GLOBAL_STATE->abandon_work = 1;
     queue_clear(&GLOBAL_STATE->stratum_queue);
 
     pthread_mutex_lock(&GLOBAL_STATE->valid_jobs_lock);
-    ASIC_jobs_queue_clear(&GLOBAL_STATE->ASIC_jobs_queue);
-    for (int i = 0; i < 128; i = i + 4) {
-        GLOBAL_STATE->valid_jobs[i] = 0;
+    for (int c = 0; c < GLOBAL_STATE->chain_count; c++) {
+        AsicChain * chain = &GLOBAL_STATE->chains[c];
+        ASIC_jobs_queue_clear(&chain->ASIC_jobs_queue);
+        if (chain->valid_jobs == NULL) {
+            continue;
+        }
+        for (int i = 0; i < 128; i = i + 4) {
+            chain->valid_jobs[i] = 0;
+        }
     }
     pthread_mutex_unlock(&GLOBAL_STATE->valid_jobs_lock);
 }
@@ -233,6 +249,7 @@ void stratum_task(void * pvParameters)
         }
 
         STRATUM_V1_reset_uid();
+        SYSTEM_notify_pool_connected(GLOBAL_STATE);
         cleanQueue(GLOBAL_STATE);
 
         ///// Start Stratum Action
@@ -270,7 +287,7 @@ void stratum_task(void * pvParameters)
             if (stratum_api_v1_message.method == MINING_NOTIFY) {
                 SYSTEM_notify_new_ntime(GLOBAL_STATE, stratum_api_v1_message.mining_notification->ntime);
                 if (stratum_api_v1_message.should_abandon_work &&
-                    (GLOBAL_STATE->stratum_queue.count > 0 || GLOBAL_STATE->ASIC_jobs_queue.count > 0)) {
+                    (GLOBAL_STATE->stratum_queue.count > 0 || asic_jobs_queued(GLOBAL_STATE) > 0)) {
                     cleanQueue(GLOBAL_STATE);
                 }
                 if (GLOBAL_STATE->stratum_queue.count == QUEUE_SIZE) {
@@ -300,10 +317,10 @@ void stratum_task(void * pvParameters)
             } else if (stratum_api_v1_message.method == STRATUM_RESULT) {
                 if (stratum_api_v1_message.response_success) {
                     ESP_LOGI(TAG, "message result accepted");
-                    SYSTEM_notify_accepted_share(GLOBAL_STATE);
+                    SYSTEM_notify_accepted_share(GLOBAL_STATE, stratum_api_v1_message.message_id);
                 } else {
                     ESP_LOGW(TAG, "message result rejected: %s", stratum_api_v1_message.error_str ? stratum_api_v1_message.error_str : "unknown");
-                    SYSTEM_notify_rejected_share(GLOBAL_STATE);
+                    SYSTEM_notify_rejected_share(GLOBAL_STATE, stratum_api_v1_message.message_id, stratum_api_v1_message.error_str);
                 }
             } else if (stratum_api_v1_message.method == STRATUM_RESULT_SETUP) {
                 if (stratum_api_v1_message.response_success) {
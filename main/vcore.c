@@ -6,6 +6,7 @@
 #include "adc.h"
 #include "DS4432U.h"
 #include "TPS546.h"
+#include "freq_ramp.h"
 
 #define TPS40305_VFB 0.6
 
@@ -21,6 +22,13 @@
 
 static const char *TAG = "vcore.c";
 
+// a regulator that does not answer reads as NAN, the ramps must not take that for a settled current
+static float ramp_current(void)
+{
+    float iout;
+    return TPS546_read_iout(&iout) == ESP_OK ? iout : NAN;
+}
+
 esp_err_t VCORE_init(GlobalState * global_state) {
     switch (global_state->device_model) {
         case DEVICE_MAX:
@@ -31,6 +39,8 @@ esp_err_t VCORE_init(GlobalState * global_state) {
                     ESP_LOGE(TAG, "TPS546 init failed!");
                     return ESP_FAIL;
                 }
+                // the frequency ramps step as fast as the regulator current settles
+                FREQ_RAMP_set_current_sensor(ramp_current);
             } else {
                 ESP_RETURN_ON_ERROR(DS4432U_init(), TAG, "DS4432 init failed!");
             }
@@ -40,6 +50,7 @@ esp_err_t VCORE_init(GlobalState * global_state) {
                 ESP_LOGE(TAG, "TPS546 init failed!");
                 return ESP_FAIL;
             }
+            FREQ_RAMP_set_current_sensor(ramp_current);
             break;
         // case DEVICE_HEX:
         default:
@@ -0,0 +1,573 @@
+#include <string.h>
+#include <strings.h>
+
+#include "bm13xx_sim.h"
+#include "common.h"
+#include "crc.h"
+
+#define TYPE_JOB 0x20
+#define TYPE_CMD 0x40
+#define GROUP_ALL 0x10
+
+#define CMD_SETADDRESS 0x00
+#define CMD_WRITE 0x01
+#define CMD_READ 0x02
+#define CMD_INACTIVE 0x03
+
+#define RESPONSE_JOB 0x80
+
+#define REG_CHIP_ID 0x00
+#define REG_TICKET_MASK 0x14
+#define REG_VERSION_MASK 0xA4
+
+typedef struct
+{
+    const char * name;
+    // register 0x00, read back during enumeration
+    uint32_t chip_id;
+    uint8_t response_len;
+    uint8_t job_len;
+    uint8_t small_cores;
+} Bm13xxSimModelInfo;
+
+static const Bm13xxSimModelInfo models[] = {
+    [BM13XX_SIM_BM1397] = {"BM1397", 0x13971800, 9, 146, 4},
+    [BM13XX_SIM_BM1366] = {"BM1366", 0x13660000, 11, 82, 8},
+    [BM13XX_SIM_BM1368] = {"BM1368", 0x13680000, 11, 82, 16},
+    [BM13XX_SIM_BM1370] = {"BM1370", 0x13700000, 11, 82, 16},
+};
+
+static const uint32_t sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static uint32_t _be32(const uint8_t * p)
+{
+    return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) | ((uint32_t) p[2] << 8) | p[3];
+}
+
+static void _put_be32(uint8_t * p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+static void _sha256_compress(uint32_t state[8], const uint8_t block[64])
+{
+    uint32_t w[64];
+
+    for (int i = 0; i < 16; i++) {
+        w[i] = _be32(block + i * 4);
+    }
+    for (int i = 16; i < 64; i++) {
+        uint32_t s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+    for (int i = 0; i < 64; i++) {
+        uint32_t t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + sha256_k[i] + w[i];
+        uint32_t t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+/// @brief sha256 state after the first 64 bytes of a header
+void bm13xx_sim_sha256_midstate(const uint8_t block[64], uint32_t state[8])
+{
+    memcpy(state, sha256_iv, sizeof(sha256_iv));
+    _sha256_compress(state, block);
+}
+
+/// @brief double sha256 of the 80 byte header continued from its midstate, result in state words
+static void _sha256d_from_midstate(const uint32_t midstate[8], const uint8_t tail[16], uint32_t result[8])
+{
+    uint8_t block[64] = {0};
+    uint32_t state[8];
+
+    // second block of the header: the last 16 bytes, padding and the 640 bit length
+    memcpy(block, tail, 16);
+    block[16] = 0x80;
+    block[62] = 0x02;
+    block[63] = 0x80;
+    memcpy(state, midstate, sizeof(state));
+    _sha256_compress(state, block);
+
+    // the 32 byte first hash, padding and the 256 bit length
+    memset(block, 0, sizeof(block));
+    for (int i = 0; i < 8; i++) {
+        _put_be32(block + i * 4, state[i]);
+    }
+    block[32] = 0x80;
+    block[62] = 0x01;
+    memcpy(result, sha256_iv, sizeof(sha256_iv));
+    _sha256_compress(result, block);
+}
+
+/// @brief double sha256 of a block header, hash bytes in the order test_nonce_value reads them
+void bm13xx_sim_sha256d(const uint8_t header[80], uint8_t hash[32])
+{
+    uint32_t midstate[8];
+    uint32_t result[8];
+
+    bm13xx_sim_sha256_midstate(header, midstate);
+    _sha256d_from_midstate(midstate, header + 64, result);
+
+    for (int i = 0; i < 8; i++) {
+        _put_be32(hash + i * 4, result[i]);
+    }
+}
+
+static uint64_t _xorshift(Bm13xxSim * sim)
+{
+    sim->rng ^= sim->rng << 13;
+    sim->rng ^= sim->rng >> 7;
+    sim->rng ^= sim->rng << 17;
+    return sim->rng;
+}
+
+double bm13xx_sim_uniform(Bm13xxSim * sim)
+{
+    return (_xorshift(sim) >> 11) / 9007199254740992.0;
+}
+
+bool bm13xx_sim_model_from_name(const char * name, Bm13xxSimModel * model)
+{
+    for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); i++) {
+        if (strcasecmp(name, models[i].name) == 0) {
+            *model = (Bm13xxSimModel) i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void bm13xx_sim_init(Bm13xxSim * sim, Bm13xxSimModel model, uint16_t chip_count, uint64_t seed)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->model = model;
+    sim->chip_count = chip_count > BM13XX_SIM_MAX_CHIPS ? BM13XX_SIM_MAX_CHIPS : chip_count;
+    sim->search_job = -1;
+    sim->rng = seed != 0 ? seed : 0x9E3779B97F4A7C15ull;
+
+    for (int i = 0; i < sim->chip_count; i++) {
+        sim->chips[i].registers[REG_CHIP_ID] = models[model].chip_id;
+    }
+}
+
+/// @brief fills in the reply crc, it covers everything after the preamble up to the flag bits of the last byte
+static void _seal_response(uint8_t * frame, uint8_t len)
+{
+    frame[len - 1] |= crc5_bits(frame + 2, (len - 2) * 8 - 5);
+}
+
+static void _output(Bm13xxSim * sim, const uint8_t * data, size_t len)
+{
+    // a real chain would overrun the UART the same way, the reader sees truncated output
+    if (sim->output_len + len > sizeof(sim->output)) {
+        return;
+    }
+    memcpy(sim->output + sim->output_len, data, len);
+    sim->output_len += len;
+}
+
+/// @brief moves the pending response bytes into buf
+/// @return number of bytes copied
+size_t bm13xx_sim_take_output(Bm13xxSim * sim, uint8_t * buf, size_t size)
+{
+    size_t len = sim->output_len < size ? sim->output_len : size;
+
+    memcpy(buf, sim->output, len);
+    memmove(sim->output, sim->output + len, sim->output_len - len);
+    sim->output_len -= len;
+    return len;
+}
+
+/// @brief ticket difficulty from the mask register, the chips read every mask byte bit reversed
+uint32_t bm13xx_sim_ticket_difficulty(const Bm13xxSim * sim)
+{
+    uint32_t value = sim->chip_count > 0 ? sim->chips[0].registers[REG_TICKET_MASK] : 0;
+    uint32_t mask = 0;
+
+    for (int i = 0; i < 4; i++) {
+        mask |= (uint32_t) _reverse_bits((value >> (8 * i)) & 0xFF) << (8 * i);
+    }
+
+    return mask + 1;
+}
+
+/// @brief spreads hashes evenly over the chips for the hash counter register
+void bm13xx_sim_add_hashes(Bm13xxSim * sim, double hashes)
+{
+    for (int i = 0; i < sim->chip_count; i++) {
+        sim->chips[i].hashes += hashes / sim->chip_count;
+    }
+}
+
+static void _send_register(Bm13xxSim * sim, const Bm13xxSimChip * chip, uint8_t reg)
+{
+    const Bm13xxSimModelInfo * info = &models[sim->model];
+    uint8_t frame[11] = {0xAA, 0x55};
+    uint32_t value = chip->registers[reg];
+
+    if (reg == ASIC_HASH_COUNTER_REGISTER) {
+        value = (uint32_t) (uint64_t) (chip->hashes / ASIC_HASH_COUNTER_HASHES);
+    }
+
+    _put_be32(frame + 2, value);
+    frame[6] = chip->address;
+    frame[7] = reg;
+    // register replies leave the job bit of the last byte clear
+    frame[info->response_len - 1] = 0;
+    _seal_response(frame, info->response_len);
+    _output(sim, frame, info->response_len);
+}
+
+static bool _chip_selected(const Bm13xxSimChip * chip, uint8_t header, uint8_t address)
+{
+    return (header & GROUP_ALL) != 0 || chip->address == address;
+}
+
+static void _handle_command(Bm13xxSim * sim, uint8_t header, const uint8_t * data, uint8_t data_len)
+{
+    switch (header & 0x0F) {
+        case CMD_SETADDRESS:
+            // the first chip without an address takes it, the others pass the command down the chain
+            for (int i = 0; i < sim->chip_count; i++) {
+                if (!sim->chips[i].addressed) {
+                    sim->chips[i].address = data[0];
+                    sim->chips[i].addressed = true;
+                    break;
+                }
+            }
+            break;
+        case CMD_WRITE:
+            if (data_len < 6) {
+                break;
+            }
+            for (int i = 0; i < sim->chip_count; i++) {
+                if (_chip_selected(&sim->chips[i], header, data[0])) {
+                    sim->chips[i].registers[data[1]] = _be32(data + 2);
+                }
+            }
+            break;
+        case CMD_READ:
+            for (int i = 0; i < sim->chip_count; i++) {
+                if (_chip_selected(&sim->chips[i], header, data[0])) {
+                    _send_register(sim, &sim->chips[i], data[1]);
+                }
+            }
+            break;
+        case CMD_INACTIVE:
+            for (int i = 0; i < sim->chip_count; i++) {
+                sim->chips[i].addressed = false;
+            }
+            break;
+    }
+}
+
+static uint16_t _version_mask(const Bm13xxSim * sim)
+{
+    return sim->chip_count > 0 ? sim->chips[0].registers[REG_VERSION_MASK] & 0xFFFF : 0;
+}
+
+/// @brief points the search at the start of the current version roll
+static void _start_roll(Bm13xxSim * sim)
+{
+    Bm13xxSimJob * job = &sim->jobs[sim->search_job];
+
+    sim->search_nonce = job->starting_nonce;
+    sim->search_count = 0;
+
+    if (sim->model == BM13XX_SIM_BM1397) {
+        memcpy(sim->search_midstate, job->midstates[sim->search_roll], sizeof(sim->search_midstate));
+        return;
+    }
+
+    uint8_t block[64];
+    uint32_t version;
+    memcpy(block, job->header, 64);
+    memcpy(&version, block, 4);
+    version |= (uint32_t) sim->search_roll << 13;
+    memcpy(block, &version, 4);
+    bm13xx_sim_sha256_midstate(block, sim->search_midstate);
+}
+
+/// @brief word order of a 32 byte field is reversed between the job frame and the header
+static void _reverse_words(uint8_t * dest, const uint8_t * src)
+{
+    for (int i = 0; i < 8; i++) {
+        memcpy(dest + i * 4, src + (7 - i) * 4, 4);
+    }
+}
+
+static void _handle_job(Bm13xxSim * sim, const uint8_t * data)
+{
+    uint8_t job_id = data[0] % BM13XX_SIM_JOB_IDS;
+    Bm13xxSimJob * job = &sim->jobs[job_id];
+
+    memset(job, 0, sizeof(*job));
+    job->valid = true;
+    job->num_midstates = data[1] == 0 ? 1 : (data[1] > 4 ? 4 : data[1]);
+    memcpy(&job->starting_nonce, data + 2, 4);
+
+    if (sim->model == BM13XX_SIM_BM1397) {
+        memcpy(job->tail, data + 14, 4);
+        memcpy(job->tail + 4, data + 10, 4);
+        memcpy(job->tail + 8, data + 6, 4);
+        for (int m = 0; m < job->num_midstates; m++) {
+            // midstates are sent as their big endian state words with the whole 32 bytes reversed
+            const uint8_t * midstate = data + 18 + m * 32;
+            for (int i = 0; i < 8; i++) {
+                uint8_t word[4] = {midstate[31 - i * 4], midstate[30 - i * 4], midstate[29 - i * 4], midstate[28 - i * 4]};
+                job->midstates[m][i] = _be32(word);
+            }
+        }
+    } else {
+        memcpy(job->header, data + 78, 4);
+        _reverse_words(job->header + 4, data + 46);
+        _reverse_words(job->header + 36, data + 14);
+        memcpy(job->header + 68, data + 10, 4);
+        memcpy(job->header + 72, data + 6, 4);
+        memcpy(job->tail, job->header + 64, 12);
+    }
+
+    // every chip drops what it was doing for the newest job
+    sim->search_job = job_id;
+    sim->search_roll = 0;
+    _start_roll(sim);
+}
+
+/// @brief checks and handles the frame at the start of the rx buffer
+/// @return false if the crc does not match
+static bool _handle_frame(Bm13xxSim * sim, const uint8_t * frame, uint8_t len)
+{
+    uint8_t header = frame[2];
+    const uint8_t * data = frame + 4;
+
+    if (header & TYPE_JOB) {
+        uint16_t crc = crc16_false(frame + 2, len - 4);
+        if (frame[len - 2] != (crc >> 8) || frame[len - 1] != (crc & 0xFF)) {
+            return false;
+        }
+        sim->job_frames++;
+        if (len - 6 == models[sim->model].job_len) {
+            _handle_job(sim, data);
+        }
+        return true;
+    }
+
+    if (crc5(frame + 2, len - 3) != frame[len - 1]) {
+        return false;
+    }
+    sim->command_frames++;
+    if (header & TYPE_CMD) {
+        _handle_command(sim, header, data, len - 5);
+    }
+    return true;
+}
+
+static void _parse(Bm13xxSim * sim)
+{
+    uint16_t pos = 0;
+
+    while (sim->rx_len - pos >= 4) {
+        const uint8_t * frame = sim->rx + pos;
+        // the length byte covers everything after the preamble
+        uint8_t len = frame[3] + 2;
+
+        if (frame[0] != 0x55 || frame[1] != 0xAA || len < 5 || len > BM13XX_SIM_MAX_FRAME) {
+            pos++;
+            sim->dropped_bytes++;
+            continue;
+        }
+
+        if (sim->rx_len - pos < len) {
+            break;
+        }
+
+        if (!_handle_frame(sim, frame, len)) {
+            // the length may be what got corrupted, resync on the next preamble
+            sim->crc_errors++;
+            pos++;
+            sim->dropped_bytes++;
+            continue;
+        }
+        pos += len;
+    }
+
+    memmove(sim->rx, sim->rx + pos, sim->rx_len - pos);
+    sim->rx_len -= pos;
+}
+
+/// @brief feeds bytes written to the chain, replies are queued for bm13xx_sim_take_output
+void bm13xx_sim_feed(Bm13xxSim * sim, const uint8_t * data, size_t len)
+{
+    while (len > 0) {
+        size_t space = sizeof(sim->rx) - sim->rx_len;
+        size_t chunk = len < space ? len : space;
+
+        memcpy(sim->rx + sim->rx_len, data, chunk);
+        sim->rx_len += chunk;
+        data += chunk;
+        len -= chunk;
+
+        _parse(sim);
+    }
+}
+
+/// @brief true if the top 32 + difficulty_bits bits of the little endian hash are zero, like the chip's ticket mask check
+static bool _meets_ticket_mask(const uint32_t hash[8], int difficulty_bits)
+{
+    if (hash[7] != 0) {
+        return false;
+    }
+    // hash bytes 27..24 are the next most significant ones
+    uint32_t next = __builtin_bswap32(hash[6]);
+    return difficulty_bits == 0 || (next >> (32 - difficulty_bits)) == 0;
+}
+
+/// @brief hashes the current job like the chain does, stops at the first nonce that meets the ticket mask
+/// @param max_hashes work done before giving up for this call
+/// @return true if found was filled in
+bool bm13xx_sim_search(Bm13xxSim * sim, uint32_t max_hashes, Bm13xxSimNonce * found)
+{
+    if (sim->search_job < 0) {
+        return false;
+    }
+
+    Bm13xxSimJob * job = &sim->jobs[sim->search_job];
+    int difficulty_bits = __builtin_popcount(bm13xx_sim_ticket_difficulty(sim) - 1);
+    uint8_t tail[16];
+    uint32_t hash[8];
+
+    memcpy(tail, job->tail, 12);
+
+    for (uint32_t i = 0; i < max_hashes; i++) {
+        uint32_t nonce = sim->search_nonce;
+        memcpy(tail + 12, &nonce, 4);
+        _sha256d_from_midstate(sim->search_midstate, tail, hash);
+
+        sim->hashes++;
+        sim->search_nonce++;
+        sim->search_count++;
+
+        bool met = _meets_ticket_mask(hash, difficulty_bits);
+        if (met) {
+            found->job_id = sim->search_job;
+            found->nonce = nonce;
+            found->roll = sim->search_roll;
+        }
+
+        if (sim->search_count == 0) {
+            // nonce space done, move on to the next version
+            if (sim->model == BM13XX_SIM_BM1397) {
+                sim->search_roll = (sim->search_roll + 1) % job->num_midstates;
+            } else {
+                uint16_t mask = _version_mask(sim);
+                sim->search_roll = ((sim->search_roll | ~mask) + 1) & mask;
+            }
+            _start_roll(sim);
+        }
+
+        if (met) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/// @brief a nonce for the current job that was never hashed, for benchmarks that only care about frame rates
+bool bm13xx_sim_random_nonce(Bm13xxSim * sim, Bm13xxSimNonce * nonce)
+{
+    if (sim->search_job < 0) {
+        return false;
+    }
+
+    nonce->job_id = sim->search_job;
+    nonce->nonce = (uint32_t) _xorshift(sim);
+    nonce->roll = 0;
+    return true;
+}
+
+/// @brief queues the result frame of a nonce, corrupting it with probability hw_error_rate
+void bm13xx_sim_emit_nonce(Bm13xxSim * sim, const Bm13xxSimNonce * nonce)
+{
+    const Bm13xxSimModelInfo * info = &models[sim->model];
+    uint8_t frame[11] = {0xAA, 0x55};
+    uint32_t value = nonce->nonce;
+    uint8_t small_core = _xorshift(sim) % info->small_cores;
+
+    if (sim->hw_error_rate > 0 && bm13xx_sim_uniform(sim) < sim->hw_error_rate) {
+        value ^= 1u << (_xorshift(sim) % 32);
+        sim->hw_errors++;
+    }
+
+    memcpy(frame + 2, &value, 4);
+
+    switch (sim->model) {
+        case BM13XX_SIM_BM1397:
+            frame[7] = nonce->job_id | (nonce->roll & 0x03);
+            break;
+        case BM13XX_SIM_BM1366:
+            frame[7] = nonce->job_id | small_core;
+            break;
+        default:
+            frame[7] = ((nonce->job_id << 1) & 0xF0) | small_core;
+            break;
+    }
+
+    if (info->response_len == 11) {
+        frame[8] = nonce->roll >> 8;
+        frame[9] = nonce->roll & 0xFF;
+    }
+
+    frame[info->response_len - 1] = RESPONSE_JOB;
+    _seal_response(frame, info->response_len);
+    _output(sim, frame, info->response_len);
+    sim->nonces++;
+}
+
+/// @brief queues random line noise
+void bm13xx_sim_inject_noise(Bm13xxSim * sim, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        uint8_t byte = _xorshift(sim) & 0xFF;
+        _output(sim, &byte, 1);
+    }
+}
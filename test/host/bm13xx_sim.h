@@ -0,0 +1,102 @@
+#ifndef BM13XX_SIM_H_
+#define BM13XX_SIM_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define BM13XX_SIM_MAX_CHIPS 128
+#define BM13XX_SIM_JOB_IDS 128
+// largest frame the firmware sends, the BM1397 job with 4 midstates
+#define BM13XX_SIM_MAX_FRAME 152
+#define BM13XX_SIM_OUTPUT_SIZE 8192
+
+typedef enum
+{
+    BM13XX_SIM_BM1397,
+    BM13XX_SIM_BM1366,
+    BM13XX_SIM_BM1368,
+    BM13XX_SIM_BM1370,
+} Bm13xxSimModel;
+
+typedef struct
+{
+    uint8_t address;
+    // set by a set address command, cleared by chain inactive so the chain can be enumerated again
+    bool addressed;
+    uint32_t registers[256];
+    // hashes done, register 0x8C counts them in units of 2^32
+    double hashes;
+} Bm13xxSimChip;
+
+typedef struct
+{
+    bool valid;
+    uint8_t num_midstates;
+    uint32_t starting_nonce;
+    // BM1366 and later get the whole header, in the byte order it is hashed in
+    uint8_t header[80];
+    // the BM1397 gets sha256 states of the first 64 header bytes, one per rolled version
+    uint32_t midstates[4][8];
+    // last 12 header bytes before the nonce: merkle root tail, ntime, nbits
+    uint8_t tail[12];
+} Bm13xxSimJob;
+
+// a nonce that met the ticket mask, ready to be sent back
+typedef struct
+{
+    uint8_t job_id;
+    uint32_t nonce;
+    // version roll (BM1366 and later, version bits >> 13) or midstate index (BM1397)
+    uint16_t roll;
+} Bm13xxSimNonce;
+
+/// @brief a chain of BM13xx chips behind one UART, fed the bytes the firmware writes
+typedef struct
+{
+    Bm13xxSimModel model;
+    uint16_t chip_count;
+    Bm13xxSimChip chips[BM13XX_SIM_MAX_CHIPS];
+    Bm13xxSimJob jobs[BM13XX_SIM_JOB_IDS];
+
+    // job the search works on, -1 before the first job
+    int search_job;
+    uint32_t search_nonce;
+    uint32_t search_count;
+    uint16_t search_roll;
+    uint32_t search_midstate[8];
+
+    // probability of a nonce being corrupted on its way out
+    double hw_error_rate;
+    uint64_t rng;
+
+    uint8_t rx[BM13XX_SIM_MAX_FRAME * 2];
+    uint16_t rx_len;
+    uint8_t output[BM13XX_SIM_OUTPUT_SIZE];
+    size_t output_len;
+
+    uint32_t command_frames;
+    uint32_t job_frames;
+    uint32_t crc_errors;
+    uint32_t dropped_bytes;
+    uint32_t nonces;
+    uint32_t hw_errors;
+    uint64_t hashes;
+} Bm13xxSim;
+
+bool bm13xx_sim_model_from_name(const char * name, Bm13xxSimModel * model);
+void bm13xx_sim_init(Bm13xxSim * sim, Bm13xxSimModel model, uint16_t chip_count, uint64_t seed);
+void bm13xx_sim_feed(Bm13xxSim * sim, const uint8_t * data, size_t len);
+size_t bm13xx_sim_take_output(Bm13xxSim * sim, uint8_t * buf, size_t size);
+uint32_t bm13xx_sim_ticket_difficulty(const Bm13xxSim * sim);
+void bm13xx_sim_add_hashes(Bm13xxSim * sim, double hashes);
+bool bm13xx_sim_search(Bm13xxSim * sim, uint32_t max_hashes, Bm13xxSimNonce * found);
+bool bm13xx_sim_random_nonce(Bm13xxSim * sim, Bm13xxSimNonce * nonce);
+void bm13xx_sim_emit_nonce(Bm13xxSim * sim, const Bm13xxSimNonce * nonce);
+void bm13xx_sim_inject_noise(Bm13xxSim * sim, size_t len);
+double bm13xx_sim_uniform(Bm13xxSim * sim);
+
+void bm13xx_sim_sha256_midstate(const uint8_t block[64], uint32_t state[8]);
+void bm13xx_sim_sha256d(const uint8_t header[80], uint8_t hash[32]);
+
+#endif /* BM13XX_SIM_H_ */
@@ -0,0 +1,271 @@
+// Emulates a BM13xx chain behind a pseudo-terminal so the serial and job path can run without hardware:
+//
+//   ./bm13xx_sim --model BM1370 --chips 1 --hashrate 500 --link /tmp/ttyASIC0
+//
+// The chips parse the frames the firmware writes, answer enumeration and register reads and hash the jobs
+// for real, so every nonce they return meets the ticket mask. Each nonce costs 2^32 * ticket difficulty
+// hashes on the host CPU, so the nonce rate is the lower of --hashrate and what the CPU manages;
+// --no-search sends unhashed nonces at the full rate when only frame throughput matters.
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bm13xx_sim.h"
+
+// hashes per search slice, keeps the loop responsive to new jobs
+#define SEARCH_SLICE 65536
+#define POLL_MS 10
+
+static volatile sig_atomic_t running = 1;
+
+static void _stop(int signal)
+{
+    (void) signal;
+    running = 0;
+}
+
+static double _now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void _usage(const char * name)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  --model NAME          BM1397, BM1366, BM1368 or BM1370 (default BM1370)\n"
+            "  --chips N             chips on the chain (default 1)\n"
+            "  --hashrate GHS        simulated hashrate of the chain (default 500)\n"
+            "  --hw-error-rate P     fraction of nonces corrupted on the way out (default 0)\n"
+            "  --noise BYTES         random bytes of line noise per second (default 0)\n"
+            "  --no-search           send unhashed nonces, only the frame rate is simulated\n"
+            "  --seed N              random seed\n"
+            "  --link PATH           symlink to the pty for the firmware config\n"
+            "  --verbose             print counters every 10 seconds\n",
+            name);
+}
+
+static void _print_stats(const Bm13xxSim * sim)
+{
+    fprintf(stderr,
+            "commands %u jobs %u crc errors %u dropped bytes %u nonces %u hw errors %u hashes %llu ticket diff %u\n",
+            sim->command_frames, sim->job_frames, sim->crc_errors, sim->dropped_bytes, sim->nonces, sim->hw_errors,
+            (unsigned long long) sim->hashes, bm13xx_sim_ticket_difficulty(sim));
+}
+
+static int _open_pty(int * slave)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+
+    // keep the slave open so the master does not see EIO between firmware sessions
+    *slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if (*slave < 0) {
+        perror("open pty");
+        return -1;
+    }
+
+    struct termios tio;
+    tcgetattr(*slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(*slave, TCSANOW, &tio);
+
+    return master;
+}
+
+static void _flush(int fd, Bm13xxSim * sim)
+{
+    uint8_t buf[1024];
+    size_t len;
+
+    while ((len = bm13xx_sim_take_output(sim, buf, sizeof(buf))) > 0) {
+        size_t written = 0;
+        while (written < len) {
+            ssize_t ret = write(fd, buf + written, len - written);
+            if (ret < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                perror("write");
+                return;
+            }
+            written += ret;
+        }
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    Bm13xxSimModel model = BM13XX_SIM_BM1370;
+    int chips = 1;
+    double hashrate_ghs = 500;
+    double hw_error_rate = 0;
+    double noise_rate = 0;
+    bool search = true;
+    bool verbose = false;
+    uint64_t seed = 0;
+    const char * link = NULL;
+
+    static const struct option options[] = {
+        {"model", required_argument, NULL, 'm'},    {"chips", required_argument, NULL, 'c'},
+        {"hashrate", required_argument, NULL, 'r'}, {"hw-error-rate", required_argument, NULL, 'e'},
+        {"noise", required_argument, NULL, 'n'},    {"no-search", no_argument, NULL, 'x'},
+        {"seed", required_argument, NULL, 's'},     {"link", required_argument, NULL, 'l'},
+        {"verbose", no_argument, NULL, 'v'},        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "m:c:r:e:n:xs:l:vh", options, NULL)) != -1) {
+        switch (opt) {
+            case 'm':
+                if (!bm13xx_sim_model_from_name(optarg, &model)) {
+                    fprintf(stderr, "unknown model %s\n", optarg);
+                    return 1;
+                }
+                break;
+            case 'c':
+                chips = atoi(optarg);
+                break;
+            case 'r':
+                hashrate_ghs = atof(optarg);
+                break;
+            case 'e':
+                hw_error_rate = atof(optarg);
+                break;
+            case 'n':
+                noise_rate = atof(optarg);
+                break;
+            case 'x':
+                search = false;
+                break;
+            case 's':
+                seed = strtoull(optarg, NULL, 0);
+                break;
+            case 'l':
+                link = optarg;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                _usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+
+    if (chips < 1 || chips > BM13XX_SIM_MAX_CHIPS || hashrate_ghs <= 0) {
+        _usage(argv[0]);
+        return 1;
+    }
+
+    static Bm13xxSim sim;
+    bm13xx_sim_init(&sim, model, chips, seed != 0 ? seed : (uint64_t) time(NULL));
+    sim.hw_error_rate = hw_error_rate;
+
+    int slave;
+    int master = _open_pty(&slave);
+    if (master < 0) {
+        return 1;
+    }
+
+    if (link != NULL) {
+        unlink(link);
+        if (symlink(ptsname(master), link) != 0) {
+            perror("symlink");
+            return 1;
+        }
+    }
+
+    printf("%s\n", ptsname(master));
+    fflush(stdout);
+
+    signal(SIGINT, _stop);
+    signal(SIGTERM, _stop);
+
+    double last = _now_s();
+    double due = last;
+    double next_stats = last + 10;
+    double noise_budget = 0;
+    bool pending = false;
+    Bm13xxSimNonce nonce;
+
+    while (running) {
+        double now = _now_s();
+        double elapsed = now - last;
+        last = now;
+
+        // nonces arrive as a Poisson process at the simulated hashrate
+        double nonce_rate = hashrate_ghs * 1e9 / (bm13xx_sim_ticket_difficulty(&sim) * 4294967296.0);
+
+        if (sim.search_job >= 0) {
+            bm13xx_sim_add_hashes(&sim, hashrate_ghs * 1e9 * elapsed);
+
+            if (!pending) {
+                pending = search ? bm13xx_sim_search(&sim, SEARCH_SLICE, &nonce) : bm13xx_sim_random_nonce(&sim, &nonce);
+            }
+            if (pending && now >= due) {
+                bm13xx_sim_emit_nonce(&sim, &nonce);
+                pending = false;
+                // a CPU bound search falls behind, do not let the backlog burst out later
+                due = fmax(due, now - 1) - log(1 - bm13xx_sim_uniform(&sim)) / nonce_rate;
+            }
+        }
+
+        noise_budget += noise_rate * elapsed;
+        if (noise_budget >= 1) {
+            bm13xx_sim_inject_noise(&sim, (size_t) noise_budget);
+            noise_budget -= floor(noise_budget);
+        }
+
+        _flush(master, &sim);
+
+        // keep hashing while there is nothing to wait for
+        int timeout = POLL_MS;
+        if (sim.search_job >= 0 && (!pending || now >= due)) {
+            timeout = 0;
+        } else if (pending) {
+            timeout = (int) fmin(POLL_MS, (due - now) * 1000);
+        }
+
+        struct pollfd pfd = {.fd = master, .events = POLLIN};
+        if (poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN)) {
+            uint8_t buf[1024];
+            ssize_t len = read(master, buf, sizeof(buf));
+            if (len > 0) {
+                bm13xx_sim_feed(&sim, buf, len);
+                _flush(master, &sim);
+            }
+        }
+
+        if (verbose && now >= next_stats) {
+            _print_stats(&sim);
+            next_stats = now + 10;
+        }
+    }
+
+    _print_stats(&sim);
+
+    if (link != NULL) {
+        unlink(link);
+    }
+    close(slave);
+    close(master);
+    return 0;
+}
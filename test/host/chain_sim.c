@@ -0,0 +1,85 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chain_sim.h"
+
+// error probability of a chip running within its limit
+#define CHAIN_SIM_BASE_ERROR_RATE 0.0005
+#define CHAIN_SIM_STEP_MHZ 6.25
+
+static uint32_t _xorshift(ChainSim * sim)
+{
+    sim->rng ^= sim->rng << 13;
+    sim->rng ^= sim->rng >> 17;
+    sim->rng ^= sim->rng << 5;
+    return sim->rng;
+}
+
+static double _uniform(ChainSim * sim)
+{
+    return _xorshift(sim) / 4294967296.0;
+}
+
+void chain_sim_init(ChainSim * sim, uint16_t chip_count, float frequency, const float * stable_limits)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->chip_count = chip_count;
+    sim->work_rate = 128;
+    sim->ticket_diff = 256;
+    sim->rng = 0x2545F491;
+
+    for (int i = 0; i < chip_count; i++) {
+        sim->chips[i].frequency = frequency;
+        sim->chips[i].stable_limit = stable_limits[i];
+    }
+
+    ASIC_stats_init(&sim->stats, chip_count, sim->now_us);
+}
+
+void chain_sim_free(ChainSim * sim)
+{
+    free(sim->stats.chips);
+    sim->stats.chips = NULL;
+}
+
+void chain_sim_set_chip_frequency(ChainSim * sim, uint8_t asic_nr, float frequency)
+{
+    sim->chips[asic_nr].frequency = frequency;
+}
+
+/// @brief run the chain for some seconds, one second at a time
+void chain_sim_run(ChainSim * sim, uint32_t seconds)
+{
+    for (uint32_t s = 0; s < seconds; s++) {
+        sim->now_us += 1000000;
+
+        for (int i = 0; i < sim->chip_count; i++) {
+            ChainSimChip * chip = &sim->chips[i];
+            double error_rate = CHAIN_SIM_BASE_ERROR_RATE;
+            double yield = 1.0;
+
+            if (chip->stable_limit <= 0) {
+                continue;
+            }
+
+            // past the limit every step adds errors and drops cores
+            if (chip->frequency > chip->stable_limit) {
+                double steps = ceil((chip->frequency - chip->stable_limit) / CHAIN_SIM_STEP_MHZ);
+                error_rate = fmin(0.9, 0.02 * steps);
+                yield = fmax(0.1, 1.0 - 0.1 * steps);
+            }
+
+            // round the expected number of results randomly so the rate holds on average
+            double expected = sim->work_rate / sim->ticket_diff * chip->frequency * yield / (1.0 - error_rate);
+            uint32_t results = (uint32_t) expected + (_uniform(sim) < expected - floor(expected) ? 1 : 0);
+
+            for (uint32_t r = 0; r < results; r++) {
+                uint8_t core_id = _xorshift(sim) % ASIC_STATS_CORES;
+                uint8_t small_core_id = _xorshift(sim) % ASIC_STATS_SMALL_CORES;
+                AsicResultType type = _uniform(sim) < error_rate ? ASIC_RESULT_HW_ERROR : ASIC_RESULT_VALID;
+                ASIC_stats_record(&sim->stats, i, core_id, small_core_id, type, sim->ticket_diff, sim->now_us);
+            }
+        }
+    }
+}
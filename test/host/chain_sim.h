@@ -0,0 +1,36 @@
+#ifndef CHAIN_SIM_H_
+#define CHAIN_SIM_H_
+
+#include <stdint.h>
+
+#include "asic_stats.h"
+
+#define CHAIN_SIM_MAX_CHIPS 16
+
+typedef struct
+{
+    float frequency;
+    // highest frequency the chip hashes correctly at, 0 for a dead chip
+    float stable_limit;
+} ChainSimChip;
+
+// a chain of chips returning nonces into an AsicStatsModule like the result task does
+typedef struct
+{
+    uint16_t chip_count;
+    ChainSimChip chips[CHAIN_SIM_MAX_CHIPS];
+    // diff 1 work per second per MHz of a stable chip
+    double work_rate;
+    // ticket difficulty the chips are programmed with
+    uint32_t ticket_diff;
+    uint32_t rng;
+    int64_t now_us;
+    AsicStatsModule stats;
+} ChainSim;
+
+void chain_sim_init(ChainSim * sim, uint16_t chip_count, float frequency, const float * stable_limits);
+void chain_sim_free(ChainSim * sim);
+void chain_sim_set_chip_frequency(ChainSim * sim, uint8_t asic_nr, float frequency);
+void chain_sim_run(ChainSim * sim, uint32_t seconds);
+
+#endif /* CHAIN_SIM_H_ */
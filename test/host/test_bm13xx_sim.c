@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "bm13xx_sim.h"
+#include "common.h"
+#include "asic_link.h"
+#include "crc.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                           \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                            \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+// block 0, found at nonce 0x7C2BAC1D with 11 leading zero bits past the diff 1 target
+static const char * genesis_header_hex = "0100000000000000000000000000000000000000000000000000000000000000"
+                                         "000000003ba3edfd7a7b12b27ac72c3e67768f617fc81bc3888a51323a9fb8aa"
+                                         "4b1e5e4a29ab5f49ffff001d1dac2b7c";
+static const char * genesis_hash_hex = "6fe28c0ab6f1b372c1a6a246ae63f74f931e8365e15a089c68d6190000000000";
+static const uint32_t genesis_nonce = 0x7C2BAC1D;
+
+static void hex_to_bin(const char * hex, uint8_t * out, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        sscanf(hex + i * 2, "%2hhx", &out[i]);
+    }
+}
+
+/// @brief builds a frame the way ASIC_frame_build does
+static uint8_t build_frame(uint8_t * buf, uint8_t header, const uint8_t * data, uint8_t data_len)
+{
+    bool is_job = (header & 0x20) != 0;
+
+    buf[0] = 0x55;
+    buf[1] = 0xAA;
+    buf[2] = header;
+    buf[3] = is_job ? data_len + 4 : data_len + 3;
+    memcpy(buf + 4, data, data_len);
+
+    if (is_job) {
+        uint16_t crc = crc16_false(buf + 2, data_len + 2);
+        buf[4 + data_len] = crc >> 8;
+        buf[5 + data_len] = crc & 0xFF;
+        return data_len + 6;
+    }
+
+    buf[4 + data_len] = crc5(buf + 2, data_len + 2);
+    return data_len + 5;
+}
+
+static void send_frame(Bm13xxSim * sim, uint8_t header, const uint8_t * data, uint8_t data_len)
+{
+    uint8_t frame[BM13XX_SIM_MAX_FRAME];
+    bm13xx_sim_feed(sim, frame, build_frame(frame, header, data, data_len));
+}
+
+static void reverse_words(uint8_t * dest, const uint8_t * src)
+{
+    for (int i = 0; i < 8; i++) {
+        memcpy(dest + i * 4, src + (7 - i) * 4, 4);
+    }
+}
+
+static void set_ticket_difficulty(Bm13xxSim * sim, int difficulty)
+{
+    uint32_t mask = ASIC_get_ticket_mask(difficulty);
+    uint8_t data[6] = {0x00, 0x14, mask >> 24, mask >> 16, mask >> 8, mask};
+    send_frame(sim, 0x51, data, 6);
+}
+
+static void test_enumeration(void)
+{
+    Bm13xxSim sim;
+    uint8_t out[256];
+
+    bm13xx_sim_init(&sim, BM13XX_SIM_BM1370, 4, 1);
+
+    // read register 0 on all chips, like _send_init does
+    send_frame(&sim, 0x52, (uint8_t[]){0x00, 0x00}, 2);
+    size_t len = bm13xx_sim_take_output(&sim, out, sizeof(out));
+    CHECK(len == 4 * 11, "enumeration returned %zu bytes", len);
+    for (int i = 0; i < 4; i++) {
+        CHECK(memcmp(out + i * 11, "\xaa\x55\x13\x70\x00\x00", 6) == 0, "chip %d did not answer with its id", i);
+        CHECK((out[i * 11 + 10] & 0x80) == 0, "register reply %d has the job bit set", i);
+        CHECK(ASIC_link_response_crc_ok(out + i * 11, 11), "register reply %d has a bad crc", i);
+    }
+
+    // address the chips, then a single chip write is only seen by that chip
+    send_frame(&sim, 0x53, (uint8_t[]){0x00, 0x00}, 2);
+    for (int i = 0; i < 4; i++) {
+        send_frame(&sim, 0x40, (uint8_t[]){i * 64, 0x00}, 2);
+    }
+    send_frame(&sim, 0x41, (uint8_t[]){128, 0x08, 0x40, 0xA0, 0x02, 0x41}, 6);
+    send_frame(&sim, 0x52, (uint8_t[]){0x00, 0x08}, 2);
+    len = bm13xx_sim_take_output(&sim, out, sizeof(out));
+    CHECK(len == 4 * 11, "register read returned %zu bytes", len);
+    for (int i = 0; i < 4; i++) {
+        bool written = out[i * 11 + 6] == 128;
+        CHECK(out[i * 11 + 6] == i * 64, "chip %d replied from address %d", i, out[i * 11 + 6]);
+        CHECK(out[i * 11 + 7] == 0x08, "chip %d replied for register %02X", i, out[i * 11 + 7]);
+        CHECK((memcmp(out + i * 11 + 2, "\x40\xa0\x02\x41", 4) == 0) == written, "chip %d register 0x08 is wrong", i);
+    }
+
+    CHECK(sim.command_frames == 8, "%u command frames", sim.command_frames);
+    CHECK(sim.crc_errors == 0, "%u crc errors", sim.crc_errors);
+}
+
+static void test_crc_and_resync(void)
+{
+    Bm13xxSim sim;
+    uint8_t frame[16];
+    uint8_t out[64];
+
+    bm13xx_sim_init(&sim, BM13XX_SIM_BM1368, 1, 1);
+
+    uint8_t len = build_frame(frame, 0x52, (uint8_t[]){0x00, 0x00}, 2);
+    frame[len - 1] ^= 0x01;
+    bm13xx_sim_feed(&sim, (const uint8_t *) "\x12\x34", 2);
+    bm13xx_sim_feed(&sim, frame, len);
+    CHECK(bm13xx_sim_take_output(&sim, out, sizeof(out)) == 0, "a frame with a bad crc was answered");
+    CHECK(sim.crc_errors == 1, "%u crc errors", sim.crc_errors);
+
+    // a good frame split over two writes still gets through
+    len = build_frame(frame, 0x52, (uint8_t[]){0x00, 0x00}, 2);
+    bm13xx_sim_feed(&sim, frame, 3);
+    bm13xx_sim_feed(&sim, frame + 3, len - 3);
+    CHECK(bm13xx_sim_take_output(&sim, out, sizeof(out)) == 11, "the chip id was not read after the resync");
+    CHECK(memcmp(out, "\xaa\x55\x13\x68\x00\x00", 6) == 0, "wrong chip id");
+    CHECK(sim.dropped_bytes >= 2, "%u dropped bytes", sim.dropped_bytes);
+}
+
+static void test_ticket_mask(void)
+{
+    Bm13xxSim sim;
+
+    bm13xx_sim_init(&sim, BM13XX_SIM_BM1366, 2, 1);
+    CHECK(bm13xx_sim_ticket_difficulty(&sim) == 1, "reset ticket difficulty %u", bm13xx_sim_ticket_difficulty(&sim));
+
+    int difficulties[] = {1, 256, 512, 2048, 65536};
+    for (size_t i = 0; i < sizeof(difficulties) / sizeof(difficulties[0]); i++) {
+        set_ticket_difficulty(&sim, difficulties[i]);
+        CHECK(bm13xx_sim_ticket_difficulty(&sim) == (uint32_t) difficulties[i], "ticket difficulty %u, wrote %d",
+              bm13xx_sim_ticket_difficulty(&sim), difficulties[i]);
+    }
+}
+
+static void test_sha256d(void)
+{
+    uint8_t header[80];
+    uint8_t expected[32];
+    uint8_t hash[32];
+
+    hex_to_bin(genesis_header_hex, header, 80);
+    hex_to_bin(genesis_hash_hex, expected, 32);
+    bm13xx_sim_sha256d(header, hash);
+    CHECK(memcmp(hash, expected, 32) == 0, "double sha256 of the genesis header is wrong");
+}
+
+/// @brief true if the hash of the header with this nonce has 32 + bits leading zero bits, read little endian
+static bool nonce_meets(const uint8_t header[80], uint32_t nonce, int bits)
+{
+    uint8_t block[80];
+    uint8_t hash[32];
+
+    memcpy(block, header, 80);
+    memcpy(block + 76, &nonce, 4);
+    bm13xx_sim_sha256d(block, hash);
+
+    uint64_t top = 0;
+    for (int i = 31; i >= 24; i--) {
+        top = (top << 8) | hash[i];
+    }
+    return (top >> (32 - bits)) == 0;
+}
+
+static void link_write_register(void * ctx, uint8_t reg, uint32_t value)
+{
+    send_frame(ctx, 0x51, (uint8_t[]){0x00, reg, value >> 24, value >> 16, value >> 8, value}, 6);
+}
+
+static void link_read_register(void * ctx, uint8_t reg)
+{
+    send_frame(ctx, 0x52, (uint8_t[]){0x00, reg}, 2);
+}
+
+static void link_set_baud(void * ctx, int baud)
+{
+    (void) ctx;
+    (void) baud;
+}
+
+static int16_t link_read_frames(void * ctx, uint8_t * buf, uint16_t frame_size, uint16_t max_frames, uint16_t timeout_ms)
+{
+    (void) timeout_ms;
+    return bm13xx_sim_take_output(ctx, buf, (size_t) frame_size * max_frames) / frame_size;
+}
+
+static void test_link_negotiation(void)
+{
+    Bm13xxSim sim;
+    AsicLink link;
+    AsicLinkIo io = {
+        .ctx = &sim,
+        .write_register = link_write_register,
+        .read_register = link_read_register,
+        .set_baud = link_set_baud,
+        .read_frames = link_read_frames,
+    };
+
+    bm13xx_sim_init(&sim, BM13XX_SIM_BM1370, 4, 1);
+    ASIC_link_init(&link);
+    ASIC_link_set_rates(&link, ASIC_LINK_FAST_UART_RATES, ASIC_LINK_FAST_UART_RATE_COUNT);
+    // what the BM1370 init script leaves in MISC_CONTROL
+    link_write_register(&sim, ASIC_LINK_MISC_CONTROL, 0xF000C100);
+
+    // the pty has no line rate to fail at, so the reply crc decides
+    int baud = ASIC_link_negotiate(&link, &io, 4, 11);
+    CHECK(baud == 1000000, "negotiated %d baud", baud);
+    CHECK(link.crc_checked, "the simulated reply crc was not accepted");
+    CHECK(sim.chips[3].registers[ASIC_LINK_FAST_UART] == 0x11300200, "chip 3 fast UART configuration is %08X",
+          sim.chips[3].registers[ASIC_LINK_FAST_UART]);
+    CHECK(sim.chips[3].registers[ASIC_LINK_MISC_CONTROL] == 0xF000C100, "chip 3 MISC_CONTROL is %08X",
+          sim.chips[3].registers[ASIC_LINK_MISC_CONTROL]);
+}
+
+static void test_bm1370_nonce(void)
+{
+    Bm13xxSim sim;
+    uint8_t header[80];
+    uint8_t job[82];
+    uint8_t out[64];
+    Bm13xxSimNonce nonce;
+
+    hex_to_bin(genesis_header_hex, header, 80);
+    bm13xx_sim_init(&sim, BM13XX_SIM_BM1370, 1, 1);
+    set_ticket_difficulty(&sim, 256);
+
+    // the BM1370_job layout as BM1370_prepare_work fills it
+    uint32_t starting_nonce = genesis_nonce - 4096;
+    job[0] = 24;
+    job[1] = 1;
+    memcpy(job + 2, &starting_nonce, 4);
+    memcpy(job + 6, header + 72, 4);
+    memcpy(job + 10, header + 68, 4);
+    reverse_words(job + 14, header + 36);
+    reverse_words(job + 46, header + 4);
+    memcpy(job + 78, header, 4);
+    send_frame(&sim, 0x21, job, sizeof(job));
+    CHECK(sim.job_frames == 1, "%u job frames", sim.job_frames);
+
+    CHECK(bm13xx_sim_search(&sim, 8192, &nonce), "no nonce found in the 8192 hashes before the genesis nonce");
+    CHECK(nonce.nonce == genesis_nonce, "found nonce %08X", nonce.nonce);
+    CHECK(sim.hashes == 4097, "%llu hashes", (unsigned long long) sim.hashes);
+
+    // decode the result the way BM1370_proccess_work does
+    bm13xx_sim_emit_nonce(&sim, &nonce);
+    CHECK(bm13xx_sim_take_output(&sim, out, sizeof(out)) == 11, "result frame is not 11 bytes");
+    uint32_t rx_nonce;
+    memcpy(&rx_nonce, out + 2, 4);
+    CHECK(out[0] == 0xAA && out[1] == 0x55, "bad preamble");
+    CHECK(rx_nonce == genesis_nonce, "returned nonce %08X", rx_nonce);
+    CHECK(((out[7] & 0xF0) >> 1) == 24, "returned job id %02X", (out[7] & 0xF0) >> 1);
+    CHECK(out[8] == 0 && out[9] == 0, "returned version bits for an unrolled job");
+    CHECK((out[10] & 0x80) != 0, "nonce reply without the job bit");
+    CHECK(nonce_meets(header, rx_nonce, 8), "returned nonce does not meet the ticket mask");
+
+    // every corrupted nonce misses the mask
+    sim.hw_error_rate = 1.0;
+    bm13xx_sim_emit_nonce(&sim, &nonce);
+    bm13xx_sim_take_output(&sim, out, sizeof(out));
+    memcpy(&rx_nonce, out + 2, 4);
+    CHECK(sim.hw_errors == 1, "%u hw errors", sim.hw_errors);
+    CHECK(rx_nonce != genesis_nonce && !nonce_meets(header, rx_nonce, 8), "corrupted nonce %08X still meets the mask", rx_nonce);
+}
+
+static void test_bm1397_nonce(void)
+{
+    Bm13xxSim sim;
+    uint8_t header[80];
+    uint8_t job[146] = {0};
+    uint8_t out[64];
+    uint32_t state[8];
+    Bm13xxSimNonce nonce;
+
+    hex_to_bin(genesis_header_hex, header, 80);
+    bm13xx_sim_init(&sim, BM13XX_SIM_BM1397, 1, 1);
+    set_ticket_difficulty(&sim, 2048);
+
+    // the job_packet layout as BM1397_prepare_work fills it, the midstate flipped and reversed like construct_bm_job
+    uint32_t starting_nonce = genesis_nonce - 100;
+    job[0] = 8;
+    job[1] = 1;
+    memcpy(job + 2, &starting_nonce, 4);
+    memcpy(job + 6, header + 72, 4);
+    memcpy(job + 10, header + 68, 4);
+    memcpy(job + 14, header + 64, 4);
+    bm13xx_sim_sha256_midstate(header, state);
+    for (int i = 0; i < 8; i++) {
+        for (int b = 0; b < 4; b++) {
+            job[18 + 31 - (i * 4 + b)] = state[i] >> (24 - 8 * b);
+        }
+    }
+    send_frame(&sim, 0x21, job, sizeof(job));
+
+    CHECK(bm13xx_sim_search(&sim, 1000, &nonce), "no nonce found before the genesis nonce");
+    CHECK(nonce.nonce == genesis_nonce, "found nonce %08X", nonce.nonce);
+
+    bm13xx_sim_emit_nonce(&sim, &nonce);
+    CHECK(bm13xx_sim_take_output(&sim, out, sizeof(out)) == 9, "result frame is not 9 bytes");
+    uint32_t rx_nonce;
+    memcpy(&rx_nonce, out + 2, 4);
+    CHECK(rx_nonce == genesis_nonce, "returned nonce %08X", rx_nonce);
+    CHECK((out[7] & 0xFC) == 8 && (out[7] & 0x03) == 0, "returned job byte %02X", out[7]);
+
+    // the genesis hash has 11 zero bits past the diff 1 target, so the search has to skip it at 4096
+    set_ticket_difficulty(&sim, 4096);
+    send_frame(&sim, 0x21, job, sizeof(job));
+    CHECK(!bm13xx_sim_search(&sim, 1000, &nonce), "nonce %08X found above the genesis difficulty", nonce.nonce);
+}
+
+int main(void)
+{
+    test_enumeration();
+    test_crc_and_resync();
+    test_ticket_mask();
+    test_sha256d();
+    test_link_negotiation();
+    test_bm1370_nonce();
+    test_bm1397_nonce();
+
+    printf("%d failure(s)\n", failures);
+    return failures == 0 ? 0 : 1;
+}
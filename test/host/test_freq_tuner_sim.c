@@ -0,0 +1,175 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "chain_sim.h"
+#include "freq_tuner.h"
+
+#define POLL_S 10
+#define MAX_POLLS 2000
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                           \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                            \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+/// @brief what the tuner task does every poll, against the simulated chain
+static bool poll_tuner(ChainSim * sim, FreqTuner * tuner)
+{
+    bool changed = false;
+
+    chain_sim_run(sim, POLL_S);
+
+    for (int i = 0; i < tuner->chip_count; i++) {
+        if (FREQ_TUNER_update_chip(tuner, i, sim->stats.chips[i].nonces, sim->stats.chips[i].hw_errors, sim->stats.chips[i].work,
+                                   sim->now_us)) {
+            chain_sim_set_chip_frequency(sim, i, tuner->chips[i].frequency);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+static int run_until_settled(ChainSim * sim, FreqTuner * tuner)
+{
+    for (int poll = 0; poll < MAX_POLLS; poll++) {
+        poll_tuner(sim, tuner);
+        if (FREQ_TUNER_is_settled(tuner)) {
+            return poll;
+        }
+    }
+    return -1;
+}
+
+/// @brief highest frequency on the tuning grid that is still within the limit of a chip
+static float best_stable(const FreqTunerConfig * config, float start, float limit)
+{
+    float best = start;
+    while (best + config->step <= limit && best + config->step <= config->max_frequency) {
+        best += config->step;
+    }
+    return best;
+}
+
+static void test_chips_converge_to_their_own_limit(void)
+{
+    const float limits[] = {512.5, 531.25, 560, 640, 500};
+    const uint16_t chip_count = sizeof(limits) / sizeof(limits[0]);
+    ChainSim sim;
+    FreqTuner tuner = {0};
+    FreqTunerConfig config;
+
+    FREQ_TUNER_default_config(&config, 500, 600);
+    chain_sim_init(&sim, chip_count, 500, limits);
+    CHECK(FREQ_TUNER_init(&tuner, &config, chip_count, 500, NULL), "init");
+
+    int polls = run_until_settled(&sim, &tuner);
+    CHECK(polls >= 0, "chain did not settle");
+    printf("settled after %d s\n", polls * POLL_S);
+
+    for (int i = 0; i < chip_count; i++) {
+        float expected = best_stable(&config, 500, limits[i]);
+        printf("chip %d: limit %.2f -> %.2f MHz\n", i, limits[i], tuner.chips[i].frequency);
+        CHECK(tuner.chips[i].frequency == expected, "chip %d at %.2f, expected %.2f", i, tuner.chips[i].frequency, expected);
+        CHECK(sim.chips[i].frequency == tuner.chips[i].frequency, "chip %d frequency not applied", i);
+    }
+
+    // settled chips stay put while they are stable
+    for (int poll = 0; poll < 360; poll++) {
+        CHECK(!poll_tuner(&sim, &tuner), "settled chain changed frequency at poll %d", poll);
+    }
+
+    // the ticket mask follows the hashrate, the settled chips must not read that as instability
+    sim.ticket_diff = 128;
+    for (int poll = 0; poll < 60; poll++) {
+        CHECK(!poll_tuner(&sim, &tuner), "lower ticket mask changed frequency at poll %d", poll);
+    }
+    sim.ticket_diff = 512;
+    for (int poll = 0; poll < 60; poll++) {
+        CHECK(!poll_tuner(&sim, &tuner), "higher ticket mask changed frequency at poll %d", poll);
+    }
+
+    // persist and restart: every chip comes back settled on its tuned frequency
+    char saved_str[128];
+    CHECK(FREQ_TUNER_format(&tuner, saved_str, sizeof(saved_str)) > 0, "format");
+
+    float saved[CHAIN_SIM_MAX_CHIPS];
+    CHECK(FREQ_TUNER_parse(saved_str, saved, chip_count) == chip_count, "parse %s", saved_str);
+
+    FreqTuner restarted = {0};
+    CHECK(FREQ_TUNER_init(&restarted, &config, chip_count, 500, saved), "init from saved");
+    CHECK(FREQ_TUNER_is_settled(&restarted), "restart not settled");
+    for (int i = 0; i < chip_count; i++) {
+        CHECK(restarted.chips[i].frequency == tuner.chips[i].frequency, "chip %d restarted at %.2f", i, restarted.chips[i].frequency);
+    }
+
+    FREQ_TUNER_free(&restarted);
+    FREQ_TUNER_free(&tuner);
+    chain_sim_free(&sim);
+}
+
+static void test_settled_chip_backs_off_when_it_degrades(void)
+{
+    const float limits[] = {575, 575};
+    ChainSim sim;
+    FreqTuner tuner = {0};
+    FreqTunerConfig config;
+
+    FREQ_TUNER_default_config(&config, 550, 600);
+    chain_sim_init(&sim, 2, 550, limits);
+    FREQ_TUNER_init(&tuner, &config, 2, 550, NULL);
+
+    CHECK(run_until_settled(&sim, &tuner) >= 0, "chain did not settle");
+    CHECK(tuner.chips[1].frequency == 575, "chip 1 at %.2f", tuner.chips[1].frequency);
+
+    // chip 1 gets hotter and loses two steps of headroom
+    sim.chips[1].stable_limit = 562.5;
+
+    for (int poll = 0; poll < 100; poll++) {
+        poll_tuner(&sim, &tuner);
+    }
+
+    CHECK(tuner.chips[0].frequency == 575, "chip 0 moved to %.2f", tuner.chips[0].frequency);
+    CHECK(tuner.chips[1].frequency == 562.5, "chip 1 at %.2f after degrading", tuner.chips[1].frequency);
+    CHECK(FREQ_TUNER_is_settled(&tuner), "chain did not settle again");
+
+    FREQ_TUNER_free(&tuner);
+    chain_sim_free(&sim);
+}
+
+static void test_dead_chip_falls_to_the_minimum(void)
+{
+    const float limits[] = {525, 0};
+    ChainSim sim;
+    FreqTuner tuner = {0};
+    FreqTunerConfig config;
+
+    FREQ_TUNER_default_config(&config, 500, 600);
+    chain_sim_init(&sim, 2, 500, limits);
+    FREQ_TUNER_init(&tuner, &config, 2, 500, NULL);
+
+    CHECK(run_until_settled(&sim, &tuner) >= 0, "chain did not settle");
+    CHECK(tuner.chips[0].frequency == 525, "chip 0 at %.2f", tuner.chips[0].frequency);
+    CHECK(tuner.chips[1].frequency == config.min_frequency, "dead chip at %.2f", tuner.chips[1].frequency);
+
+    FREQ_TUNER_free(&tuner);
+    chain_sim_free(&sim);
+}
+
+int main(void)
+{
+    test_chips_converge_to_their_own_limit();
+    test_settled_chip_backs_off_when_it_degrades();
+    test_dead_chip_falls_to_the_minimum();
+
+    printf("%d failure(s)\n", failures);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,296 @@
+// Two simulated BM1370 chains, each behind its own pty, fed the way create_jobs_task and the ASIC task feed
+// several chains: the shortest queue gets the next extranonce_2, every chain numbers its own job ids and the
+// results read back from each UART are counted in that chain's stats.
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "asic_dispatch.h"
+#include "asic_stats.h"
+#include "bm13xx_sim.h"
+#include "crc.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                           \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                            \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+#define CHAINS 2
+// same as create_jobs_task
+#define QUEUE_LOW_WATER_MARK 10
+#define BM1370_JOB_ID_STEP 24
+#define NOTIFICATIONS 4
+#define ROUNDS 50
+#define MAX_EXTRANONCE_2 1024
+#define TICKET_DIFFICULTY 256
+#define READ_TIMEOUT_MS 1000
+
+typedef struct
+{
+    Bm13xxSim sim;
+    // the simulator reads and writes the master, the firmware side uses the slave like a UART
+    int master;
+    int slave;
+    // stands in for ASIC_jobs_queue, holds extranonce_2 values
+    uint32_t queue[QUEUE_LOW_WATER_MARK];
+    int queue_count;
+    uint8_t last_job_id;
+    // notification and extranonce_2 of the job dispatched under each id, -1 if none
+    int64_t active[ASIC_DISPATCH_JOB_IDS];
+    uint32_t dispatched;
+    uint32_t results;
+    AsicStatsModule stats;
+} SimChain;
+
+static SimChain chains[CHAINS];
+
+static bool open_pty(SimChain * chain)
+{
+    chain->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (chain->master < 0 || grantpt(chain->master) != 0 || unlockpt(chain->master) != 0) {
+        perror("posix_openpt");
+        return false;
+    }
+
+    chain->slave = open(ptsname(chain->master), O_RDWR | O_NOCTTY);
+    if (chain->slave < 0) {
+        perror("open pty");
+        return false;
+    }
+
+    struct termios tio;
+    tcgetattr(chain->slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(chain->slave, TCSANOW, &tio);
+    return true;
+}
+
+static void write_all(int fd, const uint8_t * buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t ret = write(fd, buf, len);
+        if (ret <= 0) {
+            perror("write");
+            return;
+        }
+        buf += ret;
+        len -= ret;
+    }
+}
+
+/// @brief reads exactly len bytes unless the other end goes quiet
+static size_t read_exact(int fd, uint8_t * buf, size_t len)
+{
+    size_t got = 0;
+    while (got < len) {
+        struct pollfd pfd = {.fd = fd, .events = POLLIN};
+        if (poll(&pfd, 1, READ_TIMEOUT_MS) <= 0) {
+            break;
+        }
+        ssize_t ret = read(fd, buf + got, len - got);
+        if (ret <= 0) {
+            break;
+        }
+        got += ret;
+    }
+    return got;
+}
+
+/// @brief builds a frame the way ASIC_frame_build does
+static uint8_t build_frame(uint8_t * buf, uint8_t header, const uint8_t * data, uint8_t data_len)
+{
+    bool is_job = (header & 0x20) != 0;
+
+    buf[0] = 0x55;
+    buf[1] = 0xAA;
+    buf[2] = header;
+    buf[3] = is_job ? data_len + 4 : data_len + 3;
+    memcpy(buf + 4, data, data_len);
+
+    if (is_job) {
+        uint16_t crc = crc16_false(buf + 2, data_len + 2);
+        buf[4 + data_len] = crc >> 8;
+        buf[5 + data_len] = crc & 0xFF;
+        return data_len + 6;
+    }
+
+    buf[4 + data_len] = crc5(buf + 2, data_len + 2);
+    return data_len + 5;
+}
+
+/// @brief writes a frame to the chain's UART and lets the simulator on the other end of the pty take it
+static void send_frame(SimChain * chain, uint8_t header, const uint8_t * data, uint8_t data_len)
+{
+    uint8_t frame[BM13XX_SIM_MAX_FRAME];
+    uint8_t len = build_frame(frame, header, data, data_len);
+
+    write_all(chain->slave, frame, len);
+    uint8_t rx[BM13XX_SIM_MAX_FRAME];
+    size_t got = read_exact(chain->master, rx, len);
+    CHECK(got == len, "simulator read %zu of %u frame bytes", got, len);
+    bm13xx_sim_feed(&chain->sim, rx, got);
+}
+
+static int64_t job_key(int notification, uint32_t extranonce_2)
+{
+    return ((int64_t) notification << 32) | extranonce_2;
+}
+
+/// @brief sends the oldest queued job with the next job id of the chain, like ASIC_task dispatching to BM1370_send_work
+static void dispatch(SimChain * chain, int notification)
+{
+    uint32_t extranonce_2 = chain->queue[0];
+    chain->queue_count--;
+    memmove(chain->queue, chain->queue + 1, chain->queue_count * sizeof(chain->queue[0]));
+
+    uint8_t id = ASIC_dispatch_next_job_id(&chain->last_job_id, BM1370_JOB_ID_STEP);
+    chain->active[id] = job_key(notification, extranonce_2);
+    chain->dispatched++;
+
+    // the BM1370_job layout, the merkle root carries the notification and extranonce_2 it was built from
+    uint8_t job[82] = {0};
+    job[0] = id;
+    job[1] = 1;
+    memcpy(job + 14, &extranonce_2, 4);
+    memcpy(job + 18, &notification, 4);
+    send_frame(chain, 0x21, job, sizeof(job));
+}
+
+/// @brief has the chain return a nonce for its current job and handles it the way the result task would
+static void read_result(SimChain * chain, int64_t now_us)
+{
+    Bm13xxSimNonce nonce;
+    if (!bm13xx_sim_random_nonce(&chain->sim, &nonce)) {
+        return;
+    }
+    bm13xx_sim_emit_nonce(&chain->sim, &nonce);
+
+    uint8_t out[64];
+    size_t len = bm13xx_sim_take_output(&chain->sim, out, sizeof(out));
+    write_all(chain->master, out, len);
+
+    uint8_t result[11];
+    if (read_exact(chain->slave, result, sizeof(result)) != sizeof(result)) {
+        CHECK(false, "no result frame on the UART");
+        return;
+    }
+
+    // decode the way BM1370_proccess_work does
+    uint8_t id = (result[7] & 0xF0) >> 1;
+    uint8_t small_core = result[7] & 0x0F;
+    CHECK(chain->active[id] >= 0, "result for job id %u that was never dispatched to this chain", id);
+
+    // the job the chip hashed is the one dispatched under this id on this chain, not on any other
+    const Bm13xxSimJob * job = &chain->sim.jobs[id];
+    uint32_t extranonce_2;
+    int notification;
+    memcpy(&extranonce_2, job->header + 36 + 28, 4);
+    memcpy(&notification, job->header + 36 + 24, 4);
+    CHECK(chain->active[id] == job_key(notification, extranonce_2), "job id %u resolves to the wrong job", id);
+
+    ASIC_stats_record(&chain->stats, 0, 0, small_core, ASIC_RESULT_VALID, TICKET_DIFFICULTY, now_us);
+    chain->results++;
+}
+
+int main(void)
+{
+    for (int c = 0; c < CHAINS; c++) {
+        SimChain * chain = &chains[c];
+        bm13xx_sim_init(&chain->sim, BM13XX_SIM_BM1370, 1, c + 1);
+        chain->stats.chips = calloc(1, sizeof(AsicChipStats));
+        ASIC_stats_init(&chain->stats, 1, 0);
+        for (int i = 0; i < ASIC_DISPATCH_JOB_IDS; i++) {
+            chain->active[i] = -1;
+        }
+        if (!open_pty(chain)) {
+            return 1;
+        }
+    }
+
+    // chain c takes c + 1 jobs per round, so the queues drain at different rates
+    int64_t now_us = 0;
+    for (int n = 0; n < NOTIFICATIONS; n++) {
+        static int8_t owner[MAX_EXTRANONCE_2];
+        memset(owner, -1, sizeof(owner));
+
+        // a clean job empties every queue and extranonce_2 starts over
+        for (int c = 0; c < CHAINS; c++) {
+            chains[c].queue_count = 0;
+        }
+        uint32_t extranonce_2 = 0;
+
+        for (int round = 0; round < ROUNDS; round++) {
+            int queue_counts[CHAINS];
+            int chain;
+            for (;;) {
+                for (int c = 0; c < CHAINS; c++) {
+                    queue_counts[c] = chains[c].queue_count;
+                }
+                chain = ASIC_dispatch_chain_needing_work(queue_counts, CHAINS, QUEUE_LOW_WATER_MARK);
+                if (chain < 0 || extranonce_2 >= MAX_EXTRANONCE_2) {
+                    break;
+                }
+                CHECK(owner[extranonce_2] < 0, "extranonce_2 %u went to chain %d and chain %d", extranonce_2,
+                      owner[extranonce_2], chain);
+                owner[extranonce_2] = chain;
+                chains[chain].queue[chains[chain].queue_count++] = extranonce_2++;
+            }
+
+            for (int c = 0; c < CHAINS; c++) {
+                for (int i = 0; i <= c && chains[c].queue_count > 0; i++) {
+                    dispatch(&chains[c], n);
+                    now_us += 100000;
+                    read_result(&chains[c], now_us);
+                }
+            }
+        }
+    }
+
+    uint32_t total_results = 0;
+    for (int c = 0; c < CHAINS; c++) {
+        SimChain * chain = &chains[c];
+        CHECK(chain->dispatched == (uint32_t) NOTIFICATIONS * ROUNDS * (c + 1), "chain %d got %u jobs", c, chain->dispatched);
+        CHECK(chain->sim.job_frames == chain->dispatched, "chain %d saw %u of %u job frames", c, chain->sim.job_frames,
+              chain->dispatched);
+        CHECK(chain->sim.crc_errors == 0, "chain %d had %u crc errors", c, chain->sim.crc_errors);
+
+        // job ids only advance with the chain's own dispatches
+        CHECK(chain->last_job_id == (chain->dispatched * BM1370_JOB_ID_STEP) % ASIC_DISPATCH_JOB_IDS,
+              "chain %d is at job id %u after %u jobs", c, chain->last_job_id, chain->dispatched);
+
+        // every result is counted on the chain whose UART it came from
+        CHECK(chain->results == chain->sim.nonces, "chain %d read %u of %u nonces", c, chain->results, chain->sim.nonces);
+        CHECK(chain->stats.chips[0].nonces == chain->sim.nonces, "chain %d stats count %u nonces, it sent %u", c,
+              chain->stats.chips[0].nonces, chain->sim.nonces);
+        CHECK(chain->stats.chips[0].work == (double) chain->sim.nonces * TICKET_DIFFICULTY, "chain %d stats work %.0f", c,
+              chain->stats.chips[0].work);
+        total_results += chain->results;
+    }
+
+    CHECK(chains[1].stats.chips[0].nonces == 2 * chains[0].stats.chips[0].nonces, "the faster chain counted %u nonces, the slower %u",
+          chains[1].stats.chips[0].nonces, chains[0].stats.chips[0].nonces);
+    CHECK(total_results == (uint32_t) NOTIFICATIONS * ROUNDS * 3, "%u results in total", total_results);
+
+    for (int c = 0; c < CHAINS; c++) {
+        close(chains[c].slave);
+        close(chains[c].master);
+        free(chains[c].stats.chips);
+    }
+
+    printf("%d failure(s)\n", failures);
+    return failures == 0 ? 0 : 1;
+}
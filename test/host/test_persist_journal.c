@@ -0,0 +1,105 @@
+// The two-slot journal PERSIST_flush writes and PERSIST_init reads back: the newest valid record wins, a torn
+// write only loses the slot it went to and the sequence numbers keep ordering the slots across their wrap.
+#include <stdio.h>
+#include <string.h>
+
+#include "persist_journal.h"
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                                                                                           \
+    do {                                                                                                                           \
+        if (!(cond)) {                                                                                                             \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__);                                                                            \
+            printf(__VA_ARGS__);                                                                                                   \
+            printf("\n");                                                                                                          \
+            failures++;                                                                                                            \
+        }                                                                                                                          \
+    } while (0)
+
+/// @brief writes a record the way PERSIST_flush does and reads the slot back
+static void flush(PersistRecord * slots, bool * valid, uint32_t sequence, uint64_t best_diff)
+{
+    uint64_t values[PERSIST_COUNTERS] = {[PERSIST_BEST_DIFF] = best_diff};
+    int slot = PERSIST_journal_slot(sequence);
+
+    PERSIST_journal_seal(&slots[slot], sequence, values);
+    valid[slot] = PERSIST_journal_valid(&slots[slot], sizeof(slots[slot]));
+}
+
+static void test_alternating_slots(void)
+{
+    PersistRecord slots[PERSIST_JOURNAL_SLOTS] = {0};
+    bool valid[PERSIST_JOURNAL_SLOTS] = {false, false};
+
+    CHECK(PERSIST_journal_newest(slots, valid) < 0, "an empty journal has a newest record");
+
+    for (uint32_t sequence = 1; sequence <= 5; sequence++) {
+        flush(slots, valid, sequence, sequence * 1000);
+        int newest = PERSIST_journal_newest(slots, valid);
+        CHECK(newest == PERSIST_journal_slot(sequence), "record %u is not the newest", sequence);
+        CHECK(slots[newest].values[PERSIST_BEST_DIFF] == sequence * 1000, "record %u holds %llu", sequence,
+              (unsigned long long) slots[newest].values[PERSIST_BEST_DIFF]);
+    }
+    CHECK(PERSIST_journal_slot(6) != PERSIST_journal_slot(5), "two records in a row go to the same slot");
+}
+
+static void test_torn_slot(void)
+{
+    PersistRecord slots[PERSIST_JOURNAL_SLOTS] = {0};
+    bool valid[PERSIST_JOURNAL_SLOTS] = {false, false};
+
+    flush(slots, valid, 7, 7000);
+    flush(slots, valid, 8, 8000);
+
+    // the write of record 9 stops halfway through the values
+    int torn = PERSIST_journal_slot(9);
+    uint64_t values[PERSIST_COUNTERS] = {[PERSIST_BEST_DIFF] = 9000};
+    PersistRecord record;
+    PERSIST_journal_seal(&record, 9, values);
+    memcpy(&slots[torn], &record, offsetof(PersistRecord, values) + 4);
+    valid[torn] = PERSIST_journal_valid(&slots[torn], sizeof(slots[torn]));
+
+    CHECK(!valid[torn], "a torn record is taken as valid");
+    int newest = PERSIST_journal_newest(slots, valid);
+    CHECK(newest == PERSIST_journal_slot(8), "the record before the torn one is lost");
+    CHECK(slots[newest].values[PERSIST_BEST_DIFF] == 8000, "the journal came back with %llu",
+          (unsigned long long) slots[newest].values[PERSIST_BEST_DIFF]);
+
+    // a flipped bit and a record of another layout are damaged too
+    PERSIST_journal_seal(&record, 10, values);
+    record.values[PERSIST_BEST_DIFF] ^= 1;
+    CHECK(!PERSIST_journal_valid(&record, sizeof(record)), "a flipped bit passes the crc");
+    PERSIST_journal_seal(&record, 10, values);
+    CHECK(!PERSIST_journal_valid(&record, sizeof(record) - 8), "a record of another size is valid");
+}
+
+static void test_sequence_wrap(void)
+{
+    PersistRecord slots[PERSIST_JOURNAL_SLOTS] = {0};
+    bool valid[PERSIST_JOURNAL_SLOTS] = {false, false};
+
+    flush(slots, valid, 0xFFFFFFFE, 1);
+    flush(slots, valid, 0xFFFFFFFF, 2);
+    CHECK(slots[PERSIST_journal_newest(slots, valid)].sequence == 0xFFFFFFFF, "the last record before the wrap is not the newest");
+
+    // sequence + 1 wraps to 0 and still goes to the other slot
+    flush(slots, valid, 0, 3);
+    int newest = PERSIST_journal_newest(slots, valid);
+    CHECK(slots[newest].sequence == 0, "record %u is taken over the one after the wrap", slots[newest].sequence);
+    CHECK(slots[newest].values[PERSIST_BEST_DIFF] == 3, "the journal came back with %llu",
+          (unsigned long long) slots[newest].values[PERSIST_BEST_DIFF]);
+
+    flush(slots, valid, 1, 4);
+    CHECK(slots[PERSIST_journal_newest(slots, valid)].sequence == 1, "the journal stopped at the wrap");
+}
+
+int main(void)
+{
+    test_alternating_slots();
+    test_torn_slot();
+    test_sequence_wrap();
+
+    printf("%d failure(s)\n", failures);
+    return failures == 0 ? 0 : 1;
+}